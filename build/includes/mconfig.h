@@ -0,0 +1,26 @@
+// This file is auto-generated by mconfig-gen.cc.
+
+#ifndef DINIT_MCONFIG_H
+#define DINIT_MCONFIG_H 1
+
+// Defines
+
+#define USE_INITGROUPS 1
+#define SUPPORT_CGROUPS 1
+#define SUPPORT_CAPABILITIES 0
+#define SUPPORT_IOPRIO 1
+#define SUPPORT_OOM_ADJ 1
+#define SUPPORT_PIDFD 1
+#define DEFAULT_AUTO_RESTART ALWAYS
+
+// Constants
+
+constexpr static char DINIT_VERSION[] = "0.23.0pre";
+constexpr static char SYSCONTROLSOCKET[] = "/run/dinitctl";
+constexpr static char BINDIR[] = "/usr/bin";
+constexpr static char SBINDIR[] = "/usr/sbin";
+constexpr static char SHUTDOWN_PREFIX[] = "";
+constexpr static unsigned DEFAULT_START_TIMEOUT = 60;
+constexpr static unsigned DEFAULT_STOP_TIMEOUT = 10;
+
+#endif // DINIT_MCONFIG_H
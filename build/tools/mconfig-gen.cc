@@ -86,6 +86,9 @@ int main(int argc, char **argv)
     if (vars.find("SUPPORT_OOM_ADJ") != vars.end()) {
         cout << "#define SUPPORT_OOM_ADJ " << vars["SUPPORT_OOM_ADJ"] << "\n";
     }
+    if (vars.find("SUPPORT_PIDFD") != vars.end()) {
+        cout << "#define SUPPORT_PIDFD " << vars["SUPPORT_PIDFD"] << "\n";
+    }
     if (vars.find("DEFAULT_AUTO_RESTART") != vars.end()) {
         cout << "#define DEFAULT_AUTO_RESTART " << vars["DEFAULT_AUTO_RESTART"] << "\n";
     }
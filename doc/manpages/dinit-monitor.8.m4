@@ -42,6 +42,12 @@ Exit after the first command is executed, instead of waiting for more events.
 Instead of monitoring the services, monitor changes in the global environment.
 If no environment variables are passed, all environment is monitored.
 .TP
+\fB\-a\fR, \fB\-\-all\fR
+Monitor all services, including services that are loaded after \fBdinit\-monitor\fR is started.
+Any services named on the command line are loaded first, but are otherwise not treated specially.
+This option requires a \fBdinit\fR daemon which supports service status subscription, and cannot be
+combined with `\fB\-\-env\fR'.
+.TP
 \fB\-s\fR, \fB\-\-system\fR
 Control the system init process (this is the default when run as root).
 This option determines the default path to the control socket used to communicate with the \fBdinit\fR daemon
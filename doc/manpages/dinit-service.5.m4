@@ -261,6 +261,22 @@ The normal restart restrictions (such as \fBrestart\-limit\-count\fR) apply.
 Specifies the minimum time (in seconds) between automatic restarts.
 The default is 0.2 (200 milliseconds).
 .TP
+\fBrestart\-delay\-max\fR = \fIXXX.YYYY\fR
+Enables exponential backoff of the restart delay, and specifies the maximum delay (in seconds).
+If set to a value greater than that of \fBrestart\-delay\fR, then each time the service restarts
+without its process having run for at least the \fBrestart\-limit\-interval\fR, the delay before the
+next restart is doubled, up to this maximum; once the process has run for that long, the delay
+returns to the \fBrestart\-delay\fR value.
+Note that the delay is measured from the time that the process was last started.
+The default is 0 (no backoff).
+.TP
+\fBrestart\-delay\-jitter\fR = \fINNN\fR
+Specifies a random additional delay before each automatic restart, as a maximum percentage (0\-100)
+of the restart delay.
+This spreads out the restarts of services which would otherwise all be restarted at the same time
+(for example, after the failure of a service that they all rely on).
+The default is 0 (no random delay).
+.TP
 \fBrestart\-limit\-interval\fR = \fIXXX.YYYY\fR
 Sets the interval (in seconds) over which restarts are limited.
 If a process automatically restarts more than a certain number of times (specified by the
@@ -297,6 +313,9 @@ daemon will write its process ID before detaching.
 Dinit will read the contents of this file when starting the service, once the initial process
 terminates (after having forked a child process), and will supervise the child process with the
 discovered process ID.
+If the process is not a child of \fBdinit\fR (for example, if \fBdinit\fR is not running as
+the system init process and is not a subreaper), then on Linux it is supervised via a process
+file descriptor (pidfd), if the kernel supports these; dinit then cannot determine its exit status.
 Dinit may also send signals to the process ID to stop the service; if \fBdinit\fR runs as a
 privileged user, the path should have appropriately restricted permissions to prevent abuse by untrusted
 unprivileged processes.
@@ -461,13 +480,17 @@ using the contents of the specified environment variable, which will be set by \
 execution to a file descriptor (chosen arbitrarily) attached to the write end of a pipe.
 .RE
 .TP
-\fBlog\-type\fR = {\fBfile\fR | \fBbuffer\fR | \fBpipe\fR | \fBnone\fR}
+\fBlog\-type\fR = {\fBfile\fR | \fBrotating\-file\fR | \fBbuffer\fR | \fBpipe\fR | \fBnone\fR}
 Specifies how the output of this service is logged.
 This setting is valid only for process-based services (including \fBscripted\fR services).
 .RS
 .IP \(bu
 \fBfile\fR: output will be written to a file; see the \fBlogfile\fR setting.
 .IP \(bu
+\fBrotating\-file\fR: output will be read (via a pipe) by \fBdinit\fR, which writes it to the
+file specified by the \fBlogfile\fR setting, and rotates the file when it reaches a certain size;
+see the \fBlogfile\-rotate\-size\fR setting.
+.IP \(bu
 \fBbuffer\fR: output will be buffered in memory, up to a limit specified via the
 \fBlog\-buffer\-size\fR setting.
 The buffer contents can be examined via the \fBdinitctl\fR(8) \fBcatlog\fR subcommand. 
@@ -480,7 +503,8 @@ may become full which may cause the service process to stall.
 .RE
 .IP
 The default log type is \fBnone\fR, but note that specifying a \fBlogfile\fR setting can change the
-log type to \fBfile\fR. For \fBpipe\fR (and \fBbuffer\fR, which uses a pipe internally),
+log type to \fBfile\fR. For \fBpipe\fR (and \fBbuffer\fR and \fBrotating\-file\fR, which use a
+pipe internally),
 note that the pipe created may outlive the service process and be re-used if the service is stopped
 and restarted.
 .\"
@@ -520,10 +544,51 @@ The default value is the user id of the \fBdinit\fR process.
 \fBlogfile\-gid\fR = {\fInumeric-group-id\fR | \fIgroup-name\fR}
 Specifies the group of the log file. See discussion of \fBlogfile\-uid\fR.
 .TP
+\fBlogfile\-rotate\-size\fR = \fIsize-in-bytes\fR
+If the log type (see \fBlog\-type\fR) is set to \fBrotating\-file\fR, this setting controls the
+size at which the log file is rotated.
+When the log file reaches (or exceeds) this size, it is renamed with a suffix of \fB.1\fR; any
+previously rotated files are renamed with the suffix number increased by one, and the oldest is removed
+(see \fBlogfile\-rotate\-count\fR).
+A new log file is then created.
+The size may be given with a suffix of \fBK\fR, \fBM\fR or \fBG\fR (for kibibytes, mebibytes and
+gibibytes respectively).
+The default is 1M.
+.TP
+\fBlogfile\-rotate\-count\fR = \fInumber\fR
+Specifies the number of rotated log files that are kept (see \fBlogfile\-rotate\-size\fR).
+If 0, the log file is simply removed when it reaches the rotation size.
+The default is 5.
+.TP
+\fBlogfile\-compress\fR = \fIcommand-line\fR
+Specifies a command used to compress a log file after rotation (see \fBlogfile\-rotate\-size\fR),
+for example "\fBgzip \-f\fR".
+The name of the rotated file (with suffix \fB.1\fR) is appended to the command arguments.
+The command is run in the background by \fBdinit\fR;
+it should replace the file with a compressed file with the same name plus the suffix specified by
+\fBlogfile\-compress\-suffix\fR.
+While the command is running, the log file is not rotated (even if it exceeds the rotation size);
+rotation takes place once the command has finished.
+The command line is subject to variable substitution (see \fBVARIABLE SUBSTITUTION\fR).
+By default, rotated log files are not compressed.
+.TP
+\fBlogfile\-compress\-suffix\fR = \fIsuffix\fR
+Specifies the suffix that the \fBlogfile\-compress\fR command adds to the name of a compressed
+log file.
+The default is \fB.gz\fR.
+.TP
 \fBlog\-buffer\-size\fR = \fIsize-in-bytes\fR
 If the log type (see \fBlog\-type\fR) is set to \fBbuffer\fR, this setting controls the maximum
 size of the buffer used to store process output.
-If the buffer becomes full, further output from the service process will be discarded.
+If the buffer becomes full, output from the service process will be discarded as specified by
+the \fBlog\-buffer\-overflow\fR setting.
+.TP
+\fBlog\-buffer\-overflow\fR = {\fBdiscard\-new\fR | \fBdiscard\-old\fR}
+Specifies what happens when the log buffer (see \fBlog\-buffer\-size\fR) is full.
+With \fBdiscard\-new\fR (the default), further output from the service process is discarded, so that
+the buffer retains the earliest output.
+With \fBdiscard\-old\fR, the oldest output in the buffer is overwritten by new output, so that
+the buffer retains the most recent output.
 .TP
 \fBconsumer\-of\fR = \fIservice-name\fR
 Specifies that this service consumes (as its standard input) the output of another service.
@@ -604,6 +669,16 @@ When the given value is out of range for the operating system, it will be clampe
 supported range, but no error will be issued.
 On Linux, this also sets the autogroup priority (if the procfs filesystem has been mounted appropriately).
 .TP
+\fBstart\-priority\fR = \fIpriority\fR
+Specifies the priority of the service when starting, as an integer between -32768 and 32767
+(default 0).
+When the number of concurrently starting services is limited (see the \fB\-\-start\-limit\fR option
+of \fBdinit\fR(8)), services that are ready to start are dispatched in order of highest priority
+first.
+Amongst services with the same priority, those with more dependents waiting for them to start are
+dispatched first.
+This setting is only meaningful for process, bgprocess and scripted services.
+.TP
 \fBrun\-in\-cgroup\fR = \fIcgroup-path\fR
 Run the service process(es) in the specified \[lq]cgroup\[rq] (see \fBcgroups\fR(7)).
 The cgroup is specified as a path; if it has a leading slash, the remainder of the path is
@@ -616,11 +691,28 @@ hierarchy with no cgroups v1 hierarchies, or a single cgroups v1 hierarchy).
 Note that due to the \[lq]no internal processes\[rq] rule in cgroups v2, a relative path must typically
 begin with `..' if cgroups v2 are used.
 .IP
-The named cgroup must already exist prior to the service starting; it will not be created by
-\fBdinit\fR.
+The named cgroup must already exist prior to the service starting, unless the \fBcreate\-cgroup\fR
+option is set.
 .IP
 This setting is only available if \fBdinit\fR was built with cgroups support.
 .TP
+\fBcgroup\-memory\-max\fR = \fIbytes\fR
+Set the memory limit (\fImemory.max\fR) of the service cgroup, in bytes, before the service
+process is started.
+A suffix of `K', `M', `G' or `T' multiplies the value by the corresponding power of 1024;
+the value `max' removes any limit.
+Requires cgroups v2 and that either \fBrun\-in\-cgroup\fR or \fBcreate\-cgroup\fR is set.
+.TP
+\fBcgroup\-cpu\-weight\fR = \fIweight\fR
+Set the relative CPU weight (\fIcpu.weight\fR, 1\(en10000; the kernel default is 100) of the
+service cgroup, before the service process is started.
+Requires cgroups v2 and that either \fBrun\-in\-cgroup\fR or \fBcreate\-cgroup\fR is set.
+.TP
+\fBcgroup\-io\-weight\fR = \fIweight\fR
+Set the default relative I/O weight (\fIio.weight\fR, 1\(en10000; the kernel default is 100) of the
+service cgroup, before the service process is started.
+Requires cgroups v2 and that either \fBrun\-in\-cgroup\fR or \fBcreate\-cgroup\fR is set.
+.TP
 \fBcapabilities\fR = \fIiab\fR
 .TQ
 \fBcapabilities\fR += \fIiab-addendum\fR
@@ -798,6 +890,35 @@ dependent of the service with this option set.
 .IP
 This option can be used for scripted and internal services only.
 .TP
+\fBkill\-cgroup\fR
+When stopping the service, treat all processes in the cgroup specified by \fBrun\-in\-cgroup\fR
+as belonging to the service.
+Once the main service process has terminated, any processes remaining in the cgroup are killed
+(via the \fIcgroup.kill\fR file, which requires Linux 5.14 or later), and the service is considered
+stopped only once the cgroup is empty (as reported by the \fIcgroup.events\fR file), or once the
+stop timeout (see \fBstop\-timeout\fR) has expired.
+If the stop timeout expires while the main process is still running, all processes in the cgroup
+are killed, rather than only the process group of the main process.
+.IP
+The cgroup must not be shared with any other service.
+This option can be used for process and bgprocess services only, and requires that
+\fBrun\-in\-cgroup\fR is also set.
+It is only available if \fBdinit\fR was built with cgroups support.
+.TP
+\fBcreate\-cgroup\fR
+Create the service cgroup (see \fBrun\-in\-cgroup\fR) when the service starts, if it does not
+already exist, and remove it again when the service stops (if it was created by \fBdinit\fR and is
+empty).
+If \fBrun\-in\-cgroup\fR is not set, the cgroup path defaults to the service name, relative to the
+cgroup in which \fBdinit\fR is running.
+Due to the \[lq]no internal processes\[rq] rule in cgroups v2, that default is only suitable if
+\fBdinit\fR runs in the root cgroup (as it typically does when running as the system manager).
+.IP
+The \fIcpu\fR, \fImemory\fR, \fIio\fR and \fIpids\fR controllers are enabled for the new cgroup
+where available, and the resource usage of the cgroup is then reported by \fBdinitctl status\fR.
+This option can be used for process, bgprocess and scripted services only.
+It is only available if \fBdinit\fR was built with cgroups support.
+.TP
 \fBno\-new\-privs\fR
 Normally, child processes can gain privileges that their parent did not have, such
 as setuid or setgid and file capabilities. This option can be specified to prevent
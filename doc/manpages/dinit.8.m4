@@ -107,6 +107,15 @@ Automatically run the \fBrecovery\fR service on apparent boot failures (if all
 services stop without a shutdown command having been issued) without prompting
 the user when \fBdinit\fR is running as system manager.
 .TP
+\fB\-\-log\-buffer\-max\fR \fIbytes\fR
+Specify the maximum size of the buffer which holds log messages waiting to be written, for each of
+the console and the main log (default 65536 bytes).
+The buffer initially has a size of 4096 bytes and grows as necessary, up to this size.
+If the buffer is full, buffered messages with a lower log level than a new message are discarded
+to make room for the new message; otherwise, the new message is discarded.
+A notice of the number of discarded messages is then logged, and the counts of discarded messages
+can be queried via \fBdinitctl log\-stats\fR.
+.TP
 \fB\-q\fR, \fB\-\-quiet\fR
 Run with no output to the terminal/console.
 This disables service status messages and sets the log level for the console log to \fBnone\fR.
@@ -118,6 +127,50 @@ If service description settings contain relative cgroup paths, they will be reso
 this path.
 This option is only available if \fBdinit\fR is built with cgroups support.
 .TP
+\fB\-\-preload\fR
+Before loading any service, advise the operating system that all service description files in the
+service directories will be needed, so that they may be read in ahead of time.
+This may reduce the time taken to load services at boot when the service directories reside on slow
+storage.
+The option has no effect on systems which do not support such advice.
+.TP
+\fB\-\-auto\-reload\fR
+Watch the service directories, and any files included by service descriptions (via \fB@include\fR
+or \fB@include\-opt\fR), for changes; when the description of a loaded service changes, reload the
+service as if by \fBdinitctl reload\fR (see \fBdinitctl\fR(8)).
+Changes are collected until none have occurred for a short interval (a quarter of a second), so that
+a burst of changes results in each affected service being reloaded only once.
+A service which is referenced by a control connection (for example, by \fBdinit\-monitor\fR) is not
+reloaded automatically.
+Statistics can be queried using \fBdinitctl auto-reload-stats\fR.
+This option is available only on Linux.
+.TP
+\fB\-\-start\-limit\fR \fIcount\fR
+Limit the number of services which may concurrently be starting a process (i.e. which have had their
+dependencies satisfied and are waiting for their process to start or to signal readiness).
+Other services which are ready to start wait until the number of starting services falls below
+the limit, and are then started in order of their \fBstart\-priority\fR (see \fBdinit-service\fR(5)).
+This can reduce contention for disk and CPU at boot, so that critical services become ready sooner.
+The default, 0, means no limit.
+Internal and triggered services are not subject to the limit.
+.TP
+\fB\-\-journal\fR \fIfile\fR
+Record log messages (at or above the main log level) and service events (started, stopped and
+failed) in the specified boot journal file.
+The journal is a fixed-size binary file, which is memory-mapped by \fBdinit\fR so that records
+are written immediately, without waiting for the main log to become available and without
+blocking on it.
+When it is full, the oldest records are overwritten.
+Existing records are kept when \fBdinit\fR starts (including via soft reboot), so the journal
+can be used to examine a previous boot if the file is on a persistent filesystem, or the current
+boot if it is on a \fItmpfs\fR such as \fI/run\fR (the filesystem must be mounted when
+\fBdinit\fR starts).
+Use \fBdinitctl journal\fR to display the contents of the journal.
+.TP
+\fB\-\-journal\-size\fR \fIbytes\fR
+Specify the size of the boot journal file (default 1048576 bytes, minimum 65536 bytes).
+If an existing journal file has a different size, its contents are discarded.
+.TP
 \fB\-\-help\fR
 Display brief help text and then exit.
 .TP
@@ -15,10 +15,10 @@ dinitctl \- control services supervised by Dinit
 .nh
 .HP
 .B dinitctl
-[\fIoptions\fR] \fBstart\fR [\fB\-\-no\-wait\fR] [\fB\-\-pin\fR] \fIservice-name\fR
+[\fIoptions\fR] \fBstart\fR [\fB\-\-no\-wait\fR] [\fB\-\-pin\fR] \fIservice-name\fR...
 .HP
 .B dinitctl
-[\fIoptions\fR] \fBstop\fR [\fB\-\-no\-wait\fR] [\fB\-\-pin\fR] [\fB\-\-ignore\-unstarted\fR] \fIservice-name\fR
+[\fIoptions\fR] \fBstop\fR [\fB\-\-no\-wait\fR] [\fB\-\-pin\fR] [\fB\-\-ignore\-unstarted\fR] \fIservice-name\fR...
 .HP
 .B dinitctl
 [\fIoptions\fR] \fBstatus\fR \fIservice-name\fR
@@ -33,10 +33,10 @@ dinitctl \- control services supervised by Dinit
 [\fIoptions\fR] \fBrestart\fR [\fB\-\-no\-wait\fR] [\fB\-\-ignore\-unstarted\fR] \fIservice-name\fR
 .HP
 .B dinitctl
-[\fIoptions\fR] \fBwake\fR [\fB\-\-no\-wait\fR] \fIservice-name\fR
+[\fIoptions\fR] \fBwake\fR [\fB\-\-no\-wait\fR] \fIservice-name\fR...
 .HP
 .B dinitctl
-[\fIoptions\fR] \fBrelease\fR [\fB\-\-ignore\-unstarted\fR] \fIservice-name\fR
+[\fIoptions\fR] \fBrelease\fR [\fB\-\-ignore\-unstarted\fR] \fIservice-name\fR...
 .HP
 .B dinitctl
 [\fIoptions\fR] \fBunpin\fR \fIservice-name\fR
@@ -48,7 +48,7 @@ dinitctl \- control services supervised by Dinit
 [\fIoptions\fR] \fBreload\fR \fIservice-name\fR
 .HP
 .B dinitctl
-[\fIoptions\fR] \fBlist\fR
+[\fIoptions\fR] \fBlist\fR [\fB\-\-state\fR [\fB!\fR]\fIstate\fR] [\fB\-\-target\fR \fIstate\fR] [\fB\-\-type\fR \fItype\fR] [\fB\-\-failed\fR] [\fIname-pattern\fR]
 .HP
 .B dinitctl
 [\fIoptions\fR] \fBshutdown\fR
@@ -82,6 +82,21 @@ dinitctl \- control services supervised by Dinit
 .HP
 .B dinitctl
 [\fIoptions\fR] \fBsignal\fR { \fIsignal-id\fR \fIservice-name\fR | \fB\-\-list\fR | \fB-l\fR }
+.HP
+.B dinitctl
+[\fIoptions\fR] \fBanalyze\fR [\fIservice-name\fR]
+.HP
+.B dinitctl
+[\fIoptions\fR] \fBlog\-stats\fR
+.HP
+.B dinitctl
+[\fIoptions\fR] \fBmem\-usage\fR
+.HP
+.B dinitctl
+[\fIoptions\fR] \fBauto\-reload\-stats\fR
+.HP
+.B dinitctl
+[\fIoptions\fR] \fBjournal\fR [\fB\-\-service\fR \fIservice-name\fR] [\fB\-\-level\fR \fIlevel\fR] \fIjournal-file\fR
 .\"
 .PD
 .hy
@@ -172,8 +187,41 @@ success.
 \fB\-\-clear\fR
 Clear the log buffer for the service after displaying it.
 .TP
+\fB\-\-state\fR [\fB!\fR]\fIstate\fR
+List only services in the given state (\fBstarted\fR, \fBstarting\fR, \fBstopped\fR or
+\fBstopping\fR), or with a `\fB!\fR' prefix, only services not in the given state.
+.TP
+\fB\-\-target\fR \fIstate\fR
+List only services with the given target state (\fBstarted\fR or \fBstopped\fR).
+.TP
+\fB\-\-type\fR \fItype\fR
+List only services of the given type (\fBprocess\fR, \fBbgprocess\fR, \fBscripted\fR,
+\fBinternal\fR or \fBtriggered\fR).
+.TP
+\fB\-\-failed\fR
+List only services which have failed (those shown with an `X' indicator).
+.TP
+\fB\-\-service\fR \fIservice-name\fR
+For the \fBjournal\fR command, display only events (started, stopped, failed) for the specified
+service.
+.TP
+\fB\-\-level\fR \fIlevel\fR
+For the \fBjournal\fR command, display only records at or above the specified log level
+(\fBdebug\fR, \fBinfo\fR, \fBwarn\fR or \fBerror\fR).
+.TP
+\fIjournal-file\fR
+For the \fBjournal\fR command, the path of the boot journal file.
+.TP
+\fIname-pattern\fR
+For the \fBlist\fR command, list only services with names matching the given shell wildcard pattern.
+.TP
 \fIservice-name\fR
 Specifies the name of the service to which the command applies (including any argument suffix).
+The \fBstart\fR, \fBstop\fR, \fBwake\fR and \fBrelease\fR commands accept multiple service
+names; the command is then applied to all the named services together, and success is returned only if
+it succeeds for every one of them.
+When stopping several services without \fB\-\-force\fR, dependents which are themselves named in the
+same command do not prevent a service from stopping.
 .\"
 .SH COMMAND DESCRIPTIONS
 .\"
@@ -205,6 +253,10 @@ This will show the current state (and target state, if different), and informati
 ID (\[lq]pid\[rq]) if applicable.
 If the service is stopped for any reason other than a normal stop, the reason for the service
 stopping will be displayed (along with any further relevant information, if available).
+For a service that runs in a cgroup and is not stopped, the CPU time, memory and number of tasks
+accounted to the cgroup are also shown (where the corresponding cgroup controllers are enabled).
+For a service which restarts with backoff (see \fBrestart\-delay\-max\fR in \fBdinit-service\fR(5)),
+the current restart delay is shown once it has been increased.
 .TP
 \fBis\-started\fR
 Check if the specified service is currently started.
@@ -257,6 +309,9 @@ If any hard dependencies are added to a running service, the dependencies must a
 .TP
 \fBlist\fR
 List loaded services and their state.
+If any of the filtering options (\fB\-\-state\fR, \fB\-\-target\fR, \fB\-\-type\fR, \fB\-\-failed\fR)
+or a \fIname-pattern\fR is given, only the services matching all of the specified criteria are listed.
+Filtering is performed by \fBdinit\fR, which requires a recent enough daemon.
 Before each service, one of the following state indicators is displayed:
 .sp
 .EX
@@ -352,6 +407,44 @@ minus the \fBSIG\fR- prefix; a limited selection of signal names are recognised,
 \fBTERM\fR, \fBHUP\fR, and \fBKILL\fR).
 The \fB--list\fR (\fB-l\fR) option can be used (without \fIsignal-id\fR and \fIservice-name\fR)
 to list the full set of supported signal names.
+.TP
+\fBanalyze\fR
+Analyse service startup times.
+The critical path to the specified service (or, if no service is specified, the service that
+started most recently) is shown: this is the chain of dependencies, each of which was the last
+to start before its dependent could begin starting.
+For each service in the path, the time at which it started (relative to the earliest start
+request) and the time it took to start once its own dependencies were satisfied are shown.
+The services which took the longest to start are then listed.
+Times reflect the most recent start of each service.
+.TP
+\fBlog\-stats\fR
+Show statistics for the buffers holding log messages which are waiting to be written to the
+main log and to the console: the amount of data currently buffered, the current and maximum size
+of each buffer, and the number of messages at each log level which have been discarded because
+the buffer was full.
+See the \fB\-\-log\-buffer\-max\fR option in \fBdinit\fR(8).
+.TP
+\fBmem\-usage\fR
+Show the memory used by each loaded service (including placeholders for services which are
+named as dependencies but not yet loaded), largest first, and the total.
+For each service, the size of the service record itself and the amount of additional heap memory
+held for it (dependency records, strings, the log buffer and so on) are shown, in bytes.
+The heap figure is an estimate: it does not include allocator overhead, or memory shared
+between services.
+.TP
+\fBauto\-reload\-stats\fR
+Show statistics for automatic reload of changed service descriptions (see the \fB\-\-auto\-reload\fR
+option in \fBdinit\fR(8)): the number of change events seen and of batches of changes processed,
+the number of services reloaded, which failed to reload, or which were not reloaded because they
+were referenced by a control connection, and the time taken from the first change in a batch until
+the affected services were reloaded (for the most recent batch, and the maximum).
+.TP
+\fBjournal\fR
+Display the records in a boot journal file (see the \fB\-\-journal\fR option in \fBdinit\fR(8)),
+oldest first, with the time and log level of each.
+The file is read directly; no connection to the \fBdinit\fR daemon is made.
+Records which were only partially written (for example, because of a crash) are ignored.
 .\"
 .SH SERVICE OPERATION
 .\"
@@ -113,6 +113,14 @@ If the shutdown hook cleanly unmounts (or remounts as read-only) all file system
 root file system, it should exit with status 0 (success), which will prevent \fB$$$SHUTDOWN_PREFIX@@@shutdown\fR from
 attempting to unmount file systems itself.
 If it does not unmount file systems, the script should exit with a status other than 0.
+.LP
+Otherwise, \fB$$$SHUTDOWN_PREFIX@@@shutdown\fR turns off swap and unmounts file systems itself.
+On Linux, the mount table is read from \fI/proc/self/mountinfo\fR, and file systems are unmounted
+in parallel except that a file system is unmounted only after those mounted beneath it.
+A file system which cannot be unmounted is remounted read-only (the root file system is only
+remounted read-only).
+As for \fBumount \-a\fR, \fBproc\fR, \fBsysfs\fR and certain other pseudo-filesystems are
+not unmounted.
 .\"
 .SH SEE ALSO
 .\"
@@ -1,5 +1,8 @@
 #include <cstring>
 #include <cstdlib>
+#include <csignal>
+#include <system_error>
+#include <limits>
 
 #include <sys/un.h>
 #include <sys/socket.h>
@@ -40,6 +43,7 @@ bool base_process_service::bring_up() noexcept
     }
     else {
         restart_interval_count = 0;
+        restart_backoff_count = 0;
         start_success = start_ps_process(exec_arg_parts,
                 onstart_flags.starts_on_console || onstart_flags.shares_console);
         // start_ps_process updates last_start_time, use it also for restart_interval_time:
@@ -85,9 +89,77 @@ void base_process_service::handle_unexpected_termination() noexcept
         // If we're going to restart, we can kick that off now:
         if (get_target_state() == service_state_t::STARTED && !pinned_stopped) {
             initiate_start();
-            services->process_queues();
+            services->process_queues_batched();
+        }
+    }
+}
+
+void base_process_service::prepare_proc_env(run_proc_env &proc_env, const char *notify_var,
+        bool have_socket, bool have_cs_fd)
+{
+    proc_env.valid = false;
+    proc_env.notify_var.clear();
+    proc_env.env_map = service_env.build(main_env);
+
+    if (notify_var != nullptr && *notify_var != 0) {
+        // The variable name, '=', and space for the value and nul terminator:
+        size_t notify_var_len = strlen(notify_var);
+        proc_env.notify_var.assign(notify_var_len + 1 + type_max_num_digits<int>() + 1, '\0');
+        buf_print(&proc_env.notify_var[0], notify_var, '=');
+        proc_env.env_map.set_var(proc_env.notify_var.c_str());
+    }
+
+    if (have_socket) {
+        proc_env.env_map.set_var("LISTEN_FDS=1");
+        buf_print(proc_env.listen_pid, "LISTEN_PID=");
+        proc_env.env_map.set_var(proc_env.listen_pid);
+    }
+
+    if (have_cs_fd) {
+        buf_print(proc_env.cs_fd, "DINIT_CS_FD=");
+        proc_env.env_map.set_var(proc_env.cs_fd);
+    }
+
+    proc_env.have_socket = have_socket;
+    proc_env.valid = true;
+}
+
+run_proc_env &base_process_service::get_proc_env(bool for_stop)
+{
+    if (!listening_main_env) {
+        main_env.add_listener(this);
+        listening_main_env = true;
+    }
+
+    // The socket may be opened or closed between launches, so check that it matches:
+    bool have_socket = (socket_fd != -1);
+    run_proc_env &proc_env = for_stop ? stop_proc_env : start_proc_env;
+    if (!proc_env.valid || proc_env.have_socket != have_socket) {
+        if (for_stop) {
+            prepare_proc_env(proc_env, nullptr, have_socket, false);
+        }
+        else {
+            prepare_proc_env(proc_env, notification_var.c_str(), have_socket, onstart_flags.pass_cs_fd);
         }
     }
+    return proc_env;
+}
+
+bool base_process_service::can_vfork_spawn(bool on_console) noexcept
+{
+    // Console handoff (and utmp entry creation, via after_fork) are left to a regular fork.
+    if (on_console || needs_after_fork()) return false;
+
+    // Setting the user/group may require looking up the user database and initialising the supplementary
+    // groups, which allocates; the C library may also need to coordinate the change across threads.
+    if (run_as_uid != uid_t(-1)) return false;
+
+    #if SUPPORT_CAPABILITIES
+    // The capabilities library allocates:
+    if (cap_iab.get() != nullptr || secbits != 0) return false;
+    #endif
+
+    return true;
 }
 
 bool base_process_service::start_ps_process(const std::vector<const char *> &cmd, bool on_console) noexcept
@@ -98,6 +170,9 @@ bool base_process_service::start_ps_process(const std::vector<const char *> &cmd
     // is written to the pipe, and the parent can read it.
 
     event_loop.get_time(last_start_time, clock_type::MONOTONIC);
+    if (get_state() == service_state_t::STARTING) {
+        record_start_time(start_stage_t::EXEC_ISSUED);
+    }
 
     int pipefd[2];
     if (bp_sys::pipe2(pipefd, O_CLOEXEC)) {
@@ -117,7 +192,7 @@ bool base_process_service::start_ps_process(const std::vector<const char *> &cmd
             logfile = "/dev/null";
         }
     }
-    else /* log_type_id::BUFFER or ::PIPE */ {
+    else /* log_type_id::BUFFER, ::PIPE or ::ROTFILE */ {
         if (this->log_output_fd == -1) {
             int logfd[2];
             // Note: we set CLOEXEC on the file descriptors here; when the output file descriptor is dup'd
@@ -128,7 +203,7 @@ bool base_process_service::start_ps_process(const std::vector<const char *> &cmd
             }
             this->log_input_fd = logfd[0];
             this->log_output_fd = logfd[1];
-            if (this->log_type == log_type_id::BUFFER) {
+            if (value(this->log_type).is_in(log_type_id::BUFFER, log_type_id::ROTFILE)) {
                 try {
                     this->log_output_listener.add_watch(event_loop, logfd[0], dasynq::IN_EVENTS,
                             false /* not enabled */);
@@ -143,6 +218,11 @@ bool base_process_service::start_ps_process(const std::vector<const char *> &cmd
                 }
             }
         }
+        if (this->log_type == log_type_id::ROTFILE && logfile_fd == -1) {
+            if (!open_rotfile()) {
+                goto out_lfd;
+            }
+        }
         // (More is done below, after we have performed additional setup)
     }
 
@@ -155,6 +235,7 @@ bool base_process_service::start_ps_process(const std::vector<const char *> &cmd
         bool have_notify = !notification_var.empty() || force_notification_fd != -1;
         ready_notify_watcher * rwatcher = have_notify ? get_ready_watcher() : nullptr;
         bool ready_watcher_registered = false;
+        run_proc_env *proc_env;
 
         if (onstart_flags.pass_cs_fd) {
             if (dinit_socketpair(AF_UNIX, SOCK_STREAM, /* protocol */ 0, control_socket, SOCK_NONBLOCK)) {
@@ -197,10 +278,14 @@ bool base_process_service::start_ps_process(const std::vector<const char *> &cmd
             }
         }
 
-        if (log_type == log_type_id::BUFFER) {
+        if (log_type == log_type_id::ROTFILE) {
+            log_output_listener.set_enabled(event_loop, true);
+        }
+        else if (log_type == log_type_id::BUFFER) {
             // Set watcher enabled if space in buffer
             if (log_buf_size > 0) {
                 // Append a "restarted" message to buffer contents
+                unwrap_log_buffer();
                 const char *restarting_msg = "\n(dinit: note: service restarted)\n";
                 unsigned restarting_msg_len = strlen(restarting_msg);
                 bool trailing_nl = log_buffer[log_buf_size - 1] == '\n';
@@ -209,7 +294,13 @@ bool base_process_service::start_ps_process(const std::vector<const char *> &cmd
                     --restarting_msg_len;
                 }
                 if (log_buf_size + restarting_msg_len >= log_buf_max) {
-                    goto skip_enable_log_watch;
+                    if (!log_buf_discard_old || restarting_msg_len >= log_buf_max) {
+                        goto skip_enable_log_watch;
+                    }
+                    // Discard oldest output to make room:
+                    unsigned discard_len = log_buf_size + restarting_msg_len - log_buf_max;
+                    log_buf_size -= discard_len;
+                    memmove(log_buffer.data(), log_buffer.data() + discard_len, log_buf_size);
                 }
                 if (!ensure_log_buffer_backing(log_buf_size + restarting_msg_len)) {
                     goto skip_enable_log_watch;
@@ -225,26 +316,23 @@ bool base_process_service::start_ps_process(const std::vector<const char *> &cmd
 
         pid_t forkpid;
 
+        #if SUPPORT_CGROUPS
+        if (!setup_cgroup()) {
+            goto out_cs_h;
+        }
+        #endif
+
         try {
-            child_status_listener.add_watch(event_loop, pipefd[0], dasynq::IN_EVENTS);
-            child_status_registered = true;
-
-            // We specify a high priority (i.e. low priority value) so that process termination is
-            // handled early. This means we have always recorded that the process is terminated by the
-            // time that we handle events that might otherwise cause us to signal the process, so we
-            // avoid sending a signal to an invalid (and possibly recycled) process ID.
-            forkpid = child_listener.fork(event_loop, reserved_child_watch, dasynq::DEFAULT_PRIORITY - 10);
-            reserved_child_watch = true;
-        }
-        catch (std::exception &e) {
-            log(loglevel_t::ERROR, get_name(), ": could not fork: ", e.what());
+            proc_env = &get_proc_env(false);
+        }
+        catch (std::bad_alloc &) {
+            log(loglevel_t::ERROR, get_name(), ": can't launch process; out of memory");
             goto out_cs_h;
         }
 
-        if (forkpid == 0) {
+        {
             const char * working_dir_c = service_dsc_dir;
             if (!working_dir.empty()) working_dir_c = working_dir.c_str();
-            after_fork(getpid());
             run_proc_params run_params{cmd.data(), working_dir_c, logfile, pipefd[1], run_as_uid, run_as_gid, rlimits};
             run_params.on_console = on_console;
             run_params.in_foreground = !onstart_flags.shares_console;
@@ -259,6 +347,7 @@ bool base_process_service::start_ps_process(const std::vector<const char *> &cmd
             run_params.input_fd = input_fd;
             run_params.nice_is_set = nice_is_set;
             run_params.nice = nice;
+            run_params.proc_env = proc_env;
             #if SUPPORT_CGROUPS
             run_params.run_in_cgroup = run_in_cgroup.c_str();
             #endif
@@ -274,20 +363,69 @@ bool base_process_service::start_ps_process(const std::vector<const char *> &cmd
             run_params.oom_adj_is_set = oom_adj_is_set;
             run_params.oom_adj = oom_adj;
             #endif
-            run_child_proc(run_params);
-        }
-        else {
-            // Parent process
-            pid = forkpid;
-
-            bp_sys::close(pipefd[1]); // close the 'other end' fd
-            if (control_socket[1] != -1) bp_sys::close(control_socket[1]);
-            if (notify_pipe[1] != -1) bp_sys::close(notify_pipe[1]);
-            notification_fd = notify_pipe[0];
-            waiting_for_execstat = true;
-            return true;
+
+            try {
+                child_status_listener.add_watch(event_loop, pipefd[0], dasynq::IN_EVENTS);
+                child_status_registered = true;
+
+                // We specify a high priority (i.e. low priority value) so that process termination is
+                // handled early. This means we have always recorded that the process is terminated by the
+                // time that we handle events that might otherwise cause us to signal the process, so we
+                // avoid sending a signal to an invalid (and possibly recycled) process ID.
+                if (bp_sys::have_vfork_call && can_vfork_spawn(on_console)) {
+                    // Launch without copying our address space. The child runs (and execs) before
+                    // vfork_call returns, so we must reserve the child watch in advance.
+                    if (!reserved_child_watch) {
+                        child_listener.reserve_watch(event_loop);
+                        reserved_child_watch = true;
+                    }
+
+                    struct child_args_t {
+                        base_process_service *service;
+                        run_proc_params *params;
+                    } child_args = { this, &run_params };
+
+                    auto child_fn = [](void *arg) -> int {
+                        child_args_t *args = static_cast<child_args_t *>(arg);
+                        args->service->run_child_proc(*args->params);
+                        return 0; // not reached
+                    };
+
+                    // The child sets the environment before exec, which we must restore:
+                    char **orig_environ = bp_sys::environ;
+                    forkpid = bp_sys::vfork_call(child_fn, &child_args);
+                    bp_sys::environ = orig_environ;
+                    if (forkpid == -1) {
+                        throw std::system_error(errno, std::system_category());
+                    }
+                    child_listener.add_reserved(event_loop, forkpid, dasynq::DEFAULT_PRIORITY - 10);
+                }
+                else {
+                    forkpid = child_listener.fork(event_loop, reserved_child_watch, dasynq::DEFAULT_PRIORITY - 10);
+                    reserved_child_watch = true;
+                }
+            }
+            catch (std::exception &e) {
+                log(loglevel_t::ERROR, get_name(), ": could not fork: ", e.what());
+                goto out_cs_h;
+            }
+
+            if (forkpid == 0) {
+                after_fork(getpid());
+                run_child_proc(run_params);
+            }
         }
 
+        // Parent process
+        pid = forkpid;
+
+        bp_sys::close(pipefd[1]); // close the 'other end' fd
+        if (control_socket[1] != -1) bp_sys::close(control_socket[1]);
+        if (notify_pipe[1] != -1) bp_sys::close(notify_pipe[1]);
+        notification_fd = notify_pipe[0];
+        waiting_for_execstat = true;
+        return true;
+
         // Failure exit:
 
         out_cs_h:
@@ -326,12 +464,173 @@ bool base_process_service::start_ps_process(const std::vector<const char *> &cmd
     return false;
 }
 
+bool base_process_service::open_rotfile() noexcept
+{
+    int fd = bp_sys::open(logfile.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, logfile_perms);
+    if (fd == -1) {
+        log(loglevel_t::ERROR, get_name(), ": can't open log file ", logfile.c_str(), ": ",
+                strerror(errno));
+        return false;
+    }
+
+    struct stat statbuf;
+    if (bp_sys::fchown(fd, logfile_uid, logfile_gid) == -1
+            || bp_sys::fchmod(fd, logfile_perms) == -1
+            || bp_sys::fstat(fd, &statbuf) == -1) {
+        log(loglevel_t::ERROR, get_name(), ": can't set up log file ", logfile.c_str(), ": ",
+                strerror(errno));
+        bp_sys::close(fd);
+        return false;
+    }
+
+    logfile_fd = fd;
+    logfile_size = statbuf.st_size;
+    return true;
+}
+
+void base_process_service::write_rotfile(const char *data, size_t len) noexcept
+{
+    if (logfile_fd == -1 && !open_rotfile()) {
+        return;
+    }
+
+    while (len > 0) {
+        ssize_t r = bp_sys::write(logfile_fd, data, len);
+        if (r == -1) {
+            if (errno == EINTR) continue;
+            // Report only the first of a run of failures (output is discarded meanwhile):
+            if (!logfile_write_failed) {
+                log(loglevel_t::WARN, get_name(), ": can't write to log file: ", strerror(errno));
+                logfile_write_failed = true;
+            }
+            return;
+        }
+        data += r;
+        len -= r;
+        logfile_size += r;
+    }
+    logfile_write_failed = false;
+
+    // (If the previous rotated file is still being compressed, rotation is deferred until the
+    // compress command finishes; see log_compress_watcher::status_change)
+    if (logfile_size >= logfile_rotate_size && logfile_compress_pid == -1) {
+        rotate_logfile();
+    }
+}
+
+dasynq::rearm log_compress_watcher::status_change(eventloop_t &loop, pid_t child,
+        proc_status_t status) noexcept
+{
+    base_process_service *sr = service;
+    sr->logfile_compress_pid = -1;
+    stop_watch(loop); // (retain the watch reservation for the next compress command)
+
+    if (sr->logfile_fd != -1 && sr->logfile_size >= sr->logfile_rotate_size) {
+        sr->rotate_logfile();
+    }
+
+    return dasynq::rearm::NOOP;
+}
+
+void base_process_service::rotate_logfile() noexcept
+{
+    bp_sys::close(logfile_fd);
+    logfile_fd = -1;
+
+    try {
+        bool compress = !logfile_compress.empty();
+        auto rotated_name = [&](unsigned n, bool compressed) -> string {
+            string name = logfile + '.' + std::to_string(n);
+            if (compressed) name += logfile_compress_suffix;
+            return name;
+        };
+
+        if (logfile_rotate_count == 0) {
+            bp_sys::unlink(logfile.c_str());
+        }
+        else {
+            // Discard the oldest, and shift the rest along. A rotated file may or may not have been
+            // compressed (compression may have failed, or still be in progress), so we deal with
+            // both names.
+            for (bool compressed : {false, true}) {
+                if (compressed && !compress) break;
+                bp_sys::unlink(rotated_name(logfile_rotate_count, compressed).c_str());
+                for (unsigned n = logfile_rotate_count - 1; n > 0; --n) {
+                    bp_sys::rename(rotated_name(n, compressed).c_str(),
+                            rotated_name(n + 1, compressed).c_str());
+                }
+            }
+
+            string first_name = rotated_name(1, false);
+            if (bp_sys::rename(logfile.c_str(), first_name.c_str()) == -1) {
+                log(loglevel_t::WARN, get_name(), ": can't rotate log file: ", strerror(errno));
+            }
+            else if (compress) {
+                // Run the compress command in the background. We watch for its termination, since
+                // the next rotation (which would rename the file being compressed) must wait for
+                // it.
+                if (!reserved_compress_watch) {
+                    compress_listener.reserve_watch(event_loop);
+                    reserved_compress_watch = true;
+                }
+
+                std::vector<const char *> args = logfile_compress_parts;
+                args.back() = first_name.c_str();
+                args.push_back(nullptr);
+
+                auto child_fn = [](void *arg) -> int {
+                    const char * const *args = static_cast<const char * const *>(arg);
+                    sigset_t sigset;
+                    sigemptyset(&sigset);
+                    sigprocmask(SIG_SETMASK, &sigset, nullptr);
+                    execvp(args[0], const_cast<char * const *>(args));
+                    _exit(1);
+                };
+
+                pid_t child;
+                if (bp_sys::have_vfork_call) {
+                    child = bp_sys::vfork_call(child_fn, args.data());
+                }
+                else {
+                    child = fork();
+                    if (child == 0) child_fn(args.data());
+                }
+                if (child == -1) {
+                    log(loglevel_t::WARN, get_name(), ": can't run log compress command: ",
+                            strerror(errno));
+                }
+                else {
+                    compress_listener.add_reserved(event_loop, child);
+                    logfile_compress_pid = child;
+                }
+            }
+        }
+    }
+    catch (std::bad_alloc &) {
+        log(loglevel_t::WARN, get_name(), ": can't rotate log file: out of memory");
+    }
+
+    if (open_rotfile() && logfile_size >= logfile_rotate_size) {
+        // Rotation failed; start counting from zero, so we don't try again (and most likely fail
+        // again) on every write.
+        logfile_size = 0;
+    }
+}
+
 base_process_service::base_process_service(service_set *sset, string name,
         service_type_t service_type_p, ha_string &&command,
         const std::list<std::pair<unsigned,unsigned>> &command_offsets,
         const std::list<prelim_dep> &deplist_p)
-     : service_record(sset, name, service_type_p, deplist_p), child_listener(this),
-       child_status_listener(this), process_timer(this), log_output_listener(this)
+     : service_record(sset, name, service_type_p, deplist_p),
+       #if SUPPORT_CGROUPS
+       cgroup_watcher(this),
+       #endif
+       #if SUPPORT_PIDFD
+       pidfd_listener(this),
+       #endif
+       child_listener(this),
+       child_status_listener(this), process_timer(this), log_output_listener(this),
+       compress_listener(this)
 {
     program_name = std::move(command);
     exec_arg_parts = separate_args(program_name, command_offsets);
@@ -350,6 +649,20 @@ base_process_service::base_process_service(service_set *sset, string name,
     waiting_stopstart_timer = false;
     reserved_child_watch = false;
     tracking_child = false;
+    listening_main_env = false;
+    log_buf_discard_old = false;
+    logfile_write_failed = false;
+    reserved_compress_watch = false;
+    nice_is_set = false;
+    #if SUPPORT_OOM_ADJ
+    oom_adj_is_set = false;
+    #endif
+    #if SUPPORT_CAPABILITIES
+    no_new_privs = false;
+    #endif
+    #if SUPPORT_CGROUPS
+    cgroup_created = false;
+    #endif
 }
 
 void base_process_service::do_restart() noexcept
@@ -379,6 +692,56 @@ void base_process_service::do_restart() noexcept
     }
 }
 
+// Pseudo-random number source for restart delay jitter. The quality isn't important, only that
+// different services (and successive restarts) see different values.
+static uint64_t jitter_random(uint64_t seed) noexcept
+{
+    static uint64_t state = 0;
+    if (state == 0) {
+        state = seed | 1;
+    }
+    // xorshift64:
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+}
+
+base_process_service::time_val base_process_service::next_restart_delay(time_val run_time) noexcept
+{
+    time_val delay = restart_delay;
+
+    if (restart_delay < restart_delay_max) {
+        if (restart_backoff_count == 0 || !(run_time < restart_interval)) {
+            // First restart, or the process ran for long enough to be considered stable
+            restart_backoff = restart_delay;
+            restart_backoff_count = 1;
+        }
+        else {
+            restart_backoff = restart_backoff + restart_backoff;
+            if (restart_delay_max < restart_backoff) {
+                restart_backoff = restart_delay_max;
+            }
+            ++restart_backoff_count;
+        }
+        delay = restart_backoff;
+    }
+
+    if (restart_delay_jitter != 0) {
+        constexpr uint64_t ns_per_sec = 1000000000;
+        uint64_t delay_ns = (uint64_t)delay.seconds() * ns_per_sec + delay.nseconds();
+        uint64_t max_jitter_ns = delay_ns / 100 * restart_delay_jitter
+                + delay_ns % 100 * restart_delay_jitter / 100;
+        if (max_jitter_ns != 0) {
+            uint64_t jitter_ns = jitter_random(delay_ns ^ (uintptr_t)this ^ last_start_time.nseconds())
+                    % (max_jitter_ns + 1);
+            delay = delay + time_val(jitter_ns / ns_per_sec, jitter_ns % ns_per_sec);
+        }
+    }
+
+    return delay;
+}
+
 bool base_process_service::restart_ps_process() noexcept
 {
     using time_val = dasynq::time_val;
@@ -388,12 +751,13 @@ bool base_process_service::restart_ps_process() noexcept
 
     // Check if enough time has lapsed since the previous restart. If not, start a timer:
     time_val tdiff = current_time - last_start_time;
-    if (restart_delay <= tdiff) {
+    time_val delay = next_restart_delay(tdiff);
+    if (delay <= tdiff) {
         // > restart delay (normally 200ms)
         do_restart();
     }
     else {
-        time_val timeout = restart_delay - tdiff;
+        time_val timeout = delay - tdiff;
         process_timer.arm_timer_rel(event_loop, timeout);
         waiting_restart_timer = true;
     }
@@ -431,12 +795,31 @@ void base_process_service::kill_with_fire() noexcept
     if (pid != -1) {
         log(loglevel_t::WARN, "Service ", get_name(), " with pid ", pid,
                 " exceeded allowed stop time; killing.");
+        #if SUPPORT_CGROUPS
+        if (uses_cgroup_kill() && kill_cgroup()) {
+            return;
+        }
+        #endif
         kill_pg(SIGKILL);
     }
 }
 
 void base_process_service::kill_pg(int signo) noexcept
 {
+    #if SUPPORT_PIDFD
+    if (pidfd != -1) {
+        // The process isn't our child, so once it terminates its pid may be reused (before we are
+        // notified); signal via the pidfd, or at least check that the process still exists first.
+        if (onstart_flags.signal_process_only) {
+            bp_sys::pidfd_send_signal(pidfd, signo, nullptr, 0);
+            return;
+        }
+        if (bp_sys::pidfd_send_signal(pidfd, 0, nullptr, 0) == -1) {
+            return;
+        }
+    }
+    #endif
+
     if (onstart_flags.signal_process_only) {
         bp_sys::kill(pid, signo);
     }
@@ -461,6 +844,18 @@ void base_process_service::timer_expired() noexcept
     // starting (start timeout, state is STARTING); We are waiting for restart timer before restarting,
     // including smooth recovery (restart timeout, state is STARTING or STARTED).
     if (get_state() == service_state_t::STOPPING) {
+        #if SUPPORT_CGROUPS
+        if (cgroup_events_fd != -1) {
+            // Process has terminated, but the cgroup has not emptied (even though all processes in it
+            // have been sent SIGKILL); don't wait any longer.
+            log(loglevel_t::WARN, "Service ", get_name(), " cgroup did not become empty within allowed"
+                    " stop time.");
+            stop_cgroup_watch();
+            cgroup_emptied();
+            services->process_queues();
+            return;
+        }
+        #endif
         kill_with_fire();
     }
     else if (pid != -1) {
@@ -477,12 +872,355 @@ void base_process_service::timer_expired() noexcept
     }
 }
 
+#if SUPPORT_CGROUPS
+
+// Read the contents of a cgroup file (for small files only) into buf, nul-terminated. Returns false
+// if the file could not be read.
+static bool read_cgroup_file(const std::string &path, char *buf, size_t bufsize) noexcept
+{
+    int fd = bp_sys::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        return false;
+    }
+
+    size_t len = 0;
+    while (len < bufsize - 1) {
+        ssize_t r = bp_sys::read(fd, buf + len, bufsize - 1 - len);
+        if (r == 0) break;
+        if (r == -1) {
+            if (errno == EINTR) continue;
+            bp_sys::close(fd);
+            return false;
+        }
+        len += r;
+    }
+    bp_sys::close(fd);
+    buf[len] = '\0';
+    return true;
+}
+
+// Write a value to a cgroup file. Returns false (with errno set) on failure.
+static bool write_cgroup_file(const std::string &path, const char *value) noexcept
+{
+    int fd = bp_sys::open(path.c_str(), O_WRONLY | O_CLOEXEC);
+    if (fd == -1) {
+        return false;
+    }
+    size_t len = strlen(value);
+    bool r = bp_sys::write(fd, value, len) == (ssize_t)len;
+    int write_errno = errno;
+    bp_sys::close(fd);
+    errno = write_errno;
+    return r;
+}
+
+// Find a "<key> <value>" line in the contents of a cgroup file (such as cgroup.events or cpu.stat)
+// and parse the value. Returns false if not found.
+static bool find_cgroup_key(const char *contents, const char *key, uint64_t &value) noexcept
+{
+    size_t key_len = strlen(key);
+    const char *line = contents;
+    while (*line != '\0') {
+        if (strncmp(line, key, key_len) == 0 && line[key_len] == ' ') {
+            value = strtoull(line + key_len + 1, nullptr, 10);
+            return true;
+        }
+        line = strchr(line, '\n');
+        if (line == nullptr) break;
+        ++line;
+    }
+    return false;
+}
+
+bool base_process_service::get_cgroup_path(std::string &path)
+{
+    const char *run_cgroup_path = run_in_cgroup.c_str();
+    path = "/sys/fs/cgroup/";
+    if (run_cgroup_path[0] != '/') {
+        // Relative path is resolved against our own cgroup (as for run-child-proc)
+        if (!have_cgroups_path) {
+            return false;
+        }
+        if (!cgroups_path.empty()) {
+            path += cgroups_path;
+            path += '/';
+        }
+    }
+    else {
+        ++run_cgroup_path;
+    }
+    path += run_cgroup_path;
+    return true;
+}
+
+bool base_process_service::get_cgroup_file_path(std::string &path, const char *file_name)
+{
+    if (!get_cgroup_path(path)) {
+        return false;
+    }
+    path += '/';
+    path += file_name;
+    return true;
+}
+
+bool base_process_service::setup_cgroup() noexcept
+{
+    if (run_in_cgroup.empty() || (!onstart_flags.create_cgroup && cgroup_memory_max == 0
+            && cgroup_cpu_weight == 0 && cgroup_io_weight == 0)) {
+        return true;
+    }
+
+    const char *setting_file = nullptr;
+    try {
+        std::string path;
+        if (!get_cgroup_path(path)) {
+            log(loglevel_t::ERROR, get_name(), ": can't determine cgroup path (dinit's own cgroup is"
+                    " not known)");
+            return false;
+        }
+
+        if (onstart_flags.create_cgroup) {
+            if (bp_sys::mkdir(path.c_str(), 0755) == 0) {
+                cgroup_created = true;
+            }
+            else if (errno != EEXIST) {
+                log(loglevel_t::ERROR, get_name(), ": can't create cgroup ", path, ": ", strerror(errno));
+                return false;
+            }
+
+            // Enable the controllers needed for resource settings and accounting in the new cgroup.
+            // Any that are unavailable (or already enabled) are skipped; if a resource setting then
+            // can't be applied, that is reported below.
+            std::string subtree_control = path.substr(0, path.rfind('/')) + "/cgroup.subtree_control";
+            for (const char *controller : {"+cpu", "+memory", "+io", "+pids"}) {
+                write_cgroup_file(subtree_control, controller);
+            }
+        }
+
+        char buf[8 + type_max_num_digits<uint64_t>() + 1];
+        if (cgroup_memory_max != 0) {
+            setting_file = "memory.max";
+            if (cgroup_memory_max == std::numeric_limits<uint64_t>::max()) {
+                strcpy(buf, "max");
+            }
+            else {
+                buf_print(buf, cgroup_memory_max);
+            }
+            if (!write_cgroup_file(path + "/memory.max", buf)) goto setting_failed;
+        }
+        if (cgroup_cpu_weight != 0) {
+            setting_file = "cpu.weight";
+            buf_print(buf, cgroup_cpu_weight);
+            if (!write_cgroup_file(path + "/cpu.weight", buf)) goto setting_failed;
+        }
+        if (cgroup_io_weight != 0) {
+            setting_file = "io.weight";
+            buf_print(buf, "default ", cgroup_io_weight);
+            if (!write_cgroup_file(path + "/io.weight", buf)) goto setting_failed;
+        }
+    }
+    catch (std::bad_alloc &) {
+        log(loglevel_t::ERROR, get_name(), ": can't set up cgroup: out of memory");
+        return false;
+    }
+
+    return true;
+
+    setting_failed:
+    log(loglevel_t::ERROR, get_name(), ": can't set cgroup ", setting_file, ": ", strerror(errno));
+    return false;
+}
+
+bool base_process_service::get_resource_usage(service_resource_usage &usage) noexcept
+{
+    if (run_in_cgroup.empty()) {
+        return false;
+    }
+
+    try {
+        std::string path;
+        if (!get_cgroup_path(path)) {
+            return false;
+        }
+
+        char buf[1024];
+        usage.flags = 0;
+        if (read_cgroup_file(path + "/cpu.stat", buf, sizeof(buf))
+                && find_cgroup_key(buf, "usage_usec", usage.cpu_usec)) {
+            usage.flags |= service_resource_usage::HAVE_CPU;
+        }
+        if (read_cgroup_file(path + "/memory.current", buf, sizeof(buf))) {
+            usage.memory_bytes = strtoull(buf, nullptr, 10);
+            usage.flags |= service_resource_usage::HAVE_MEMORY;
+        }
+        if (read_cgroup_file(path + "/pids.current", buf, sizeof(buf))) {
+            usage.pids = strtoull(buf, nullptr, 10);
+            usage.flags |= service_resource_usage::HAVE_PIDS;
+        }
+    }
+    catch (std::bad_alloc &) {
+        return false;
+    }
+
+    return true;
+}
+
+bool base_process_service::is_cgroup_populated() noexcept
+{
+    char buf[256];
+    try {
+        std::string events_path;
+        if (!get_cgroup_file_path(events_path, "cgroup.events")
+                || !read_cgroup_file(events_path, buf, sizeof(buf))) {
+            return false;
+        }
+    }
+    catch (std::bad_alloc &) {
+        return false;
+    }
+
+    uint64_t populated;
+    return find_cgroup_key(buf, "populated", populated) && populated != 0;
+}
+
+bool base_process_service::kill_cgroup() noexcept
+{
+    try {
+        std::string kill_path;
+        return get_cgroup_file_path(kill_path, "cgroup.kill") && write_cgroup_file(kill_path, "1");
+    }
+    catch (std::bad_alloc &) {
+        return false;
+    }
+}
+
+bool base_process_service::kill_cgroup_remainder() noexcept
+{
+    if (!uses_cgroup_kill() || !is_cgroup_populated()) {
+        return false;
+    }
+
+    // Watch for changes before killing, so that we can't miss the cgroup becoming empty:
+    if (cgroup_events_fd == -1) {
+        std::string events_path;
+        try {
+            if (!get_cgroup_file_path(events_path, "cgroup.events")) {
+                return false;
+            }
+        }
+        catch (std::bad_alloc &) {
+            log(loglevel_t::ERROR, get_name(), ": can't watch cgroup: out of memory");
+            kill_cgroup();
+            return false;
+        }
+
+        int fd = bp_sys::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (fd == -1) {
+            log(loglevel_t::ERROR, get_name(), ": can't watch cgroup: ", strerror(errno));
+            kill_cgroup();
+            return false;
+        }
+        if (bp_sys::inotify_add_watch(fd, events_path.c_str(), IN_MODIFY) == -1) {
+            log(loglevel_t::ERROR, get_name(), ": can't watch cgroup: ", strerror(errno));
+            bp_sys::close(fd);
+            kill_cgroup();
+            return false;
+        }
+        try {
+            cgroup_watcher.add_watch(event_loop, fd, dasynq::IN_EVENTS);
+        }
+        catch (std::exception &exc) {
+            log(loglevel_t::ERROR, get_name(), ": can't watch cgroup: ", exc.what());
+            bp_sys::close(fd);
+            kill_cgroup();
+            return false;
+        }
+        cgroup_events_fd = fd;
+    }
+
+    if (!kill_cgroup()) {
+        log(loglevel_t::WARN, get_name(), ": can't kill remaining processes in cgroup: ", strerror(errno));
+    }
+
+    if (!is_cgroup_populated()) {
+        stop_cgroup_watch();
+        return false;
+    }
+
+    // Limit the wait by the stop timeout:
+    if (stop_timeout != time_val(0,0)) {
+        process_timer.arm_timer_rel(event_loop, stop_timeout);
+        waiting_stopstart_timer = true;
+    }
+
+    return true;
+}
+
+void base_process_service::stop_cgroup_watch() noexcept
+{
+    if (cgroup_events_fd != -1) {
+        cgroup_watcher.deregister(event_loop);
+        bp_sys::close(cgroup_events_fd);
+        cgroup_events_fd = -1;
+    }
+}
+
+#endif
+
+#if SUPPORT_PIDFD
+
+bool base_process_service::watch_pidfd() noexcept
+{
+    int fd = bp_sys::pidfd_open(pid, 0);
+    if (fd == -1) {
+        return false;
+    }
+    try {
+        pidfd_listener.add_watch(event_loop, fd, dasynq::IN_EVENTS);
+    }
+    catch (std::exception &exc) {
+        log(loglevel_t::ERROR, get_name(), ": can't watch process: ", exc.what());
+        bp_sys::close(fd);
+        return false;
+    }
+    pidfd = fd;
+    return true;
+}
+
+void base_process_service::stop_pidfd_watch() noexcept
+{
+    if (pidfd != -1) {
+        pidfd_listener.deregister(event_loop);
+        bp_sys::close(pidfd);
+        pidfd = -1;
+    }
+}
+
+#endif
+
 void base_process_service::becoming_inactive() noexcept
 {
     if (socket_fd != -1) {
         close(socket_fd);
         socket_fd = -1;
     }
+    #if SUPPORT_PIDFD
+    stop_pidfd_watch();
+    #endif
+    #if SUPPORT_CGROUPS
+    if (cgroup_created) {
+        // Remove the cgroup we created. This fails if any processes remain in it, in which case it
+        // is left in place.
+        std::string path;
+        try {
+            if (get_cgroup_path(path)) {
+                bp_sys::rmdir(path.c_str());
+            }
+        }
+        catch (std::bad_alloc &) { }
+        cgroup_created = false;
+    }
+    #endif
 }
 
 bool base_process_service::open_socket() noexcept
@@ -588,3 +1326,35 @@ bool base_process_service::ensure_log_buffer_backing(unsigned new_size) noexcept
     }
     return true;
 }
+
+// Get the heap memory used by a prepared process environment (approximate)
+static size_t proc_env_heap_usage(const run_proc_env &proc_env) noexcept
+{
+    using var_map_t = decltype(proc_env.env_map.var_map);
+    constexpr size_t var_node_size = sizeof(var_map_t::value_type) + 2 * sizeof(void *);
+
+    return proc_env.env_map.env_list.capacity() * sizeof(const char *)
+            + proc_env.env_map.var_map.bucket_count() * sizeof(void *)
+            + proc_env.env_map.var_map.size() * var_node_size + heap_size_of(proc_env.notify_var);
+}
+
+void base_process_service::get_mem_usage(service_mem_usage &usage) noexcept
+{
+    service_record::get_mem_usage(usage);
+    usage.record_size = sizeof(*this);
+
+    auto ha_size = [](const ha_string &s) -> size_t {
+        return s.c_str() == nullptr ? 0 : s.length() + 1;
+    };
+
+    usage.heap_size += ha_size(program_name) + ha_size(stop_command) + ha_size(logfile_compress)
+            + (exec_arg_parts.capacity() + stop_arg_parts.capacity()
+                    + logfile_compress_parts.capacity()) * sizeof(const char *)
+            + heap_size_of(working_dir) + heap_size_of(env_file) + heap_size_of(logfile)
+            + heap_size_of(logfile_compress_suffix) + heap_size_of(notification_var)
+            + log_buffer.capacity() + rlimits.capacity() * sizeof(service_rlimits)
+            + proc_env_heap_usage(start_proc_env) + proc_env_heap_usage(stop_proc_env);
+    #if SUPPORT_CGROUPS
+    usage.heap_size += heap_size_of(run_in_cgroup);
+    #endif
+}
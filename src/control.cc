@@ -1,12 +1,16 @@
 #include <algorithm>
 #include <unordered_set>
 #include <climits>
+#include <memory>
+
+#include <fnmatch.h>
 
 #include "control-cmds.h"
 #include "dinit-env.h"
 #include "control.h"
 #include "service.h"
 #include "proc-service.h"
+#include "auto-reload.h"
 #include "control-datatypes.h"
 
 // Server-side control protocol implementation. This implements the functionality that allows
@@ -15,10 +19,18 @@
 // common communication datatypes
 using namespace dinit_cptypes;
 
+// IOV_MAX may be left undefined if the limit is indeterminate; POSIX guarantees at least 16.
+#ifndef IOV_MAX
+#define IOV_MAX 16
+#endif
+
+cpoutbuf::chunk *cpoutbuf::free_chunks = nullptr;
+cpoutbuf::stats_t cpoutbuf::stats;
+
 namespace {
     // Control protocol minimum compatible version and current version:
     constexpr uint16_t min_compat_version = 1;
-    constexpr uint16_t cp_version = 7;
+    constexpr uint16_t cp_version = 8;
 
     // check for value in a set
     template <typename T, int N, typename U>
@@ -61,6 +73,10 @@ bool control_conn_t::process_packet()
         case cp_cmd::WAKESERVICE:
         case cp_cmd::RELEASESERVICE:
             return process_start_stop(pkt_type);
+        case cp_cmd::LOADSERVICES:
+            return process_load_services();
+        case cp_cmd::STARTSTOPSERVICES:
+            return process_start_stop_services();
         case cp_cmd::UNPINSERVICE:
             return process_unpin_service();
         case cp_cmd::UNLOADSERVICE:
@@ -94,12 +110,16 @@ bool control_conn_t::process_packet()
             return list_services();
         case cp_cmd::LISTSERVICES5:
             return list_services5();
+        case cp_cmd::LISTSERVICES8:
+            return list_services8();
         case cp_cmd::SERVICESTATUS:
             return process_service_status();
         case cp_cmd::SERVICESTATUS5:
             return process_service_status5();
         case cp_cmd::SERVICESTATUS6:
             return process_service_status6();
+        case cp_cmd::SERVICESTATUS8:
+            return process_service_status6(true);
         case cp_cmd::ADD_DEP:
             return add_service_dep();
         case cp_cmd::REM_DEP:
@@ -118,6 +138,18 @@ bool control_conn_t::process_packet()
             return process_getallenv();
         case cp_cmd::LISTENENV:
             return process_listenenv();
+        case cp_cmd::SUBSCRIBE:
+            return process_subscribe();
+        case cp_cmd::QUERYSTARTTIMES:
+            return process_query_start_times();
+        case cp_cmd::QUERYRESOURCES:
+            return process_query_resources();
+        case cp_cmd::QUERYLOGSTATS:
+            return process_query_log_stats();
+        case cp_cmd::QUERYMEMUSAGE:
+            return process_query_mem_usage();
+        case cp_cmd::QUERYAUTORELOAD:
+            return process_query_auto_reload();
         case cp_cmd::SETTRIGGER:
             return process_set_trigger();
         case cp_cmd::CATLOG:
@@ -178,12 +210,39 @@ bool control_conn_t::process_find_load(cp_cmd pktType)
     rbuf.consume(chklen);
     chklen = 0;
     
-    cp_rply fail_code = cp_rply::NOSERVICE;
+    cp_rply fail_code;
+    record = find_load_service(service_name.c_str(), pktType == cp_cmd::LOADSERVICE, fail_code);
+
+    if (record == nullptr) {
+        std::vector<char> rp_buf = { (char)fail_code };
+        if (!queue_packet(std::move(rp_buf))) return false;
+        return true;
+    }
+
+    // Allocate a service handle
+    handle_t handle = allocate_service_handle(record);
+    std::vector<char> rp_buf;
+    rp_buf.reserve(7);
+    rp_buf.push_back((char)cp_rply::SERVICERECORD);
+    rp_buf.push_back(static_cast<char>(record->get_state()));
+    for (int i = 0; i < (int) sizeof(handle); i++) {
+        rp_buf.push_back(*(((char *) &handle) + i));
+    }
+    rp_buf.push_back(static_cast<char>(record->get_target_state()));
+    if (!queue_packet(std::move(rp_buf))) return false;
+    
+    return true;
+}
+
+service_record *control_conn_t::find_load_service(const char *name, bool do_load,
+        cp_rply &fail_code)
+{
+    service_record *record = nullptr;
+    fail_code = cp_rply::NOSERVICE;
 
-    if (pktType == cp_cmd::LOADSERVICE) {
-        // LOADSERVICE
+    if (do_load) {
         try {
-            record = services->load_service(service_name.c_str());
+            record = services->load_service(name);
         }
         catch (service_description_exc &sdexc) {
             log_service_load_failure(sdexc);
@@ -201,29 +260,112 @@ bool control_conn_t::process_find_load(cp_cmd pktType)
         }
     }
     else {
-        // FINDSERVICE
-        record = services->find_service(service_name.c_str());
+        record = services->find_service(name);
     }
-    
-    if (record == nullptr) {
-        std::vector<char> rp_buf = { (char)fail_code };
-        if (!queue_packet(std::move(rp_buf))) return false;
+
+    return record;
+}
+
+bool control_conn_t::process_load_services()
+{
+    using std::string;
+
+    // 1 byte: packet type
+    // 1 byte: flags
+    //    bit 0: 0 = load, 1 = find only (don't load)
+    // 2 bytes: number of services (N)
+    // N * (2 bytes: service name length, followed by service name)
+    // The complete packet must fit in the receive buffer.
+
+    constexpr unsigned hdr_size = 4;
+
+    if (rbuf.get_length() < hdr_size) {
+        chklen = hdr_size;
         return true;
     }
 
-    // Allocate a service handle
-    handle_t handle = allocate_service_handle(record);
-    std::vector<char> rp_buf;
-    rp_buf.reserve(7);
-    rp_buf.push_back((char)cp_rply::SERVICERECORD);
-    rp_buf.push_back(static_cast<char>(record->get_state()));
-    for (int i = 0; i < (int) sizeof(handle); i++) {
-        rp_buf.push_back(*(((char *) &handle) + i));
+    bool do_load = ((rbuf[1] & 1) == 0);
+    uint16_t num_services;
+    rbuf.extract(&num_services, 2, sizeof(num_services));
+
+    // Determine the total packet size, reading more if necessary
+    unsigned pkt_size = hdr_size;
+    bool bad_req = false;
+    for (unsigned i = 0; i < num_services; ++i) {
+        if (pkt_size + sizeof(srvname_len_t) > rbuf.get_size()) {
+            bad_req = true;
+            break;
+        }
+        if (rbuf.get_length() < pkt_size + sizeof(srvname_len_t)) {
+            chklen = pkt_size + sizeof(srvname_len_t);
+            return true;
+        }
+        srvname_len_t srvname_len;
+        rbuf.extract(&srvname_len, pkt_size, sizeof(srvname_len));
+        pkt_size += sizeof(srvname_len) + srvname_len;
+        if (srvname_len == 0 || pkt_size > rbuf.get_size()) {
+            bad_req = true;
+            break;
+        }
     }
-    rp_buf.push_back(static_cast<char>(record->get_target_state()));
-    if (!queue_packet(std::move(rp_buf))) return false;
-    
-    return true;
+
+    if (!bad_req && rbuf.get_length() < pkt_size) {
+        chklen = pkt_size;
+        return true;
+    }
+
+    std::vector<string> service_names;
+    if (!bad_req) {
+        service_names.reserve(num_services);
+        unsigned pos = hdr_size;
+        for (unsigned i = 0; i < num_services; ++i) {
+            srvname_len_t srvname_len;
+            rbuf.extract(&srvname_len, pos, sizeof(srvname_len));
+            pos += sizeof(srvname_len);
+            service_names.push_back(rbuf.extract_string(pos, srvname_len));
+            pos += srvname_len;
+            if (!dinit_load::validate_service_name(service_names.back())) {
+                bad_req = true;
+                break;
+            }
+        }
+    }
+
+    if (bad_req) {
+        char badreq_rep[] = { (char)cp_rply::BADREQ };
+        if (!queue_packet(badreq_rep, 1)) return false;
+        bad_conn_close = true;
+        return true;
+    }
+
+    // Clear the packet from the buffer
+    rbuf.consume(pkt_size);
+    chklen = 0;
+
+    // Reply: packet type, (2 bytes) N, N * (result code, state, handle, target state)
+    constexpr unsigned entry_size = 3 + sizeof(handle_t);
+    std::vector<char> rp_buf(3 + num_services * entry_size);
+    rp_buf[0] = (char)cp_rply::SERVICERECORDS;
+    memcpy(rp_buf.data() + 1, &num_services, sizeof(num_services));
+
+    char *entry = rp_buf.data() + 3;
+    for (const string &service_name : service_names) {
+        cp_rply fail_code;
+        service_record *record = find_load_service(service_name.c_str(), do_load, fail_code);
+        if (record == nullptr) {
+            entry[0] = (char)fail_code;
+        }
+        else {
+            handle_t handle = allocate_service_handle(record);
+            entry[0] = (char)cp_rply::SERVICERECORD;
+            entry[1] = static_cast<char>(record->get_state());
+            memcpy(entry + 2, &handle, sizeof(handle));
+            entry[2 + sizeof(handle)] = static_cast<char>(record->get_target_state());
+        }
+        entry += entry_size;
+    }
+
+    return queue_packet(std::move(rp_buf));
 }
 
 bool control_conn_t::process_close_handle()
@@ -241,8 +383,7 @@ bool control_conn_t::process_close_handle()
     rbuf.consume(pkt_size);
     chklen = 0;
 
-    auto key_it = key_service_map.find(handle);
-    if (key_it == key_service_map.end()) {
+    if (find_handle_slot(handle) == nullptr) {
         // Service handle is bad
         char badreq_rep[] = { (char)cp_rply::BADREQ };
         if (!queue_packet(badreq_rep, 1)) return false;
@@ -250,25 +391,7 @@ bool control_conn_t::process_close_handle()
         return true;
     }
 
-    service_record *service = key_it->second;
-    key_service_map.erase(key_it);
-
-    bool have_other_handle = false;
-    auto handle_range = service_key_map.equal_range(service);
-    auto it = handle_range.first;
-    while (it->second != handle) {
-        have_other_handle = true;
-        ++it;
-    }
-    if (!have_other_handle) {
-        // check if more handles beyond the found handle
-        have_other_handle = std::next(it) != handle_range.second;
-    }
-    service_key_map.erase(it);
-
-    if (!have_other_handle) {
-        service->remove_listener(this);
-    }
+    release_service_handle(handle);
 
     char ack_reply[] = { (char)cp_rply::ACK };
     return queue_packet(ack_reply, sizeof(ack_reply));
@@ -470,6 +593,180 @@ bool control_conn_t::process_start_stop(cp_cmd pktType)
     return true;
 }
 
+bool control_conn_t::process_start_stop_services()
+{
+    // 1 byte: packet type
+    // 1 byte: command (STARTSERVICE, STOPSERVICE, WAKESERVICE or RELEASESERVICE)
+    // 1 byte: flags, as for the single-service command (restart is not supported)
+    // 2 bytes: number of services (N)
+    // N * handle
+
+    constexpr unsigned hdr_size = 5;
+
+    if (rbuf.get_length() < hdr_size) {
+        chklen = hdr_size;
+        return true;
+    }
+
+    cp_cmd cmd = (cp_cmd)rbuf[1];
+    char flags = rbuf[2];
+    uint16_t num_services;
+    rbuf.extract(&num_services, 3, sizeof(num_services));
+
+    unsigned pkt_size = hdr_size + num_services * sizeof(handle_t);
+    bool bad_req = (pkt_size > rbuf.get_size()) || (flags & 4)
+            || !value(cmd).is_in(cp_cmd::STARTSERVICE, cp_cmd::STOPSERVICE, cp_cmd::WAKESERVICE,
+                    cp_cmd::RELEASESERVICE);
+
+    if (!bad_req && rbuf.get_length() < pkt_size) {
+        chklen = pkt_size;
+        return true;
+    }
+
+    std::vector<service_record *> records;
+    if (!bad_req) {
+        records.reserve(num_services);
+        for (unsigned i = 0; i < num_services; ++i) {
+            handle_t handle;
+            rbuf.extract(&handle, hdr_size + i * sizeof(handle), sizeof(handle));
+            service_record *service = find_service_for_key(handle);
+            if (service == nullptr) {
+                bad_req = true;
+                break;
+            }
+            records.push_back(service);
+        }
+    }
+
+    if (bad_req) {
+        char badreq_rep[] = { (char)cp_rply::BADREQ };
+        if (!queue_packet(badreq_rep, 1)) return false;
+        bad_conn_close = true;
+        return true;
+    }
+
+    // Clear the packet from the buffer
+    rbuf.consume(pkt_size);
+    chklen = 0;
+
+    if (flags & 128) {
+        // Issue PREACK before changing any service state (see process_start_stop)
+        char preack_buf[] = { (char)cp_rply::PREACK };
+        if (!queue_packet(preack_buf, 1)) return false;
+    }
+
+    bool do_pin = ((flags & 1) == 1);
+    bool gentle = ((flags & 2) == 2);
+
+    // Reply: packet type, (2 bytes) N, N * result code
+    std::vector<char> rp_buf(3 + num_services, (char)cp_rply::ACK);
+    rp_buf[0] = (char)cp_rply::SSRESULTS;
+    memcpy(rp_buf.data() + 1, &num_services, sizeof(num_services));
+    char *codes = rp_buf.data() + 3;
+
+    // First check whether each command can be actioned, as per process_start_stop:
+    for (unsigned i = 0; i < num_services; ++i) {
+        service_record *service = records[i];
+        auto state = service->get_state();
+        if (cmd == cp_cmd::STOPSERVICE || cmd == cp_cmd::RELEASESERVICE) {
+            if (cmd == cp_cmd::STOPSERVICE && (state == service_state_t::STARTED
+                    || state == service_state_t::STARTING) && service->is_start_pinned()) {
+                codes[i] = (char)cp_rply::PINNEDSTARTED;
+            }
+        }
+        else if (services->is_shutting_down()) {
+            codes[i] = (char)cp_rply::SHUTTINGDOWN;
+        }
+        else if ((state == service_state_t::STOPPED || state == service_state_t::STOPPING)
+                && service->is_stop_pinned()) {
+            codes[i] = (char)cp_rply::PINNEDSTOPPED;
+        }
+    }
+
+    if (cmd == cp_cmd::STOPSERVICE && gentle) {
+        // A dependent which is itself being stopped as part of this batch doesn't prevent its
+        // dependency from stopping. Other dependents do, and in turn prevent their own batch
+        // dependencies from stopping; iterate until no more services are excluded.
+        std::unordered_set<service_record *> stopping;
+        for (unsigned i = 0; i < num_services; ++i) {
+            if (codes[i] == (char)cp_rply::ACK) stopping.insert(records[i]);
+        }
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            for (unsigned i = 0; i < num_services; ++i) {
+                if (codes[i] != (char)cp_rply::ACK) continue;
+                for (service_dep *dep : records[i]->get_dependents()) {
+                    if (value(dep->dep_type).is_in(dependency_type::REGULAR,
+                            dependency_type::PREPARED_BY) && dep->holding_acq
+                            && stopping.count(dep->get_from()) == 0) {
+                        codes[i] = (char)cp_rply::DEPENDENTS;
+                        stopping.erase(records[i]);
+                        changed = true;
+                        break;
+                    }
+                }
+            }
+        }
+    }
+
+    // Issue the commands, and then process the queues once for the whole batch:
+    std::vector<bool> actioned(num_services, false);
+    for (unsigned i = 0; i < num_services; ++i) {
+        if (codes[i] != (char)cp_rply::ACK) continue;
+        service_record *service = records[i];
+        actioned[i] = true;
+        switch (cmd) {
+        case cp_cmd::STARTSERVICE:
+            if (do_pin) service->pin_start();
+            service->start();
+            break;
+        case cp_cmd::STOPSERVICE:
+            if (do_pin) service->pin_stop();
+            service->stop(true);
+            // For a gentle stop, any dependents are part of the batch and will stop of their own
+            // accord; forcing the stop would instead mark them as failed.
+            if (!gentle) service->forced_stop();
+            break;
+        case cp_cmd::WAKESERVICE:
+        {
+            bool found_dpt = false;
+            for (auto dpt : service->get_dependents()) {
+                if (dpt->is_only_ordering()) continue;
+                auto from_state = dpt->get_from()->get_state();
+                if (from_state == service_state_t::STARTED || from_state == service_state_t::STARTING) {
+                    found_dpt = true;
+                    if (!dpt->holding_acq) {
+                        dpt->get_from()->start_dep(*dpt);
+                    }
+                }
+            }
+            if (!found_dpt) {
+                codes[i] = (char)cp_rply::NAK;
+            }
+            if (do_pin) service->pin_start();
+            break;
+        }
+        default: // RELEASESERVICE
+            if (do_pin) service->pin_stop();
+            service->stop(false);
+            break;
+        }
+    }
+
+    services->process_queues();
+
+    service_state_t wanted_state = value(cmd).is_in(cp_cmd::STARTSERVICE, cp_cmd::WAKESERVICE)
+            ? service_state_t::STARTED : service_state_t::STOPPED;
+    for (unsigned i = 0; i < num_services; ++i) {
+        if (actioned[i] && records[i]->get_state() == wanted_state) {
+            codes[i] = (char)cp_rply::ALREADYSS;
+        }
+    }
+
+    return queue_packet(std::move(rp_buf));
+}
+
 bool control_conn_t::process_unpin_service()
 {
     using std::string;
@@ -539,13 +836,12 @@ bool control_conn_t::process_unload_service()
         if (!queue_packet(nak_rep, 1)) return false;
     }
     else {
+        // drop handle(s); this must be done before unloading, which deletes the service record
+        release_service_handles(service);
+
         // unload (this may fail with bad_alloc)
         services->unload_service(service);
 
-        // drop handle
-        service_key_map.erase(service);
-        key_service_map.erase(handle);
-
         // send ack
         char ack_buf[] = { (char) cp_rply::ACK };
         if (!queue_packet(ack_buf, 1)) return false;
@@ -590,12 +886,10 @@ bool control_conn_t::process_reload_service()
     }
     else {
         try {
-            // drop handle
-            key_service_map.erase(handle);
-            service_key_map.erase(service);
+            // drop handle(s)
+            release_service_handles(service);
 
             // reload
-            service->remove_listener(this);
             services->reload_service(service);
             services->process_queues();
 
@@ -716,17 +1010,38 @@ static void fill_status_buffer6(char *buffer, service_record *service)
     memcpy(buffer + 6 + 2 * sizeof(int), &mod_time, sizeof(mod_time));
 }
 
+constexpr static unsigned STATUS_BUFFER8_SIZE = STATUS_BUFFER6_SIZE + 8 + 4;
+
+static void fill_status_buffer8(char *buffer, service_record *service)
+{
+    fill_status_buffer6(buffer, service);
+
+    // Restart backoff: delay (nanoseconds) before the next restart, and number of consecutive
+    // restarts. Both are 0 if the service doesn't restart with backoff.
+    uint64_t delay_ns = 0;
+    uint32_t count32 = 0;
+    time_val delay;
+    unsigned count;
+    if (service->get_restart_backoff(delay, count)) {
+        delay_ns = (uint64_t)delay.seconds() * 1000000000u + delay.nseconds();
+        count32 = count;
+    }
+    memcpy(buffer + STATUS_BUFFER6_SIZE, &delay_ns, sizeof(delay_ns));
+    memcpy(buffer + STATUS_BUFFER6_SIZE + sizeof(delay_ns), &count32, sizeof(count32));
+}
+
 bool control_conn_t::list_services()
 {
     rbuf.consume(1); // clear request packet
     chklen = 0;
     
     try {
-        auto slist = services->list_services();
+        auto &slist = services->list_services();
+        // (the packet buffer is re-used for each service, since queue_packet copies the data)
+        std::vector<char> pkt_buf;
         for (auto sptr : slist) {
             if (sptr->get_type() == service_type_t::PLACEHOLDER) continue;
 
-            std::vector<char> pkt_buf;
             int hdrsize = 2 + STATUS_BUFFER_SIZE;
 
             const std::string &name = sptr->get_name();
@@ -742,7 +1057,7 @@ bool control_conn_t::list_services()
                 pkt_buf[hdrsize+i] = name[i];
             }
             
-            if (!queue_packet(std::move(pkt_buf))) return false;
+            if (!queue_packet(pkt_buf.data(), pkt_buf.size())) return false;
         }
         
         char ack_buf[] = { (char) cp_rply::LISTDONE };
@@ -763,11 +1078,12 @@ bool control_conn_t::list_services5()
     chklen = 0;
 
     try {
-        auto slist = services->list_services();
+        auto &slist = services->list_services();
+        // (the packet buffer is re-used for each service, since queue_packet copies the data)
+        std::vector<char> pkt_buf;
         for (auto sptr : slist) {
             if (sptr->get_type() == service_type_t::PLACEHOLDER) continue;
 
-            std::vector<char> pkt_buf;
             int hdrsize = 2 + STATUS_BUFFER5_SIZE;
 
             const std::string &name = sptr->get_name();
@@ -783,7 +1099,7 @@ bool control_conn_t::list_services5()
                 pkt_buf[hdrsize+i] = name[i];
             }
 
-            if (!queue_packet(std::move(pkt_buf))) return false;
+            if (!queue_packet(pkt_buf.data(), pkt_buf.size())) return false;
         }
 
         char ack_buf[] = { (char) cp_rply::LISTDONE };
@@ -798,6 +1114,125 @@ bool control_conn_t::list_services5()
     }
 }
 
+// Check whether a service is stopped due to failure (as per the "X" indicator in "dinitctl list")
+static bool service_has_failed(service_record *service)
+{
+    if (service->get_state() != service_state_t::STOPPED) return false;
+    auto stop_reason = service->get_stop_reason();
+    if (stop_reason == stopped_reason_t::TERMINATED) {
+        auto exit_status = service->get_exit_status();
+        return !exit_status.did_exit() || !exit_status.did_exit_clean();
+    }
+    return stop_reason != stopped_reason_t::NORMAL;
+}
+
+bool control_conn_t::list_services8()
+{
+    // 1 byte: packet type
+    // 1 byte: filter flags
+    //    bit 0: match current state
+    //    bit 1: match target state
+    //    bit 2: match service type
+    //    bit 3: only match services which have failed
+    //    bit 4: invert current state match (match services not in the given state)
+    // 1 byte: current state
+    // 1 byte: target state
+    // 1 byte: service type
+    // 4 bytes: cursor: list services following the service with this identifier (0 to list from
+    //         the beginning, otherwise as returned in LISTMORE)
+    // 2 bytes: limit on number of services listed (0 = no limit)
+    // 2 bytes: name pattern length (0 = match all names)
+    // N bytes: name pattern (shell wildcard pattern as per fnmatch(3))
+
+    constexpr unsigned hdr_size = 13;
+
+    if (rbuf.get_length() < hdr_size) {
+        chklen = hdr_size;
+        return true;
+    }
+
+    uint16_t pattern_len;
+    rbuf.extract(&pattern_len, 11, sizeof(pattern_len));
+    if (pattern_len > rbuf.get_size() - hdr_size) {
+        char badreq_rep[] = { (char)cp_rply::BADREQ };
+        if (!queue_packet(badreq_rep, 1)) return false;
+        bad_conn_close = true;
+        return true;
+    }
+
+    chklen = hdr_size + pattern_len;
+    if (rbuf.get_length() < chklen) {
+        return true;
+    }
+
+    char flags = rbuf[1];
+    bool match_state = (flags & 1) != 0;
+    bool match_target = (flags & 2) != 0;
+    bool match_type = (flags & 4) != 0;
+    bool only_failed = (flags & 8) != 0;
+    bool invert_state = (flags & 16) != 0;
+    service_state_t state = static_cast<service_state_t>(rbuf[2]);
+    service_state_t target_state = static_cast<service_state_t>(rbuf[3]);
+    service_type_t type = static_cast<service_type_t>(rbuf[4]);
+    uint32_t cursor;
+    rbuf.extract(&cursor, 5, sizeof(cursor));
+    uint16_t limit;
+    rbuf.extract(&limit, 9, sizeof(limit));
+    std::string pattern = rbuf.extract_string(hdr_size, pattern_len);
+
+    rbuf.consume(chklen);
+    chklen = 0;
+
+    try {
+        // The service list is ordered by service identifier, so we can find the position to resume
+        // from directly (services added or removed since the previous request don't affect it).
+        auto &slist = services->list_services();
+        auto it = services->list_services_after(cursor);
+
+        std::vector<char> pkt_buf;
+        unsigned num_listed = 0;
+        for ( ; it != slist.end(); ++it) {
+            service_record *sptr = *it;
+            if (sptr->get_type() == service_type_t::PLACEHOLDER) continue;
+            if (match_state && ((sptr->get_state() == state) == invert_state)) continue;
+            if (match_target && sptr->get_target_state() != target_state) continue;
+            if (match_type && sptr->get_type() != type) continue;
+            if (only_failed && !service_has_failed(sptr)) continue;
+
+            const std::string &name = sptr->get_name();
+            if (!pattern.empty() && fnmatch(pattern.c_str(), name.c_str(), 0) != 0) continue;
+
+            if (limit != 0 && num_listed == limit) {
+                // Limit reached; tell the client where to continue from (the last listed service)
+                char more_buf[1 + sizeof(cursor)] = { (char)cp_rply::LISTMORE };
+                memcpy(more_buf + 1, &cursor, sizeof(cursor));
+                return queue_packet(more_buf, sizeof(more_buf));
+            }
+
+            int hdrsize = 2 + STATUS_BUFFER5_SIZE;
+            int name_len = std::min((size_t)255, name.length());
+            pkt_buf.resize(hdrsize + name_len);
+
+            pkt_buf[0] = (char)cp_rply::SVCINFO;
+            pkt_buf[1] = name_len;
+            fill_status_buffer5(&pkt_buf[2], sptr);
+            memcpy(&pkt_buf[hdrsize], name.data(), name_len);
+
+            if (!queue_packet(pkt_buf.data(), pkt_buf.size())) return false;
+            cursor = sptr->get_service_id();
+            ++num_listed;
+        }
+
+        char done_buf[] = { (char) cp_rply::LISTDONE };
+        return queue_packet(done_buf, 1);
+    }
+    catch (std::bad_alloc &exc)
+    {
+        do_oom_close();
+        return true;
+    }
+}
+
 bool control_conn_t::process_service_status()
 {
     constexpr int pkt_size = 1 + sizeof(handle_t);
@@ -862,7 +1297,7 @@ bool control_conn_t::process_service_status5()
     return queue_packet(std::move(pkt_buf));
 }
 
-bool control_conn_t::process_service_status6()
+bool control_conn_t::process_service_status6(bool v8)
 {
     constexpr int pkt_size = 1 + sizeof(handle_t);
     if (rbuf.get_length() < pkt_size) {
@@ -884,12 +1319,17 @@ bool control_conn_t::process_service_status6()
     // Reply:
     // 1 byte packet type = cp_rply::SERVICESTATUS
     // 1 byte reserved ( = 0)
-    // STATUS_BUFFER6_SIZE bytes status
+    // STATUS_BUFFER6_SIZE (or STATUS_BUFFER8_SIZE) bytes status
 
-    std::vector<char> pkt_buf(2 + STATUS_BUFFER6_SIZE);
+    std::vector<char> pkt_buf(2 + (v8 ? STATUS_BUFFER8_SIZE : STATUS_BUFFER6_SIZE));
     pkt_buf[0] = (char)cp_rply::SERVICESTATUS;
     pkt_buf[1] = 0;
-    fill_status_buffer6(pkt_buf.data() + 2, service);
+    if (v8) {
+        fill_status_buffer8(pkt_buf.data() + 2, service);
+    }
+    else {
+        fill_status_buffer6(pkt_buf.data() + 2, service);
+    }
 
     return queue_packet(std::move(pkt_buf));
 }
@@ -1268,6 +1708,299 @@ bool control_conn_t::process_listenenv()
     return queue_packet(ack_rep, 1);
 }
 
+bool control_conn_t::process_subscribe()
+{
+    // 1 byte packet type
+    // 8 bytes: sequence number of the last event seen by a previous subscription (0 for none);
+    //          if all later events can be replayed, they are sent instead of a snapshot
+
+    constexpr unsigned pkt_size = 1 + sizeof(uint64_t);
+
+    if (rbuf.get_length() < pkt_size) {
+        chklen = pkt_size;
+        return true;
+    }
+
+    uint64_t resume_seq;
+    rbuf.extract(&resume_seq, 1, sizeof(resume_seq));
+    rbuf.consume(pkt_size);
+    chklen = 0;
+
+    if (!subscribed) {
+        services->add_set_listener(this);
+        subscribed = true;
+    }
+
+    bool resume = resume_seq != 0 && services->has_events_since(resume_seq);
+    auto &slist = services->list_services();
+
+    uint32_t count = 0;
+    if (!resume) {
+        for (auto sptr : slist) {
+            if (sptr->get_type() != service_type_t::PLACEHOLDER) ++count;
+        }
+    }
+
+    uint64_t seq = services->get_event_seq();
+    char hdr_buf[2 + sizeof(seq) + sizeof(count)];
+    hdr_buf[0] = (char)cp_rply::SUBSCRIBED;
+    hdr_buf[1] = resume ? 1 : 0;
+    memcpy(hdr_buf + 2, &seq, sizeof(seq));
+    memcpy(hdr_buf + 2 + sizeof(seq), &count, sizeof(count));
+    if (!queue_packet(hdr_buf, sizeof(hdr_buf))) return false;
+
+    if (resume) {
+        bool ok = true;
+        services->replay_events_since(resume_seq, [&](const service_set_event_t &event) {
+            if (ok) ok = queue_service_delta(event);
+        });
+        return ok;
+    }
+
+    // (the entry buffer is re-used for each service, since queue_packet copies the data)
+    std::vector<char> entry_buf;
+    for (auto sptr : slist) {
+        if (sptr->get_type() == service_type_t::PLACEHOLDER) continue;
+
+        const std::string &name = sptr->get_name();
+        uint32_t id = sptr->get_service_id();
+        uint16_t name_len = std::min(name.length(), (size_t)UINT16_MAX);
+        constexpr unsigned entry_hdr_size = sizeof(id) + 2 + sizeof(name_len);
+
+        entry_buf.resize(entry_hdr_size + name_len);
+        memcpy(entry_buf.data(), &id, sizeof(id));
+        entry_buf[sizeof(id)] = static_cast<char>(sptr->get_state());
+        entry_buf[sizeof(id) + 1] = static_cast<char>(sptr->get_target_state());
+        memcpy(entry_buf.data() + sizeof(id) + 2, &name_len, sizeof(name_len));
+        memcpy(entry_buf.data() + entry_hdr_size, name.data(), name_len);
+
+        if (!queue_packet(entry_buf.data(), entry_buf.size())) return false;
+    }
+
+    return true;
+}
+
+bool control_conn_t::process_query_start_times()
+{
+    // 1 byte packet type, nothing else
+    rbuf.consume(1);
+    chklen = 0;
+
+    // Number the (non-placeholder) services, so that dependencies can be identified by index:
+    auto &slist = services->list_services();
+    std::unordered_map<service_record *, uint32_t> svc_index;
+    uint32_t count = 0;
+    for (auto sptr : slist) {
+        if (sptr->get_type() == service_type_t::PLACEHOLDER) continue;
+        svc_index[sptr] = count++;
+    }
+
+    time_val now;
+    event_loop.get_time(now, clock_type::MONOTONIC, true);
+    uint64_t now_ns = uint64_t(now.seconds()) * 1000000000u + now.nseconds();
+
+    char hdr_buf[1 + sizeof(now_ns) + sizeof(count)];
+    hdr_buf[0] = (char)cp_rply::STARTTIMES;
+    memcpy(hdr_buf + 1, &now_ns, sizeof(now_ns));
+    memcpy(hdr_buf + 1 + sizeof(now_ns), &count, sizeof(count));
+    if (!queue_packet(hdr_buf, sizeof(hdr_buf))) return false;
+
+    // (the entry buffer is re-used for each service, since queue_packet copies the data)
+    std::vector<char> entry_buf;
+    for (auto sptr : slist) {
+        if (sptr->get_type() == service_type_t::PLACEHOLDER) continue;
+
+        entry_buf.clear();
+        auto append = [&](const void *data, size_t len) {
+            const char *cdata = static_cast<const char *>(data);
+            entry_buf.insert(entry_buf.end(), cdata, cdata + len);
+        };
+
+        for (int i = 0; i < NUM_START_STAGES; ++i) {
+            uint64_t stage_time = sptr->get_start_time(static_cast<start_stage_t>(i));
+            append(&stage_time, sizeof(stage_time));
+        }
+
+        uint16_t num_deps = 0;
+        size_t num_deps_pos = entry_buf.size();
+        append(&num_deps, sizeof(num_deps));
+        for (auto &dep : sptr->get_dependencies()) {
+            auto i = svc_index.find(dep.get_to());
+            if (i == svc_index.end() || num_deps == UINT16_MAX) continue;
+            char dep_type = static_cast<char>(dep.dep_type);
+            append(&i->second, sizeof(i->second));
+            append(&dep_type, 1);
+            ++num_deps;
+        }
+        memcpy(entry_buf.data() + num_deps_pos, &num_deps, sizeof(num_deps));
+
+        const std::string &name = sptr->get_name();
+        uint16_t name_len = std::min(name.length(), (size_t)UINT16_MAX);
+        append(&name_len, sizeof(name_len));
+        append(name.data(), name_len);
+
+        if (!queue_packet(entry_buf.data(), entry_buf.size())) return false;
+    }
+
+    return true;
+}
+
+bool control_conn_t::process_query_resources()
+{
+    constexpr int pkt_size = 1 + sizeof(handle_t);
+    if (rbuf.get_length() < pkt_size) {
+        chklen = pkt_size;
+        return true;
+    }
+
+    handle_t handle;
+    rbuf.extract(&handle, 1, sizeof(handle));
+    rbuf.consume(pkt_size);
+    chklen = 0;
+
+    service_record *service = find_service_for_key(handle);
+    if (service == nullptr) {
+        // Service handle is bad
+        char badreq_rep[] = { (char)cp_rply::BADREQ };
+        if (!queue_packet(badreq_rep, 1)) return false;
+        bad_conn_close = true;
+        return true;
+    }
+
+    // Reply:
+    // 1 byte packet type = cp_rply::RESOURCES
+    // 1 byte flags (which of the following are valid)
+    // 8 byte CPU time (microseconds), 8 byte memory (bytes), 8 byte task count
+
+    service_resource_usage usage;
+    if (!service->get_resource_usage(usage)) {
+        usage.flags = 0;
+    }
+
+    constexpr int rply_size = 2 + 3 * sizeof(uint64_t);
+    char rply[rply_size];
+    rply[0] = (char)cp_rply::RESOURCES;
+    rply[1] = (char)usage.flags;
+    memcpy(rply + 2, &usage.cpu_usec, sizeof(uint64_t));
+    memcpy(rply + 2 + sizeof(uint64_t), &usage.memory_bytes, sizeof(uint64_t));
+    memcpy(rply + 2 + 2 * sizeof(uint64_t), &usage.pids, sizeof(uint64_t));
+
+    return queue_packet(rply, rply_size);
+}
+
+bool control_conn_t::process_query_log_stats()
+{
+    rbuf.consume(1);
+
+    // Reply:
+    // 1 byte packet type = cp_rply::LOGSTATS
+    // then for each log stream (main, console): 4 byte buffered, 4 byte buffer size, 4 byte max
+    // buffer size, 4 * 4 byte discarded message count (per log level)
+
+    constexpr int stream_size = (3 + DLOG_NUM_LEVELS) * sizeof(uint32_t);
+    constexpr int rply_size = 1 + DLOG_NUM * stream_size;
+    char rply[rply_size];
+    rply[0] = (char)cp_rply::LOGSTATS;
+
+    int stream_ids[DLOG_NUM] = { DLOG_MAIN, DLOG_CONS };
+    char *p = rply + 1;
+    for (int idx : stream_ids) {
+        log_stats_t stats;
+        get_log_stats(idx, stats);
+        uint32_t vals[3 + DLOG_NUM_LEVELS] = { (uint32_t)stats.buffered,
+                (uint32_t)stats.capacity, (uint32_t)stats.max_capacity };
+        for (unsigned i = 0; i < DLOG_NUM_LEVELS; ++i) {
+            vals[3 + i] = (uint32_t)std::min(stats.discarded[i], (unsigned long)UINT32_MAX);
+        }
+        memcpy(p, vals, sizeof(vals));
+        p += sizeof(vals);
+    }
+
+    return queue_packet(rply, rply_size);
+}
+
+bool control_conn_t::process_query_auto_reload()
+{
+    rbuf.consume(1);
+    chklen = 0;
+
+    // Reply:
+    // 1 byte packet type = cp_rply::AUTORELOAD
+    // 1 byte enabled, 5 * 4 byte counts (events, batches, reloads, failures, skipped),
+    // 2 * 8 byte latency (last, max) in nanoseconds
+
+    constexpr int rply_size = 2 + 5 * sizeof(uint32_t) + 2 * sizeof(uint64_t);
+    char rply[rply_size] = {};
+    rply[0] = (char)cp_rply::AUTORELOAD;
+
+    auto_reloader *reloader = nullptr;
+    if (services->get_set_type_id() == SSET_TYPE_DIRLOAD) {
+        reloader = static_cast<dirload_service_set *>(services)->get_auto_reloader();
+    }
+
+    if (reloader != nullptr) {
+        const auto_reload_stats &stats = reloader->get_stats();
+        rply[1] = 1;
+
+        uint32_t counts[5] = { (uint32_t)std::min(stats.events, (unsigned long)UINT32_MAX),
+                (uint32_t)std::min(stats.batches, (unsigned long)UINT32_MAX),
+                (uint32_t)std::min(stats.reloads, (unsigned long)UINT32_MAX),
+                (uint32_t)std::min(stats.failures, (unsigned long)UINT32_MAX),
+                (uint32_t)std::min(stats.skipped, (unsigned long)UINT32_MAX) };
+        memcpy(rply + 2, counts, sizeof(counts));
+
+        uint64_t latencies[2];
+        const time_val *latency_vals[2] = { &stats.last_latency, &stats.max_latency };
+        for (int i = 0; i < 2; ++i) {
+            latencies[i] = (uint64_t)latency_vals[i]->seconds() * 1000000000u
+                    + latency_vals[i]->nseconds();
+        }
+        memcpy(rply + 2 + sizeof(counts), latencies, sizeof(latencies));
+    }
+
+    return queue_packet(rply, rply_size);
+}
+
+bool control_conn_t::process_query_mem_usage()
+{
+    // 1 byte packet type, nothing else
+    rbuf.consume(1);
+    chklen = 0;
+
+    auto &slist = services->list_services();
+    uint32_t count = slist.size();
+
+    char hdr_buf[1 + sizeof(count)];
+    hdr_buf[0] = (char)cp_rply::MEMUSAGE;
+    memcpy(hdr_buf + 1, &count, sizeof(count));
+    if (!queue_packet(hdr_buf, sizeof(hdr_buf))) return false;
+
+    // Entry: (4 byte) record size, (4 byte) heap size, (2 byte) name length, name
+    constexpr size_t entry_hdr_size = 2 * sizeof(uint32_t) + sizeof(uint16_t);
+    std::vector<char> entry_buf;
+    for (auto sptr : slist) {
+        service_mem_usage usage;
+        sptr->get_mem_usage(usage);
+
+        const std::string &name = sptr->get_name();
+        uint16_t name_len = std::min(name.length(), (size_t)UINT16_MAX);
+        uint32_t sizes[2] = { (uint32_t)std::min(usage.record_size, (size_t)UINT32_MAX),
+                (uint32_t)std::min(usage.heap_size, (size_t)UINT32_MAX) };
+
+        entry_buf.resize(entry_hdr_size + name_len);
+        char *p = entry_buf.data();
+        memcpy(p, sizes, sizeof(sizes));
+        p += sizeof(sizes);
+        memcpy(p, &name_len, sizeof(name_len));
+        p += sizeof(name_len);
+        memcpy(p, name.data(), name_len);
+
+        if (!queue_packet(entry_buf.data(), entry_buf.size())) return false;
+    }
+
+    return true;
+}
+
 bool control_conn_t::process_set_trigger()
 {
     // 1 byte packet type
@@ -1335,17 +2068,22 @@ bool control_conn_t::process_catlog()
         return queue_packet(nak_rep, 1);
     }
 
-    auto buffer_details = bps->get_log_buffer();
-    const char *bufaddr = buffer_details.first;
-    unsigned buflen = buffer_details.second;
+    // The log buffer may have wrapped, in which case its contents are in two segments. We send the
+    // packet header and both segments directly from their current locations.
+    struct iovec pkt_parts[3];
+    bps->get_log_buffer(&pkt_parts[1]);
+    unsigned buflen = pkt_parts[1].iov_len + pkt_parts[2].iov_len;
 
-    std::vector<char> pkt = { (char)cp_rply::SERVICE_LOG, 0 /* flags; reserved for future */ };
-    pkt.insert(pkt.end(), (char *)(&buflen), (char *)(&buflen + 1));
-    pkt.insert(pkt.end(), bufaddr, bufaddr + buflen);
+    char pkt_hdr[2 + sizeof(buflen)] = { (char)cp_rply::SERVICE_LOG, 0 /* flags; reserved for future */ };
+    memcpy(pkt_hdr + 2, &buflen, sizeof(buflen));
+    pkt_parts[0].iov_base = pkt_hdr;
+    pkt_parts[0].iov_len = sizeof(pkt_hdr);
+
+    bool r = queue_packet(pkt_parts, 3);
     if ((flags & 1) != 0) {
         bps->clear_log_buffer();
     }
-    return queue_packet(std::move(pkt));
+    return r;
 }
 
 bool control_conn_t::process_signal()
@@ -1553,46 +2291,99 @@ bool control_conn_t::query_load_mech()
 
 handle_t control_conn_t::allocate_service_handle(service_record *record)
 {
-    // Try to find a unique handle (integer) in a single pass. Since the map is ordered, we can search until
-    // we find a gap in the handle values.
-    handle_t candidate = 0;
-    for (auto p : key_service_map) {
-        if (p.first == candidate) ++candidate;
-        else break;
+    // Get a free slot (if there is none, add one) first, since that may fail:
+    if (free_slot == no_slot) {
+        if (handle_slots.size() > handle_slot_mask) throw std::bad_alloc();
+        handle_slots.push_back({nullptr, 0, no_slot});
+        free_slot = handle_slots.size() - 1;
     }
 
-    bool is_unique = (service_key_map.find(record) == service_key_map.end());
-
-    // The following operations perform allocation (can throw std::bad_alloc). If an exception occurs we
-    // must undo any previous actions:
-    if (is_unique) {
-        record->add_listener(this);
+    conn_service_ref *ref;
+    auto ref_it = service_refs.find(record);
+    if (ref_it != service_refs.end()) {
+        ref = ref_it->second;
     }
-    
-    try {
-        key_service_map[candidate] = record;
-        service_key_map.insert(std::make_pair(record, candidate));
+    else {
+        // The following operations perform allocation (can throw std::bad_alloc); the free slot
+        // remains free if so.
+        std::unique_ptr<conn_service_ref> new_ref { new conn_service_ref(this, record) };
+        service_refs.emplace(record, new_ref.get());
+        ref = new_ref.release();
+        record->add_listener(ref);
+    }
+
+    uint32_t index = free_slot;
+    handle_slot &slot = handle_slots[index];
+    free_slot = slot.next;
+    slot.ref = ref;
+    slot.next = ref->first_slot;
+    ref->first_slot = index;
+
+    return (slot.generation << handle_slot_bits) | index;
+}
+
+void control_conn_t::release_service_handle(handle_t key) noexcept
+{
+    uint32_t index = key & handle_slot_mask;
+    conn_service_ref *ref = handle_slots[index].ref;
+
+    // Unlink the slot from the chain of slots for the service:
+    uint32_t *link = &ref->first_slot;
+    while (*link != index) {
+        link = &handle_slots[*link].next;
     }
-    catch (...) {
-        if (is_unique) {
-            record->remove_listener(this);
-        }
+    *link = handle_slots[index].next;
+
+    free_handle_slot(index);
+}
+
+void control_conn_t::release_service_handles(service_record *service) noexcept
+{
+    auto ref_it = service_refs.find(service);
+    if (ref_it == service_refs.end()) return;
+
+    // (freeing the last slot also deletes the reference)
+    conn_service_ref *ref = ref_it->second;
+    bool more;
+    do {
+        uint32_t index = ref->first_slot;
+        ref->first_slot = handle_slots[index].next;
+        more = ref->first_slot != no_slot;
+        free_handle_slot(index);
+    } while (more);
+}
+
+void control_conn_t::free_handle_slot(uint32_t index) noexcept
+{
+    handle_slot &slot = handle_slots[index];
+    conn_service_ref *ref = slot.ref;
+
+    slot.ref = nullptr;
+    slot.generation++;
+    slot.next = free_slot;
+    free_slot = index;
 
-        key_service_map.erase(candidate);
+    if (ref->first_slot == no_slot) {
+        // No more handles refer to the service
+        ref->service->remove_listener(ref);
+        service_refs.erase(ref->service);
+        delete ref;
     }
-    
-    return candidate;
 }
 
-void control_conn_t::service_event(service_record *service, service_event_t event) noexcept
+void conn_service_ref::service_event(service_record *service, service_event_t event) noexcept
 {
+    conn->service_event(this, event);
+}
+
+void control_conn_t::service_event(conn_service_ref *ref, service_event_t event) noexcept
+{
+    service_record *service = ref->service;
+
     // For each service handle corresponding to the event, send an information packet.
-    auto range = service_key_map.equal_range(service);
-    auto &i = range.first;
-    auto &end = range.second;
     try {
-        while (i != end) {
-            uint32_t key = i->second;
+        for (uint32_t index = ref->first_slot; index != no_slot; index = handle_slots[index].next) {
+            uint32_t key = (handle_slots[index].generation << handle_slot_bits) | index;
             std::vector<char> pkt;
 
             // There are two types of service event packet: v5+, and the original. For backwards
@@ -1628,8 +2419,6 @@ void control_conn_t::service_event(service_record *service, service_event_t even
             pkt.resize(pktsize);
             fill_status_buffer(pkt.data() + 3 + sizeof(key), service);
             queue_packet(std::move(pkt));
-
-            ++i;
         }
     }
     catch (std::bad_alloc &exc) {
@@ -1637,6 +2426,48 @@ void control_conn_t::service_event(service_record *service, service_event_t even
     }
 }
 
+void control_conn_t::service_set_event(const service_set_event_t &event) noexcept
+{
+    queue_service_delta(event);
+}
+
+bool control_conn_t::queue_service_delta(const service_set_event_t &event) noexcept
+{
+    // packet type (byte) + packet length (byte) + event code (byte) + sequence number +
+    // service id + state (byte) + target state (byte) [+ service name, for ADDED]
+    constexpr unsigned hdr_size = 3 + sizeof(event.seq) + sizeof(event.service_id) + 2;
+    char pkt[UCHAR_MAX];
+
+    unsigned pkt_size = hdr_size;
+    char event_code;
+    switch (event.kind) {
+    case service_set_event_t::kind_t::ADDED:
+        event_code = (char)cp_delta_event::ADDED;
+        if (event.service != nullptr) {
+            const std::string &name = event.service->get_name();
+            unsigned name_len = std::min(name.length(), sizeof(pkt) - hdr_size);
+            memcpy(pkt + hdr_size, name.data(), name_len);
+            pkt_size += name_len;
+        }
+        break;
+    case service_set_event_t::kind_t::REMOVED:
+        event_code = (char)cp_delta_event::REMOVED;
+        break;
+    default:
+        event_code = static_cast<char>(event.event);
+    }
+
+    pkt[0] = (char)cp_info::SERVICEDELTA;
+    pkt[1] = (char)pkt_size;
+    pkt[2] = event_code;
+    memcpy(pkt + 3, &event.seq, sizeof(event.seq));
+    memcpy(pkt + 3 + sizeof(event.seq), &event.service_id, sizeof(event.service_id));
+    pkt[hdr_size - 2] = static_cast<char>(event.state);
+    pkt[hdr_size - 1] = static_cast<char>(event.target_state);
+
+    return queue_packet(pkt, pkt_size);
+}
+
 void control_conn_t::environ_event(environment *env, std::string const &var_and_val, bool overridden) noexcept
 {
     // packet type (byte) + packet length (byte) + flags byte + data size + data
@@ -1660,13 +2491,27 @@ void control_conn_t::environ_event(environment *env, std::string const &var_and_
 }
 
 bool control_conn_t::queue_packet(const char *pkt, unsigned size) noexcept
+{
+    struct iovec part;
+    part.iov_base = const_cast<char *>(pkt);
+    part.iov_len = size;
+    return queue_packet(&part, 1);
+}
+
+bool control_conn_t::queue_packet(const struct iovec *parts, int num_parts) noexcept
 {
     bool was_empty = outbuf.empty();
 
+    size_t size = 0;
+    for (int i = 0; i < num_parts; ++i) {
+        size += parts[i].iov_len;
+    }
+
     // If the queue is empty, we can try to write the packet out now rather than queueing it.
     // If the write is unsuccessful or partial, we queue the remainder.
+    size_t written = 0;
     if (was_empty) {
-        int wr = bp_sys::write(iob.get_watched_fd(), pkt, size);
+        ssize_t wr = bp_sys::writev(iob.get_watched_fd(), parts, num_parts);
         if (wr == -1) {
             if (errno == EPIPE) {
                 return false;
@@ -1678,19 +2523,17 @@ bool control_conn_t::queue_packet(const char *pkt, unsigned size) noexcept
             // EAGAIN etc: fall through to below
         }
         else {
-            if ((unsigned)wr == size) {
+            if ((size_t)wr == size) {
                 // Ok, all written.
                 return true;
             }
-            pkt += wr;
-            size -= wr;
+            written = wr;
         }
     }
-    
-    // Create a vector out of the (remaining part of the) packet:
+
+    // Queue the (remaining part of the) packet:
     try {
-        outbuf.emplace_back(pkt, pkt + size);
-        outbuf_size += size;
+        outbuf.append(parts, num_parts, written);
         return true;
     }
     catch (std::bad_alloc &baexc) {
@@ -1709,54 +2552,9 @@ bool control_conn_t::queue_packet(const char *pkt, unsigned size) noexcept
     }
 }
 
-// This queue_packet method is frustratingly similar to the one above, but the subtle differences
-// make them extraordinary difficult to combine into a single method.
 bool control_conn_t::queue_packet(std::vector<char> &&pkt) noexcept
 {
-    bool was_empty = outbuf.empty();
-    
-    if (was_empty) {
-        outpkt_index = 0;
-        // We can try sending the packet immediately:
-        int wr = bp_sys::write(iob.get_watched_fd(), pkt.data(), pkt.size());
-        if (wr == -1) {
-            if (errno == EPIPE) {
-                return false;
-            }
-            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
-                log(loglevel_t::WARN, "Error writing to control connection: ", strerror(errno));
-                return false;
-            }
-            // EAGAIN etc: fall through to below
-        }
-        else {
-            if ((unsigned)wr == pkt.size()) {
-                // Ok, all written.
-                return true;
-            }
-            outpkt_index = wr;
-        }
-    }
-    
-    try {
-        outbuf.emplace_back(std::move(pkt));
-        outbuf_size += pkt.size();
-        return true;
-    }
-    catch (std::bad_alloc &baexc) {
-        // Mark the connection bad, and stop reading further requests
-        bad_conn_close = true;
-        oom_close = true;
-        if (was_empty) {
-            // We can't send out-of-memory response as we already wrote as much as we
-            // could above. Neither can we later send the response since we have currently
-            // sent an incomplete packet. All we can do is close the connection.
-            return false;
-        }
-        else {
-            return true;
-        }
-    }
+    return queue_packet(pkt.data(), pkt.size());
 }
 
 bool control_conn_t::data_ready() noexcept
@@ -1814,10 +2612,15 @@ bool control_conn_t::send_data() noexcept
         }
         return true;
     }
-    
-    vector<char> & pkt = outbuf.front();
-    char *data = pkt.data();
-    int written = bp_sys::write(iob.get_watched_fd(), data + outpkt_index, pkt.size() - outpkt_index);
+
+    // Write out as much of the queued output as we can in one go. (The queued data isn't likely to
+    // span more than a few chunks, since we stop reading requests once the buffer fills beyond
+    // OUTBUF_LIMIT.)
+    constexpr int max_iov = (IOV_MAX < 64) ? IOV_MAX : 64;
+    struct iovec iov[max_iov];
+    int num_iov = outbuf.get_iovecs(iov, max_iov);
+
+    ssize_t written = bp_sys::writev(iob.get_watched_fd(), iov, num_iov);
     if (written == -1) {
         if (errno == EPIPE) {
             // read end closed
@@ -1833,21 +2636,17 @@ bool control_conn_t::send_data() noexcept
         }
     }
 
-    outpkt_index += written;
-    if (outpkt_index == pkt.size()) {
-        // We've finished this packet, move on to the next:
-        outbuf_size -= pkt.size();
-        outbuf.pop_front();
-        outpkt_index = 0;
+    outbuf.consume(written);
+    if (outbuf.empty()) {
         if (oom_close) {
             // remain active, try to send cp_rply::OOM shortly
             return false;
         }
-        if (outbuf.empty() && bad_conn_close) {
+        if (bad_conn_close) {
             return true;
         }
     }
-    
+
     // more to send
     return false;
 }
@@ -1858,11 +2657,15 @@ control_conn_t::~control_conn_t() noexcept
     iob.deregister(loop);
     bp_sys::close(fd);
     
-    // Clear service listeners
-    for (auto p : service_key_map) {
-        p.first->remove_listener(this);
+    // Clear service references (and listeners)
+    for (auto p : service_refs) {
+        p.first->remove_listener(p.second);
+        delete p.second;
     }
     main_env.remove_listener(this);
+    if (subscribed) {
+        services->remove_set_listener(this);
+    }
     
     active_control_conns--;
 }
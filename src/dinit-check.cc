@@ -872,7 +872,8 @@ service_record *load_service(service_set_t &services, const std::string &name,
                 settings.stop_command.substr(offset_start, offset_end - offset_start).c_str());
     }
 
-    if (settings.log_type == log_type_id::LOGFILE && !settings.logfile.empty()) {
+    if (value(settings.log_type).is_in(log_type_id::LOGFILE, log_type_id::ROTFILE)
+            && !settings.logfile.empty()) {
         string logfile_dir = parent_path(settings.logfile);
         if (!logfile_dir.empty()) {
             struct stat logfile_dir_stat;
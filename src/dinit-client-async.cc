@@ -0,0 +1,241 @@
+#include <cerrno>
+
+#include <unistd.h>
+
+#include <dinit-client-async.h>
+
+// Asynchronous (non-blocking) control protocol client: see dinit-client-async.h
+
+using dinit_cptypes::handle_t;
+using dinit_cptypes::envvar_len_t;
+
+void decode_service_status(const char *buf, bool v5, dinit_service_status &status) noexcept
+{
+    status.state = (service_state_t)buf[0];
+    status.target_state = (service_state_t)buf[1];
+
+    char flags = buf[2];
+    status.waiting_for_console = (flags & 1) != 0;
+    status.has_console = (flags & 2) != 0;
+    status.was_skipped = (flags & 4) != 0;
+    status.marked_active = (flags & 8) != 0;
+    bool has_pid = (flags & 16) != 0;
+
+    status.stop_reason = (stopped_reason_t)buf[3];
+    status.exec_stage = 0;
+    status.exit_si_code = 0;
+    status.exit_si_status = 0;
+    status.pid = -1;
+
+    if (has_pid) {
+        memcpy(&status.pid, buf + 6, sizeof(status.pid));
+    }
+    else if (status.stop_reason == stopped_reason_t::EXECFAILED) {
+        memcpy(&status.exec_stage, buf + 4, sizeof(status.exec_stage));
+        memcpy(&status.exit_si_code, buf + 6, sizeof(status.exit_si_code));
+    }
+    else {
+        memcpy(&status.exit_si_code, buf + 6, sizeof(status.exit_si_code));
+        if (v5) {
+            memcpy(&status.exit_si_status, buf + 6 + sizeof(int), sizeof(status.exit_si_status));
+        }
+    }
+}
+
+size_t dinit_reply_length(const char *data, size_t len)
+{
+    switch ((cp_rply)data[0]) {
+    case cp_rply::ACK:
+    case cp_rply::NAK:
+    case cp_rply::BADREQ:
+    case cp_rply::OOM:
+    case cp_rply::SERVICELOADERR:
+    case cp_rply::SERVICEOOM:
+    case cp_rply::NOSERVICE:
+    case cp_rply::ALREADYSS:
+    case cp_rply::PINNEDSTOPPED:
+    case cp_rply::PINNEDSTARTED:
+    case cp_rply::SHUTTINGDOWN:
+    case cp_rply::SERVICE_DESC_ERR:
+    case cp_rply::SERVICE_LOAD_ERR:
+    case cp_rply::SIGNAL_NOPID:
+    case cp_rply::SIGNAL_BADSIG:
+    case cp_rply::SIGNAL_KILLERR:
+    case cp_rply::PREACK:
+        return 1;
+    case cp_rply::CPVERSION:
+        // (2 byte) minimum compatible version, (2 byte) actual version
+        return 5;
+    case cp_rply::SERVICERECORD:
+        // state, handle, target state
+        return 3 + sizeof(handle_t);
+    case cp_rply::DEPENDENTS:
+    {
+        // (size_t) count, count * handle
+        constexpr size_t hdr_size = 1 + sizeof(size_t);
+        if (len < hdr_size) return 0;
+        size_t count;
+        memcpy(&count, data + 1, sizeof(count));
+        if (count > (std::numeric_limits<size_t>::max() - hdr_size) / sizeof(handle_t)) {
+            throw dinit_protocol_error();
+        }
+        return hdr_size + count * sizeof(handle_t);
+    }
+    default:
+        throw dinit_protocol_error();
+    }
+}
+
+void dinit_async_conn::send_request(const char *data, size_t len,
+        std::unique_ptr<dinit_reply_handler> handler)
+{
+    if (out_pos == outbuf.size()) {
+        outbuf.clear();
+        out_pos = 0;
+    }
+    // Make room for the handler first, so that a failure leaves no unmatched request
+    pending.emplace_back();
+    try {
+        outbuf.insert(outbuf.end(), data, data + len);
+    }
+    catch (...) {
+        pending.pop_back();
+        throw;
+    }
+    pending.back() = std::move(handler);
+}
+
+void dinit_async_conn::write_ready()
+{
+    while (out_pos < outbuf.size()) {
+        ssize_t r = write(fd, outbuf.data() + out_pos, outbuf.size() - out_pos);
+        if (r == -1) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return;
+            throw cp_write_exception(errno);
+        }
+        out_pos += r;
+    }
+    outbuf.clear();
+    out_pos = 0;
+}
+
+void dinit_async_conn::read_ready()
+{
+    // Discard already-processed input
+    if (in_pos != 0) {
+        inbuf.erase(inbuf.begin(), inbuf.begin() + in_pos);
+        in_pos = 0;
+    }
+
+    // On end-of-file or error, any complete packets already read are still processed, before the
+    // exception is thrown.
+    constexpr size_t read_size = 1024;
+    int read_err = -1;
+    while (true) {
+        size_t old_size = inbuf.size();
+        inbuf.resize(old_size + read_size);
+        ssize_t r = read(fd, inbuf.data() + old_size, read_size);
+        if (r <= 0) {
+            inbuf.resize(old_size);
+            if (r == 0) {
+                read_err = 0;
+                break;
+            }
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            read_err = errno;
+            break;
+        }
+        inbuf.resize(old_size + r);
+        if ((size_t)r < read_size) break;
+    }
+
+    process_input();
+
+    if (read_err != -1) {
+        throw cp_read_exception(read_err);
+    }
+}
+
+void dinit_async_conn::process_input()
+{
+    while (in_pos < inbuf.size()) {
+        const char *data = inbuf.data() + in_pos;
+        size_t avail = inbuf.size() - in_pos;
+        size_t pkt_len;
+
+        if ((unsigned char)data[0] >= 100) {
+            // Information packet: type, length, ...
+            if (avail < 2) return;
+            pkt_len = (unsigned char)data[1];
+            if (data[0] == (char)cp_info::ENVEVENT) {
+                // The length covers only the header; the variable data (of given length) follows
+                constexpr size_t hdr_size = 3 + sizeof(envvar_len_t);
+                if (pkt_len != hdr_size) throw dinit_protocol_error();
+                if (avail < hdr_size) return;
+                envvar_len_t ln;
+                memcpy(&ln, data + 3, sizeof(ln));
+                pkt_len += ln;
+            }
+            else if (pkt_len < 2) {
+                throw dinit_protocol_error();
+            }
+            if (avail < pkt_len) return;
+            in_pos += pkt_len;
+            process_info(data, pkt_len);
+        }
+        else {
+            if (pending.empty()) throw dinit_protocol_error();
+            // (references to deque elements remain valid if further requests are queued)
+            dinit_reply_handler *handler = pending.front().get();
+            pkt_len = handler->reply_length(data, avail);
+            if (pkt_len == 0 || avail < pkt_len) return;
+            in_pos += pkt_len;
+            if (handler->reply(data, pkt_len)) {
+                pending.pop_front();
+            }
+        }
+    }
+}
+
+void dinit_async_conn::process_info(const char *data, size_t len)
+{
+    if (info_handler == nullptr) return;
+
+    switch ((cp_info)data[0]) {
+    case cp_info::SERVICEEVENT5:
+    case cp_info::SERVICEEVENT:
+    {
+        // handle, event, status buffer. Since protocol version 5, each event is reported via
+        // SERVICEEVENT5 followed by SERVICEEVENT (for older clients); report only one.
+        bool v5 = data[0] == (char)cp_info::SERVICEEVENT5;
+        if (v5) {
+            seen_event5 = true;
+        }
+        else if (seen_event5) {
+            return;
+        }
+        constexpr size_t hdr_size = 3 + sizeof(handle_t);
+        if (len < hdr_size + (v5 ? STATUS_BUFFER5_SIZE : STATUS_BUFFER_SIZE)) {
+            throw dinit_protocol_error();
+        }
+        handle_t handle;
+        memcpy(&handle, data + 2, sizeof(handle));
+        dinit_service_status status;
+        decode_service_status(data + hdr_size, v5, status);
+        info_handler->service_event(handle, (service_event_t)data[2 + sizeof(handle)], status);
+        return;
+    }
+    case cp_info::ENVEVENT:
+    {
+        // flags, length, variable (nul-terminated)
+        constexpr size_t hdr_size = 3 + sizeof(envvar_len_t);
+        if (len == hdr_size || data[len - 1] != '\0') throw dinit_protocol_error();
+        info_handler->env_event(data + hdr_size, data[2] != 0);
+        return;
+    }
+    default:
+        info_handler->info_packet(data, len);
+    }
+}
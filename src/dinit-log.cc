@@ -2,6 +2,9 @@
 
 #include <unistd.h>
 #include <fcntl.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <sys/syslog.h>
 #include <sys/uio.h>
 
@@ -9,7 +12,8 @@
 
 #include "service.h"
 #include "dinit-log.h"
-#include "cpbuffer.h"
+#include "log-arena.h"
+#include "dinit-journal.h"
 
 // Dinit logging subsystem.
 //
@@ -34,6 +38,11 @@ bool console_service_status = true;  // always show service status messages to c
 
 dasynq::time_val release_time; // time the log was released
 
+// Boot journal (if open):
+static journal_writer journal;
+static char *journal_map = nullptr;
+static size_t journal_map_size = 0;
+
 using rearm = dasynq::rearm;
 
 namespace {
@@ -42,25 +51,25 @@ class buffered_log_stream : public eventloop_t::fd_watcher_impl<buffered_log_str
     private:
 
     // Outgoing:
-    bool partway = false;     // if we are partway throught output of a log message
-    bool discarded = false;   // if we have discarded a message
     bool release = true;      // if we should inhibit output and release console when possible
 
-    // A "special message" is not stored in the circular buffer; instead
-    // it is delivered from an external buffer not managed by BufferedLogger.
+    // A "special message" is not stored in the message buffer; instead it is delivered from a
+    // separate buffer. It is used to report discarded messages.
     bool special = false;      // currently outputting special message?
-    const char *special_buf; // buffer containing special message
+    char special_buf[128];     // buffer containing special message
     int msg_index;     // index into special message
 
-    cpbuffer<4096> log_buffer;
+    log_arena log_buffer;
     
     public:
-    
-    // Incoming:
-    int current_index = 0;    // current/next incoming message index
 
     int fd = -1;
 
+    buffered_log_stream() noexcept
+    {
+        log_buffer.set_max_size(DEFAULT_LOG_BUFFER_MAX);
+    }
+
     void init(int fd)
     {
         this->fd = fd;
@@ -73,42 +82,42 @@ class buffered_log_stream : public eventloop_t::fd_watcher_impl<buffered_log_str
     void flush_for_release();
     bool is_release_set() { return release; }
     
+    // Begin a log message. Returns false if the message must be discarded (due to lack of space).
+    bool begin_msg(loglevel_t lvl)
+    {
+        return log_buffer.begin_msg((unsigned)lvl);
+    }
+
     // Commit a log message
     void commit_msg()
     {
-        bool was_first = current_index == 0;
-        current_index = log_buffer.get_length();
+        bool was_first = log_buffer.commit();
         if (was_first && !release) {
             set_enabled(event_loop, true);
         }
     }
-    
-    void rollback_msg()
-    {
-        log_buffer.trim_to(current_index);
-    }
-    
-    int get_free()
+
+    // Append to the current message. If there is no space, the message is discarded, and false is
+    // returned.
+    bool append(const char *s, size_t len)
     {
-        return log_buffer.get_free();
+        return log_buffer.append(s, len);
     }
-    
-    void append(const char *s, size_t len)
+
+    bool is_empty()
     {
-        log_buffer.append(s, len);
+        return log_buffer.empty();
     }
-    
+
     // Discard buffer; call only when the stream isn't active.
     void discard()
     {
-        current_index = 0;
-        log_buffer.trim_to(0);
+        log_buffer.clear();
     }
 
-    // Mark that a message was discarded due to full buffer
-    void mark_discarded()
+    log_arena &get_buffer()
     {
-        discarded = true;
+        return log_buffer;
     }
 
     void watch_removed() noexcept override;
@@ -121,6 +130,9 @@ class buffered_log_stream : public eventloop_t::fd_watcher_impl<buffered_log_str
 // (One for main log, one for console)
 buffered_log_stream log_stream[DLOG_NUM];
 
+static_assert(log_arena::num_priorities == (int)loglevel_t::ZERO && DLOG_NUM_LEVELS == (int)loglevel_t::ZERO,
+        "log levels don't match buffer priorities");
+
 void buffered_log_stream::release_console()
 {
     if (release) {
@@ -159,14 +171,17 @@ void buffered_log_stream::flush_for_release()
 
 rearm buffered_log_stream::fd_event(eventloop_t &loop, int fd, int flags) noexcept
 {
-    if ((!partway) && (!special) && discarded) {
-        special_buf = "dinit: *** log message discarded due to full buffer ***\n";
-        special = true;
-        discarded = false;
-        msg_index = 0;
+    if (!log_buffer.is_partway() && !special) {
+        unsigned long discards = log_buffer.take_unreported_discards();
+        if (discards != 0) {
+            buf_print(special_buf, "dinit: *** ", discards,
+                    " log message(s) discarded due to full buffer ***\n");
+            special = true;
+            msg_index = 0;
+        }
     }
 
-    if ((!partway) && special) {
+    if (!log_buffer.is_partway() && special) {
         const char * start = special_buf + msg_index;
         const char * end = start;
         while (*end != '\n') end++;
@@ -175,7 +190,6 @@ rearm buffered_log_stream::fd_event(eventloop_t &loop, int fd, int flags) noexce
             if (start + r > end) {
                 // All written: go on to next message in queue
                 special = false;
-                discarded = false;
                 msg_index = 0;
                 
                 if (release) {
@@ -194,65 +208,24 @@ rearm buffered_log_stream::fd_event(eventloop_t &loop, int fd, int flags) noexce
         return rearm::REARM;
     }
     else {
-        // Writing from the regular circular buffer
+        // Writing from the message buffer
         
-        if (current_index == 0) {
+        if (log_buffer.empty()) {
             release_console();
             return rearm::DISARM;
         }
         
-        // We try to find a complete line (terminated by '\n') in the buffer, and write it
-        // out. Since it may span the circular buffer end, it may consist of two distinct spans,
-        // and so we use writev to write them atomically.
-        
-        struct iovec logiov[2];
-        
-        char *ptr = log_buffer.get_ptr(0);
-        unsigned len = log_buffer.get_contiguous_length(ptr);
-        char *creptr = ptr + len;  // contiguous region end
-        char *eptr = std::find(ptr, creptr, '\n');
-        
-        bool will_complete = false;  // will complete this message?
-        if (eptr != creptr) {
-            eptr++;  // include '\n'
-            will_complete = true;
-        }
-
-        len = eptr - ptr;
-        
-        logiov[0].iov_base = ptr;
-        logiov[0].iov_len = len;
-        int iovs_to_write = 1;
-        
-        // Do we need the second span?
-        if (!will_complete && len != log_buffer.get_length()) {
-            ptr = log_buffer.get_buf_base();
-            creptr = ptr + log_buffer.get_length() - len;
-            eptr = std::find(ptr, creptr, '\n');
-            if (eptr != creptr) {
-                eptr++; // include '\n'
-                // It should not ever be the case that we do not now have a complete message
-                will_complete = true;
-            }
-            logiov[1].iov_base = ptr;
-            logiov[1].iov_len = eptr - ptr;
-            len += logiov[1].iov_len;
-            iovs_to_write = 2;
-        }
-        
-        ssize_t r = bp_sys::writev(fd, logiov, iovs_to_write);
+        // Write out (the remainder of) the first message. Each message is stored contiguously.
+        size_t len;
+        const char *ptr = log_buffer.front(len);
+        ssize_t r = bp_sys::write(fd, ptr, len);
 
         if (r >= 0) {
-            bool complete = (r == len) && will_complete;
-            log_buffer.consume(len);
-            partway = !complete;
-            if (complete) {
-                current_index -= len;
-                if (current_index == 0 || release) {
-                    // No more messages buffered / stop logging to console:
-                    release_console();
-                    return rearm::DISARM;
-                }
+            bool complete = log_buffer.consume(r);
+            if (complete && (log_buffer.empty() || release)) {
+                // No more messages buffered / stop logging to console:
+                release_console();
+                return rearm::DISARM;
             }
         }
         else if (errno != EAGAIN && errno != EINTR && errno != EWOULDBLOCK) {
@@ -316,8 +289,108 @@ void setup_main_log(int fd)
 
 bool is_log_flushed() noexcept
 {
-    return log_stream[DLOG_CONS].current_index == 0 &&
-            (log_stream[DLOG_MAIN].fd == -1 || log_stream[DLOG_MAIN].current_index == 0);
+    return log_stream[DLOG_CONS].is_empty() &&
+            (log_stream[DLOG_MAIN].fd == -1 || log_stream[DLOG_MAIN].is_empty());
+}
+
+// Get the current (wall-clock) time for a journal record
+static uint64_t journal_time() noexcept
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+// Record a message or event in the boot journal (if open), if it is at or above the main log level
+static void journal_log(journal_rec_type type, loglevel_t lvl, const char *service_name,
+        const char *msg) noexcept
+{
+    if (lvl < log_level[DLOG_MAIN]) return;
+    size_t name_len = (service_name != nullptr) ? strlen(service_name) : 0;
+    if (journal.begin(type, (uint8_t)lvl, service_name, name_len)) {
+        journal.append(msg, strlen(msg));
+        journal.commit(journal_time());
+    }
+}
+
+bool open_journal(const char *path, size_t size) noexcept
+{
+    size &= ~(journal_rec_align - 1);
+    if (size < journal_min_size) {
+        errno = EINVAL;
+        return false;
+    }
+
+    int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (fd == -1) return false;
+
+    struct stat statbuf;
+    void *map = MAP_FAILED;
+    bool resized = false;
+    if (fstat(fd, &statbuf) == 0) {
+        resized = ((size_t)statbuf.st_size != size);
+        if (!resized || ftruncate(fd, size) == 0) {
+            map = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        }
+    }
+    int saved_errno = errno;
+    close(fd);
+    if (map == MAP_FAILED) {
+        errno = saved_errno;
+        return false;
+    }
+
+    // Initialise the journal if it's new, of a different size, or otherwise not valid:
+    char *map_p = static_cast<char *>(map);
+    journal_file_hdr hdr;
+    memcpy(&hdr, map_p, sizeof(hdr));
+    if (resized || memcmp(hdr.magic, journal_magic, sizeof(journal_magic)) != 0
+            || hdr.version != journal_version || hdr.hdr_size != journal_hdr_size
+            || hdr.size != size) {
+        memset(map_p, 0, size);
+        memcpy(hdr.magic, journal_magic, sizeof(journal_magic));
+        hdr.version = journal_version;
+        hdr.hdr_size = journal_hdr_size;
+        hdr.size = size;
+        memcpy(map_p, &hdr, sizeof(hdr));
+    }
+
+    if (journal_map != nullptr) {
+        munmap(journal_map, journal_map_size);
+    }
+    journal_map = map_p;
+    journal_map_size = size;
+    journal.attach(map_p + journal_hdr_size, size - journal_hdr_size);
+
+    if (journal.begin(journal_rec_type::DINIT_START, (uint8_t)loglevel_t::NOTICE, nullptr, 0)) {
+        journal.commit(journal_time());
+    }
+    return true;
+}
+
+void sync_journal() noexcept
+{
+    if (journal_map != nullptr) {
+        msync(journal_map, journal_map_size, MS_SYNC);
+    }
+}
+
+void set_log_buffer_max(size_t max_size) noexcept
+{
+    for (int i = 0; i < DLOG_NUM; i++) {
+        log_stream[i].get_buffer().set_max_size(max_size);
+    }
+}
+
+void get_log_stats(int idx, log_stats_t &stats) noexcept
+{
+    log_arena &buffer = log_stream[idx].get_buffer();
+    stats.buffered = buffer.get_length();
+    stats.capacity = buffer.get_capacity();
+    stats.max_capacity = buffer.get_max_size();
+    for (unsigned i = 0; i < log_arena::num_priorities; i++) {
+        stats.discarded[i] = buffer.get_discarded(i);
+    }
 }
 
 // Enable or disable console logging. If disabled, console logging will be disabled on the
@@ -349,27 +422,15 @@ void discard_console_log_buffer() noexcept
     }
 }
 
-// Variadic method to calculate the sum of string lengths:
-static int sum_length(const char *arg) noexcept
+// Variadic method to append strings to a buffer. Returns false if the message was discarded.
+static bool append(buffered_log_stream &buf, const char *s)
 {
-    return std::strlen(arg);
+    return buf.append(s, std::strlen(s));
 }
 
-template <typename ... T> static int sum_length(const char * first, T ... args) noexcept
+template <typename ... T> static bool append(buffered_log_stream &buf, const char *u, T ... t)
 {
-    return sum_length(first) + sum_length(args...);
-}
-
-// Variadic method to append strings to a buffer:
-static void append(buffered_log_stream &buf, const char *s)
-{
-    buf.append(s, std::strlen(s));
-}
-
-template <typename ... T> static void append(buffered_log_stream &buf, const char *u, T ... t)
-{
-    append(buf, u);
-    append(buf, t...);
+    return append(buf, u) && append(buf, t...);
 }
 
 static int log_level_to_syslog_level(loglevel_t l)
@@ -390,17 +451,12 @@ static int log_level_to_syslog_level(loglevel_t l)
 }
 
 // Variadic method to log a sequence of strings as a single message to a particular facility:
-template <typename ... T> static void push_to_log(int idx, T ... args) noexcept
+template <typename ... T> static void push_to_log(int idx, loglevel_t lvl, T ... args) noexcept
 {
     if (!log_current_line[idx]) return;
-    int amount = sum_length(args...);
-    if (log_stream[idx].get_free() >= amount) {
-        append(log_stream[idx], args...);
+    if (log_stream[idx].begin_msg(lvl) && append(log_stream[idx], args...)) {
         log_stream[idx].commit_msg();
     }
-    else {
-        log_stream[idx].mark_discarded();
-    }
 }
 
 namespace {
@@ -426,15 +482,15 @@ template <typename ... T> static void do_log(loglevel_t lvl, bool to_cons, T ...
 {
     log_current_line[DLOG_CONS] = (lvl >= log_level[DLOG_CONS]) && to_cons;
     log_current_line[DLOG_MAIN] = (lvl >= log_level[DLOG_MAIN]);
-    push_to_log(DLOG_CONS, args...);
+    push_to_log(DLOG_CONS, lvl, args...);
     
     if (log_current_line[DLOG_MAIN]) {
         if (log_format_syslog[DLOG_MAIN]) {
             ll_marker mark(LOG_DAEMON | log_level_to_syslog_level(lvl));
-            push_to_log(DLOG_MAIN, mark.buf, args...);
+            push_to_log(DLOG_MAIN, lvl, mark.buf, args...);
         }
         else {
-            push_to_log(DLOG_MAIN, args...);
+            push_to_log(DLOG_MAIN, lvl, args...);
         }
     }
 }
@@ -445,7 +501,7 @@ template <typename ... T> static void do_log_cons(loglevel_t lvl, T ... args) no
     if (console_service_status || lvl >= log_level[DLOG_CONS]) {
         log_current_line[DLOG_CONS] = true;
         log_current_line[DLOG_MAIN] = false;
-        push_to_log(DLOG_CONS, args...);
+        push_to_log(DLOG_CONS, lvl, args...);
     }
 }
 
@@ -466,10 +522,10 @@ template <typename ... T> static void do_log_main(loglevel_t lvl, T ... args) no
 
     if (log_format_syslog[DLOG_MAIN]) {
         ll_marker mark(LOG_DAEMON | log_level_to_syslog_level(lvl));
-        push_to_log(DLOG_MAIN, mark.buf, args...);
+        push_to_log(DLOG_MAIN, lvl, mark.buf, args...);
     }
     else {
-        push_to_log(DLOG_MAIN, args...);
+        push_to_log(DLOG_MAIN, lvl, args...);
     }
 }
 
@@ -483,26 +539,22 @@ template <typename ... T> static void do_log_main(T ... args) noexcept
 void log(loglevel_t lvl, const char *msg) noexcept
 {
     do_log(lvl, true, "dinit: ", msg, "\n");
+    journal_log(journal_rec_type::MESSAGE, lvl, nullptr, msg);
 }
 
 void log(loglevel_t lvl, bool to_cons, const char *msg) noexcept
 {
     do_log(lvl, to_cons, "dinit: ", msg, "\n");
+    journal_log(journal_rec_type::MESSAGE, lvl, nullptr, msg);
 }
 
 // Log part of a message. A series of calls to do_log_part must be followed by a call to do_log_commit.
 static void do_log_part(int idx, const char *arg) noexcept
 {
     if (log_current_line[idx]) {
-        int amount = sum_length(arg);
-        if (log_stream[idx].get_free() >= amount) {
-            append(log_stream[idx], arg);
-        }
-        else {
-            // we have to discard the message
-            log_stream[idx].rollback_msg();
+        if (!append(log_stream[idx], arg)) {
+            // the message has been discarded
             log_current_line[idx] = false;
-            log_stream[idx].mark_discarded();
         }
     }
 }
@@ -521,6 +573,12 @@ void log_msg_begin(loglevel_t lvl, const char *msg) noexcept
     log_current_line[DLOG_CONS] = lvl >= log_level[DLOG_CONS];
     log_current_line[DLOG_MAIN] = lvl >= log_level[DLOG_MAIN];
 
+    for (int i = 0; i < DLOG_NUM; i++) {
+        if (log_current_line[i] && !log_stream[i].begin_msg(lvl)) {
+            log_current_line[i] = false;
+        }
+    }
+
     // Prepend the syslog priority level string ("<N>") for the main log:
     if (log_current_line[DLOG_MAIN]) {
         if (log_format_syslog[DLOG_MAIN]) {
@@ -533,6 +591,11 @@ void log_msg_begin(loglevel_t lvl, const char *msg) noexcept
         do_log_part(i, "dinit: ");
         do_log_part(i, msg);
     }
+
+    if (lvl >= log_level[DLOG_MAIN]
+            && journal.begin(journal_rec_type::MESSAGE, (uint8_t)lvl, nullptr, 0)) {
+        journal.append(msg, strlen(msg));
+    }
 }
 
 // Continue a multi-part log message
@@ -540,6 +603,7 @@ void log_msg_part(const char *msg) noexcept
 {
     do_log_part(DLOG_CONS, msg);
     do_log_part(DLOG_MAIN, msg);
+    journal.append(msg, strlen(msg));
 }
 
 // Complete a multi-part log message
@@ -550,12 +614,16 @@ void log_msg_end(const char *msg) noexcept
         do_log_part(i, "\n");
         do_log_commit(i);
     }
+
+    journal.append(msg, strlen(msg));
+    journal.commit(journal_time());
 }
 
 void log_service_started(const char *service_name) noexcept
 {
     do_log_cons(loglevel_t::NOTICE, "[  OK  ] ", service_name, "\n");
     do_log_main(loglevel_t::NOTICE, "dinit: service ", service_name, " started.\n");
+    journal_log(journal_rec_type::SERVICE_STARTED, loglevel_t::NOTICE, service_name, "");
 }
 
 void log_service_failed(const char *service_name, bool dep_failed) noexcept
@@ -563,10 +631,13 @@ void log_service_failed(const char *service_name, bool dep_failed) noexcept
     loglevel_t cons_lvl = dep_failed ? loglevel_t::WARN : loglevel_t::ERROR;
     do_log_cons(cons_lvl, "[FAILED] ", service_name, "\n");
     do_log_main(loglevel_t::ERROR, "dinit: service ", service_name, " failed to start.\n");
+    journal_log(journal_rec_type::SERVICE_FAILED, loglevel_t::ERROR, service_name,
+            dep_failed ? "dependency failed" : "");
 }
 
 void log_service_stopped(const char *service_name) noexcept
 {
     do_log_cons(loglevel_t::NOTICE, "[STOPPD] ", service_name, "\n");
     do_log_main(loglevel_t::NOTICE, "dinit: service ", service_name, " stopped.\n");
+    journal_log(journal_rec_type::SERVICE_STOPPED, loglevel_t::NOTICE, service_name, "");
 }
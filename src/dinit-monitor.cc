@@ -23,7 +23,7 @@
 using namespace dinit_cptypes;
 
 static constexpr uint16_t min_cp_version = 1;
-static constexpr uint16_t max_cp_version = 7;
+static constexpr uint16_t max_cp_version = 8;
 
 struct stringview {
     const char *str;
@@ -34,6 +34,9 @@ static std::vector<stringview> split_command(const char *cmd);
 static bool load_service(int socknum, cpbuffer_t &rbuffer, const char *name, handle_t *handle,
         service_state_t *state);
 static void request_environ(int socknum, cpbuffer_t &rbuffer, uint16_t proto_version);
+static void subscribe_all(int socknum, cpbuffer_t &rbuffer, uint16_t proto_version,
+        std::unordered_map<uint32_t, std::string> &all_services,
+        std::vector<std::pair<uint32_t, service_state_t>> &init_states);
 static size_t get_allenv(int socknum, cpbuffer_t &rbuffer);
 
 // dummy handler, so we can wait for children
@@ -49,6 +52,7 @@ int dinit_monitor_main(int argc, char **argv)
     bool user_dinit = (getuid() != 0);  // communicate with user daemon
     bool issue_init = false;  // request initial service state
     bool use_environ = false;  // listening on activation environment changes
+    bool watch_all = false;  // monitor all services (via subscription)
     bool exit_after = false;  // exit after first issued command
     const char *str_started = "started";
     const char *str_stopped = "stopped";
@@ -75,6 +79,9 @@ int dinit_monitor_main(int argc, char **argv)
             else if (strcmp(argv[i], "--env") == 0 || strcmp(argv[i], "-E") == 0) {
                 use_environ = true;
             }
+            else if (strcmp(argv[i], "--all") == 0 || strcmp(argv[i], "-a") == 0) {
+                watch_all = true;
+            }
             else if (strcmp(argv[i], "--system") == 0 || strcmp(argv[i], "-s") == 0) {
                 user_dinit = false;
             }
@@ -156,6 +163,7 @@ int dinit_monitor_main(int argc, char **argv)
                 "  --help           : show this help\n"
                 "  -e, --exit       : exit after the first issued command\n"
                 "  -E, --env        : monitor activation environment changes\n"
+                "  -a, --all        : monitor all services (including those loaded later)\n"
                 "  -s, --system     : monitor system daemon (default if run as root)\n"
                 "  -u, --user       : monitor user daemon\n"
                 "  -i, --initial    : also execute command for initial service state\n"
@@ -172,11 +180,16 @@ int dinit_monitor_main(int argc, char **argv)
         return 1;
     }
 
-    if (services.empty() && !use_environ) {
+    if (services.empty() && !use_environ && !watch_all) {
         std::cerr << "dinit-monitor: specify at least one service name\n";
         return 1;
     }
 
+    if (use_environ && watch_all) {
+        std::cerr << "dinit-monitor: --env and --all are mutually exclusive\n";
+        return 1;
+    }
+
     if (command_str == nullptr) {
         std::cerr << "dinit-monitor: command must specified\n";
         return 1;
@@ -222,6 +235,10 @@ int dinit_monitor_main(int argc, char **argv)
         std::vector<std::pair<const char *, service_state_t>> service_init_state;
         std::string env_value;
 
+        // All services, by id (if watching all services)
+        std::unordered_map<uint32_t, std::string> all_services;
+        std::vector<std::pair<uint32_t, service_state_t>> all_init_state;
+
         for (const char *service_name : services) {
 
             handle_t hndl;
@@ -241,6 +258,17 @@ int dinit_monitor_main(int argc, char **argv)
             service_init_state.push_back(std::make_pair(service_name, state));
         }
 
+        if (watch_all) {
+            // Subscribe to events for all services (rather than the loaded services individually;
+            // the loaded services will be included in the subscription)
+            subscribe_all(socknum, rbuffer, protocol_ver, all_services, all_init_state);
+            service_init_state.clear();
+            for (auto state : all_init_state) {
+                service_init_state.push_back(std::make_pair(all_services[state.first].c_str(),
+                        state.second));
+            }
+        }
+
         if (use_environ) {
             // Request listening on environ events
             request_environ(socknum, rbuffer, protocol_ver);
@@ -282,6 +310,10 @@ int dinit_monitor_main(int argc, char **argv)
                 int pktlen = (unsigned char) rbuffer[1];
                 fill_buffer_to(rbuffer, socknum, pktlen);
 
+                // service name and event, if the packet reports a service event
+                const char *service_name = nullptr;
+                service_event_t event;
+
                 if (use_environ && rbuffer[0] == (char)cp_info::ENVEVENT) {
                     envvar_len_t envln;
                     rbuffer.extract((char *) &envln, 3, sizeof(envln));
@@ -293,13 +325,42 @@ int dinit_monitor_main(int argc, char **argv)
                         return 0;
                     }
                 }
-                else if (!use_environ && rbuffer[0] == (char)cp_info::SERVICEEVENT) {
+                else if (!use_environ && !watch_all && rbuffer[0] == (char)cp_info::SERVICEEVENT) {
                     handle_t ev_handle;
                     rbuffer.extract((char *) &ev_handle, 2, sizeof(ev_handle));
-                    service_event_t event = static_cast<service_event_t>(rbuffer[2 + sizeof(ev_handle)]);
+                    event = static_cast<service_event_t>(rbuffer[2 + sizeof(ev_handle)]);
+                    service_name = service_map.at(ev_handle);
+                }
+                else if (watch_all && rbuffer[0] == (char)cp_info::SERVICEDELTA) {
+                    // event code, sequence number, service id, state, target state[, name]
+                    constexpr int delta_hdr_size = 3 + sizeof(uint64_t) + sizeof(uint32_t) + 2;
+                    if (pktlen < delta_hdr_size) {
+                        throw dinit_protocol_error();
+                    }
 
-                    const char *service_name = service_map.at(ev_handle);
-                    const char *event_str;
+                    uint32_t id;
+                    rbuffer.extract((char *) &id, 3 + sizeof(uint64_t), sizeof(id));
+                    char event_code = rbuffer[2];
+
+                    if (event_code == (char)cp_delta_event::ADDED) {
+                        std::string name(pktlen - delta_hdr_size, '\0');
+                        rbuffer.extract(&name[0], delta_hdr_size, name.length());
+                        all_services[id] = std::move(name);
+                    }
+                    else if (event_code == (char)cp_delta_event::REMOVED) {
+                        all_services.erase(id);
+                    }
+                    else {
+                        auto it = all_services.find(id);
+                        if (it != all_services.end()) {
+                            event = static_cast<service_event_t>(event_code);
+                            service_name = it->second.c_str();
+                        }
+                    }
+                }
+
+                if (service_name != nullptr) {
+                    const char *event_str = nullptr;
 
                     if (event == service_event_t::STARTED) {
                         event_str = str_started;
@@ -310,17 +371,15 @@ int dinit_monitor_main(int argc, char **argv)
                     else if (event == service_event_t::FAILEDSTART) {
                         event_str = str_failed;
                     }
-                    else {
-                        goto consume_packet;
-                    }
-                    issue_command(service_name, nullptr, event_str, command_parts);
-                    if (exit_after) {
-                        return 0;
+
+                    if (event_str != nullptr) {
+                        issue_command(service_name, nullptr, event_str, command_parts);
+                        if (exit_after) {
+                            return 0;
+                        }
                     }
                 }
 
-                consume_packet:
-
                 rbuffer.consume(pktlen);
                 r = rbuffer.fill_to(socknum, 2);
             }
@@ -578,6 +637,62 @@ static void request_environ(int socknum, cpbuffer_t &rbuffer, uint16_t proto_ver
     rbuffer.consume(1);
 }
 
+// Subscribe to status changes of all services, and read the snapshot of services (by id) and their
+// states from the reply.
+static void subscribe_all(int socknum, cpbuffer_t &rbuffer, uint16_t proto_version,
+        std::unordered_map<uint32_t, std::string> &all_services,
+        std::vector<std::pair<uint32_t, service_state_t>> &init_states)
+{
+    if (proto_version < 8) {
+        throw cp_old_server_exception();
+    }
+
+    // packet type, sequence number to resume from (0 = none, send snapshot)
+    char buf[1 + sizeof(uint64_t)] = { (char)cp_cmd::SUBSCRIBE };
+    write_all_x(socknum, buf, sizeof(buf));
+
+    wait_for_reply(rbuffer, socknum);
+
+    cp_rply reply_pkt_h = (cp_rply)rbuffer[0];
+    if (reply_pkt_h != cp_rply::SUBSCRIBED) {
+        throw dinit_protocol_error();
+    }
+
+    // packet type, flags, sequence number, count
+    constexpr int hdr_size = 2 + sizeof(uint64_t) + sizeof(uint32_t);
+    fill_buffer_to(rbuffer, socknum, hdr_size);
+    uint32_t count;
+    rbuffer.extract((char *) &count, 2 + sizeof(uint64_t), sizeof(count));
+    rbuffer.consume(hdr_size);
+
+    // each entry: service id, state, target state, name length, name
+    constexpr int entry_hdr_size = sizeof(uint32_t) + 2 + sizeof(uint16_t);
+    for (uint32_t i = 0; i < count; ++i) {
+        fill_buffer_to(rbuffer, socknum, entry_hdr_size);
+        uint32_t id;
+        uint16_t name_len;
+        rbuffer.extract((char *) &id, 0, sizeof(id));
+        service_state_t state = static_cast<service_state_t>(rbuffer[sizeof(id)]);
+        rbuffer.extract((char *) &name_len, sizeof(id) + 2, sizeof(name_len));
+        rbuffer.consume(entry_hdr_size);
+
+        std::string name;
+        while (name_len > 0) {
+            if (rbuffer.get_length() == 0) {
+                fill_some(rbuffer, socknum);
+            }
+            unsigned chunk_len = std::min((unsigned)rbuffer.get_contiguous_length(rbuffer.get_ptr(0)),
+                    (unsigned)name_len);
+            name.append(rbuffer.get_ptr(0), chunk_len);
+            rbuffer.consume(chunk_len);
+            name_len -= chunk_len;
+        }
+
+        all_services[id] = std::move(name);
+        init_states.push_back(std::make_pair(id, state));
+    }
+}
+
 // get the whole environment block of the dinit instance in a way
 // that leaves individual variables available for read, without
 // the packet header; that allows read_var_and_issue to be used
@@ -5,6 +5,7 @@
 #include <csignal>
 #include <cstddef>
 #include <cstdlib>
+#include <limits>
 
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -29,6 +30,7 @@
 #include "service.h"
 #include "control.h"
 #include "dinit-log.h"
+#include "dinit-journal.h"
 #include "dinit-socket.h"
 #include "static-string.h"
 #include "dinit-utmp.h"
@@ -206,6 +208,11 @@ struct options {
     bool control_socket_path_set = false;
     bool env_file_set = false;
     bool log_specified = false;
+    bool preload_services = false;
+    bool auto_reload = false;
+    unsigned start_limit = 0;
+    const char *journal_path = nullptr;
+    size_t journal_size = journal_default_size;
 
     bool process_sys_args = false;
 
@@ -344,6 +351,21 @@ static int process_commandline_arg(char **argv, int argc, int &i, options &opts)
                 return 1;
             }
         }
+        else if (strcmp(argv[i], "--log-buffer-max") == 0) {
+            if (++i < argc) {
+                char *endp = nullptr;
+                auto max_size = strtoul(argv[i], &endp, 10);
+                if (endp == argv[i] || *endp || max_size > std::numeric_limits<uint32_t>::max()) {
+                    cerr << "dinit: '--log-buffer-max' requires a numerical argument\n";
+                    return 1;
+                }
+                set_log_buffer_max(max_size);
+            }
+            else {
+                cerr << "dinit: '--log-buffer-max' requires an argument\n";
+                return 1;
+            }
+        }
         else if (strcmp(argv[i], "--quiet") == 0 || strcmp(argv[i], "-q") == 0) {
             console_service_status = false;
             log_level[DLOG_CONS] = loglevel_t::ZERO;
@@ -370,6 +392,53 @@ static int process_commandline_arg(char **argv, int argc, int &i, options &opts)
             }
         }
         #endif
+        else if (strcmp(argv[i], "--preload") == 0) {
+            opts.preload_services = true;
+        }
+        else if (strcmp(argv[i], "--auto-reload") == 0) {
+            opts.auto_reload = true;
+        }
+        else if (strcmp(argv[i], "--start-limit") == 0) {
+            if (++i < argc) {
+                char *endp = nullptr;
+                auto limit = strtoul(argv[i], &endp, 10);
+                if (endp == argv[i] || *endp || limit > std::numeric_limits<unsigned>::max()) {
+                    cerr << "dinit: '--start-limit' requires a numerical argument\n";
+                    return 1;
+                }
+                opts.start_limit = (unsigned)limit;
+            }
+            else {
+                cerr << "dinit: '--start-limit' requires an argument\n";
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--journal") == 0) {
+            if (++i < argc && argv[i][0] != '\0') {
+                opts.journal_path = argv[i];
+            }
+            else {
+                cerr << "dinit: '--journal' requires an argument\n";
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--journal-size") == 0) {
+            if (++i < argc) {
+                char *endp = nullptr;
+                auto size = strtoul(argv[i], &endp, 10);
+                if (endp == argv[i] || *endp || size < journal_min_size
+                        || size > std::numeric_limits<uint32_t>::max()) {
+                    cerr << "dinit: '--journal-size' requires a numerical argument of at least "
+                            << journal_min_size << "\n";
+                    return 1;
+                }
+                opts.journal_size = size;
+            }
+            else {
+                cerr << "dinit: '--journal-size' requires an argument\n";
+                return 1;
+            }
+        }
         else if (strcmp(argv[i], "--service") == 0 || strcmp(argv[i], "-t") == 0) {
             if (++i < argc && argv[i][0] != '\0') {
                 services_to_start.push_back(argv[i]);
@@ -406,7 +475,13 @@ static int process_commandline_arg(char **argv, int argc, int &i, options &opts)
                     "                              cgroup base path (for resolving relative paths)\n"
                     #endif
                     " --log-file <file>, -l <file> log to the specified file\n"
+                    " --log-buffer-max <bytes>     maximum size of buffer for each log\n"
                     " --quiet, -q                  disable output to standard output\n"
+                    " --preload                    read ahead all service description files\n"
+                    " --auto-reload                reload services when their descriptions change\n"
+                    " --start-limit <n>            limit number of concurrently starting processes\n"
+                    " --journal <file>             record log and events in boot journal file\n"
+                    " --journal-size <bytes>       size of boot journal file\n"
                     " <service-name>, --service <service-name>, -t <service-name>\n"
                     "                              start service with name <service-name>\n";
             return -1;
@@ -595,6 +670,12 @@ int dinit_main(int argc, char **argv)
     }
 
     init_log(log_is_syslog);
+    if (opts.journal_path != nullptr) {
+        if (!open_journal(opts.journal_path, opts.journal_size)) {
+            log(loglevel_t::ERROR, "Could not open journal file ", opts.journal_path, ": ",
+                    strerror(errno));
+        }
+    }
     log_flush_timer.add_timer(event_loop, dasynq::clock_type::MONOTONIC);
 
     #if SUPPORT_CGROUPS
@@ -635,6 +716,7 @@ int dinit_main(int argc, char **argv)
     // Start requested services
 
     services = new dirload_service_set(std::move(service_dir_opts.get_paths()));
+    services->set_start_limit(opts.start_limit);
 
     setup_log_console_handoff(services);
 
@@ -665,6 +747,14 @@ int dinit_main(int argc, char **argv)
         }
     }
 
+    if (opts.preload_services) {
+        services->preload_service_descriptions();
+    }
+
+    if (opts.auto_reload) {
+        services->enable_auto_reload();
+    }
+
     for (auto svc : services_to_start) {
         try {
             services->start_service(svc);
@@ -695,9 +785,14 @@ int dinit_main(int argc, char **argv)
     
     run_event_loop:
     
-    // Process events until all services have terminated.
+    // Process events until all services have terminated. Events are dispatched in batches (all
+    // those that are ready when the event loop is polled), so that when many processes change
+    // state at once (eg. during a mass start or stop), the resulting state changes are processed
+    // together, rather than once per event.
     while (services->count_active_services() != 0) {
+        services->begin_batch();
         event_loop.run();
+        services->end_batch();
     }
 
     shutdown_type_t shutdown_type = services->get_shutdown_type();
@@ -729,6 +824,7 @@ int dinit_main(int argc, char **argv)
     }
 
     flush_log();
+    sync_journal();
     bool need_log_flush = false;
     close_control_socket();
     
@@ -10,10 +10,12 @@
 
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
 #include <sys/wait.h>
 #include <sys/socket.h>
 #include <sys/un.h>
 #include <unistd.h>
+#include <fcntl.h>
 #include <signal.h>
 #include <pwd.h>
 
@@ -23,6 +25,7 @@
 #include "dinit-client.h"
 #include "dinit-util.h"
 #include "dinit-iostream.h"
+#include "dinit-journal.h"
 #include "file-input-stack.h"
 #include "load-service.h"
 #include "options-processing.h"
@@ -42,17 +45,25 @@ using namespace dinit_cptypes;
 
 // minimum and maximum protocol verions we can speak
 static constexpr uint16_t min_cp_version = 1;
-static constexpr uint16_t max_cp_version = 7;
+static constexpr uint16_t max_cp_version = 8;
 
 enum class ctl_cmd;
 struct dinit_conn_t;
 
 static int start_stop_service(dinit_conn_t &, const char *service_name, ctl_cmd command,
         bool do_pin, bool do_force, bool wait_for_service, bool ignore_unstarted, bool verbose);
+static int start_stop_services(dinit_conn_t &, const std::vector<const char *> &service_names,
+        ctl_cmd command, bool do_pin, bool do_force, bool wait_for_service, bool ignore_unstarted,
+        bool verbose);
 static int unpin_service(dinit_conn_t &, const char *service_name, bool verbose);
 static int unload_service(dinit_conn_t &, const char *service_name, bool verbose);
 static int reload_service(dinit_conn_t &, const char *service_name, bool verbose);
-static int list_services(dinit_conn_t &, uint16_t proto_version);
+struct list_filter_t;
+static int list_services(dinit_conn_t &, uint16_t proto_version, const list_filter_t &filter);
+static int analyze_startup(dinit_conn_t &, const char *target_name);
+static int log_stats(dinit_conn_t &);
+static int mem_usage(dinit_conn_t &);
+static int auto_reload_stats(dinit_conn_t &);
 static int service_status(dinit_conn_t &, const char *service_name, ctl_cmd command,
         uint16_t proto_version, bool verbose);
 static int shutdown_dinit(dinit_conn_t &, bool verbose);
@@ -65,6 +76,7 @@ static int trigger_service(dinit_conn_t &, const char *service_name, bool trigge
 static int cat_service_log(dinit_conn_t &, const char *service_name, bool do_clear);
 static int signal_send(dinit_conn_t &, const char *service_name, sig_num_t sig_num);
 static int signal_list();
+static int show_journal(const char *journal_path, const char *service_filter, int min_level);
 
 // helpers:
 static int issue_load_service(int socknum, const char *service_name, bool find_only = false);
@@ -100,6 +112,30 @@ enum class ctl_cmd {
     SIG_LIST,
     IS_STARTED,
     IS_FAILED,
+    ANALYZE,
+    LOG_STATS,
+    MEM_USAGE,
+    AUTO_RELOAD_STATS,
+    JOURNAL,
+};
+
+// Filter for listing services (list command)
+struct list_filter_t
+{
+    bool match_state = false;
+    bool invert_state = false; // match services *not* in the specified state
+    service_state_t state = service_state_t::STOPPED;
+    bool match_target = false;
+    service_state_t target_state = service_state_t::STOPPED;
+    bool match_type = false;
+    service_type_t type = service_type_t::PROCESS;
+    bool only_failed = false;
+    const char *name_pattern = nullptr;
+
+    bool is_set() const
+    {
+        return match_state || match_target || match_type || only_failed || name_pattern != nullptr;
+    }
 };
 
 struct dinit_conn_t
@@ -144,6 +180,9 @@ int dinitctl_main(int argc, char **argv)
     bool show_siglist = false;
     std::string sigstr;
     sig_num_t sig_num = -1;
+    list_filter_t list_filter;
+    const char *journal_service = nullptr;
+    int journal_level = 0;
 
     for (int i = 1; i < argc; i++) {
         if (argv[i][0] == '-') {
@@ -216,6 +255,119 @@ int dinitctl_main(int argc, char **argv)
                     break;
                 }
             }
+            else if (strcmp(argv[i], "--state") == 0 || strcmp(argv[i], "--target") == 0
+                    || strcmp(argv[i], "--type") == 0) {
+                if (command != ctl_cmd::LIST_SERVICES) {
+                    cmdline_error = true;
+                    break;
+                }
+                const char *opt = argv[i];
+                if (++i == argc || argv[i][0] == '\0') {
+                    cerr << DINITCTL_APPNAME ": '" << opt << "' requires an argument\n";
+                    return 1;
+                }
+                const char *val = argv[i];
+                bool valid = true;
+                if (opt[2] == 's') {
+                    // --state [!]{started|starting|stopped|stopping}
+                    list_filter.match_state = true;
+                    list_filter.invert_state = (val[0] == '!');
+                    if (list_filter.invert_state) ++val;
+                    if (strcmp(val, "started") == 0) {
+                        list_filter.state = service_state_t::STARTED;
+                    }
+                    else if (strcmp(val, "starting") == 0) {
+                        list_filter.state = service_state_t::STARTING;
+                    }
+                    else if (strcmp(val, "stopped") == 0) {
+                        list_filter.state = service_state_t::STOPPED;
+                    }
+                    else if (strcmp(val, "stopping") == 0) {
+                        list_filter.state = service_state_t::STOPPING;
+                    }
+                    else {
+                        valid = false;
+                    }
+                }
+                else if (strcmp(opt, "--target") == 0) {
+                    // --target {started|stopped}
+                    list_filter.match_target = true;
+                    if (strcmp(val, "started") == 0) {
+                        list_filter.target_state = service_state_t::STARTED;
+                    }
+                    else if (strcmp(val, "stopped") == 0) {
+                        list_filter.target_state = service_state_t::STOPPED;
+                    }
+                    else {
+                        valid = false;
+                    }
+                }
+                else {
+                    // --type <service type>
+                    list_filter.match_type = true;
+                    if (strcmp(val, "process") == 0) {
+                        list_filter.type = service_type_t::PROCESS;
+                    }
+                    else if (strcmp(val, "bgprocess") == 0) {
+                        list_filter.type = service_type_t::BGPROCESS;
+                    }
+                    else if (strcmp(val, "scripted") == 0) {
+                        list_filter.type = service_type_t::SCRIPTED;
+                    }
+                    else if (strcmp(val, "internal") == 0) {
+                        list_filter.type = service_type_t::INTERNAL;
+                    }
+                    else if (strcmp(val, "triggered") == 0) {
+                        list_filter.type = service_type_t::TRIGGERED;
+                    }
+                    else {
+                        valid = false;
+                    }
+                }
+                if (!valid) {
+                    cerr << DINITCTL_APPNAME ": invalid argument for '" << opt << "': " << argv[i]
+                            << "\n";
+                    return 1;
+                }
+            }
+            else if (strcmp(argv[i], "--failed") == 0) {
+                if (command == ctl_cmd::LIST_SERVICES) {
+                    list_filter.only_failed = true;
+                }
+                else {
+                    cmdline_error = true;
+                    break;
+                }
+            }
+            else if (strcmp(argv[i], "--service") == 0 || strcmp(argv[i], "--level") == 0) {
+                if (command != ctl_cmd::JOURNAL) {
+                    cmdline_error = true;
+                    break;
+                }
+                const char *opt = argv[i];
+                if (++i == argc || argv[i][0] == '\0') {
+                    cerr << DINITCTL_APPNAME ": '" << opt << "' requires an argument\n";
+                    return 1;
+                }
+                if (opt[2] == 's') {
+                    journal_service = argv[i];
+                }
+                else {
+                    // --level {debug|info|warn|error}
+                    const char *level_names[] = { "debug", "info", "warn", "error" };
+                    journal_level = -1;
+                    for (int lvl = 0; lvl < 4; ++lvl) {
+                        if (strcmp(argv[i], level_names[lvl]) == 0) {
+                            journal_level = lvl;
+                        }
+                    }
+                    if (journal_level == -1) {
+                        cerr << DINITCTL_APPNAME ": invalid argument for '" << opt << "': "
+                                << argv[i] << "\n";
+                        return 1;
+                    }
+                }
+            }
             else if (strcmp(argv[i], "--list") == 0 || strcmp(argv[i], "-l") == 0) {
                 if (command == ctl_cmd::SIG_SEND) {
                     show_siglist = true;
@@ -312,6 +464,21 @@ int dinitctl_main(int argc, char **argv)
             else if (strcmp(argv[i], "signal") == 0) {
                 command = ctl_cmd::SIG_SEND;
             }
+            else if (strcmp(argv[i], "analyze") == 0) {
+                command = ctl_cmd::ANALYZE;
+            }
+            else if (strcmp(argv[i], "log-stats") == 0) {
+                command = ctl_cmd::LOG_STATS;
+            }
+            else if (strcmp(argv[i], "mem-usage") == 0) {
+                command = ctl_cmd::MEM_USAGE;
+            }
+            else if (strcmp(argv[i], "auto-reload-stats") == 0) {
+                command = ctl_cmd::AUTO_RELOAD_STATS;
+            }
+            else if (strcmp(argv[i], "journal") == 0) {
+                command = ctl_cmd::JOURNAL;
+            }
             else {
                 cerr << DINITCTL_APPNAME ": unrecognized command: " << argv[i] << " (use --help for help)\n";
                 return 1;
@@ -431,10 +598,41 @@ int dinitctl_main(int argc, char **argv)
             }
         }
     }
+    else if (command == ctl_cmd::LIST_SERVICES) {
+        // optional service name pattern:
+        if (cmd_args.size() > 1) {
+            cmdline_error = true;
+        }
+        else if (!cmd_args.empty()) {
+            list_filter.name_pattern = cmd_args.front();
+            // The request packet (13 byte header + pattern) must fit in dinit's receive buffer:
+            if (strlen(list_filter.name_pattern) > cpbuffer_t::get_size() - 13) {
+                cerr << DINITCTL_APPNAME ": service name pattern too long\n";
+                return 1;
+            }
+        }
+    }
+    else if (command == ctl_cmd::JOURNAL) {
+        // journal file path:
+        if (cmd_args.size() != 1) {
+            cmdline_error = true;
+        }
+    }
+    else if (command == ctl_cmd::ANALYZE) {
+        // optional target service name:
+        if (cmd_args.size() > 1) {
+            cmdline_error = true;
+        }
+        else if (!cmd_args.empty()) {
+            service_name = cmd_args.front();
+        }
+    }
     else {
-        bool no_service_cmd = (command == ctl_cmd::LIST_SERVICES
-                              || command == ctl_cmd::SHUTDOWN
-                              || command == ctl_cmd::SIG_LIST);
+        bool no_service_cmd = (command == ctl_cmd::SHUTDOWN
+                              || command == ctl_cmd::SIG_LIST
+                              || command == ctl_cmd::LOG_STATS
+                              || command == ctl_cmd::MEM_USAGE
+                              || command == ctl_cmd::AUTO_RELOAD_STATS);
         if (no_service_cmd) {
             if (!cmd_args.empty()) {
                 cmdline_error = true;
@@ -450,8 +648,9 @@ int dinitctl_main(int argc, char **argv)
                 cmdline_error = true;
             }
             else {
-                // No command can currently accept more than one service argument:
-                if (cmd_args.size() > 1) {
+                // Only start/stop/wake/release can accept more than one service argument:
+                if (cmd_args.size() > 1 && !value(command).is_in(ctl_cmd::START_SERVICE,
+                        ctl_cmd::STOP_SERVICE, ctl_cmd::WAKE_SERVICE, ctl_cmd::RELEASE_SERVICE)) {
                     cmdline_error = true;
                 }
                 service_name = cmd_args.front();
@@ -466,15 +665,15 @@ int dinitctl_main(int argc, char **argv)
           "    " DINITCTL_APPNAME " [options] status <service-name>\n"
           "    " DINITCTL_APPNAME " [options] is-started <service-name>\n"
           "    " DINITCTL_APPNAME " [options] is-failed <service-name>\n"
-          "    " DINITCTL_APPNAME " [options] start [options] <service-name>\n"
-          "    " DINITCTL_APPNAME " [options] stop [options] <service-name>\n"
+          "    " DINITCTL_APPNAME " [options] start [options] <service-name>...\n"
+          "    " DINITCTL_APPNAME " [options] stop [options] <service-name>...\n"
           "    " DINITCTL_APPNAME " [options] restart [options] <service-name>\n"
-          "    " DINITCTL_APPNAME " [options] wake [options] <service-name>\n"
-          "    " DINITCTL_APPNAME " [options] release [options] <service-name>\n"
+          "    " DINITCTL_APPNAME " [options] wake [options] <service-name>...\n"
+          "    " DINITCTL_APPNAME " [options] release [options] <service-name>...\n"
           "    " DINITCTL_APPNAME " [options] unpin <service-name>\n"
           "    " DINITCTL_APPNAME " [options] unload <service-name>\n"
           "    " DINITCTL_APPNAME " [options] reload <service-name>\n"
-          "    " DINITCTL_APPNAME " [options] list\n"
+          "    " DINITCTL_APPNAME " [options] list [list-options] [<name-pattern>]\n"
           "    " DINITCTL_APPNAME " [options] shutdown\n"
           "    " DINITCTL_APPNAME " [options] add-dep <type> <from-service> <to-service>\n"
           "    " DINITCTL_APPNAME " [options] rm-dep <type> <from-service> <to-service>\n"
@@ -486,6 +685,11 @@ int dinitctl_main(int argc, char **argv)
           "    " DINITCTL_APPNAME " [options] unsetenv [name ...]\n"
           "    " DINITCTL_APPNAME " [options] catlog <service-name>\n"
           "    " DINITCTL_APPNAME " [options] signal <signal> <service-name>\n"
+          "    " DINITCTL_APPNAME " [options] analyze [<service-name>]\n"
+          "    " DINITCTL_APPNAME " [options] log-stats\n"
+          "    " DINITCTL_APPNAME " [options] mem-usage\n"
+          "    " DINITCTL_APPNAME " [options] auto-reload-stats\n"
+          "    " DINITCTL_APPNAME " [options] journal [journal-options] <journal-file>\n"
           "\n"
           "Note: An activated service continues running when its dependents stop.\n"
           "\n"
@@ -506,7 +710,19 @@ int dinitctl_main(int argc, char **argv)
           "  --no-wait        : don't wait for service startup/shutdown to complete\n"
           "  --pin            : pin the service in the requested state\n"
           "  --force          : force stop even if dependents will be affected\n"
-          "  -l, --list       : (signal) list supported signals\n";
+          "  -l, --list       : (signal) list supported signals\n"
+          "\n"
+          "List options:\n"
+          "  --state [!]<state>  : only list services (not) in the given state (started,\n"
+          "                        starting, stopped, stopping)\n"
+          "  --target <state>    : only list services with the given target state\n"
+          "  --type <type>       : only list services of the given type\n"
+          "  --failed            : only list services which have failed\n"
+          "\n"
+          "Journal options:\n"
+          "  --service <name>    : only show events for the given service\n"
+          "  --level <level>     : only show records at or above the given log level (debug,\n"
+          "                        info, warn, error)\n";
         return 0;
     }
 
@@ -521,6 +737,11 @@ int dinitctl_main(int argc, char **argv)
         return signal_list();
     }
 
+    // JOURNAL reads the journal file directly, without a connection.
+    if (command == ctl_cmd::JOURNAL) {
+        return show_journal(cmd_args.front(), journal_service, journal_level);
+    }
+
     dinit_conn_t dinit_conn;
 
     if (offline) {
@@ -595,7 +816,7 @@ int dinitctl_main(int argc, char **argv)
             return reload_service(dinit_conn, service_name, verbose);
         }
         else if (command == ctl_cmd::LIST_SERVICES) {
-            return list_services(dinit_conn, daemon_protocol_ver);
+            return list_services(dinit_conn, daemon_protocol_ver, list_filter);
         }
         else if (command == ctl_cmd::SERVICE_STATUS || command == ctl_cmd::IS_STARTED
                 || command == ctl_cmd::IS_FAILED) {
@@ -638,6 +859,34 @@ int dinitctl_main(int argc, char **argv)
             }
             return signal_send(dinit_conn, service_name, sig_num);
         }
+        else if (command == ctl_cmd::ANALYZE) {
+            if (daemon_protocol_ver < 8) {
+                throw cp_old_server_exception();
+            }
+            return analyze_startup(dinit_conn, service_name);
+        }
+        else if (command == ctl_cmd::LOG_STATS) {
+            if (daemon_protocol_ver < 8) {
+                throw cp_old_server_exception();
+            }
+            return log_stats(dinit_conn);
+        }
+        else if (command == ctl_cmd::MEM_USAGE) {
+            if (daemon_protocol_ver < 8) {
+                throw cp_old_server_exception();
+            }
+            return mem_usage(dinit_conn);
+        }
+        else if (command == ctl_cmd::AUTO_RELOAD_STATS) {
+            if (daemon_protocol_ver < 8) {
+                throw cp_old_server_exception();
+            }
+            return auto_reload_stats(dinit_conn);
+        }
+        else if (cmd_args.size() > 1) {
+            return start_stop_services(dinit_conn, cmd_args, command, do_pin, do_force,
+                    wait_for_service, ignore_unstarted, verbose);
+        }
         else {
             return start_stop_service(dinit_conn, service_name, command, do_pin, do_force,
                     wait_for_service, ignore_unstarted, verbose);
@@ -1220,6 +1469,304 @@ static int start_stop_service(dinit_conn_t &dinit_conn, const char *service_name
     return wait_service_state(dinit_conn, handle, service_name, do_stop, verbose);
 }
 
+// Report failure to load a service, as per a LOADSERVICES result code.
+static void report_load_failure(const char *service_name, cp_rply result_code)
+{
+    using std::cerr;
+
+    if (result_code == cp_rply::NOSERVICE) {
+        cerr << DINITCTL_APPNAME ": failed to find service description for '" << service_name
+                << "'.\n";
+        cerr << DINITCTL_APPNAME ": check service description file exists / service name spelling.\n";
+    }
+    else if (result_code == cp_rply::SERVICE_DESC_ERR) {
+        cerr << DINITCTL_APPNAME ": error in service description for '" << service_name << "'.\n";
+        cerr << DINITCTL_APPNAME ": try '" DINIT_CHECK_APPNAME " " << service_name << "' or check"
+                " log for more information.\n";
+    }
+    else if (result_code == cp_rply::SERVICE_LOAD_ERR) {
+        cerr << DINITCTL_APPNAME ": error loading service '" << service_name
+                << "' (or dependency of service).\n";
+        cerr << DINITCTL_APPNAME ": try '" DINIT_CHECK_APPNAME " " << service_name << "' or check"
+                " log for more information.\n";
+    }
+    else {
+        throw dinit_protocol_error();
+    }
+}
+
+// Start/stop/wake/release multiple services. With a daemon that supports it (protocol version 8+)
+// the services are loaded with LOADSERVICES and then commanded with a single STARTSTOPSERVICES
+// request, so that the daemon processes the whole set in one pass; otherwise each service is
+// handled in turn as per start_stop_service. Returns 0 if the command succeeded for all services.
+static int start_stop_services(dinit_conn_t &dinit_conn, const std::vector<const char *> &service_names,
+        ctl_cmd command, bool do_pin, bool do_force, bool wait_for_service, bool ignore_unstarted,
+        bool verbose)
+{
+    using std::cout;
+    using std::cerr;
+
+    if (dinit_conn.protocol_version < 8) {
+        int r = 0;
+        for (const char *service_name : service_names) {
+            if (start_stop_service(dinit_conn, service_name, command, do_pin, do_force,
+                    wait_for_service, ignore_unstarted, verbose) != 0) {
+                r = 1;
+            }
+        }
+        return r;
+    }
+
+    // Requests must fit within the daemon's receive buffer:
+    constexpr unsigned max_request_size = cpbuffer_t::get_size();
+
+    int socknum = dinit_conn.fd;
+    cpbuffer_t &rbuffer = *dinit_conn.buffer;
+
+    bool do_stop = (command == ctl_cmd::STOP_SERVICE || command == ctl_cmd::RELEASE_SERVICE);
+    if (!do_stop) {
+        ignore_unstarted = false;
+    }
+
+    service_state_t wanted_state = do_stop ? service_state_t::STOPPED : service_state_t::STARTED;
+    cp_cmd pcommand;
+    switch (command) {
+        case ctl_cmd::STOP_SERVICE:
+            pcommand = cp_cmd::STOPSERVICE;
+            break;
+        case ctl_cmd::RELEASE_SERVICE:
+            pcommand = cp_cmd::RELEASESERVICE;
+            break;
+        case ctl_cmd::WAKE_SERVICE:
+            pcommand = cp_cmd::WAKESERVICE;
+            break;
+        default:
+            pcommand = cp_cmd::STARTSERVICE;
+    }
+
+    struct batch_service
+    {
+        const char *name;
+        handle_t handle;
+        service_state_t state;
+        observed_states_t seen_states;
+        bool pending = false; // command issued, waiting for completion
+    };
+
+    std::vector<batch_service> services;
+    services.reserve(service_names.size());
+    int result = 0;
+
+    // Load the services, as many per request as will fit:
+    size_t next = 0;
+    while (next < service_names.size()) {
+        std::vector<char> buf = { (char)cp_cmd::LOADSERVICES, 0 /* flags */, 0, 0 };
+        size_t first = next;
+        while (next < service_names.size()) {
+            size_t name_len = strlen(service_names[next]);
+            if (name_len > max_request_size - buf.size() - sizeof(srvname_len_t)) {
+                if (next == first) {
+                    cerr << DINITCTL_APPNAME ": service name too long.\n";
+                    return 1;
+                }
+                break;
+            }
+            srvname_len_t srvname_len = name_len;
+            const char *srvname_len_cptr = reinterpret_cast<const char *>(&srvname_len);
+            buf.insert(buf.end(), srvname_len_cptr, srvname_len_cptr + sizeof(srvname_len));
+            buf.insert(buf.end(), service_names[next], service_names[next] + name_len);
+            ++next;
+        }
+        uint16_t count = next - first;
+        memcpy(buf.data() + 2, &count, sizeof(count));
+        write_all_x(socknum, buf);
+
+        // Reply: SERVICERECORDS, (2 bytes) N, N * (result code, state, handle, target state)
+        constexpr unsigned entry_size = 3 + sizeof(handle_t);
+        wait_for_reply(rbuffer, socknum);
+        if (rbuffer[0] != (char)cp_rply::SERVICERECORDS) {
+            throw dinit_protocol_error();
+        }
+        fill_buffer_to(rbuffer, socknum, 3);
+        uint16_t reply_count;
+        rbuffer.extract(&reply_count, 1, sizeof(reply_count));
+        rbuffer.consume(3);
+        if (reply_count != count) {
+            throw dinit_protocol_error();
+        }
+
+        for (size_t i = first; i < next; ++i) {
+            fill_buffer_to(rbuffer, socknum, entry_size);
+            cp_rply result_code = (cp_rply)rbuffer[0];
+            if (result_code == cp_rply::SERVICERECORD) {
+                batch_service service;
+                service.name = service_names[i];
+                service.state = static_cast<service_state_t>(rbuffer[1]);
+                rbuffer.extract(&service.handle, 2, sizeof(service.handle));
+                // (ignore repeated services)
+                if (std::none_of(services.begin(), services.end(),
+                        [&](const batch_service &s) { return s.handle == service.handle; })) {
+                    services.push_back(service);
+                }
+            }
+            else if (!ignore_unstarted || result_code != cp_rply::NOSERVICE) {
+                report_load_failure(service_names[i], result_code);
+                result = 1;
+            }
+            rbuffer.consume(entry_size);
+        }
+    }
+
+    auto find_states = [&](handle_t handle) -> observed_states_t * {
+        for (batch_service &service : services) {
+            if (service.handle == handle) return &service.seen_states;
+        }
+        return nullptr;
+    };
+
+    // Issue the command, as many services per request as will fit:
+    constexpr unsigned ss_hdr_size = 5;
+    constexpr unsigned max_handles = (max_request_size - ss_hdr_size) / sizeof(handle_t);
+    char flags = (do_pin ? 1 : 0) | ((pcommand == cp_cmd::STOPSERVICE && !do_force) ? 2 : 0);
+
+    next = 0;
+    while (next < services.size()) {
+        uint16_t count = std::min(services.size() - next, (size_t)max_handles);
+        std::vector<char> buf = { (char)cp_cmd::STARTSTOPSERVICES, (char)pcommand, flags, 0, 0 };
+        memcpy(buf.data() + 3, &count, sizeof(count));
+        for (size_t i = next; i < next + count; ++i) {
+            const char *handle_cptr = reinterpret_cast<const char *>(&services[i].handle);
+            buf.insert(buf.end(), handle_cptr, handle_cptr + sizeof(handle_t));
+        }
+        write_all_x(socknum, buf);
+
+        // Reply: SSRESULTS, (2 bytes) N, N * result code
+        wait_for_reply_states(rbuffer, socknum, find_states);
+        if (rbuffer[0] != (char)cp_rply::SSRESULTS) {
+            throw dinit_protocol_error();
+        }
+        fill_buffer_to(rbuffer, socknum, 3);
+        uint16_t reply_count;
+        rbuffer.extract(&reply_count, 1, sizeof(reply_count));
+        rbuffer.consume(3);
+        if (reply_count != count) {
+            throw dinit_protocol_error();
+        }
+        fill_buffer_to(rbuffer, socknum, count);
+
+        for (unsigned i = 0; i < count; ++i) {
+            batch_service &service = services[next + i];
+            cp_rply reply_code = (cp_rply)rbuffer[i];
+            if (reply_code == cp_rply::ACK) {
+                service.pending = true;
+            }
+            else if (reply_code == cp_rply::ALREADYSS) {
+                if (verbose) {
+                    cout << "Service '" << service.name << "' "
+                            << (service.state == wanted_state ? "(already) " : "")
+                            << describe_state(do_stop) << ".\n";
+                }
+            }
+            else {
+                if (reply_code == cp_rply::PINNEDSTARTED) {
+                    cerr << DINITCTL_APPNAME ": cannot stop service '" << service.name
+                            << "' as it is pinned started\n";
+                }
+                else if (reply_code == cp_rply::PINNEDSTOPPED) {
+                    cerr << DINITCTL_APPNAME ": cannot start service '" << service.name
+                            << "' as it is pinned stopped\n";
+                }
+                else if (reply_code == cp_rply::DEPENDENTS && pcommand == cp_cmd::STOPSERVICE) {
+                    cerr << DINITCTL_APPNAME ": cannot stop service '" << service.name
+                            << "' as it has active dependents (use '--force' to stop them also)\n";
+                }
+                else if (reply_code == cp_rply::NAK && pcommand == cp_cmd::WAKESERVICE) {
+                    cerr << DINITCTL_APPNAME ": service '" << service.name
+                            << "' has no active dependents, cannot wake.\n";
+                }
+                else if (reply_code == cp_rply::SHUTTINGDOWN) {
+                    cerr << DINITCTL_APPNAME ": cannot start/wake service '" << service.name
+                            << "', shutdown is in progress.\n";
+                }
+                else {
+                    throw dinit_protocol_error();
+                }
+                result = 1;
+            }
+        }
+        rbuffer.consume(count);
+        next += count;
+    }
+
+    if (!wait_for_service) {
+        if (verbose) {
+            for (batch_service &service : services) {
+                if (service.pending) {
+                    cout << "Issued " << describe_verb(do_stop) << " command successfully for"
+                            " service '" << service.name << "'.\n";
+                }
+            }
+        }
+        return result;
+    }
+
+    // Account for any completion events that arrived before the reply(s):
+    unsigned num_pending = 0;
+    for (batch_service &service : services) {
+        if (!service.pending) continue;
+        if (do_stop ? service.seen_states.stopped : service.seen_states.started) {
+            if (verbose) {
+                cout << "Service '" << service.name << "' " << describe_state(do_stop) << ".\n";
+            }
+            service.pending = false;
+        }
+        else if (!do_stop && service.seen_states.failed_start) {
+            if (verbose) {
+                cout << "Service '" << service.name << "' failed to start.\n";
+                observed_states_t &seen = service.seen_states;
+                print_failure_details(seen.stop_reason, 0 /* not applicable */, seen.exit_status,
+                        seen.exit_si_code, seen.exit_si_status);
+            }
+            service.pending = false;
+            result = 1;
+        }
+        else {
+            ++num_pending;
+        }
+    }
+
+    // Wait for the remaining services to reach the wanted state:
+    while (num_pending > 0) {
+        wait_for_info(rbuffer, socknum);
+        unsigned pktlen = (unsigned char) rbuffer[1];
+        if (!value((cp_info)rbuffer[0]).is_in(cp_info::SERVICEEVENT, cp_info::SERVICEEVENT5)
+                || pktlen < 2 + sizeof(handle_t)) {
+            rbuffer.consume(pktlen);
+            continue;
+        }
+
+        handle_t ev_handle;
+        rbuffer.extract(&ev_handle, 2, sizeof(ev_handle));
+        auto it = std::find_if(services.begin(), services.end(),
+                [=](const batch_service &service) { return service.handle == ev_handle; });
+        if (it == services.end() || !it->pending) {
+            rbuffer.consume(pktlen);
+            continue;
+        }
+
+        int ret = process_service_event(rbuffer, pktlen, ev_handle, it->name, do_stop, verbose);
+        if (ret >= 0) {
+            it->pending = false;
+            --num_pending;
+            if (ret != 0) {
+                result = 1;
+            }
+        }
+    }
+
+    return result;
+}
+
 // Issue a "load service" command (LOADSERVICE), without waiting for
 // a response. Returns 1 on failure (with error logged), 0 on success.
 static int issue_load_service(int socknum, const char *service_name, bool find_only)
@@ -1447,7 +1994,37 @@ static int reload_service(dinit_conn_t &dinit_conn, const char *service_name, bo
     return 0;
 }
 
-static int list_services(dinit_conn_t &dinit_conn, uint16_t proto_version)
+// Issue a LISTSERVICES8 request, to list services matching the filter following the given cursor
+// (as returned in a LISTMORE reply, or 0 to list from the beginning).
+static void issue_list_services8(int socknum, const list_filter_t &filter, uint32_t cursor)
+{
+    // Number of services to request at a time:
+    constexpr uint16_t list_limit = 128;
+
+    char flags = (filter.match_state ? 1 : 0) | (filter.match_target ? 2 : 0)
+            | (filter.match_type ? 4 : 0) | (filter.only_failed ? 8 : 0)
+            | (filter.invert_state ? 16 : 0);
+
+    // (pattern length is checked when processing command line)
+    uint16_t pattern_len = (filter.name_pattern == nullptr) ? 0 : strlen(filter.name_pattern);
+
+    auto m = membuf()
+            .append((char)cp_cmd::LISTSERVICES8)
+            .append(flags)
+            .append((char)filter.state)
+            .append((char)filter.target_state)
+            .append((char)filter.type)
+            .append(cursor)
+            .append(list_limit)
+            .append(pattern_len);
+    write_all_x(socknum, m);
+    if (pattern_len != 0) {
+        write_all_x(socknum, filter.name_pattern, pattern_len);
+    }
+}
+
+static int list_services(dinit_conn_t &dinit_conn, uint16_t proto_version,
+        const list_filter_t &filter)
 {
     using std::cout;
     using std::cerr;
@@ -1455,16 +2032,37 @@ static int list_services(dinit_conn_t &dinit_conn, uint16_t proto_version)
     int socknum = dinit_conn.fd;
     cpbuffer_t &rbuffer = *dinit_conn.buffer;
 
-    char cmdbuf[] = { (char)cp_cmd::LISTSERVICES };
-    if (proto_version >= 5) {
-        cmdbuf[0] = (char)cp_cmd::LISTSERVICES5;
+    if (proto_version >= 8) {
+        // List services in batches, filtered by dinit
+        issue_list_services8(socknum, filter, 0);
+    }
+    else {
+        if (filter.is_set()) {
+            throw cp_old_server_exception();
+        }
+
+        char cmdbuf[] = { (char)cp_cmd::LISTSERVICES };
+        if (proto_version >= 5) {
+            cmdbuf[0] = (char)cp_cmd::LISTSERVICES5;
+        }
+        write_all_x(socknum, cmdbuf, 1);
     }
-    write_all_x(socknum, cmdbuf, 1);
 
     unsigned status_buffer_size = proto_version < 5 ? STATUS_BUFFER_SIZE : STATUS_BUFFER5_SIZE;
 
     wait_for_reply(rbuffer, socknum);
-    while (rbuffer[0] == (char)cp_rply::SVCINFO) {
+    while (rbuffer[0] == (char)cp_rply::SVCINFO || rbuffer[0] == (char)cp_rply::LISTMORE) {
+        if (rbuffer[0] == (char)cp_rply::LISTMORE) {
+            // Request the next batch:
+            uint32_t cursor;
+            fill_buffer_to(rbuffer, socknum, 1 + sizeof(cursor));
+            rbuffer.extract(&cursor, 1, sizeof(cursor));
+            rbuffer.consume(1 + sizeof(cursor));
+            issue_list_services8(socknum, filter, cursor);
+            wait_for_reply(rbuffer, socknum);
+            continue;
+        }
+
         // Packet: SVCINFO (1), name length (1), status buffer (STATUS_BUFFER_SIZE), name (N)
         int hdrsize = 2 + status_buffer_size;
         fill_buffer_to(rbuffer, socknum, hdrsize);
@@ -1604,6 +2202,391 @@ static int list_services(dinit_conn_t &dinit_conn, uint16_t proto_version)
     return 0;
 }
 
+// Format a duration (in nanoseconds) as seconds, with millisecond precision
+static std::string format_duration(uint64_t ns)
+{
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%llu.%03us", (unsigned long long)(ns / 1000000000u),
+            (unsigned)(ns % 1000000000u / 1000000u));
+    return buf;
+}
+
+// Analyse startup: retrieve the start stage times of all services, and report the critical path
+// (the chain of dependencies which determined when the target service started) and the services
+// which took the longest to start.
+//   target_name - the service to find the critical path for (nullptr: the service which started
+//                 last)
+static int analyze_startup(dinit_conn_t &dinit_conn, const char *target_name)
+{
+    using std::cout;
+    using std::cerr;
+
+    int socknum = dinit_conn.fd;
+    cpbuffer_t &rbuffer = *dinit_conn.buffer;
+
+    char cmdbuf[] = { (char)cp_cmd::QUERYSTARTTIMES };
+    write_all_x(socknum, cmdbuf, 1);
+
+    wait_for_reply(rbuffer, socknum);
+    if (rbuffer[0] != (char)cp_rply::STARTTIMES) {
+        cerr << DINITCTL_APPNAME ": control socket protocol error\n";
+        return 1;
+    }
+
+    // STARTTIMES (1), current time (8), service count (4)
+    uint64_t now;
+    uint32_t count;
+    fill_buffer_to(rbuffer, socknum, 1 + sizeof(now) + sizeof(count));
+    rbuffer.extract(&now, 1, sizeof(now));
+    rbuffer.extract(&count, 1 + sizeof(now), sizeof(count));
+    rbuffer.consume(1 + sizeof(now) + sizeof(count));
+
+    struct svc_times
+    {
+        std::string name;
+        uint64_t times[NUM_START_STAGES];
+        std::vector<std::pair<uint32_t, dependency_type>> deps;
+
+        uint64_t time(start_stage_t stage) const
+        {
+            return times[static_cast<int>(stage)];
+        }
+
+        bool started() const
+        {
+            return time(start_stage_t::REQUESTED) != 0 && time(start_stage_t::STARTED) != 0;
+        }
+
+        // Time taken to start once dependencies were satisfied
+        uint64_t own_time() const
+        {
+            uint64_t from = time(start_stage_t::DEPS_STARTED);
+            if (from == 0) from = time(start_stage_t::REQUESTED);
+            return time(start_stage_t::STARTED) - from;
+        }
+    };
+
+    std::vector<svc_times> services(count);
+    for (auto &svc : services) {
+        fill_buffer_to(rbuffer, socknum, sizeof(svc.times) + sizeof(uint16_t));
+        rbuffer.extract(svc.times, 0, sizeof(svc.times));
+        uint16_t num_deps;
+        rbuffer.extract(&num_deps, sizeof(svc.times), sizeof(num_deps));
+        rbuffer.consume(sizeof(svc.times) + sizeof(num_deps));
+
+        for (uint16_t i = 0; i < num_deps; ++i) {
+            uint32_t dep_index;
+            fill_buffer_to(rbuffer, socknum, sizeof(dep_index) + 1);
+            rbuffer.extract(&dep_index, 0, sizeof(dep_index));
+            dependency_type dep_type = static_cast<dependency_type>(rbuffer[sizeof(dep_index)]);
+            rbuffer.consume(sizeof(dep_index) + 1);
+            if (dep_index >= count) {
+                throw dinit_protocol_error();
+            }
+            svc.deps.emplace_back(dep_index, dep_type);
+        }
+
+        uint16_t name_len;
+        fill_buffer_to(rbuffer, socknum, sizeof(name_len));
+        rbuffer.extract(&name_len, 0, sizeof(name_len));
+        rbuffer.consume(sizeof(name_len));
+        while (name_len > 0) {
+            fill_buffer_to(rbuffer, socknum, 1);
+            unsigned chunk_len = std::min(rbuffer.get_contiguous_length(rbuffer.get_ptr(0)),
+                    (unsigned)name_len);
+            svc.name.append(rbuffer.get_ptr(0), chunk_len);
+            rbuffer.consume(chunk_len);
+            name_len -= chunk_len;
+        }
+    }
+
+    // Find the earliest start request and the target (by default, the service which started last)
+    uint64_t first_request = 0;
+    const svc_times *target = nullptr;
+    for (auto &svc : services) {
+        if (!svc.started()) continue;
+        uint64_t requested = svc.time(start_stage_t::REQUESTED);
+        if (first_request == 0 || requested < first_request) {
+            first_request = requested;
+        }
+        if (target_name != nullptr) {
+            if (svc.name == target_name) target = &svc;
+        }
+        else if (target == nullptr
+                || svc.time(start_stage_t::STARTED) > target->time(start_stage_t::STARTED)) {
+            target = &svc;
+        }
+    }
+
+    if (target == nullptr) {
+        if (target_name != nullptr) {
+            cerr << DINITCTL_APPNAME ": service '" << target_name
+                    << "' is not loaded or has not started\n";
+        }
+        else {
+            cerr << DINITCTL_APPNAME ": no service has started\n";
+        }
+        return 1;
+    }
+
+    // Walk back from the target: at each step, the dependency which was the last to start before
+    // the dependent's dependencies were satisfied is the one that held it up.
+    std::vector<const svc_times *> path;
+    for (const svc_times *svc = target; svc != nullptr; ) {
+        path.push_back(svc);
+        uint64_t deps_time = svc->time(start_stage_t::DEPS_STARTED);
+        const svc_times *blocker = nullptr;
+        for (auto &dep : svc->deps) {
+            if (dep.second == dependency_type::SOFT) continue;
+            const svc_times *dep_svc = &services[dep.first];
+            if (!dep_svc->started() || dep_svc->time(start_stage_t::STARTED) > deps_time) continue;
+            if (std::find(path.begin(), path.end(), dep_svc) != path.end()) continue;
+            if (blocker == nullptr || dep_svc->time(start_stage_t::STARTED)
+                    > blocker->time(start_stage_t::STARTED)) {
+                blocker = dep_svc;
+            }
+        }
+        svc = blocker;
+    }
+
+    cout << "Critical path to '" << target->name << "' (started after "
+            << format_duration(target->time(start_stage_t::STARTED) - first_request) << "):\n";
+    cout << "    started at   start time   service\n";
+    for (auto i = path.rbegin(); i != path.rend(); ++i) {
+        std::string at = "+" + format_duration((*i)->time(start_stage_t::STARTED) - first_request);
+        std::string own = format_duration((*i)->own_time());
+        cout << "    " << at << std::string(at.length() < 13 ? 13 - at.length() : 1, ' ')
+                << own << std::string(own.length() < 13 ? 13 - own.length() : 1, ' ')
+                << (*i)->name << "\n";
+    }
+
+    // Services which took the longest to start (once their dependencies were satisfied)
+    std::vector<const svc_times *> by_time;
+    for (auto &svc : services) {
+        if (svc.started()) by_time.push_back(&svc);
+    }
+    std::sort(by_time.begin(), by_time.end(), [](const svc_times *a, const svc_times *b) {
+        return a->own_time() > b->own_time();
+    });
+    if (by_time.size() > 10) by_time.resize(10);
+
+    cout << "\nServices taking the longest to start:\n";
+    for (auto *svc : by_time) {
+        std::string own = format_duration(svc->own_time());
+        cout << "    " << own << std::string(own.length() < 13 ? 13 - own.length() : 1, ' ')
+                << svc->name << "\n";
+    }
+
+    return 0;
+}
+
+// Format a size in bytes for display, using a binary unit suffix (KiB, MiB...) as appropriate.
+static std::string format_size(uint64_t bytes)
+{
+    static const char * const units[] = { "B", "KiB", "MiB", "GiB", "TiB" };
+    unsigned unit = 0;
+    uint64_t scaled = bytes;
+    while (scaled >= 1024 * 10 && unit < 4) {
+        scaled /= 1024;
+        ++unit;
+    }
+    return std::to_string(scaled) + " " + units[unit];
+}
+
+// Query and print the resource usage of a service (as accounted by its cgroup). Nothing is printed
+// if the service has no cgroup.
+static void print_resource_usage(dinit_conn_t &dinit_conn, handle_t handle)
+{
+    using std::cout;
+
+    int socknum = dinit_conn.fd;
+    cpbuffer_t &rbuffer = *dinit_conn.buffer;
+
+    auto m = membuf()
+            .append((char)cp_cmd::QUERYRESOURCES)
+            .append(handle);
+    write_all_x(socknum, m);
+
+    wait_for_reply(rbuffer, socknum);
+    if (rbuffer[0] != (char)cp_rply::RESOURCES) {
+        throw dinit_protocol_error();
+    }
+
+    // RESOURCES (1), flags (1), CPU time (8), memory (8), task count (8)
+    constexpr unsigned rply_size = 2 + 3 * sizeof(uint64_t);
+    fill_buffer_to(rbuffer, socknum, rply_size);
+    uint8_t flags = rbuffer[1];
+    uint64_t cpu_usec, memory_bytes, pids;
+    rbuffer.extract(&cpu_usec, 2, sizeof(cpu_usec));
+    rbuffer.extract(&memory_bytes, 2 + sizeof(uint64_t), sizeof(memory_bytes));
+    rbuffer.extract(&pids, 2 + 2 * sizeof(uint64_t), sizeof(pids));
+    rbuffer.consume(rply_size);
+
+    if (flags & 1) {
+        cout << "    CPU time: " << format_duration(cpu_usec * 1000u) << "\n";
+    }
+    if (flags & 2) {
+        cout << "    Memory: " << format_size(memory_bytes) << "\n";
+    }
+    if (flags & 4) {
+        cout << "    Tasks: " << pids << "\n";
+    }
+}
+
+// Query and print log buffer statistics (buffer use and discarded message counts) for the main log
+// and the console log.
+static int log_stats(dinit_conn_t &dinit_conn)
+{
+    using std::cout;
+
+    int socknum = dinit_conn.fd;
+    cpbuffer_t &rbuffer = *dinit_conn.buffer;
+
+    char cmdbuf[] = { (char)cp_cmd::QUERYLOGSTATS };
+    write_all_x(socknum, cmdbuf, 1);
+
+    wait_for_reply(rbuffer, socknum);
+    if (rbuffer[0] != (char)cp_rply::LOGSTATS) {
+        throw dinit_protocol_error();
+    }
+
+    // LOGSTATS (1), then for each stream: buffered, buffer size, max size, 4 * discarded (4 each)
+    constexpr unsigned num_vals = 3 + 4;
+    constexpr unsigned rply_size = 1 + 2 * num_vals * sizeof(uint32_t);
+    fill_buffer_to(rbuffer, socknum, rply_size);
+
+    const char *stream_names[] = { "Main log", "Console" };
+    for (unsigned i = 0; i < 2; ++i) {
+        uint32_t vals[num_vals];
+        rbuffer.extract(vals, 1 + i * sizeof(vals), sizeof(vals));
+        cout << stream_names[i] << ":\n";
+        cout << "    Buffered: " << format_size(vals[0]) << " (buffer size " << format_size(vals[1])
+                << ", max " << format_size(vals[2]) << ")\n";
+        cout << "    Discarded messages: debug " << vals[3] << ", info " << vals[4] << ", warn "
+                << vals[5] << ", error " << vals[6] << "\n";
+    }
+    rbuffer.consume(rply_size);
+
+    return 0;
+}
+
+// Query and print the memory used by each service record (largest first), and the total.
+static int mem_usage(dinit_conn_t &dinit_conn)
+{
+    using std::cout;
+
+    int socknum = dinit_conn.fd;
+    cpbuffer_t &rbuffer = *dinit_conn.buffer;
+
+    char cmdbuf[] = { (char)cp_cmd::QUERYMEMUSAGE };
+    write_all_x(socknum, cmdbuf, 1);
+
+    wait_for_reply(rbuffer, socknum);
+    if (rbuffer[0] != (char)cp_rply::MEMUSAGE) {
+        throw dinit_protocol_error();
+    }
+
+    // MEMUSAGE (1), service count (4)
+    uint32_t count;
+    fill_buffer_to(rbuffer, socknum, 1 + sizeof(count));
+    rbuffer.extract(&count, 1, sizeof(count));
+    rbuffer.consume(1 + sizeof(count));
+
+    struct svc_mem
+    {
+        std::string name;
+        uint32_t record_size;
+        uint32_t heap_size;
+    };
+
+    std::vector<svc_mem> services(count);
+    uint64_t total_record = 0;
+    uint64_t total_heap = 0;
+    for (auto &svc : services) {
+        uint16_t name_len;
+        constexpr unsigned entry_hdr_size = 2 * sizeof(uint32_t) + sizeof(name_len);
+        fill_buffer_to(rbuffer, socknum, entry_hdr_size);
+        rbuffer.extract(&svc.record_size, 0, sizeof(uint32_t));
+        rbuffer.extract(&svc.heap_size, sizeof(uint32_t), sizeof(uint32_t));
+        rbuffer.extract(&name_len, 2 * sizeof(uint32_t), sizeof(name_len));
+        rbuffer.consume(entry_hdr_size);
+        while (name_len > 0) {
+            fill_buffer_to(rbuffer, socknum, 1);
+            unsigned chunk_len = std::min(rbuffer.get_contiguous_length(rbuffer.get_ptr(0)),
+                    (unsigned)name_len);
+            svc.name.append(rbuffer.get_ptr(0), chunk_len);
+            rbuffer.consume(chunk_len);
+            name_len -= chunk_len;
+        }
+        total_record += svc.record_size;
+        total_heap += svc.heap_size;
+    }
+
+    std::sort(services.begin(), services.end(), [](const svc_mem &a, const svc_mem &b) {
+        return (uint64_t)a.record_size + a.heap_size > (uint64_t)b.record_size + b.heap_size;
+    });
+
+    auto print_col = [](uint64_t val) {
+        std::string s = std::to_string(val);
+        if (s.length() < 8) cout << std::string(8 - s.length(), ' ');
+        cout << s << ' ';
+    };
+
+    cout << "  Record     Heap    Total Service\n";
+    for (auto &svc : services) {
+        print_col(svc.record_size);
+        print_col(svc.heap_size);
+        print_col((uint64_t)svc.record_size + svc.heap_size);
+        cout << svc.name << "\n";
+    }
+    cout << "Total: " << count << " services, " << format_size(total_record + total_heap)
+            << " (records " << format_size(total_record) << ", heap " << format_size(total_heap)
+            << ")\n";
+
+    return 0;
+}
+
+// Query and print automatic reload statistics.
+static int auto_reload_stats(dinit_conn_t &dinit_conn)
+{
+    using std::cout;
+
+    int socknum = dinit_conn.fd;
+    cpbuffer_t &rbuffer = *dinit_conn.buffer;
+
+    char cmdbuf[] = { (char)cp_cmd::QUERYAUTORELOAD };
+    write_all_x(socknum, cmdbuf, 1);
+
+    wait_for_reply(rbuffer, socknum);
+    if (rbuffer[0] != (char)cp_rply::AUTORELOAD) {
+        throw dinit_protocol_error();
+    }
+
+    // AUTORELOAD (1), enabled (1), 5 * count (4 each), 2 * latency (8 each)
+    constexpr unsigned rply_size = 2 + 5 * sizeof(uint32_t) + 2 * sizeof(uint64_t);
+    fill_buffer_to(rbuffer, socknum, rply_size);
+
+    bool enabled = rbuffer[1] != 0;
+    uint32_t counts[5];
+    uint64_t latencies[2];
+    rbuffer.extract(counts, 2, sizeof(counts));
+    rbuffer.extract(latencies, 2 + sizeof(counts), sizeof(latencies));
+    rbuffer.consume(rply_size);
+
+    if (!enabled) {
+        cout << "Automatic reload is not enabled.\n";
+        return 0;
+    }
+
+    cout << "Change events: " << counts[0] << " (" << counts[1] << " batches)\n";
+    cout << "Services reloaded: " << counts[2] << ", failed: " << counts[3]
+            << ", skipped (referenced): " << counts[4] << "\n";
+    cout << "Change-to-reload latency: last " << format_duration(latencies[0]) << ", max "
+            << format_duration(latencies[1]) << "\n";
+
+    return 0;
+}
+
 static int service_status(dinit_conn_t &dinit_conn, const char *service_name, ctl_cmd command,
         uint16_t proto_version, bool verbose)
 {
@@ -1641,10 +2624,12 @@ static int service_status(dinit_conn_t &dinit_conn, const char *service_name, ct
         sdf_path.append(service_name, strip_service_arg(service_name));
 
         // Issue STATUS request
-        char status_req_id = proto_version >= 6 ? (char)cp_cmd::SERVICESTATUS6
+        char status_req_id = proto_version >= 8 ? (char)cp_cmd::SERVICESTATUS8
+                : proto_version >= 6 ? (char)cp_cmd::SERVICESTATUS6
                 : (proto_version == 5 ? (char)cp_cmd::SERVICESTATUS5
                 : (char)cp_cmd::SERVICESTATUS);
-        unsigned status_buf_size = proto_version >= 6 ? STATUS_BUFFER6_SIZE
+        unsigned status_buf_size = proto_version >= 8 ? STATUS_BUFFER8_SIZE
+                : proto_version >= 6 ? STATUS_BUFFER6_SIZE
                 : (proto_version == 5 ? STATUS_BUFFER5_SIZE : STATUS_BUFFER_SIZE);
 
         auto m = membuf()
@@ -1869,6 +2854,23 @@ static int service_status(dinit_conn_t &dinit_conn, const char *service_name, ct
         if (service_pid != -1) {
             cout << "    Process ID: " << service_pid << "\n";
         }
+
+        if (proto_version >= 8) {
+            uint64_t backoff_ns;
+            uint32_t backoff_count;
+            rbuffer.extract(&backoff_ns, STATUS_BUFFER6_SIZE, sizeof(backoff_ns));
+            rbuffer.extract(&backoff_count, STATUS_BUFFER6_SIZE + sizeof(backoff_ns),
+                    sizeof(backoff_count));
+            if (backoff_count > 1) {
+                cout << "    Restart delay: " << format_duration(backoff_ns) << " (backoff after "
+                        << backoff_count << " consecutive restarts)\n";
+            }
+        }
+
+        if (proto_version >= 8 && current != service_state_t::STOPPED) {
+            rbuffer.consume(status_buf_size);
+            print_resource_usage(dinit_conn, handle);
+        }
     }
 
     return 0;
@@ -2768,6 +3770,112 @@ static int signal_send(dinit_conn_t &dinit_conn, const char *service_name, sig_n
     return 0;
 }
 
+// Print the contents of a boot journal file, in order.
+//   service_filter - if not null, only show records for the named service
+//   min_level - only show records at or above this log level
+static int show_journal(const char *journal_path, const char *service_filter, int min_level)
+{
+    using std::cout;
+    using std::cerr;
+
+    int fd = open(journal_path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        cerr << DINITCTL_APPNAME ": could not open journal file " << journal_path << ": "
+                << strerror(errno) << "\n";
+        return 1;
+    }
+
+    struct stat statbuf;
+    void *map = MAP_FAILED;
+    if (fstat(fd, &statbuf) == 0 && (size_t)statbuf.st_size >= journal_hdr_size) {
+        map = mmap(nullptr, statbuf.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+
+    const char *data = static_cast<const char *>(map);
+    journal_file_hdr hdr;
+    if (map != MAP_FAILED) {
+        memcpy(&hdr, data, sizeof(hdr));
+    }
+    if (map == MAP_FAILED || memcmp(hdr.magic, journal_magic, sizeof(journal_magic)) != 0
+            || hdr.version != journal_version || hdr.hdr_size != journal_hdr_size
+            || hdr.size != (uint64_t)statbuf.st_size) {
+        cerr << DINITCTL_APPNAME ": " << journal_path << ": not a valid journal file\n";
+        if (map != MAP_FAILED) munmap(map, statbuf.st_size);
+        return 1;
+    }
+
+    // Collect records (sequence number and offset), and sort by sequence:
+    const char *data_area = data + journal_hdr_size;
+    size_t data_size = hdr.size - journal_hdr_size;
+    std::vector<std::pair<uint64_t, size_t>> records;
+    journal_scan(data_area, data_size, [&](size_t offset, const journal_rec_hdr &rhdr,
+            const char *, const char *, size_t) {
+        records.emplace_back(rhdr.seq, offset);
+    });
+    std::sort(records.begin(), records.end());
+
+    const char *level_names[] = { "debug", "info", "warn", "error" };
+    size_t filter_len = (service_filter != nullptr) ? strlen(service_filter) : 0;
+
+    for (auto &record : records) {
+        journal_rec_hdr rhdr;
+        memcpy(&rhdr, data_area + record.second, sizeof(rhdr));
+        const char *name = data_area + record.second + sizeof(rhdr);
+        const char *text = name + rhdr.name_len;
+        size_t text_len = rhdr.length - sizeof(rhdr) - rhdr.name_len;
+
+        if (rhdr.level < min_level) continue;
+        if (service_filter != nullptr && (rhdr.name_len != filter_len
+                || strncmp(name, service_filter, filter_len) != 0)) {
+            continue;
+        }
+
+        time_t secs = rhdr.timestamp / 1000000000u;
+        unsigned msecs = (rhdr.timestamp % 1000000000u) / 1000000u;
+        struct tm tm_buf;
+        char time_buf[32] = "";
+        if (localtime_r(&secs, &tm_buf) != nullptr) {
+            strftime(time_buf, sizeof(time_buf), "%Y-%m-%d %H:%M:%S", &tm_buf);
+        }
+        char msecs_buf[8];
+        snprintf(msecs_buf, sizeof(msecs_buf), ".%03u", msecs);
+
+        cout << time_buf << msecs_buf << " ["
+                << (rhdr.level < 4 ? level_names[rhdr.level] : "?") << "] ";
+
+        std::string service_name(name, rhdr.name_len);
+        switch ((journal_rec_type)rhdr.type) {
+        case journal_rec_type::MESSAGE:
+            cout.write(text, text_len);
+            break;
+        case journal_rec_type::DINIT_START:
+            cout << "-- dinit started --";
+            break;
+        case journal_rec_type::SERVICE_STARTED:
+            cout << "service " << service_name << " started";
+            break;
+        case journal_rec_type::SERVICE_FAILED:
+            cout << "service " << service_name << " failed to start";
+            if (text_len != 0) {
+                cout << " (";
+                cout.write(text, text_len);
+                cout << ")";
+            }
+            break;
+        case journal_rec_type::SERVICE_STOPPED:
+            cout << "service " << service_name << " stopped";
+            break;
+        default:
+            cout << "(unknown record type " << (int)rhdr.type << ")";
+        }
+        cout << "\n";
+    }
+
+    munmap(map, statbuf.st_size);
+    return 0;
+}
+
 static int signal_list()
 {
     using std::cout;
@@ -0,0 +1,131 @@
+#ifndef DINIT_AUTO_RELOAD_H
+#define DINIT_AUTO_RELOAD_H
+
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include <dinit.h>
+
+class dirload_service_set;
+
+// Statistics for automatic reload of service descriptions
+struct auto_reload_stats
+{
+    unsigned long events = 0;    // change events read (from all watched directories)
+    unsigned long batches = 0;   // batches of changes processed
+    unsigned long reloads = 0;   // services reloaded successfully
+    unsigned long failures = 0;  // services which could not be reloaded
+    unsigned long skipped = 0;   // services not reloaded (referenced via a control handle)
+    time_val last_latency = {0, 0};  // first change to completion of reload, for the last batch
+    time_val max_latency = {0, 0};   // maximum of the above, over all batches
+};
+
+// Automatic reload of changed service descriptions. This watches (via inotify) each service
+// directory, and each directory containing a file included (via @include or @include-opt) by a
+// loaded service. Changes are gathered into a batch, which is processed once no further change has
+// been seen for the debounce delay (or once the batch reaches the maximum delay, if changes
+// continue). Each loaded service affected by some change in the batch is then reloaded once, as
+// per "dinitctl reload".
+//
+// A service which is referenced via a control connection handle is not reloaded, since the reload
+// may replace the service record (invalidating the handle).
+class auto_reloader
+{
+    class inotify_watcher : public eventloop_t::fd_watcher_impl<inotify_watcher>
+    {
+        public:
+        auto_reloader *owner;
+        dasynq::rearm fd_event(eventloop_t &eloop, int fd, int flags) noexcept;
+
+        explicit inotify_watcher(auto_reloader *owner_p) noexcept : owner(owner_p) { }
+    };
+
+    class debounce_timer : public eventloop_t::timer_impl<debounce_timer>
+    {
+        public:
+        auto_reloader *owner;
+        dasynq::rearm timer_expiry(eventloop_t &eloop, int expiry_count) noexcept;
+
+        explicit debounce_timer(auto_reloader *owner_p) noexcept : owner(owner_p) { }
+    };
+
+    dirload_service_set *services;
+
+    int inotify_fd = -1;
+    inotify_watcher watcher;
+    debounce_timer timer;
+
+    bool batch_pending = false;  // changes are queued, and the timer is armed
+    bool reload_all = false;     // change events were lost (queue overflow); reload all services
+    time_val batch_start;        // time of first change in the pending batch
+
+    // Watch descriptors for the service directories:
+    std::unordered_set<int> service_dir_wds;
+    // Watch descriptors for directories containing included files, by directory path:
+    std::unordered_map<std::string, int> include_dir_wds;
+    // Services using each included file, by (directory watch descriptor, file name):
+    std::map<std::pair<int, std::string>, std::unordered_set<std::string>> include_users;
+
+    // Names of changed files in the service directories, and services affected by changes to
+    // included files, in the pending batch:
+    std::unordered_set<std::string> changed_files;
+    std::unordered_set<std::string> changed_services;
+
+    auto_reload_stats stats;
+
+    // Remove the given service from the users of all included files.
+    void forget_service(const std::string &name) noexcept;
+
+    // Stop watching any directory (other than a service directory) which no longer holds an
+    // included file in use by some service.
+    void remove_unused_watches() noexcept;
+
+    // Process a change to the named file in the watched directory with the given watch descriptor.
+    // Returns true if any service may be affected.
+    // Throws: std::bad_alloc
+    bool file_changed(int wd, const char *name);
+
+    // Reload the services affected by the pending batch of changes
+    void process_batch() noexcept;
+
+    public:
+    // Delay after a change before reloading, and maximum delay if changes are continuous:
+    time_val debounce_delay = {0, 250000000};
+    time_val max_batch_delay = {2, 0};
+
+    explicit auto_reloader(dirload_service_set *services_p) noexcept
+        : services(services_p), watcher(this), timer(this)
+    {
+    }
+
+    auto_reloader(const auto_reloader &) = delete;
+    void operator=(const auto_reloader &) = delete;
+
+    ~auto_reloader() noexcept;
+
+    // Begin watching the service directories. Returns false on failure (which is logged).
+    bool start() noexcept;
+
+    // Record the files (the service description, followed by any included files) read when loading
+    // (or reloading) a service, so that changes to included files can be detected.
+    void service_loaded(const char *name, const std::vector<std::string> &files) noexcept;
+
+    // Forget the included files of a service which is being unloaded.
+    void service_unloaded(const std::string &name) noexcept;
+
+    const auto_reload_stats &get_stats() const noexcept
+    {
+        return stats;
+    }
+
+    int get_inotify_fd() const noexcept
+    {
+        return inotify_fd;
+    }
+};
+
+#endif
@@ -8,7 +8,9 @@
 #ifndef BPSYS_INCLUDED
 #define BPSYS_INCLUDED
 
+#include <cstdio> // rename
 #include <cstdlib> // getenv
+#include <csignal>
 
 #include <dasynq.h> // for pipe2
 
@@ -18,6 +20,12 @@
 #include <unistd.h>
 #include <fcntl.h>
 
+#ifdef __linux__
+#include <sched.h> // clone
+#include <sys/inotify.h>
+#include <sys/syscall.h>
+#endif
+
 extern char **environ;
 
 namespace bp_sys {
@@ -29,6 +37,11 @@ using ::open;
 using ::openat;
 using ::close;
 using ::fstatat;
+using ::fstat;
+using ::fchown;
+using ::fchmod;
+using ::rename;
+using ::unlink;
 using ::kill;
 using ::getpgid;
 using ::tcsetpgrp;
@@ -39,11 +52,85 @@ using ::writev;
 using ::waitid;
 using ::readlinkat;
 using ::dup;
+using ::mkdir;
+using ::rmdir;
+
+#ifdef __linux__
+using ::inotify_init1;
+using ::inotify_add_watch;
+using ::inotify_rm_watch;
+#endif
 
 using std::getenv;
 
 using ::environ;
 
+// Run a function in a new child process which shares memory with the caller until it either
+// execs or exits (via _exit), with the caller suspended until then (as per vfork). This avoids the
+// cost of copying the address space (page tables) of the caller, as fork must. The function runs on
+// a separate stack and with all signals masked, and must not return.
+// Returns: the pid of the child, or -1 on failure (with errno set).
+#ifdef __linux__
+
+constexpr bool have_vfork_call = true;
+
+inline pid_t vfork_call(int (*fn)(void *), void *arg) noexcept
+{
+    // Only one child at a time can be using the stack, since the caller is suspended until the
+    // child no longer needs it.
+    alignas(16) static char child_stack[128 * 1024];
+
+    sigset_t sigall_set;
+    sigset_t orig_set;
+    sigfillset(&sigall_set);
+    sigprocmask(SIG_SETMASK, &sigall_set, &orig_set);
+
+    pid_t child = clone(fn, child_stack + sizeof(child_stack), CLONE_VM | CLONE_VFORK | SIGCHLD, arg);
+    int clone_errno = errno;
+
+    sigprocmask(SIG_SETMASK, &orig_set, nullptr);
+    errno = clone_errno;
+    return child;
+}
+
+#else
+
+constexpr bool have_vfork_call = false;
+
+inline pid_t vfork_call(int (*fn)(void *), void *arg) noexcept
+{
+    errno = ENOSYS;
+    return -1;
+}
+
+#endif
+
+// Obtain a process file descriptor (pidfd) referring to the given process. The descriptor becomes
+// readable once the process terminates, and (unlike the pid) can never come to refer to a
+// different process. Returns -1 with errno set to ENOSYS if not supported (by either the C library
+// headers or the running kernel).
+inline int pidfd_open(pid_t pid, unsigned flags) noexcept
+{
+#if defined(__linux__) && defined(SYS_pidfd_open)
+    return (int) syscall(SYS_pidfd_open, pid, flags);
+#else
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+// Send a signal to the process referred to by a pidfd. Signal 0 can be used to check that the
+// process has not yet terminated.
+inline int pidfd_send_signal(int pidfd, int sig, siginfo_t *info, unsigned flags) noexcept
+{
+#if defined(__linux__) && defined(SYS_pidfd_send_signal)
+    return (int) syscall(SYS_pidfd_send_signal, pidfd, sig, info, flags);
+#else
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
 }
 
 #endif  // BPSYS_INCLUDED
@@ -16,6 +16,9 @@
 // 6 - dinit 0.21.0 (adds SERVICESTATUS6, also returns service file modification time as
 //                  per when the service was loaded)
 // 7 - dinit TBC (adds ENABLE_SERVICE_V7)
+// 8 - dinit TBC (adds LOADSERVICES, STARTSTOPSERVICES, LISTSERVICES8, SUBSCRIBE,
+//                  QUERYSTARTTIMES, QUERYRESOURCES, QUERYLOGSTATS, QUERYMEMUSAGE,
+//                  QUERYAUTORELOAD, SERVICESTATUS8)
 
 // Requests:
 enum class cp_cmd : dinit_cptypes::cp_cmd_t {
@@ -99,7 +102,37 @@ enum class cp_cmd : dinit_cptypes::cp_cmd_t {
     SERVICESTATUS6 = 28,
 
     // Enable service (7+)
-    ENABLE_SERVICE_V7 = 29
+    ENABLE_SERVICE_V7 = 29,
+
+    // Find or load multiple services (8+)
+    LOADSERVICES = 30,
+
+    // Start, stop, wake or release multiple services (8+)
+    STARTSTOPSERVICES = 31,
+
+    // List services matching a filter, with cursor and limit (8+)
+    LISTSERVICES8 = 32,
+
+    // Subscribe to status changes of all services (8+)
+    SUBSCRIBE = 33,
+
+    // Query start stage times and dependencies of all services (8+)
+    QUERYSTARTTIMES = 34,
+
+    // Query resource usage of a service, as accounted by its cgroup (8+)
+    QUERYRESOURCES = 35,
+
+    // Query log buffer statistics (8+)
+    QUERYLOGSTATS = 36,
+
+    // Query memory used by service records (8+)
+    QUERYMEMUSAGE = 37,
+
+    // Query automatic reload statistics (8+)
+    QUERYAUTORELOAD = 38,
+
+    // Service status, including restart backoff state (8+)
+    SERVICESTATUS8 = 39,
 };
 
 // Replies:
@@ -180,6 +213,51 @@ enum class cp_rply : dinit_cptypes::cp_rply_t {
     // "Pre-acknowledgement". Issued before main reply after restart command
     // (to avoid race condition for client tracking service status)
     PREACK = 79,
+
+    // Reply to LOADSERVICES: (2 byte) count N, then N * (1 byte result code (SERVICERECORD,
+    // NOSERVICE, SERVICE_DESC_ERR or SERVICE_LOAD_ERR), 1 byte state, handle, 1 byte target state).
+    // State, handle and target state are only meaningful for SERVICERECORD.
+    SERVICERECORDS = 80,
+
+    // Reply to STARTSTOPSERVICES: (2 byte) count N, then N * 1 byte result code (as per the reply
+    // to the corresponding single-service command; DEPENDENTS carries no handle list).
+    SSRESULTS = 81,
+
+    // Service list (LISTSERVICES8) is incomplete due to limit; (4 byte) cursor to continue from
+    // (identifier of the last listed service)
+    LISTMORE = 82,
+
+    // Reply to SUBSCRIBE: 1 byte flags (bit 0: resumed), (8 byte) sequence number of latest event,
+    // (4 byte) count N, then N * ((4 byte) service id, 1 byte state, 1 byte target state,
+    // (2 byte) name length, name). A resumed subscription has no entries (N = 0); instead, the
+    // missed SERVICEDELTA packets follow.
+    SUBSCRIBED = 83,
+
+    // Reply to QUERYSTARTTIMES: (8 byte) current time, (4 byte) count N, then N * (
+    // NUM_START_STAGES * (8 byte) stage time, (2 byte) dependency count D, D * ((4 byte) index
+    // of dependency within the list, 1 byte dependency type), (2 byte) name length, name).
+    // Times are in nanoseconds (monotonic clock), 0 if the stage was not reached.
+    STARTTIMES = 84,
+
+    // Reply to QUERYRESOURCES: 1 byte flags (bit 0: CPU time valid, bit 1: memory valid, bit 2:
+    // task count valid), (8 byte) CPU time in microseconds, (8 byte) current memory use in bytes,
+    // (8 byte) current number of tasks. Flags are 0 if the service has no cgroup.
+    RESOURCES = 85,
+
+    // Reply to QUERYLOGSTATS: for each of the main log and the console log: (4 byte) bytes
+    // buffered, (4 byte) buffer size, (4 byte) maximum buffer size, then 4 * (4 byte) number of
+    // discarded messages at each log level (debug, info, warn, error).
+    LOGSTATS = 86,
+
+    // Reply to QUERYMEMUSAGE: (4 byte) count N, then N * ((4 byte) record size, (4 byte) heap
+    // memory size, (2 byte) name length, name). Sizes are in bytes; the heap size is an estimate.
+    MEMUSAGE = 87,
+
+    // Reply to QUERYAUTORELOAD: 1 byte enabled (0 or 1), then (4 byte) change events, (4 byte)
+    // batches processed, (4 byte) services reloaded, (4 byte) reload failures, (4 byte) services
+    // skipped, (8 byte) latency of the last batch, (8 byte) maximum latency. Latencies (from first
+    // change to completion of reload) are in nanoseconds.
+    AUTORELOAD = 88,
 };
 
 // Information (out-of-band):
@@ -190,6 +268,16 @@ enum class cp_info : dinit_cptypes::cp_info_t {
     SERVICEEVENT5 = 101,
     // Environment event; 2 bytes length + env string
     ENVEVENT = 102,
+    // Change in service set, for subscribers (8+): 1 byte event code (service event code, or
+    // cp_delta_event), (8 byte) sequence number, (4 byte) service id, 1 byte state, 1 byte target
+    // state, and for ADDED the service name (truncated to fit the packet)
+    SERVICEDELTA = 103,
+};
+
+// SERVICEDELTA event codes other than service events:
+enum class cp_delta_event : uint8_t {
+    ADDED = 100,    // service was loaded
+    REMOVED = 101,  // service was unloaded
 };
 
 #endif
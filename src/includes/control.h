@@ -1,7 +1,6 @@
 #ifndef DINIT_CONTROL_H
 #define DINIT_CONTROL_H
 
-#include <list>
 #include <vector>
 #include <unordered_map>
 #include <map>
@@ -9,6 +8,7 @@
 #include <cstddef>
 
 #include <unistd.h>
+#include <sys/uio.h>
 
 #include <dinit.h>
 #include <dinit-log.h>
@@ -16,6 +16,7 @@
 #include <control-cmds.h>
 #include <service-listener.h>
 #include <cpbuffer.h>
+#include <cpoutbuf.h>
 #include <control-datatypes.h>
 
 // Control connection for dinit
@@ -82,8 +83,28 @@ class control_conn_watcher : public eventloop_t::bidi_fd_watcher_impl<control_co
     }
 };
 
-class control_conn_t : private service_listener, private env_listener
+// A control connection's reference to a service, via one or more handles. The reference is
+// registered as a listener with the service (so the service's listener list links the connections
+// which refer to it) and events are passed directly to the connection, with the handles to which
+// they apply.
+class conn_service_ref final : public service_listener
 {
+    public:
+    control_conn_t *conn;
+    service_record *service;
+    uint32_t first_slot;  // handle slot of the first handle (others are chained via the slots)
+
+    conn_service_ref(control_conn_t *conn_p, service_record *service_p) noexcept
+        : conn(conn_p), service(service_p), first_slot(-1)
+    {
+    }
+
+    void service_event(service_record *service, service_event_t event) noexcept override;
+};
+
+class control_conn_t : private service_set_listener, private env_listener
+{
+    friend class conn_service_ref;
     friend rearm control_conn_cb(eventloop_t *loop, control_conn_watcher *watcher, int revents);
     friend class control_conn_t_test;
 
@@ -94,6 +115,7 @@ class control_conn_t : private service_listener, private env_listener
     
     bool bad_conn_close = false; // close when finished output?
     bool oom_close = false;      // send final 'out of memory' indicator
+    bool subscribed = false;     // subscribed to service set events (SUBSCRIBE)?
 
     // The packet length before we need to re-check if the packet is complete.
     // process_packet() will not be called until the packet reaches this size.
@@ -102,18 +124,30 @@ class control_conn_t : private service_listener, private env_listener
     // Receive buffer
     cpbuffer<1024> rbuf;
     
-    template <typename T> using list = std::list<T>;
     template <typename T> using vector = std::vector<T>;
     
-    std::unordered_multimap<service_record *, dinit_cptypes::handle_t> service_key_map;
-    std::map<dinit_cptypes::handle_t, service_record *> key_service_map;
+    // Service handles. A handle identifies a slot (in the low bits) together with the generation
+    // of the slot (in the high bits), which changes each time the slot is freed, so that a stale
+    // handle is not (immediately) taken to refer to whatever now occupies the slot.
+    static constexpr unsigned handle_slot_bits = 24;
+    static constexpr uint32_t handle_slot_mask = (1u << handle_slot_bits) - 1;
+    static constexpr uint32_t no_slot = -1;
+
+    struct handle_slot
+    {
+        conn_service_ref *ref;  // the referenced service, or nullptr if the slot is free
+        uint32_t generation;
+        uint32_t next;          // next slot for same service, or next free slot (or no_slot)
+    };
+
+    vector<handle_slot> handle_slots;
+    uint32_t free_slot = no_slot;  // first free slot
+
+    // This connection's reference to each service for which it holds handles
+    std::unordered_map<service_record *, conn_service_ref *> service_refs;
     
-    // Buffer for outgoing packets. Each outgoing packet is represented as a vector<char>.
-    list<vector<char>> outbuf;
-    // Current output buffer size in bytes.
-    unsigned outbuf_size = 0;
-    // Current index within the first outgoing packet (all previous bytes have been sent).
-    unsigned outpkt_index = 0;
+    // Buffer for outgoing packets (which have not yet been sent, or have been only partially sent).
+    cpoutbuf outbuf;
     
     // Queue a packet to be sent
     //  Returns:  false if the packet could not be queued and a suitable error packet
@@ -125,6 +159,9 @@ class control_conn_t : private service_listener, private env_listener
     // The in/out watch enabled state will also be set appropriately.
     bool queue_packet(vector<char> &&v) noexcept;
     bool queue_packet(const char *pkt, unsigned size) noexcept;
+    // Queue a packet made up of several parts (which are copied only if they cannot be sent
+    // immediately)
+    bool queue_packet(const struct iovec *parts, int num_parts) noexcept;
 
     // Process a packet.
     //  Returns:  true (with bad_conn_close == false) if successful
@@ -141,6 +178,17 @@ class control_conn_t : private service_listener, private env_listener
     // Process a FINDSERVICE/LOADSERVICE packet. May throw std::bad_alloc.
     bool process_find_load(cp_cmd pktType);
 
+    // Find or load a service by name. On failure, returns nullptr and sets fail_code to the
+    // appropriate reply code. May throw std::bad_alloc.
+    service_record *find_load_service(const char *name, bool do_load, cp_rply &fail_code);
+
+    // Process a LOADSERVICES packet (find/load multiple services). May throw std::bad_alloc.
+    bool process_load_services();
+
+    // Process a STARTSTOPSERVICES packet (start/stop/wake/release multiple services). May throw
+    // std::bad_alloc.
+    bool process_start_stop_services();
+
     // Process a CLOSEHANDLE packet.
     bool process_close_handle();
 
@@ -175,10 +223,14 @@ class control_conn_t : private service_listener, private env_listener
     bool list_services();
     bool list_services5();
 
+    // List loaded services which match a filter, following a given service (by identifier) and up
+    // to a given limit (LISTSERVICES8).
+    bool list_services8();
+
     // Query service status/
     bool process_service_status();
     bool process_service_status5();
-    bool process_service_status6();
+    bool process_service_status6(bool v8 = false);  // (v8: SERVICESTATUS8)
 
     // Add a dependency between two services.
     bool add_service_dep(bool do_start = false, bool v7 = false);
@@ -195,6 +247,25 @@ class control_conn_t : private service_listener, private env_listener
     // Listen to environment events
     bool process_listenenv();
 
+    // Query start stage times and dependencies of all services
+    bool process_query_start_times();
+
+    // Query resource usage (from the cgroup) of a service
+    bool process_query_resources();
+
+    // Query log buffer statistics
+    bool process_query_log_stats();
+
+    // Query memory used by each service record
+    bool process_query_mem_usage();
+
+    // Query automatic reload statistics
+    bool process_query_auto_reload();
+
+    // Subscribe to service set events, with an initial snapshot of all services (or events missed
+    // since a previous subscription)
+    bool process_subscribe();
+
     // Notify that data is ready to be read from the socket. Returns true if the connection should
     // be closed.
     bool data_ready() noexcept;
@@ -208,17 +279,35 @@ class control_conn_t : private service_listener, private env_listener
 
     // Allocate a new handle for a service; may throw std::bad_alloc
     dinit_cptypes::handle_t allocate_service_handle(service_record *record);
-    
-    // Find the service corresponding to a service handle; returns nullptr if not found.
-    service_record *find_service_for_key(dinit_cptypes::handle_t key) noexcept
+
+    // Get the handle slot identified by a service handle; returns nullptr if the handle is not
+    // valid.
+    handle_slot *find_handle_slot(dinit_cptypes::handle_t key) noexcept
     {
-        try {
-            return key_service_map.at(key);
-        }
-        catch (std::out_of_range &exc) {
+        uint32_t index = key & handle_slot_mask;
+        if (index >= handle_slots.size()) return nullptr;
+        handle_slot &slot = handle_slots[index];
+        if (slot.ref == nullptr || (slot.generation << handle_slot_bits) != (key & ~handle_slot_mask)) {
             return nullptr;
         }
+        return &slot;
+    }
+
+    // Find the service corresponding to a service handle; returns nullptr if not found.
+    service_record *find_service_for_key(dinit_cptypes::handle_t key) noexcept
+    {
+        handle_slot *slot = find_handle_slot(key);
+        return (slot != nullptr) ? slot->ref->service : nullptr;
     }
+
+    // Release a service handle (which must be valid).
+    void release_service_handle(dinit_cptypes::handle_t key) noexcept;
+
+    // Release all handles for the given service.
+    void release_service_handles(service_record *service) noexcept;
+
+    // Free a handle slot, and the service reference if it has no more handles.
+    void free_handle_slot(uint32_t index) noexcept;
     
     // Close connection due to out-of-memory condition.
     void do_oom_close() noexcept
@@ -227,10 +316,16 @@ class control_conn_t : private service_listener, private env_listener
         oom_close = true;
     }
     
-    // Process service event broadcast.
+    // Process service event broadcast (via the connection's reference to the service).
     // Note that this can potentially be called during packet processing (upon issuing
     // service start/stop orders etc).
-    void service_event(service_record *service, service_event_t event) noexcept final override;
+    void service_event(conn_service_ref *ref, service_event_t event) noexcept;
+
+    // Process service set event (for subscription).
+    void service_set_event(const service_set_event_t &event) noexcept final override;
+
+    // Queue a SERVICEDELTA packet describing a service set event.
+    bool queue_service_delta(const service_set_event_t &event) noexcept;
 
     // Process environment event broadcast.
     void environ_event(environment *env, std::string const &var_and_val, bool overridden) noexcept final override;
@@ -273,7 +368,7 @@ inline dasynq::rearm control_conn_cb(eventloop_t * loop, control_conn_watcher *
     
     // Accept more commands unless the output buffer high water mark is exceeded
     int watch_flags = 0;
-    if (!conn->bad_conn_close && conn->outbuf_size < OUTBUF_LIMIT) {
+    if (!conn->bad_conn_close && conn->outbuf.size() < OUTBUF_LIMIT) {
         watch_flags |= dasynq::IN_EVENTS;
     }
     if (!conn->outbuf.empty() || conn->bad_conn_close) {
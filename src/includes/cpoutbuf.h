@@ -0,0 +1,247 @@
+#ifndef CPOUTBUF_H
+#define CPOUTBUF_H
+
+#include <cstddef>
+#include <cstring>
+#include <new>
+
+#include <sys/uio.h>
+
+// Control protocol output buffer: a queue of outgoing bytes held in a linked list of fixed-size
+// chunks. Chunks are taken from (and returned to) a process-wide pool of free chunks, so that in
+// the steady state queueing a packet requires no heap allocation, and all queued data can be
+// written out with a single writev() call.
+class cpoutbuf
+{
+    public:
+    // Allocation statistics, for all output buffers:
+    struct stats_t
+    {
+        unsigned long chunk_allocs = 0;  // chunks allocated from the heap
+        unsigned long chunk_reuses = 0;  // chunks taken from the free pool
+        unsigned long chunk_frees = 0;   // chunks returned to the heap
+        unsigned chunks_in_use = 0;      // chunks currently holding queued data
+        unsigned chunks_pooled = 0;      // chunks currently in the free pool
+    };
+
+    // Allocation size of each chunk, and the usable data size:
+    static constexpr unsigned chunk_alloc_size = 4096;
+    static constexpr unsigned chunk_size = chunk_alloc_size - sizeof(void *);
+
+    // Maximum number of chunks retained in the free pool:
+    static constexpr unsigned max_pooled = 32;
+
+    private:
+    struct chunk
+    {
+        chunk *next;
+        char data[chunk_size];
+    };
+
+    static chunk *free_chunks;
+    static stats_t stats;
+
+    chunk *head = nullptr;
+    chunk *tail = nullptr;
+    unsigned head_index = 0;  // index of first queued byte in head chunk
+    unsigned tail_index = 0;  // index one past last queued byte in tail chunk
+    size_t length = 0;
+
+    // Get a chunk from the pool, or allocate a new one. May throw std::bad_alloc.
+    static chunk *get_chunk()
+    {
+        chunk *c = free_chunks;
+        if (c != nullptr) {
+            free_chunks = c->next;
+            stats.chunks_pooled--;
+            stats.chunk_reuses++;
+        }
+        else {
+            c = new chunk;
+            stats.chunk_allocs++;
+        }
+        stats.chunks_in_use++;
+        c->next = nullptr;
+        return c;
+    }
+
+    // Return a chunk to the pool (or free it, if the pool is full).
+    static void put_chunk(chunk *c) noexcept
+    {
+        stats.chunks_in_use--;
+        if (stats.chunks_pooled < max_pooled) {
+            c->next = free_chunks;
+            free_chunks = c;
+            stats.chunks_pooled++;
+        }
+        else {
+            delete c;
+            stats.chunk_frees++;
+        }
+    }
+
+    public:
+    cpoutbuf() noexcept
+    {
+    }
+
+    cpoutbuf(const cpoutbuf &) = delete;
+    void operator=(const cpoutbuf &) = delete;
+
+    ~cpoutbuf() noexcept
+    {
+        clear();
+    }
+
+    bool empty() const noexcept
+    {
+        return length == 0;
+    }
+
+    size_t size() const noexcept
+    {
+        return length;
+    }
+
+    // Append the contents of the given buffers, excluding the first 'skip' bytes. Either all the
+    // data is appended, or (if std::bad_alloc is thrown) the output buffer is left unchanged.
+    void append(const struct iovec *parts, int num_parts, size_t skip = 0)
+    {
+        size_t total = 0;
+        for (int i = 0; i < num_parts; ++i) {
+            total += parts[i].iov_len;
+        }
+        if (total <= skip) return;
+        total -= skip;
+
+        // Get all the required chunks first, so that we can't fail part-way through:
+        size_t tail_space = (tail == nullptr) ? 0 : (chunk_size - tail_index);
+        if (total > tail_space) {
+            size_t num_new = (total - tail_space + chunk_size - 1) / chunk_size;
+            chunk *new_head = nullptr;
+            chunk *new_tail = nullptr;
+            try {
+                for (size_t i = 0; i < num_new; ++i) {
+                    chunk *c = get_chunk();
+                    if (new_tail == nullptr) {
+                        new_head = c;
+                    }
+                    else {
+                        new_tail->next = c;
+                    }
+                    new_tail = c;
+                }
+            }
+            catch (std::bad_alloc &) {
+                while (new_head != nullptr) {
+                    chunk *next = new_head->next;
+                    put_chunk(new_head);
+                    new_head = next;
+                }
+                throw;
+            }
+
+            if (tail == nullptr) {
+                head = tail = new_head;
+                head_index = tail_index = 0;
+            }
+            else {
+                tail->next = new_head;
+            }
+        }
+
+        for (int i = 0; i < num_parts; ++i) {
+            const char *part_base = static_cast<const char *>(parts[i].iov_base);
+            size_t part_len = parts[i].iov_len;
+            if (skip >= part_len) {
+                skip -= part_len;
+                continue;
+            }
+            part_base += skip;
+            part_len -= skip;
+            skip = 0;
+
+            while (part_len > 0) {
+                if (tail_index == chunk_size) {
+                    tail = tail->next;
+                    tail_index = 0;
+                }
+                size_t amount = chunk_size - tail_index;
+                if (amount > part_len) amount = part_len;
+                memcpy(tail->data + tail_index, part_base, amount);
+                tail_index += amount;
+                part_base += amount;
+                part_len -= amount;
+            }
+        }
+
+        length += total;
+    }
+
+    void append(const char *data, size_t len)
+    {
+        struct iovec part;
+        part.iov_base = const_cast<char *>(data);
+        part.iov_len = len;
+        append(&part, 1);
+    }
+
+    // Describe the queued data (from the front of the queue) via at most max_iov iovec structures.
+    // Returns the number of iovecs filled.
+    int get_iovecs(struct iovec *iov, int max_iov) const noexcept
+    {
+        int num = 0;
+        unsigned index = head_index;
+        for (chunk *c = head; c != nullptr && num < max_iov; c = c->next) {
+            unsigned end = (c == tail) ? tail_index : unsigned(chunk_size);
+            iov[num].iov_base = c->data + index;
+            iov[num].iov_len = end - index;
+            ++num;
+            index = 0;
+        }
+        return num;
+    }
+
+    // Remove n bytes (which must not exceed the size of the queued data) from the front.
+    void consume(size_t n) noexcept
+    {
+        length -= n;
+        while (n > 0) {
+            unsigned end = (head == tail) ? tail_index : unsigned(chunk_size);
+            size_t avail = end - head_index;
+            if (n < avail) {
+                head_index += n;
+                break;
+            }
+            n -= avail;
+            chunk *next = head->next;
+            put_chunk(head);
+            head = next;
+            head_index = 0;
+            if (head == nullptr) {
+                tail = nullptr;
+                tail_index = 0;
+            }
+        }
+    }
+
+    // Discard all queued data.
+    void clear() noexcept
+    {
+        while (head != nullptr) {
+            chunk *next = head->next;
+            put_chunk(head);
+            head = next;
+        }
+        tail = nullptr;
+        head_index = tail_index = 0;
+        length = 0;
+    }
+
+    static const stats_t &get_stats() noexcept
+    {
+        return stats;
+    }
+};
+
+#endif
@@ -0,0 +1,330 @@
+#ifndef DINIT_CLIENT_ASYNC_H_INCLUDED
+#define DINIT_CLIENT_ASYNC_H_INCLUDED 1
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <limits>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include <dinit-client.h>
+
+// Asynchronous (non-blocking) client interface to the dinit control protocol.
+//
+// The functions in dinit-client.h send a request and then block until the reply has been read. A
+// dinit_async_conn instead queues requests, and reports replies (and information packets) via
+// handlers as they arrive, so that it can be driven from an existing event loop and so that
+// several requests can be outstanding at once ("pipelined"). Dinit processes the requests on a
+// connection in order, and so replies are matched to requests in order.
+//
+// The connection socket (get_fd()) should be set non-blocking. The event loop should:
+//  - watch the socket for input, and call read_ready() when it is readable;
+//  - while wants_write() returns true, also watch the socket for output, and call write_ready()
+//    when it is writable.
+//
+// Handlers may queue further requests, but must not destroy the connection object.
+
+// Service status, as contained in a SERVICESTATUS reply or service event information packet.
+struct dinit_service_status
+{
+    service_state_t state = service_state_t::STOPPED;
+    service_state_t target_state = service_state_t::STOPPED;
+    bool waiting_for_console = false;
+    bool has_console = false;
+    bool was_skipped = false;
+    bool marked_active = false;
+    stopped_reason_t stop_reason = stopped_reason_t::NORMAL;
+    pid_t pid = -1;            // process ID, or -1 if no process
+    // If there is no process: for stop reason EXECFAILED, exec_stage and (in exit_si_code) errno
+    // of the failure; otherwise, the exit status as exit_si_code and exit_si_status (protocol
+    // version 5+), or as a status in exit_si_code (0 for clean exit, -1 otherwise):
+    uint16_t exec_stage = 0;
+    int exit_si_code = 0;
+    int exit_si_status = 0;
+};
+
+// Decode a status buffer, of STATUS_BUFFER5_SIZE bytes (if v5) or STATUS_BUFFER_SIZE bytes.
+void decode_service_status(const char *buf, bool v5, dinit_service_status &status) noexcept;
+
+// Determine the length of a reply packet of one of the common formats (which includes all
+// single-byte replies, CPVERSION, SERVICERECORD and DEPENDENTS) given the data received so far.
+// Returns 0 if more data is needed.
+//   throws: dinit_protocol_error if the reply type is unknown
+size_t dinit_reply_length(const char *data, size_t len);
+
+// Handler for the reply (or replies) to a request.
+class dinit_reply_handler
+{
+    public:
+    // Get the length of the reply packet from its initial portion (at least one byte). Return 0 if
+    // more data is needed to determine the length.
+    //   throws: dinit_protocol_error if the reply is not valid for the request
+    virtual size_t reply_length(const char *data, size_t len)
+    {
+        return dinit_reply_length(data, len);
+    }
+
+    // Process a complete reply packet. Return true if the request is complete, or false if another
+    // reply packet follows (i.e. after a PREACK).
+    virtual bool reply(const char *data, size_t len) = 0;
+
+    virtual ~dinit_reply_handler() noexcept
+    {
+    }
+};
+
+// Handler for information packets, which may arrive at any time.
+class dinit_info_handler
+{
+    public:
+    // An event for a service for which the connection holds a handle
+    virtual void service_event(dinit_cptypes::handle_t handle, service_event_t event,
+            const dinit_service_status &status)
+    {
+    }
+
+    // A change to the activation environment (after a LISTENENV request), in "NAME=value" form (or
+    // "NAME" if unset); overridden is true if a previous value was replaced
+    virtual void env_event(const char *var_and_val, bool overridden)
+    {
+    }
+
+    // Any other information packet (the complete packet including header)
+    virtual void info_packet(const char *data, size_t len)
+    {
+    }
+
+    virtual ~dinit_info_handler() noexcept
+    {
+    }
+};
+
+class dinit_async_conn
+{
+    int fd;
+    dinit_info_handler *info_handler = nullptr;
+
+    std::vector<char> outbuf;
+    size_t out_pos = 0;
+    std::vector<char> inbuf;
+    size_t in_pos = 0;
+
+    std::deque<std::unique_ptr<dinit_reply_handler>> pending;
+
+    uint16_t proto_version = 0; // as reported in CPVERSION reply (0 if not yet known)
+    bool seen_event5 = false;   // SERVICEEVENT5 received (SERVICEEVENT duplicates are ignored)
+
+    void process_info(const char *data, size_t len);
+
+    // Process complete packets in the input buffer
+    void process_input();
+
+    // Reply handler invoking a function with the (single) reply packet
+    template <typename F> class fn_reply_handler : public dinit_reply_handler
+    {
+        F func;
+
+        public:
+        explicit fn_reply_handler(F &&f) : func(std::move(f)) { }
+
+        bool reply(const char *data, size_t len) override
+        {
+            func(data, len);
+            return true;
+        }
+    };
+
+    template <typename F> void queue_fn(const char *data, size_t len, F &&f)
+    {
+        send_request(data, len,
+                std::unique_ptr<dinit_reply_handler>(new fn_reply_handler<F>(std::move(f))));
+    }
+
+    public:
+    explicit dinit_async_conn(int fd_p) noexcept : fd(fd_p)
+    {
+    }
+
+    dinit_async_conn(const dinit_async_conn &) = delete;
+    void operator=(const dinit_async_conn &) = delete;
+
+    int get_fd() const noexcept
+    {
+        return fd;
+    }
+
+    // Whether there is queued request data not yet written to the socket
+    bool wants_write() const noexcept
+    {
+        return out_pos < outbuf.size();
+    }
+
+    // The number of requests for which a reply has not (yet fully) been received
+    size_t pending_requests() const noexcept
+    {
+        return pending.size();
+    }
+
+    // The protocol version of the daemon, as reported in reply to query_version() (0 if unknown)
+    uint16_t get_protocol_version() const noexcept
+    {
+        return proto_version;
+    }
+
+    void set_info_handler(dinit_info_handler *handler) noexcept
+    {
+        info_handler = handler;
+    }
+
+    // Queue a request (the complete packet) for sending. The handler will be notified of the reply.
+    //   throws: std::bad_alloc
+    void send_request(const char *data, size_t len, std::unique_ptr<dinit_reply_handler> handler);
+
+    // Write queued request data, as much as the socket will accept.
+    //   throws: cp_write_exception on error
+    void write_ready();
+
+    // Read available data, and process replies and information packets. If the connection has been
+    // closed (or a read error occurs), complete packets already received are processed first.
+    //   throws: cp_read_exception on error, or with errcode 0 if the connection was closed;
+    //           dinit_protocol_error if an invalid or unexpected packet is received;
+    //           any exception thrown by a handler
+    void read_ready();
+
+    // Convenience functions for common requests. Each queues the request and arranges for the
+    // given function to be called with the decoded reply.
+
+    // Query the protocol version:  func(uint16_t min_version, uint16_t version)
+    template <typename F> void query_version(F func)
+    {
+        char buf[1] = { (char)cp_cmd::QUERYVERSION };
+        queue_fn(buf, 1, [this,func](const char *data, size_t len) mutable {
+            if (data[0] != (char)cp_rply::CPVERSION) throw dinit_protocol_error();
+            uint16_t min_version, version;
+            memcpy(&min_version, data + 1, sizeof(min_version));
+            memcpy(&version, data + 3, sizeof(version));
+            proto_version = version;
+            func(min_version, version);
+        });
+    }
+
+    // Find or load a service:
+    //     func(cp_rply reply, handle_t handle, service_state_t state, service_state_t target_state)
+    // (reply is SERVICERECORD on success, in which case the other arguments are valid)
+    //   throws: std::bad_alloc, dinit_protocol_error if the name is too long
+    template <typename F> void load_service(const char *name, bool find_only, F func)
+    {
+        size_t name_len = strlen(name);
+        if (name_len > std::numeric_limits<dinit_cptypes::srvname_len_t>::max()) {
+            throw dinit_protocol_error();
+        }
+        dinit_cptypes::srvname_len_t srvname_len = name_len;
+        std::vector<char> buf(1 + sizeof(srvname_len) + name_len);
+        buf[0] = (char)(find_only ? cp_cmd::FINDSERVICE : cp_cmd::LOADSERVICE);
+        memcpy(buf.data() + 1, &srvname_len, sizeof(srvname_len));
+        memcpy(buf.data() + 1 + sizeof(srvname_len), name, name_len);
+
+        queue_fn(buf.data(), buf.size(), [func](const char *data, size_t len) mutable {
+            dinit_cptypes::handle_t handle = 0;
+            service_state_t state = service_state_t::STOPPED;
+            service_state_t target_state = service_state_t::STOPPED;
+            if (data[0] == (char)cp_rply::SERVICERECORD) {
+                state = (service_state_t)data[1];
+                memcpy(&handle, data + 2, sizeof(handle));
+                target_state = (service_state_t)data[2 + sizeof(handle)];
+            }
+            func((cp_rply)data[0], handle, state, target_state);
+        });
+    }
+
+    // Issue a start/stop/wake/release/restart command (cmd is one of STARTSERVICE, STOPSERVICE,
+    // WAKESERVICE, RELEASESERVICE) for a service:  func(cp_rply reply)
+    // The flags are as per the control protocol; if PREACK was requested (flag bit 7), it is
+    // consumed here, and only the final reply is reported. For a DEPENDENTS reply, the list of
+    // dependents is not reported.
+    template <typename F> void start_stop(cp_cmd cmd, dinit_cptypes::handle_t handle, uint8_t flags,
+            F func)
+    {
+        class start_stop_handler : public dinit_reply_handler
+        {
+            F func;
+            bool preack_pending;
+
+            public:
+            start_stop_handler(F &&f, bool preack) : func(std::move(f)), preack_pending(preack) { }
+
+            bool reply(const char *data, size_t len) override
+            {
+                if (preack_pending && data[0] == (char)cp_rply::PREACK) {
+                    preack_pending = false;
+                    return false;
+                }
+                func((cp_rply)data[0]);
+                return true;
+            }
+        };
+
+        char buf[2 + sizeof(handle)];
+        buf[0] = (char)cmd;
+        buf[1] = (char)flags;
+        memcpy(buf + 2, &handle, sizeof(handle));
+        send_request(buf, sizeof(buf), std::unique_ptr<dinit_reply_handler>(
+                new start_stop_handler(std::move(func), (flags & 128) != 0)));
+    }
+
+    // Query service status:  func(cp_rply reply, const dinit_service_status &status)
+    // (reply is SERVICESTATUS on success, in which case status is valid). The full status is
+    // retrieved if the protocol version is known (via query_version()) to be 5 or greater.
+    template <typename F> void service_status(dinit_cptypes::handle_t handle, F func)
+    {
+        class status_handler : public dinit_reply_handler
+        {
+            F func;
+            bool v5;
+
+            public:
+            status_handler(F &&f, bool v5_p) : func(std::move(f)), v5(v5_p) { }
+
+            size_t reply_length(const char *data, size_t len) override
+            {
+                if (data[0] == (char)cp_rply::SERVICESTATUS) {
+                    return 2 + (v5 ? STATUS_BUFFER5_SIZE : STATUS_BUFFER_SIZE);
+                }
+                return dinit_reply_length(data, len);
+            }
+
+            bool reply(const char *data, size_t len) override
+            {
+                dinit_service_status status;
+                if (data[0] == (char)cp_rply::SERVICESTATUS) {
+                    decode_service_status(data + 2, v5, status);
+                }
+                func((cp_rply)data[0], status);
+                return true;
+            }
+        };
+
+        bool v5 = proto_version >= 5;
+        char buf[1 + sizeof(handle)];
+        buf[0] = (char)(v5 ? cp_cmd::SERVICESTATUS5 : cp_cmd::SERVICESTATUS);
+        memcpy(buf + 1, &handle, sizeof(handle));
+        send_request(buf, sizeof(buf), std::unique_ptr<dinit_reply_handler>(
+                new status_handler(std::move(func), v5)));
+    }
+
+    // Close a service handle:  func(cp_rply reply)
+    template <typename F> void close_handle(dinit_cptypes::handle_t handle, F func)
+    {
+        char buf[1 + sizeof(handle)];
+        buf[0] = (char)cp_cmd::CLOSEHANDLE;
+        memcpy(buf + 1, &handle, sizeof(handle));
+        queue_fn(buf, sizeof(buf), [func](const char *data, size_t len) mutable {
+            func((cp_rply)data[0]);
+        });
+    }
+};
+
+#endif
@@ -89,6 +89,8 @@ struct observed_states_t
 constexpr static unsigned STATUS_BUFFER_SIZE = 6 + ((sizeof(pid_t) > sizeof(int)) ? sizeof(pid_t) : sizeof(int));
 constexpr static unsigned STATUS_BUFFER5_SIZE = 6 + 2 * sizeof(int);
 constexpr static unsigned STATUS_BUFFER6_SIZE = 6 + 2 * sizeof(int) + sizeof(struct timespec);
+// (SERVICESTATUS8: as above, plus 8 byte restart delay in nanoseconds, 4 byte backoff count)
+constexpr static unsigned STATUS_BUFFER8_SIZE = STATUS_BUFFER6_SIZE + 8 + 4;
 
 // static_membuf: a buffer of a fixed size (N) with one additional value (of type T). Don't use this
 // directly, construct via membuf.
@@ -213,7 +215,11 @@ inline void wait_for_reply(cpbuffer_t &rbuffer, int fd)
     }
 }
 
-inline void wait_for_reply(cpbuffer_t &rbuffer, int fd, dinit_cptypes::handle_t handle, observed_states_t *seen_states)
+// Wait for a reply packet, recording service events received in the meantime. For each service event,
+// find_states(handle) is called and should return the observed_states_t to update for that handle, or
+// nullptr if the service is not of interest.
+template <typename F>
+inline void wait_for_reply_states(cpbuffer_t &rbuffer, int fd, F find_states)
 {
     fill_buffer_to(rbuffer, fd, 1);
 
@@ -226,8 +232,7 @@ inline void wait_for_reply(cpbuffer_t &rbuffer, int fd, dinit_cptypes::handle_t
         rbuffer.consume(1);  // Consume one byte so we'll read one byte of the next packet
         fill_buffer_to(rbuffer, fd, pktlen);
 
-        if (value(pkt_type).is_in(cp_info::SERVICEEVENT, cp_info::SERVICEEVENT5)
-                && seen_states != nullptr) {
+        if (value(pkt_type).is_in(cp_info::SERVICEEVENT, cp_info::SERVICEEVENT5)) {
 
             // earlier versions do not include status info, the size in that case is
             // base_pkt_size:
@@ -242,7 +247,8 @@ inline void wait_for_reply(cpbuffer_t &rbuffer, int fd, dinit_cptypes::handle_t
             rbuffer.extract((char *)&ev_handle, 1, sizeof(ev_handle));
             service_event_t event = static_cast<service_event_t>(rbuffer[1 + sizeof(ev_handle)]);
 
-            if (ev_handle == handle) {
+            observed_states_t *seen_states = find_states(ev_handle);
+            if (seen_states != nullptr) {
                 if (event == service_event_t::STOPPED) {
                     seen_states->stopped = true;
                 }
@@ -281,6 +287,13 @@ inline void wait_for_reply(cpbuffer_t &rbuffer, int fd, dinit_cptypes::handle_t
     }
 }
 
+inline void wait_for_reply(cpbuffer_t &rbuffer, int fd, dinit_cptypes::handle_t handle, observed_states_t *seen_states)
+{
+    wait_for_reply_states(rbuffer, fd, [=](dinit_cptypes::handle_t ev_handle) {
+        return (ev_handle == handle) ? seen_states : nullptr;
+    });
+}
+
 // Wait for an info packet. If any other reply packet comes, throw a cp_read_exception.
 inline void wait_for_info(cpbuffer_t &rbuffer, int fd)
 {
@@ -103,6 +103,16 @@ class environment
 
     std::unordered_set<env_listener *> listeners;
 
+    template <typename S> static size_t set_heap_usage(const S &vars) noexcept
+    {
+        constexpr size_t node_size = sizeof(std::string) + 2 * sizeof(void *);
+        size_t usage = vars.bucket_count() * sizeof(std::list<std::string>);
+        for (const std::string &var : vars) {
+            usage += node_size + heap_size_of(var);
+        }
+        return usage;
+    }
+
     string_view find_var_name(string_view var)
     {
         const char *var_ch;
@@ -144,6 +154,31 @@ public:
             }
             return nullptr;
         }
+
+        // Set (or replace) a variable in the mapping. The mapping is non-owning: the given NAME=VALUE
+        // string must outlive the mapping. Only the value part of the string may subsequently be
+        // modified.
+        // Throws: std::bad_alloc
+        void set_var(const char *name_and_val)
+        {
+            const char *var_ch;
+            for (var_ch = name_and_val; *var_ch != '='; ++var_ch) {
+                if (*var_ch == '\0') break;
+            }
+            string_view name_view {name_and_val, (size_t)(var_ch - name_and_val)};
+
+            auto it = var_map.find(name_view);
+            if (it != var_map.end()) {
+                env_list[it->second] = name_and_val;
+            }
+            else {
+                // replace the terminating null entry, and add a new one:
+                env_list.push_back(nullptr);
+                unsigned pos = env_list.size() - 2;
+                var_map.insert({name_view, pos});
+                env_list[pos] = name_and_val;
+            }
+        }
     };
 
     // return environment variable in form NAME=VALUE. Assumes that the real environment is the parent.
@@ -362,6 +397,14 @@ public:
     {
         listeners.erase(listener);
     }
+
+    // Get an (approximate) count of the heap memory used by this environment: the variable sets
+    // (bucket arrays, list nodes and string contents). Listeners are not counted.
+    size_t get_heap_usage() const noexcept
+    {
+        return set_heap_usage(set_vars) + set_heap_usage(import_from_parent)
+                + set_heap_usage(undefine);
+    }
 };
 
 // Read and set environment variables (encapsulated in an 'environment' object) from a file.
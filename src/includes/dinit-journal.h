@@ -0,0 +1,225 @@
+#ifndef DINIT_JOURNAL_H
+#define DINIT_JOURNAL_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// Dinit boot journal: a fixed-size file, memory-mapped by dinit, which holds a ring of binary log
+// records. Records are written directly into the mapping, so they are not delayed by (and do not
+// depend on) the main log being available, and they persist across a soft reboot (and, if the
+// file is on a persistent filesystem, across a crash or reboot).
+//
+// The file consists of a header (journal_file_hdr, padded to journal_hdr_size bytes) followed by
+// the data area. Each record in the data area begins at an offset aligned to journal_rec_align
+// and consists of a record header (journal_rec_hdr), the service name (if any) and the message
+// text. Records are written sequentially, wrapping to the start of the data area when the end is
+// reached, and overwriting the oldest records.
+//
+// A record is valid only if it has the record magic number and a correct checksum (FNV-1a over
+// the record, with the checksum field zeroed). The magic number is written last, after the
+// position has been invalidated, so that a partially-written record is never seen as valid. To
+// read the journal, the data area is scanned for valid records which are then ordered by their
+// sequence number; no other state needs to be maintained.
+
+constexpr char journal_magic[8] = { 'D', 'I', 'N', 'I', 'T', 'J', 'N', 'L' };
+constexpr uint32_t journal_version = 1;
+constexpr uint32_t journal_rec_magic = 0x4c4e4a44; // "DJNL" (little-endian)
+
+constexpr size_t journal_hdr_size = 64;
+constexpr size_t journal_rec_align = 8;
+
+// Default and minimum size of the journal file:
+constexpr size_t journal_default_size = 1024 * 1024;
+constexpr size_t journal_min_size = 64 * 1024;
+
+enum class journal_rec_type : uint8_t {
+    MESSAGE = 0,        // log message
+    DINIT_START = 1,    // dinit started (or re-started via soft reboot)
+    SERVICE_STARTED = 2,
+    SERVICE_FAILED = 3,
+    SERVICE_STOPPED = 4,
+};
+
+struct journal_file_hdr
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t hdr_size;  // size of header (offset of data area)
+    uint64_t size;      // total size of file
+};
+
+struct journal_rec_hdr
+{
+    uint32_t magic;     // journal_rec_magic
+    uint32_t length;    // length of record, including header (excluding alignment padding)
+    uint64_t seq;       // sequence number, increasing across all records
+    uint64_t timestamp; // wall-clock time, nanoseconds since the epoch
+    uint32_t checksum;
+    uint8_t type;       // journal_rec_type
+    uint8_t level;      // log level (loglevel_t)
+    uint16_t name_len;  // length of service name (0 if none)
+};
+
+static_assert(sizeof(journal_file_hdr) <= journal_hdr_size, "journal file header too large");
+static_assert(sizeof(journal_rec_hdr) == 32, "journal record header has unexpected padding");
+
+// Compute (or continue computing) an FNV-1a checksum
+inline uint32_t journal_checksum(const char *data, size_t len, uint32_t hash = 2166136261u) noexcept
+{
+    for (size_t i = 0; i < len; ++i) {
+        hash ^= (unsigned char)data[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// The space occupied by a record of the given length (including alignment padding)
+inline size_t journal_rec_span(size_t length) noexcept
+{
+    return (length + journal_rec_align - 1) & ~(journal_rec_align - 1);
+}
+
+// Scan a journal data area for valid records, calling
+//     func(offset, const journal_rec_hdr &hdr, const char *name, const char *text, size_t text_len)
+// for each, in order of position (which is not necessarily the order of sequence).
+template <typename F> void journal_scan(const char *data, size_t size, F func)
+{
+    size_t offset = 0;
+    while (offset + sizeof(journal_rec_hdr) <= size) {
+        journal_rec_hdr hdr;
+        memcpy(&hdr, data + offset, sizeof(hdr));
+        if (hdr.magic == journal_rec_magic && hdr.length >= sizeof(hdr) && hdr.length <= size - offset
+                && hdr.name_len <= hdr.length - sizeof(hdr)) {
+            uint32_t checksum = hdr.checksum;
+            hdr.checksum = 0;
+            uint32_t hash = journal_checksum((const char *)&hdr, sizeof(hdr));
+            const char *payload = data + offset + sizeof(hdr);
+            hash = journal_checksum(payload, hdr.length - sizeof(hdr), hash);
+            if (hash == checksum) {
+                hdr.checksum = checksum;
+                func(offset, hdr, payload, payload + hdr.name_len,
+                        hdr.length - sizeof(hdr) - hdr.name_len);
+                offset += journal_rec_span(hdr.length);
+                continue;
+            }
+        }
+        offset += journal_rec_align;
+    }
+}
+
+// Writes records to a journal data area. A record is composed via begin(), any number of append()
+// calls, and commit(); it is written to the data area only on commit.
+class journal_writer
+{
+    public:
+    // Maximum size of a record (longer text is truncated):
+    static constexpr size_t max_rec_size = 2048;
+
+    private:
+    char *data = nullptr;
+    size_t data_size = 0;
+    size_t write_pos = 0;
+    uint64_t next_seq = 1;
+
+    bool composing = false;
+    size_t rec_len = 0;
+    char rec_buf[max_rec_size];
+
+    public:
+    // Attach to a data area (whose size must be a multiple of journal_rec_align). Existing records
+    // are retained; new records will follow the most recent.
+    void attach(char *data_area, size_t size) noexcept
+    {
+        data = data_area;
+        data_size = size;
+        write_pos = 0;
+        next_seq = 1;
+        journal_scan(data, size, [&](size_t offset, const journal_rec_hdr &hdr, const char *,
+                const char *, size_t) {
+            if (hdr.seq >= next_seq) {
+                next_seq = hdr.seq + 1;
+                write_pos = offset + journal_rec_span(hdr.length);
+            }
+        });
+        if (write_pos >= data_size) write_pos = 0;
+    }
+
+    void detach() noexcept
+    {
+        data = nullptr;
+        composing = false;
+    }
+
+    bool is_attached() const noexcept
+    {
+        return data != nullptr;
+    }
+
+    // Begin composing a record. Returns false if not attached.
+    bool begin(journal_rec_type type, uint8_t level, const char *name, size_t name_len) noexcept
+    {
+        if (data == nullptr) return false;
+        if (name_len > max_rec_size / 2) name_len = max_rec_size / 2;
+
+        journal_rec_hdr hdr = {};
+        hdr.type = (uint8_t)type;
+        hdr.level = level;
+        hdr.name_len = (uint16_t)name_len;
+        memcpy(rec_buf, &hdr, sizeof(hdr));
+        if (name_len != 0) {
+            memcpy(rec_buf + sizeof(hdr), name, name_len);
+        }
+        rec_len = sizeof(hdr) + name_len;
+        composing = true;
+        return true;
+    }
+
+    // Append text to the record being composed (truncating if the record is too long).
+    void append(const char *s, size_t len) noexcept
+    {
+        if (!composing) return;
+        if (len > max_rec_size - rec_len) len = max_rec_size - rec_len;
+        memcpy(rec_buf + rec_len, s, len);
+        rec_len += len;
+    }
+
+    // Write the record being composed, with the given timestamp.
+    void commit(uint64_t timestamp) noexcept
+    {
+        if (!composing) return;
+        composing = false;
+
+        size_t span = journal_rec_span(rec_len);
+        if (span > data_size) return;
+        if (write_pos + span > data_size) write_pos = 0;
+
+        journal_rec_hdr hdr;
+        memcpy(&hdr, rec_buf, sizeof(hdr));
+        hdr.magic = journal_rec_magic;
+        hdr.length = (uint32_t)rec_len;
+        hdr.seq = next_seq++;
+        hdr.timestamp = timestamp;
+        hdr.checksum = 0;
+        memcpy(rec_buf, &hdr, sizeof(hdr));
+        memset(rec_buf + rec_len, 0, span - rec_len);
+        hdr.checksum = journal_checksum(rec_buf, rec_len);
+        memcpy(rec_buf, &hdr, sizeof(hdr));
+
+        // Invalidate the record (if any) at the write position, write everything but the magic
+        // number, and finally the magic number:
+        char *dest = data + write_pos;
+        uint32_t no_magic = 0;
+        memcpy(dest, &no_magic, sizeof(no_magic));
+        std::atomic_signal_fence(std::memory_order_seq_cst);
+        memcpy(dest + sizeof(no_magic), rec_buf + sizeof(no_magic), span - sizeof(no_magic));
+        std::atomic_signal_fence(std::memory_order_seq_cst);
+        memcpy(dest, &hdr.magic, sizeof(hdr.magic));
+
+        write_pos += span;
+        if (write_pos >= data_size) write_pos = 0;
+    }
+};
+
+#endif
@@ -1,6 +1,9 @@
 #ifndef DINIT_LL_INCLUDED
 #define DINIT_LL_INCLUDED 1
 
+#include <cstddef>
+#include <iterator>
+
 // Simple single- and doubly-linked list implementation, where the contained element includes the
 // list node. This allows a single item to be a member of several different kinds of list, without
 // requiring dynamic allocation of nodes for the different lists.
@@ -34,8 +37,66 @@ class dlist
     // E extractor;
 
     public:
+    // Iterator over the elements of the list (dereferences to a pointer to the element). Unlinking
+    // an element does not invalidate iterators referring to other elements.
+    class iterator
+    {
+        dlist *list;
+        T *current;  // nullptr at end
+
+        public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = T *;
+        using difference_type = std::ptrdiff_t;
+        using pointer = T **;
+        using reference = T *;
+
+        iterator(dlist *list_p, T *current_p) noexcept : list(list_p), current(current_p) { }
+
+        T *operator*() const noexcept
+        {
+            return current;
+        }
+
+        iterator &operator++() noexcept
+        {
+            current = list->next_of(current);
+            return *this;
+        }
+
+        iterator operator++(int) noexcept
+        {
+            iterator r = *this;
+            current = list->next_of(current);
+            return r;
+        }
+
+        bool operator==(const iterator &other) const noexcept
+        {
+            return current == other.current;
+        }
+
+        bool operator!=(const iterator &other) const noexcept
+        {
+            return current != other.current;
+        }
+    };
+
     dlist() noexcept : first(nullptr) { }
 
+    dlist(const dlist &) = delete;
+    void operator=(const dlist &) = delete;
+
+    iterator begin() noexcept
+    {
+        return iterator(this, first);
+    }
+
+    iterator end() noexcept
+    {
+        return iterator(this, nullptr);
+    }
+
     bool is_queued(T *e) noexcept
     {
         auto &node = E(e);
@@ -58,6 +119,32 @@ class dlist
         }
     }
 
+    // Insert an element before another element which is already in the list.
+    void insert_before(T *e, T *before) noexcept
+    {
+        auto &node = E(e);
+        auto &before_node = E(before);
+        node.next = before;
+        node.prev = before_node.prev;
+        E(before_node.prev).next = e;
+        before_node.prev = e;
+        if (first == before) {
+            first = e;
+        }
+    }
+
+    // Get the element following the given element (nullptr if it is the last).
+    T * next_of(T *e) noexcept
+    {
+        T *next = E(e).next;
+        return (next == first) ? nullptr : next;
+    }
+
+    T * front() noexcept
+    {
+        return first;
+    }
+
     T * tail() noexcept
     {
         if (first == nullptr) {
@@ -68,11 +155,37 @@ class dlist
         }
     }
 
-    bool is_empty() noexcept
+    bool is_empty() const noexcept
     {
         return first == nullptr;
     }
 
+    // Insert an element at the front of the list.
+    void prepend(T *e) noexcept
+    {
+        if (first == nullptr) {
+            append(e);
+        }
+        else {
+            insert_before(e, first);
+        }
+    }
+
+    // Move all elements of another list to this list, before the given element (or, if nullptr,
+    // to the end), preserving their order.
+    void splice_before(dlist &other, T *before) noexcept
+    {
+        while (!other.is_empty()) {
+            T *e = other.pop_front();
+            if (before == nullptr) {
+                append(e);
+            }
+            else {
+                insert_before(e, before);
+            }
+        }
+    }
+
     T * pop_front() noexcept
     {
         auto r = first;
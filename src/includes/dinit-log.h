@@ -12,20 +12,23 @@
 // level of the log mechanisms).
 //
 // We have two separate log "streams": one for the console/stdout, one for the syslog facility (or log
-// file). Both have a circular buffer. Log messages are appended to the circular buffer (for a syslog
-// stream, the messages are prepended with a syslog priority indicator). Both streams start out inactive
-// (release = true in buffered_log_stream), which means they will buffer messages but not write them.
+// file). Both have a message buffer (a log_arena, see log-arena.h). Log messages are appended to the
+// buffer (for a syslog stream, the messages are prepended with a syslog priority indicator). Both streams
+// start out inactive (release = true in buffered_log_stream), which means they will buffer messages but
+// not write them.
 //
 // Service start/stop messages for the console stream are formatted differently, with a "visual" flavour.
 // The console stream is treated as informational and in some circumstances messages will be discarded
 // from its buffer with no warning.
 //
-// If a stream buffer becomes full mid-message, the message is discarded and we mark the stream as "message
-// discarded". Once the message at the front of the buffer has been fully output we check for the mark and
-// if set, issue a message informing that log messages have been discarded, before resuming regular output
-// from the buffer. (Because the buffer is full, we can't store the "message discarded" message in it; we
-// temporarily switch to a "special buffer" which just contains the "message discarded" text. Current the
-// special buffer mechanism is used only for this purpose).
+// A stream buffer grows as needed, up to a limit (see set_log_buffer_max). If it becomes full, buffered
+// messages of lower priority (log level) than a new message are evicted to make room for it; if that's
+// not possible the new message is discarded. Discarded messages are counted (see get_log_stats). Once
+// the message at the front of the buffer has been fully output we check for any discards since the last
+// check and, if there were any, issue a message informing that log messages have been discarded, before
+// resuming regular output from the buffer. (Because the buffer is full, we can't store the "message
+// discarded" message in it; we temporarily switch to a "special buffer" which just contains the "message
+// discarded" text. Currently the special buffer mechanism is used only for this purpose).
 //
 // The console log stream needs to be able to release the console, if a service is waiting to acquire it.
 // This is accomplished by calling flush_for_release() which then completes the output of the current
@@ -55,6 +58,21 @@ constexpr static int DLOG_CONS = 1; // console
 
 constexpr static int DLOG_NUM = 2;
 
+// Number of log levels at which messages can be logged (DEBUG to ERROR)
+constexpr static int DLOG_NUM_LEVELS = 4;
+
+// Default maximum size of the buffer for each log stream
+constexpr static size_t DEFAULT_LOG_BUFFER_MAX = 64 * 1024;
+
+// Statistics for a log stream buffer
+struct log_stats_t
+{
+    size_t buffered;        // bytes currently buffered
+    size_t capacity;        // current size of buffer
+    size_t max_capacity;    // maximum size of buffer
+    unsigned long discarded[DLOG_NUM_LEVELS]; // number of messages discarded, by log level (DEBUG to ERROR)
+};
+
 // These are defined in dinit-log.cc:
 extern loglevel_t log_level[2];
 extern bool console_service_status;  // show service status messages to console?
@@ -67,6 +85,19 @@ void setup_main_log(int fd);
 bool is_log_flushed() noexcept;
 void discard_console_log_buffer() noexcept;
 
+// Set the maximum size that each log stream buffer may grow to
+void set_log_buffer_max(size_t max_size) noexcept;
+
+// Get statistics for a log stream (DLOG_MAIN or DLOG_CONS)
+void get_log_stats(int idx, log_stats_t &stats) noexcept;
+
+// Open (creating or re-initialising if necessary) the boot journal file, of the given size, and
+// begin recording messages and service events to it. Returns false (with errno set) on failure.
+bool open_journal(const char *path, size_t size) noexcept;
+
+// Flush the boot journal contents to the underlying file.
+void sync_journal() noexcept;
+
 // Log a simple string:
 void log(loglevel_t lvl, const char *msg) noexcept;
 // Log a simple string, optionally without logging to console:
@@ -38,6 +38,11 @@ constexpr auto str_logfile_uid = cts::literal("logfile-uid");
 constexpr auto str_logfile_gid = cts::literal("logfile-gid");
 constexpr auto str_log_type = cts::literal("log-type");
 constexpr auto str_log_buffer_size = cts::literal("log-buffer-size");
+constexpr auto str_log_buffer_overflow = cts::literal("log-buffer-overflow");
+constexpr auto str_logfile_rotate_size = cts::literal("logfile-rotate-size");
+constexpr auto str_logfile_rotate_count = cts::literal("logfile-rotate-count");
+constexpr auto str_logfile_compress = cts::literal("logfile-compress");
+constexpr auto str_logfile_compress_suffix = cts::literal("logfile-compress-suffix");
 constexpr auto str_consumer_of = cts::literal("consumer-of");
 constexpr auto str_restart = cts::literal("restart");
 constexpr auto str_smooth_recovery = cts::literal("smooth-recovery");
@@ -47,6 +52,8 @@ constexpr auto str_term_signal = cts::literal("term-signal");
 constexpr auto str_termsignal = cts::literal("termsignal"); // (deprecated)
 constexpr auto str_restart_limit_interval = cts::literal("restart-limit-interval");
 constexpr auto str_restart_delay = cts::literal("restart-delay");
+constexpr auto str_restart_delay_max = cts::literal("restart-delay-max");
+constexpr auto str_restart_delay_jitter = cts::literal("restart-delay-jitter");
 constexpr auto str_restart_limit_count = cts::literal("restart-limit-count");
 constexpr auto str_stop_timeout = cts::literal("stop-timeout");
 constexpr auto str_start_timeout = cts::literal("start-timeout");
@@ -60,9 +67,13 @@ constexpr auto str_rlimit_core = cts::literal("rlimit-core");
 constexpr auto str_rlimit_data = cts::literal("rlimit-data");
 constexpr auto str_rlimit_addrspace = cts::literal("rlimit-addrspace");
 constexpr auto str_nice = cts::literal("nice");
+constexpr auto str_start_priority = cts::literal("start-priority");
 
 #if SUPPORT_CGROUPS
 constexpr auto str_run_in_cgroup = cts::literal("run-in-cgroup");
+constexpr auto str_cgroup_memory_max = cts::literal("cgroup-memory-max");
+constexpr auto str_cgroup_cpu_weight = cts::literal("cgroup-cpu-weight");
+constexpr auto str_cgroup_io_weight = cts::literal("cgroup-io-weight");
 #endif
 
 #if SUPPORT_CAPABILITIES
@@ -86,15 +97,20 @@ enum class setting_id_t {
     TYPE, COMMAND, WORKING_DIR, ENV_FILE, SOCKET_LISTEN, SOCKET_PERMISSIONS, SOCKET_UID,
     SOCKET_GID, STOP_COMMAND, PID_FILE, DEPENDS_ON, DEPENDS_MS, WAITS_FOR, WAITS_FOR_D,
     DEPENDS_ON_D, DEPENDS_MS_D, AFTER, BEFORE, PREPARED_BY, LOGFILE, LOGFILE_PERMISSIONS,
-    LOGFILE_UID, LOGFILE_GID, LOG_TYPE, LOG_BUFFER_SIZE, CONSUMER_OF, RESTART, SMOOTH_RECOVERY,
-    OPTIONS, LOAD_OPTIONS, TERM_SIGNAL, TERMSIGNAL /* deprecated */, RESTART_LIMIT_INTERVAL,
-    RESTART_DELAY, RESTART_LIMIT_COUNT, STOP_TIMEOUT, START_TIMEOUT, RUN_AS, CHAIN_TO,
-    READY_NOTIFICATION, INITTAB_ID, INITTAB_LINE, NICE,
+    LOGFILE_UID, LOGFILE_GID, LOG_TYPE, LOG_BUFFER_SIZE, LOG_BUFFER_OVERFLOW, LOGFILE_ROTATE_SIZE,
+    LOGFILE_ROTATE_COUNT, LOGFILE_COMPRESS, LOGFILE_COMPRESS_SUFFIX, CONSUMER_OF, RESTART,
+    SMOOTH_RECOVERY, OPTIONS, LOAD_OPTIONS, TERM_SIGNAL, TERMSIGNAL /* deprecated */,
+    RESTART_LIMIT_INTERVAL, RESTART_DELAY, RESTART_DELAY_MAX, RESTART_DELAY_JITTER, RESTART_LIMIT_COUNT,
+    STOP_TIMEOUT, START_TIMEOUT, RUN_AS, CHAIN_TO,
+    READY_NOTIFICATION, INITTAB_ID, INITTAB_LINE, NICE, START_PRIORITY,
     // Prefixed with SETTING_ to avoid name collision with system macros:
     SETTING_RLIMIT_NOFILE, SETTING_RLIMIT_CORE, SETTING_RLIMIT_DATA, SETTING_RLIMIT_ADDRSPACE,
     // Possibly unsupported depending on platform/build options:
 #if SUPPORT_CGROUPS
     RUN_IN_CGROUP,
+    CGROUP_MEMORY_MAX,
+    CGROUP_CPU_WEIGHT,
+    CGROUP_IO_WEIGHT,
 #endif
 #if SUPPORT_CAPABILITIES
     CAPABILITIES,
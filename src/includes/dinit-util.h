@@ -13,6 +13,7 @@
 
 #include <cstring>
 #include <cstddef>
+#include <cstdint>
 #include <cerrno>
 
 #include <sys/types.h>
@@ -563,6 +564,16 @@ inline bool starts_with(const std::string &s, const char *prefix) noexcept
     return *prefix == 0;
 }
 
+// Get the amount of heap memory used by a string: none if the string contents are held within the
+// string object itself (short string optimisation), otherwise the allocated capacity.
+inline size_t heap_size_of(const std::string &s) noexcept
+{
+    uintptr_t data = reinterpret_cast<uintptr_t>(s.data());
+    uintptr_t obj = reinterpret_cast<uintptr_t>(&s);
+    if (data >= obj && data < obj + sizeof(s)) return 0;
+    return s.capacity() + 1;
+}
+
 // Numeric maximum as constexpr (not needed in C++14 which has constexpr std::max).
 template <typename T> constexpr
 T constexpr_max(T a, T b)
@@ -1045,6 +1056,7 @@ public:
     {
         auto new_it = std::next(pos);
         buckets[pos.bucket_num].erase(pos.list_it);
+        --current_size;
         return new_it;
     }
 
@@ -1054,6 +1066,7 @@ public:
         auto it = find(value);
         if (it != end()) {
             buckets[it.bucket_num].erase(it.list_it);
+            --current_size;
             return 1;
         }
         return 0;
@@ -1070,6 +1083,11 @@ public:
         return current_size;
     }
 
+    size_type bucket_count() const noexcept
+    {
+        return buckets.size();
+    }
+
     bool empty() const noexcept
     {
         return current_size == 0;
@@ -5,8 +5,10 @@
 #include <stack>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include "dinit-iostream.h"
+#include "dinit-util.h"
 
 // A stack of input sources (open files) for a service description
 class file_input_stack
@@ -16,10 +18,12 @@ class file_input_stack
         std::string file_name;
         int line_num;
         int parent_dir_fd;
+        std::string file_path; // path of the file (only if recording file paths)
 
-        input_file(dio::istream &&stream_p, std::string &&file_name_p, int line_num_p, int parent_dir_fd_p) :
+        input_file(dio::istream &&stream_p, std::string &&file_name_p, int line_num_p, int parent_dir_fd_p,
+                std::string &&file_path_p) :
                 stream(std::move(stream_p)), file_name(std::move(file_name_p)), line_num(line_num_p),
-                parent_dir_fd(parent_dir_fd_p)
+                parent_dir_fd(parent_dir_fd_p), file_path(std::move(file_path_p))
         {}
 
         ~input_file() noexcept
@@ -30,16 +34,36 @@ class file_input_stack
 
     std::stack<input_file> input_stack;
 
+    // If set, the path of each file pushed is appended to this list
+    std::vector<std::string> *file_paths = nullptr;
+
 public:
     file_input_stack() = default;
     file_input_stack(const file_input_stack &) = delete;
 
+    // Record the path of each file subsequently pushed in the given list. The path of a file which
+    // is named relative to the file that includes it is resolved against that file's path.
+    void record_file_paths(std::vector<std::string> *paths) noexcept
+    {
+        file_paths = paths;
+    }
+
     // Push a new input file
     // TODO limit depth and/or prevent recursion
     void push(std::string file_name, dio::istream &&file, int parent_dir_fd)
     {
         try {
-            input_stack.emplace(std::move(file), std::move(file_name), 0, parent_dir_fd);
+            std::string file_path;
+            if (file_paths != nullptr) {
+                if (input_stack.empty()) {
+                    file_path = file_name;
+                }
+                else {
+                    file_path = combine_paths(parent_path(input_stack.top().file_path), file_name.c_str());
+                }
+                file_paths->push_back(file_path);
+            }
+            input_stack.emplace(std::move(file), std::move(file_name), 0, parent_dir_fd, std::move(file_path));
         }
         catch (...) {
             // we accept ownership of 'parent_dir_fd' at call:
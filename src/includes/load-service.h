@@ -68,12 +68,14 @@ struct service_flags_t
     bool always_chain : 1;      // always start chain-to service on exit
     bool kill_all_on_stop : 1;  // kill all other processes before stopping this service
     bool no_new_privs : 1;      // set PR_SET_NO_NEW_PRIVS
+    bool kill_cgroup : 1;       // on stop, kill all processes in the service cgroup and wait for it to empty
+    bool create_cgroup : 1;     // create the service cgroup (if it doesn't exist) before starting
 
     service_flags_t() noexcept : rw_ready(false), log_ready(false),
             runs_on_console(false), starts_on_console(false), shares_console(false),
             unmask_intr(false), pass_cs_fd(false), start_interruptible(false), skippable(false),
             signal_process_only(false), always_chain(false), kill_all_on_stop(false),
-            no_new_privs(false)
+            no_new_privs(false), kill_cgroup(false), create_cgroup(false)
     {
     }
 };
@@ -1653,6 +1655,12 @@ class service_settings_wrapper
     gid_t logfile_uid_gid = -1; // Primary group of logfile owner if known
     gid_t logfile_gid = -1;
     unsigned max_log_buffer_sz = 4096;
+    bool log_buffer_discard_old = false;
+    uint64_t logfile_rotate_size = 1024 * 1024;
+    unsigned logfile_rotate_count = 5;
+    ha_string logfile_compress;
+    list<pair<unsigned,unsigned>> logfile_compress_offsets;
+    string logfile_compress_suffix = ".gz";
     service_flags_t onstart_flags;
     int term_signal = SIGTERM;  // termination signal
     auto_restart_mode auto_restart = auto_restart_mode::DEFAULT_AUTO_RESTART;
@@ -1668,6 +1676,9 @@ class service_settings_wrapper
     timespec restart_interval = { .tv_sec = 10, .tv_nsec = 0 };
     int max_restarts = 3;
     timespec restart_delay = { .tv_sec = 0, .tv_nsec = 200000000 };
+    // Maximum restart delay (with backoff; 0 = no backoff), random extra delay (percent):
+    timespec restart_delay_max = { .tv_sec = 0, .tv_nsec = 0 };
+    unsigned restart_delay_jitter = 0;
     timespec stop_timeout = { .tv_sec = DEFAULT_STOP_TIMEOUT, .tv_nsec = 0 };
     timespec start_timeout = { .tv_sec = DEFAULT_START_TIMEOUT, .tv_nsec = 0 };
     std::vector<service_rlimits> rlimits;
@@ -1682,11 +1693,16 @@ class service_settings_wrapper
     bool nice_is_set = false;
     int nice;
 
+    int start_priority = 0;
+
     string chain_to_name;
     string consumer_of_name;
 
     #if SUPPORT_CGROUPS
     string run_in_cgroup;
+    uint64_t cgroup_memory_max = 0;  // memory.max for the service cgroup; 0 = not set, -1 = "max"
+    unsigned cgroup_cpu_weight = 0;  // cpu.weight for the service cgroup; 0 = not set
+    unsigned cgroup_io_weight = 0;   // io.weight for the service cgroup; 0 = not set
     #endif
 
     #if SUPPORT_CAPABILITIES
@@ -1811,6 +1827,10 @@ class service_settings_wrapper
                 report_lint("option 'nice' was specified, but ignored for the specified (or"
                         " default) service type.");
             }
+            if (start_priority != 0) {
+                report_lint("option 'start-priority' was specified, but ignored for the specified"
+                        " (or default) service type.");
+            }
             #if SUPPORT_IOPRIO
             if (ioprio >= 0) {
                 report_lint("option 'ioprio' was specified, but ignored for the specified"
@@ -1826,12 +1846,29 @@ class service_settings_wrapper
         }
 
         if (do_report_lint) {
-            if (log_type != log_type_id::LOGFILE && !logfile.empty()) {
-                report_lint("option 'logfile' was specified, but selected log type is not 'file'");
+            if (!value(log_type).is_in(log_type_id::LOGFILE, log_type_id::ROTFILE)
+                    && !logfile.empty()) {
+                report_lint("option 'logfile' was specified, but selected log type is not 'file'"
+                        " or 'rotating-file'");
             }
             if (log_type == log_type_id::LOGFILE && logfile.empty()) {
                 report_lint("option 'logfile' not set, but selected log type is 'file'");
             }
+            if (log_type != log_type_id::ROTFILE && !logfile_compress.empty()) {
+                report_lint("option 'logfile-compress' was specified, but selected log type is not"
+                        " 'rotating-file'");
+            }
+            if ((restart_delay_max.tv_sec != 0 || restart_delay_max.tv_nsec != 0)
+                    && (restart_delay_max.tv_sec < restart_delay.tv_sec
+                        || (restart_delay_max.tv_sec == restart_delay.tv_sec
+                            && restart_delay_max.tv_nsec <= restart_delay.tv_nsec))) {
+                report_lint("'restart-delay-max' is not greater than 'restart-delay'; the restart"
+                        " delay will not back off.");
+            }
+        }
+
+        if (log_type == log_type_id::ROTFILE && logfile.empty()) {
+            report_error("log type is 'rotating-file', but 'logfile' not set.");
         }
 
         if (service_type == service_type_t::BGPROCESS) {
@@ -1850,6 +1887,30 @@ class service_settings_wrapper
             report_error("kill-all-on-stop can only be set on scripted or internal services.");
         }
 
+        #if SUPPORT_CGROUPS
+        if (onstart_flags.create_cgroup || cgroup_memory_max != 0 || cgroup_cpu_weight != 0
+                || cgroup_io_weight != 0) {
+            if (service_type != service_type_t::PROCESS && service_type != service_type_t::BGPROCESS
+                    && service_type != service_type_t::SCRIPTED) {
+                report_error("create-cgroup and cgroup resource settings can only be used with"
+                        " process-based services.");
+            }
+            else if (run_in_cgroup.empty() && !onstart_flags.create_cgroup) {
+                // (with create-cgroup, the cgroup path defaults to the service name)
+                report_error("cgroup resource settings were specified, but 'run-in-cgroup' is"
+                        " not set.");
+            }
+        }
+        if (onstart_flags.kill_cgroup) {
+            if (service_type != service_type_t::PROCESS && service_type != service_type_t::BGPROCESS) {
+                report_error("kill-cgroup can only be set on process or bgprocess services.");
+            }
+            else if (run_in_cgroup.empty() && !onstart_flags.create_cgroup) {
+                report_error("kill-cgroup was specified, but 'run-in-cgroup' is not set.");
+            }
+        }
+        #endif
+
         // Resolve paths via variable substitution
         {
             auto do_resolve = [&](const char *setting_name, string &setting_value) {
@@ -1875,6 +1936,12 @@ class service_settings_wrapper
             value_var_subst("stop-command", stop_command_s, stop_command_offsets, var_subst, service_arg);
             command = command_s;
             stop_command = stop_command_s;
+
+            std::string logfile_compress_s = std::string(logfile_compress.c_str(),
+                    logfile_compress.length());
+            value_var_subst("logfile-compress", logfile_compress_s, logfile_compress_offsets,
+                    var_subst, service_arg);
+            logfile_compress = logfile_compress_s;
         }
 
         // If socket_gid hasn't been explicitly set, but the socket_uid was specified as a name (and
@@ -1898,7 +1965,7 @@ class service_settings_wrapper
         if (run_as_gid == (gid_t)-1) run_as_gid = run_as_uid_gid;
 #endif
 
-        if (log_type != log_type_id::LOGFILE) {
+        if (!value(log_type).is_in(log_type_id::LOGFILE, log_type_id::ROTFILE)) {
             logfile.clear();
         }
 
@@ -2024,6 +2091,46 @@ void process_service_line(settings_wrapper &settings, ::string_view name, const
         case setting_id_t::RUN_IN_CGROUP:
             settings.run_in_cgroup = read_setting_value(input_pos, i, end, nullptr);
             break;
+        case setting_id_t::CGROUP_MEMORY_MAX:
+        {
+            string mem_str = read_setting_value(input_pos, i, end);
+            if (mem_str == "max") {
+                settings.cgroup_memory_max = std::numeric_limits<uint64_t>::max();
+                break;
+            }
+            // Allow a K/M/G/T suffix (powers of 1024):
+            unsigned shift = 0;
+            if (!mem_str.empty()) {
+                switch (mem_str.back()) {
+                case 'K': shift = 10; break;
+                case 'M': shift = 20; break;
+                case 'G': shift = 30; break;
+                case 'T': shift = 40; break;
+                default: break;
+                }
+                if (shift != 0) mem_str.pop_back();
+            }
+            uint64_t limit_max = (std::numeric_limits<uint64_t>::max() - 1) >> shift;
+            uint64_t mem_max = parse_unum_param(input_pos, mem_str, name, limit_max) << shift;
+            if (mem_max == 0) {
+                throw service_description_exc(name, "value must be non-zero",
+                        setting_str::str_cgroup_memory_max, input_pos);
+            }
+            settings.cgroup_memory_max = mem_max;
+            break;
+        }
+        case setting_id_t::CGROUP_CPU_WEIGHT:
+        {
+            string weight_str = read_setting_value(input_pos, i, end);
+            settings.cgroup_cpu_weight = (unsigned)parse_snum_param(input_pos, weight_str, name, 1, 10000);
+            break;
+        }
+        case setting_id_t::CGROUP_IO_WEIGHT:
+        {
+            string weight_str = read_setting_value(input_pos, i, end);
+            settings.cgroup_io_weight = (unsigned)parse_snum_param(input_pos, weight_str, name, 1, 10000);
+            break;
+        }
         #endif
         #if SUPPORT_CAPABILITIES
         case setting_id_t::CAPABILITIES:
@@ -2085,6 +2192,13 @@ void process_service_line(settings_wrapper &settings, ::string_view name, const
                     std::numeric_limits<int>::min() / 2, std::numeric_limits<int>::max() / 2);
             break;
         }
+        case setting_id_t::START_PRIORITY:
+        {
+            string priority_str = read_setting_value(input_pos, i, end);
+            settings.start_priority = (int)parse_snum_param(input_pos, priority_str, name,
+                    std::numeric_limits<int16_t>::min(), std::numeric_limits<int16_t>::max());
+            break;
+        }
         #if SUPPORT_IOPRIO
         case setting_id_t::IOPRIO:
         {
@@ -2273,9 +2387,12 @@ void process_service_line(settings_wrapper &settings, ::string_view name, const
             else if (log_type_str == "pipe") {
                 settings.log_type = log_type_id::PIPE;
             }
+            else if (log_type_str == "rotating-file") {
+                settings.log_type = log_type_id::ROTFILE;
+            }
             else {
                 throw service_description_exc(name, "log type must be one of: \"file\", \"buffer\", \"pipe\","
-                        " or \"none\"", details->setting_str, input_pos);
+                        " \"rotating-file\" or \"none\"", details->setting_str, input_pos);
             }
             break;
         }
@@ -2287,6 +2404,58 @@ void process_service_line(settings_wrapper &settings, ::string_view name, const
             settings.max_log_buffer_sz = bufsize;
             break;
         }
+        case setting_id_t::LOG_BUFFER_OVERFLOW:
+        {
+            string overflow_str = read_setting_value(input_pos, i, end);
+            if (overflow_str == "discard-new") {
+                settings.log_buffer_discard_old = false;
+            }
+            else if (overflow_str == "discard-old") {
+                settings.log_buffer_discard_old = true;
+            }
+            else {
+                throw service_description_exc(name, "log buffer overflow must be one of: \"discard-new\" or"
+                        " \"discard-old\"", details->setting_str, input_pos);
+            }
+            break;
+        }
+        case setting_id_t::LOGFILE_ROTATE_SIZE:
+        {
+            string size_str = read_setting_value(input_pos, i, end);
+            // Allow a K/M/G suffix (powers of 1024):
+            unsigned shift = 0;
+            if (!size_str.empty()) {
+                switch (size_str.back()) {
+                case 'K': shift = 10; break;
+                case 'M': shift = 20; break;
+                case 'G': shift = 30; break;
+                default: break;
+                }
+                if (shift != 0) size_str.pop_back();
+            }
+            uint64_t size_max = std::numeric_limits<uint64_t>::max() >> shift;
+            uint64_t rotate_size = parse_unum_param(input_pos, size_str, name, size_max) << shift;
+            if (rotate_size == 0) {
+                throw service_description_exc(name, "value must be non-zero",
+                        setting_str::str_logfile_rotate_size, input_pos);
+            }
+            settings.logfile_rotate_size = rotate_size;
+            break;
+        }
+        case setting_id_t::LOGFILE_ROTATE_COUNT:
+        {
+            string count_str = read_setting_value(input_pos, i, end);
+            settings.logfile_rotate_count = (unsigned)parse_unum_param(input_pos, count_str, name,
+                    999);
+            break;
+        }
+        case setting_id_t::LOGFILE_COMPRESS:
+            read_setting_value(settings.logfile_compress, setting_op, input_pos, i, end,
+                    &settings.logfile_compress_offsets);
+            break;
+        case setting_id_t::LOGFILE_COMPRESS_SUFFIX:
+            settings.logfile_compress_suffix = read_setting_value(input_pos, i, end);
+            break;
         case setting_id_t::CONSUMER_OF:
         {
             string consumed_svc_name = read_value_resolved(details->setting_str, input_pos, i,
@@ -2415,6 +2584,14 @@ void process_service_line(settings_wrapper &settings, ::string_view name, const
                 else if (option_txt == "no-new-privs") {
                     settings.onstart_flags.no_new_privs = true;
                 }
+#endif
+#if SUPPORT_CGROUPS
+                else if (option_txt == "kill-cgroup") {
+                    settings.onstart_flags.kill_cgroup = true;
+                }
+                else if (option_txt == "create-cgroup") {
+                    settings.onstart_flags.create_cgroup = true;
+                }
 #endif
                 else {
                     throw service_description_exc(name, "unknown option: " + option_txt,
@@ -2475,6 +2652,19 @@ void process_service_line(settings_wrapper &settings, ::string_view name, const
             parse_timespec(input_pos, rsdelay_str, name, details->setting_str, settings.restart_delay);
             break;
         }
+        case setting_id_t::RESTART_DELAY_MAX:
+        {
+            string rsdelay_str = read_setting_value(input_pos, i, end, nullptr);
+            parse_timespec(input_pos, rsdelay_str, name, details->setting_str,
+                    settings.restart_delay_max);
+            break;
+        }
+        case setting_id_t::RESTART_DELAY_JITTER:
+        {
+            string jitter_str = read_setting_value(input_pos, i, end, nullptr);
+            settings.restart_delay_jitter = parse_unum_param(input_pos, jitter_str, name, 100);
+            break;
+        }
         case setting_id_t::RESTART_LIMIT_COUNT: {
             string limit_str = read_setting_value(input_pos, i, end, nullptr);
             settings.max_restarts = parse_unum_param(input_pos, limit_str, name,
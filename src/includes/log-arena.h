@@ -0,0 +1,303 @@
+#ifndef LOG_ARENA_H
+#define LOG_ARENA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+
+// Log message arena: a queue of log messages, each tagged with a priority (log level), held in a
+// contiguous buffer. The buffer starts out as a fixed-size internal array, so that no allocation
+// is needed in the normal case, and grows (by doubling) on demand up to a configured maximum.
+//
+// When no more space can be made available for a new message, queued messages of lower priority
+// than the new message are evicted (lowest priority, then oldest, first) to make room for it. If
+// that isn't possible the new message is discarded instead. Counts of discarded messages (whether
+// evicted or never queued) are kept per priority level.
+//
+// A message is composed via begin_msg(), any number of append() calls, and then commit() (or
+// rollback()). Queued messages are consumed from the front via front()/consume(); the front
+// message may be partially consumed, in which case it is never evicted.
+//
+// Each message is stored as a header (message length, 4 bytes; priority, 1 byte) followed by the
+// message text.
+class log_arena
+{
+    public:
+    static constexpr unsigned num_priorities = 4;
+    static constexpr size_t initial_size = 4096;
+
+    private:
+    static constexpr size_t header_size = sizeof(uint32_t) + 1;
+
+    char initial_buf[initial_size];
+    char *buf = initial_buf;
+    size_t capacity = initial_size;
+    size_t max_capacity = initial_size;
+
+    size_t head = 0;        // offset of the first queued message
+    size_t head_consumed = 0;   // amount of the first message's text already consumed
+    size_t tail = 0;        // offset one past the last committed message
+    size_t msg_end = 0;     // offset one past the end of the message being composed (if any)
+    bool composing = false;
+    uint8_t msg_priority = 0;
+
+    unsigned long discarded[num_priorities] = {};
+    unsigned long unreported_discards = 0;
+
+    uint32_t msg_len_at(size_t offset) const noexcept
+    {
+        uint32_t len;
+        memcpy(&len, buf + offset, sizeof(len));
+        return len;
+    }
+
+    uint8_t msg_priority_at(size_t offset) const noexcept
+    {
+        return (uint8_t)buf[offset + sizeof(uint32_t)];
+    }
+
+    void count_discard(uint8_t priority) noexcept
+    {
+        discarded[priority]++;
+        unreported_discards++;
+    }
+
+    // Move the queued data to the start of the buffer.
+    void compact() noexcept
+    {
+        if (head == 0) return;
+        memmove(buf, buf + head, msg_end - head);
+        tail -= head;
+        msg_end -= head;
+        head = 0;
+    }
+
+    // Grow the buffer so that it can hold at least 'needed' bytes (not exceeding the maximum
+    // size). Returns false if it can't be grown (sufficiently).
+    bool grow(size_t needed) noexcept
+    {
+        if (needed > max_capacity) return false;
+        size_t new_capacity = capacity;
+        while (new_capacity < needed) {
+            new_capacity = (new_capacity > max_capacity / 2) ? max_capacity : new_capacity * 2;
+        }
+
+        char *new_buf = new (std::nothrow) char[new_capacity];
+        if (new_buf == nullptr) return false;
+
+        memcpy(new_buf, buf + head, msg_end - head);
+        tail -= head;
+        msg_end -= head;
+        head = 0;
+        if (buf != initial_buf) delete[] buf;
+        buf = new_buf;
+        capacity = new_capacity;
+        return true;
+    }
+
+    // Evict one queued message with priority lower than that of the message being composed,
+    // choosing the lowest priority and then the oldest. Returns false if there is no such message.
+    bool evict_one() noexcept
+    {
+        size_t victim = tail;
+        uint8_t victim_priority = msg_priority;
+        size_t offset = head;
+        if (head_consumed != 0) {
+            // Skip the partially-consumed front message
+            offset += header_size + msg_len_at(offset);
+        }
+        for ( ; offset < tail; offset += header_size + msg_len_at(offset)) {
+            uint8_t priority = msg_priority_at(offset);
+            if (priority < victim_priority) {
+                victim = offset;
+                victim_priority = priority;
+            }
+        }
+        if (victim == tail) return false;
+
+        size_t victim_size = header_size + msg_len_at(victim);
+        memmove(buf + victim, buf + victim + victim_size, msg_end - victim - victim_size);
+        tail -= victim_size;
+        msg_end -= victim_size;
+        count_discard(victim_priority);
+        return true;
+    }
+
+    // Ensure there is space for 'amount' more bytes in the message being composed.
+    bool make_space(size_t amount) noexcept
+    {
+        if (capacity - msg_end >= amount) return true;
+
+        size_t needed = msg_end - head + amount;
+        if (needed <= capacity) {
+            compact();
+            return true;
+        }
+        if (grow(needed)) return true;
+
+        // Evict lower-priority messages until there is space (or nothing more can be evicted)
+        compact();
+        while (capacity - msg_end < amount) {
+            if (!evict_one()) return false;
+        }
+        return true;
+    }
+
+    public:
+    log_arena() noexcept
+    {
+    }
+
+    log_arena(const log_arena &) = delete;
+    void operator=(const log_arena &) = delete;
+
+    ~log_arena() noexcept
+    {
+        if (buf != initial_buf) delete[] buf;
+    }
+
+    // Set the maximum size that the buffer may grow to (not less than the initial size). The
+    // buffer is not shrunk if it is already larger.
+    void set_max_size(size_t max_size) noexcept
+    {
+        max_capacity = (max_size < initial_size) ? initial_size : max_size;
+    }
+
+    size_t get_max_size() const noexcept
+    {
+        return max_capacity;
+    }
+
+    size_t get_capacity() const noexcept
+    {
+        return capacity;
+    }
+
+    // The number of bytes currently used by queued (committed) messages
+    size_t get_length() const noexcept
+    {
+        return tail - head;
+    }
+
+    // Begin composing a message with the given priority (0 = lowest, num_priorities - 1 = highest).
+    // Returns false (and counts the message as discarded) if the message can't be queued.
+    bool begin_msg(unsigned priority) noexcept
+    {
+        msg_priority = (uint8_t)priority;
+        msg_end = tail;
+        composing = true;
+        if (!make_space(header_size)) {
+            composing = false;
+            count_discard(msg_priority);
+            return false;
+        }
+        buf[msg_end + sizeof(uint32_t)] = (char)msg_priority;
+        msg_end += header_size;
+        return true;
+    }
+
+    // Append to the message being composed. If there's no space, the message is discarded, and
+    // false is returned (as it is if no message is being composed).
+    bool append(const char *s, size_t len) noexcept
+    {
+        if (!composing) return false;
+        if (!make_space(len)) {
+            rollback();
+            return false;
+        }
+        memcpy(buf + msg_end, s, len);
+        msg_end += len;
+        return true;
+    }
+
+    // Queue the message being composed. Returns true if it is the only queued message.
+    bool commit() noexcept
+    {
+        uint32_t len = msg_end - tail - header_size;
+        memcpy(buf + tail, &len, sizeof(len));
+        bool was_empty = (head == tail);
+        tail = msg_end;
+        composing = false;
+        return was_empty;
+    }
+
+    // Discard the message being composed (counting it as discarded).
+    void rollback() noexcept
+    {
+        if (!composing) return;
+        msg_end = tail;
+        composing = false;
+        count_discard(msg_priority);
+    }
+
+    bool is_composing() const noexcept
+    {
+        return composing;
+    }
+
+    bool empty() const noexcept
+    {
+        return head == tail;
+    }
+
+    // Whether the front message has been partially consumed
+    bool is_partway() const noexcept
+    {
+        return head_consumed != 0;
+    }
+
+    // Get the (remaining, unconsumed) text of the front message. The arena must not be empty.
+    const char *front(size_t &len) const noexcept
+    {
+        len = msg_len_at(head) - head_consumed;
+        return buf + head + header_size + head_consumed;
+    }
+
+    // Consume the given amount (not more than remains) of the front message text. Returns true if
+    // the front message was completely consumed.
+    bool consume(size_t amount) noexcept
+    {
+        head_consumed += amount;
+        uint32_t len = msg_len_at(head);
+        if (head_consumed < len) return false;
+
+        head += header_size + len;
+        head_consumed = 0;
+        if (head == msg_end) {
+            head = tail = msg_end = 0;
+        }
+        return true;
+    }
+
+    // Discard all queued messages, other than a partially consumed front message (without
+    // counting them as discarded). A message being composed is retained.
+    void clear() noexcept
+    {
+        size_t keep_end = head;
+        if (head_consumed != 0) {
+            keep_end += header_size + msg_len_at(head);
+        }
+        memmove(buf + keep_end, buf + tail, msg_end - tail);
+        msg_end -= (tail - keep_end);
+        tail = keep_end;
+        if (head == msg_end) {
+            head = tail = msg_end = 0;
+        }
+    }
+
+    unsigned long get_discarded(unsigned priority) const noexcept
+    {
+        return discarded[priority];
+    }
+
+    // Get the number of messages discarded since this was last called.
+    unsigned long take_unreported_discards() noexcept
+    {
+        unsigned long r = unreported_discards;
+        unreported_discards = 0;
+        return r;
+    }
+};
+
+#endif
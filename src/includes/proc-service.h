@@ -19,6 +19,12 @@
 
 class process_service;
 
+#if SUPPORT_CGROUPS
+// The cgroup path (relative to /sys/fs/cgroup) that relative "run-in-cgroup" paths are resolved against
+extern std::string cgroups_path;
+extern bool have_cgroups_path;
+#endif
+
 // Given a string and a list of pairs of (start,end) indices for each argument in that string,
 // store a null terminator for the argument. Return a `char *` vector containing the beginning
 // of each argument and a trailing nullptr. (The returned array is invalidated if the string is later
@@ -26,6 +32,26 @@ class process_service;
 std::vector<const char *> separate_args(ha_string &s,
         const std::list<std::pair<unsigned,unsigned>> &arg_indices);
 
+// Environment for a child process. This is built before forking, so that the child need not allocate
+// (which is required if the child shares memory with the parent; see bp_sys::vfork_call). Values which
+// are known only in the child (file descriptor numbers, process ID) are written by the child into the
+// buffers here, which env_map already refers to. The environment is kept by the service and re-used
+// for each process launched, until it is invalidated by a change in environment (or settings); it
+// must not be moved or copied, since env_map refers to the buffers.
+struct run_proc_env
+{
+    environment::env_map env_map;
+    std::string notify_var;  // "NAME=nnn" for the notification fd variable (value part reserved)
+    char listen_pid[11 + type_max_num_digits<pid_t>() + 1];  // "LISTEN_PID=nnn"
+    char cs_fd[12 + type_max_num_digits<int>() + 1];         // "DINIT_CS_FD=nnn"
+    bool valid = false;        // whether built and still current
+    bool have_socket = false;  // whether built with socket activation variables
+
+    run_proc_env() noexcept { }
+    run_proc_env(const run_proc_env &) = delete;
+    void operator=(const run_proc_env &) = delete;
+};
+
 // Parameters for process execution
 struct run_proc_params
 {
@@ -64,6 +90,7 @@ struct run_proc_params
     gid_t gid;
     const std::vector<service_rlimits> &rlimits;
     int input_fd = -1;        // file descriptor to be used for input (STDIN)
+    run_proc_env *proc_env = nullptr; // prepared environment (see prepare_proc_env)
 
     run_proc_params(const char * const *args, const char *working_dir, const char *logfile, int wpipefd,
             uid_t uid, gid_t gid, const std::vector<service_rlimits> &rlimits)
@@ -162,6 +189,37 @@ class stop_child_watcher : public eventloop_t::child_proc_watcher_impl<stop_chil
     void operator=(const service_child_watcher &) = delete;
 };
 
+#if SUPPORT_CGROUPS
+// Watcher (via inotify) for changes to the "cgroup.events" file of a service cgroup
+class cgroup_events_watcher : public eventloop_t::fd_watcher_impl<cgroup_events_watcher>
+{
+    public:
+    base_process_service *service;
+    dasynq::rearm fd_event(eventloop_t &eloop, int fd, int flags) noexcept;
+
+    cgroup_events_watcher(base_process_service * sr) noexcept : service(sr) { }
+
+    cgroup_events_watcher(const cgroup_events_watcher &) = delete;
+    void operator=(const cgroup_events_watcher &) = delete;
+};
+#endif
+
+#if SUPPORT_PIDFD
+// Watcher for termination of a service process which is not a child of dinit (i.e. a process
+// identified via a pid file), via a process file descriptor (pidfd)
+class pidfd_watcher : public eventloop_t::fd_watcher_impl<pidfd_watcher>
+{
+    public:
+    base_process_service *service;
+    dasynq::rearm fd_event(eventloop_t &eloop, int fd, int flags) noexcept;
+
+    pidfd_watcher(base_process_service * sr) noexcept : service(sr) { }
+
+    pidfd_watcher(const pidfd_watcher &) = delete;
+    void operator=(const pidfd_watcher &) = delete;
+};
+#endif
+
 class log_output_watcher : public eventloop_t::fd_watcher_impl<log_output_watcher>
 {
     public:
@@ -175,14 +233,34 @@ class log_output_watcher : public eventloop_t::fd_watcher_impl<log_output_watche
     void operator=(const ready_notify_watcher &) = delete;
 };
 
+// watcher for the logfile compress command (ROTFILE log type)
+class log_compress_watcher : public eventloop_t::child_proc_watcher_impl<log_compress_watcher>
+{
+    public:
+    base_process_service *service;
+    dasynq::rearm status_change(eventloop_t &eloop, pid_t child, proc_status_t status) noexcept;
+
+    log_compress_watcher(base_process_service * sr) noexcept : service(sr) { }
+
+    log_compress_watcher(const log_compress_watcher &) = delete;
+    void operator=(const log_compress_watcher &) = delete;
+};
+
 // Base class for process-based services.
-class base_process_service : public service_record
+class base_process_service : public service_record, private env_listener
 {
     friend class service_child_watcher;
     friend class exec_status_pipe_watcher;
     friend class base_process_service_test;
     friend class ready_notify_watcher;
     friend class log_output_watcher;
+    friend class log_compress_watcher;
+    #if SUPPORT_CGROUPS
+    friend class cgroup_events_watcher;
+    #endif
+    #if SUPPORT_PIDFD
+    friend class pidfd_watcher;
+    #endif
 
     protected:
     ha_string program_name;          // storage for program/script and arguments
@@ -196,6 +274,10 @@ class base_process_service : public service_record
     string working_dir;       // working directory (or empty)
     string env_file;          // file with environment settings for this service
 
+    // Prepared environments for the start (main) command and the stop command (see get_proc_env)
+    run_proc_env start_proc_env;
+    run_proc_env stop_proc_env;
+
     log_type_id log_type = log_type_id::NONE;
     string logfile;          // log file name, empty string specifies /dev/null
     int logfile_perms = 0;   // logfile permissions("mode")
@@ -203,9 +285,19 @@ class base_process_service : public service_record
     gid_t logfile_gid = -1;  // logfile group id
     unsigned log_buf_max = 0; // log buffer maximum size
     unsigned log_buf_size = 0; // log buffer current size
+    unsigned log_buf_start = 0; // offset of oldest data in log buffer (non-zero only if wrapped)
     std::vector<char, default_init_allocator<char>> log_buffer;
 
-    bool nice_is_set = false;
+    // For log type ROTFILE: output is read from the pipe and written to the logfile by dinit
+    int logfile_fd = -1;              // logfile, if open
+    uint64_t logfile_size = 0;        // current size of logfile
+    uint64_t logfile_rotate_size = 1024 * 1024; // size at which the logfile is rotated
+    unsigned logfile_rotate_count = 5; // number of rotated logfiles kept
+    ha_string logfile_compress;       // command to compress a rotated logfile (empty for none)
+    std::vector<const char *> logfile_compress_parts; // pointer to each part of the above, and nullptr
+    string logfile_compress_suffix;   // suffix added to the file name by the compress command
+    pid_t logfile_compress_pid = -1;  // compress command process, while running
+
     int nice;
 
 #if SUPPORT_IOPRIO
@@ -213,7 +305,6 @@ class base_process_service : public service_record
 #endif
 
 #if SUPPORT_OOM_ADJ
-    bool oom_adj_is_set = false;
     short oom_adj = 0;
 #endif
 
@@ -222,17 +313,27 @@ class base_process_service : public service_record
 #if SUPPORT_CAPABILITIES
     cap_iab_wrapper cap_iab;
     unsigned long secbits = 0;
-    bool no_new_privs = false;
 #endif
 
 #if SUPPORT_CGROUPS
     string run_in_cgroup;
+    cgroup_events_watcher cgroup_watcher;
+    int cgroup_events_fd = -1;  // inotify fd watching cgroup.events, while waiting for cgroup to empty
+    uint64_t cgroup_memory_max = 0;  // memory.max to set; 0 = not set, -1 = "max"
+    unsigned cgroup_cpu_weight = 0;  // cpu.weight to set; 0 = not set
+    unsigned cgroup_io_weight = 0;   // io.weight (default weight) to set; 0 = not set
+#endif
+
+#if SUPPORT_PIDFD
+    pidfd_watcher pidfd_listener;
+    int pidfd = -1;  // pidfd for the service process, if it is not our child (bgprocess)
 #endif
 
     service_child_watcher child_listener;
     exec_status_pipe_watcher child_status_listener;
     process_restart_timer process_timer; // timer is used for start, stop and restart
     log_output_watcher log_output_listener;
+    log_compress_watcher compress_listener;
     time_val last_start_time;
 
     // Restart interval time and restart count are used to track the number of automatic restarts
@@ -244,6 +345,14 @@ class base_process_service : public service_record
     int max_restart_interval_count;  // number of restarts allowed over maximum interval
     time_val restart_delay;          // delay between restarts
 
+    // Restart backoff: with consecutive restarts (where the process did not run for at least the
+    // restart interval), the restart delay is doubled each time, up to the maximum delay. A random
+    // extra delay (jitter) of up to the given percentage of the delay is added to each restart.
+    time_val restart_delay_max = {0, 0}; // maximum delay; no backoff unless > restart_delay
+    time_val restart_backoff = {0, 0};   // current delay, with backoff
+    unsigned restart_backoff_count = 0;  // number of consecutive restarts (with backoff)
+    unsigned restart_delay_jitter = 0;   // maximum jitter, percent of delay
+
     // Time allowed for service stop, after which SIGKILL is sent. 0 to disable.
     time_val stop_timeout = {10, 0}; // default of 10 seconds
 
@@ -273,6 +382,21 @@ class base_process_service : public service_record
     bool reserved_child_watch : 1;
     bool tracking_child : 1;  // whether we expect to see child process status
 
+    bool listening_main_env : 1;  // registered as listener for changes to main environment
+    bool log_buf_discard_old : 1; // when log buffer full, overwrite oldest data (ring buffer)
+    bool logfile_write_failed : 1; // (ROTFILE) a write error has been reported (and not yet cleared)
+    bool reserved_compress_watch : 1; // (ROTFILE) compress_listener holds a watch reservation
+    bool nice_is_set : 1;
+#if SUPPORT_OOM_ADJ
+    bool oom_adj_is_set : 1;
+#endif
+#if SUPPORT_CAPABILITIES
+    bool no_new_privs : 1;
+#endif
+#if SUPPORT_CGROUPS
+    bool cgroup_created : 1;      // whether we created the cgroup (and should remove it)
+#endif
+
     // If executing child process failed, information about the error
     run_proc_err exec_err_info;
 
@@ -285,6 +409,107 @@ class base_process_service : public service_record
     // but in general file descriptors may be moved before the exec call.
     void run_child_proc(run_proc_params params) noexcept;
 
+    // Build the environment for a child process, reserving space for variables whose values are
+    // determined in the child.
+    // Throws: std::bad_alloc
+    void prepare_proc_env(run_proc_env &proc_env, const char *notify_var, bool have_socket,
+            bool have_cs_fd);
+
+    // Get the prepared environment for the start command or stop command, building it if it has
+    // not been built or has been invalidated since.
+    // Throws: std::bad_alloc
+    run_proc_env &get_proc_env(bool for_stop);
+
+    // Invalidate prepared environments (they will be rebuilt when next needed).
+    void invalidate_proc_env() noexcept
+    {
+        start_proc_env.valid = false;
+        stop_proc_env.valid = false;
+    }
+
+    // The main environment changed
+    void environ_event(environment *env, std::string const &name_and_val, bool overridden) noexcept override
+    {
+        invalidate_proc_env();
+    }
+
+    // The service environment (or other settings) changed
+    void environment_changed() noexcept override
+    {
+        invalidate_proc_env();
+    }
+
+    #if SUPPORT_CGROUPS
+    // Whether to kill the whole service cgroup (via cgroup.kill) when stopping
+    bool uses_cgroup_kill() noexcept
+    {
+        return onstart_flags.kill_cgroup && !run_in_cgroup.empty();
+    }
+
+    // Get the full path of the service cgroup directory. Returns false if the path cannot be
+    // determined (relative cgroup path, and dinit's own cgroup is not known).
+    // Throws: std::bad_alloc
+    bool get_cgroup_path(std::string &path);
+
+    // Get the full path of a file in the service cgroup directory (as per get_cgroup_path).
+    // Throws: std::bad_alloc
+    bool get_cgroup_file_path(std::string &path, const char *file_name);
+
+    // Create the service cgroup (if create-cgroup is set) and apply resource settings to it. Returns
+    // false (having logged an error) on failure.
+    bool setup_cgroup() noexcept;
+
+    // Check whether the service cgroup contains any processes (per the "populated" field of
+    // cgroup.events). Returns false if the cgroup is empty, or its status cannot be read.
+    bool is_cgroup_populated() noexcept;
+
+    // Kill all processes in the service cgroup by writing to cgroup.kill. Returns false on failure
+    // (including if the kernel does not support cgroup.kill).
+    bool kill_cgroup() noexcept;
+
+    // The service process has terminated while stopping; kill any other processes remaining in the
+    // service cgroup, and start watching for the cgroup to become empty. Returns true if we must wait
+    // for the cgroup to empty (cgroup_emptied() will then be called), false if stopping is complete.
+    bool kill_cgroup_remainder() noexcept;
+
+    // Stop watching cgroup.events
+    void stop_cgroup_watch() noexcept;
+
+    // The service cgroup has become empty (or we have given up waiting for it to do so)
+    virtual void cgroup_emptied() noexcept
+    {
+        stopped();
+    }
+    #endif
+
+    #if SUPPORT_PIDFD
+    // Start watching for termination of the service process (pid) via a pidfd. Returns false on
+    // failure (including if pidfds are not supported by the kernel).
+    bool watch_pidfd() noexcept;
+
+    // Stop watching the pidfd (if any), and close it
+    void stop_pidfd_watch() noexcept;
+    #endif
+
+    // Open (creating if necessary) the logfile for log type ROTFILE. Returns false on failure
+    // (which is logged).
+    bool open_rotfile() noexcept;
+
+    // Write service output to the logfile (log type ROTFILE), rotating it if it has reached the
+    // rotation size.
+    void write_rotfile(const char *data, size_t len) noexcept;
+
+    // Rotate the logfile: shift existing rotated files along (discarding the oldest), rename the
+    // logfile to <logfile>.1, start compression of it (if configured) and re-open the logfile.
+    // Must not be called while a previous compress command is running (since <logfile>.1 would be
+    // renamed while it is being compressed); rotation is instead deferred until it has finished.
+    void rotate_logfile() noexcept;
+
+    // Check whether a process can be launched via bp_sys::vfork_call, i.e. with the child sharing our
+    // memory until it execs, rather than via a full fork. This is only the case if run_child_proc
+    // needs to do nothing (with the given settings) which might allocate or modify shared state.
+    bool can_vfork_spawn(bool on_console) noexcept;
+
     // Launch the process with the given arguments, return true on success
     bool start_ps_process(const std::vector<const char *> &args, bool on_console) noexcept;
 
@@ -292,15 +517,27 @@ class base_process_service : public service_record
     // rate-limited.
     bool restart_ps_process() noexcept;
 
+    // Get the delay before the next restart (as measured from the last start), applying backoff
+    // and jitter; run_time is the time since the last start.
+    time_val next_restart_delay(time_val run_time) noexcept;
+
     // Perform smooth recovery process
     void do_smooth_recovery() noexcept;
 
     // Start the process, return true on success
     virtual bool bring_up() noexcept override;
 
+    bool needs_start_slot() noexcept override
+    {
+        return true;
+    }
+
     // Called after forking (before executing remote process).
     virtual void after_fork(pid_t child_pid) noexcept { }
 
+    // Whether after_fork needs to be called (i.e. whether it does anything).
+    virtual bool needs_after_fork() noexcept { return false; }
+
     // Called when the process exits. The exit_status variable must be set before calling.
     virtual void handle_exit_status() noexcept = 0;
 
@@ -343,6 +580,16 @@ class base_process_service : public service_record
 
     bool ensure_log_buffer_backing(unsigned size) noexcept;
 
+    // Make the log buffer contents contiguous from the start of the buffer, if it has wrapped.
+    void unwrap_log_buffer() noexcept
+    {
+        if (log_buf_start != 0) {
+            std::rotate(log_buffer.begin(), log_buffer.begin() + log_buf_start,
+                    log_buffer.begin() + log_buf_size);
+            log_buf_start = 0;
+        }
+    }
+
     public:
     // Constructor for a base_process_service. Note that the various parameters not specified here must in
     // general be set separately (using the appropriate set_xxx function for each).
@@ -352,9 +599,24 @@ class base_process_service : public service_record
 
     ~base_process_service() noexcept
     {
+        if (listening_main_env) {
+            main_env.remove_listener(this);
+        }
+        #if SUPPORT_CGROUPS
+        stop_cgroup_watch();
+        #endif
+        #if SUPPORT_PIDFD
+        stop_pidfd_watch();
+        #endif
         if (reserved_child_watch) {
             child_listener.unreserve(event_loop);
         }
+        if (logfile_compress_pid != -1) {
+            compress_listener.deregister(event_loop, logfile_compress_pid);
+        }
+        else if (reserved_compress_watch) {
+            compress_listener.unreserve(event_loop);
+        }
         process_timer.deregister(event_loop);
         set_log_mode(log_type_id::NONE);
     }
@@ -388,12 +650,28 @@ class base_process_service : public service_record
     void set_logfile_details(string &&logfile, int logfile_perms, uid_t logfile_uid, gid_t logfile_gid)
             noexcept
     {
+        if (logfile_fd != -1 && logfile != this->logfile) {
+            // (re-opened, with the new name, when next written)
+            bp_sys::close(logfile_fd);
+            logfile_fd = -1;
+        }
         this->logfile = std::move(logfile);
         this->logfile_perms = logfile_perms;
         this->logfile_uid = logfile_uid;
         this->logfile_gid = logfile_gid;
     }
 
+    // Set logfile rotation parameters (for if mode is ROTFILE). The compress command may be empty.
+    void set_logfile_rotation(uint64_t rotate_size, unsigned rotate_count, ha_string &&compress,
+            std::vector<const char *> &&compress_parts, string &&compress_suffix) noexcept
+    {
+        logfile_rotate_size = rotate_size;
+        logfile_rotate_count = rotate_count;
+        logfile_compress = std::move(compress);
+        logfile_compress_parts = std::move(compress_parts);
+        logfile_compress_suffix = std::move(compress_suffix);
+    }
+
     // Set log buffer maximum size (for if mode is BUFFER). Maximum allowed size is UINT_MAX / 2
     // (must be checked by caller).
     void set_log_buf_max(unsigned max_size) noexcept
@@ -401,17 +679,22 @@ class base_process_service : public service_record
         this->log_buf_max = max_size;
     }
 
-    // Set log mode (NONE, BUFFER, FILE, PIPE) (must not change mode when service is not STOPPED).
+    // Set log mode (NONE, BUFFER, FILE, PIPE, ROTFILE) (must not change mode when service is not
+    // STOPPED).
     void set_log_mode(log_type_id log_type) noexcept
     {
         if (this->log_type == log_type) {
             return;
         }
+        if (logfile_fd != -1) {
+            bp_sys::close(logfile_fd);
+            logfile_fd = -1;
+        }
         if (log_output_fd != -1) {
-            if (this->log_type == log_type_id::BUFFER) {
+            if (value(this->log_type).is_in(log_type_id::BUFFER, log_type_id::ROTFILE)) {
                 log_output_listener.deregister(event_loop);
             }
-            if (!value(log_type).is_in(log_type_id::BUFFER, log_type_id::PIPE)) {
+            if (!value(log_type).is_in(log_type_id::BUFFER, log_type_id::PIPE, log_type_id::ROTFILE)) {
                 bp_sys::close(log_output_fd);
                 bp_sys::close(log_input_fd);
                 log_output_fd = log_input_fd = -1;
@@ -437,7 +720,7 @@ class base_process_service : public service_record
     std::pair<int,int> transfer_output_pipe() noexcept override
     {
         std::pair<int,int> r { log_input_fd, log_output_fd };
-        if (log_type == log_type_id::BUFFER && log_output_fd != -1) {
+        if (value(log_type).is_in(log_type_id::BUFFER, log_type_id::ROTFILE) && log_output_fd != -1) {
             log_output_listener.deregister(event_loop);
         }
         log_input_fd = log_output_fd = -1;
@@ -460,10 +743,23 @@ class base_process_service : public service_record
         return log_input_fd;
     }
 
-    // Get the log buffer (address, length)
-    std::pair<const char *, unsigned> get_log_buffer() noexcept
+    // Set whether, once the log buffer is full, the oldest output is discarded to make room for new
+    // output (rather than new output being discarded).
+    void set_log_buf_discard_old(bool discard_old) noexcept
     {
-        return {log_buffer.data(), log_buf_size};
+        log_buf_discard_old = discard_old;
+    }
+
+    // Get the log buffer contents, as two segments (the second possibly empty) which together
+    // contain the buffered output in order. The segs parameter must point to an array of (at least)
+    // two iovec structures.
+    void get_log_buffer(struct iovec *segs) noexcept
+    {
+        char *base = log_buffer.data();
+        segs[0].iov_base = base + log_buf_start;
+        segs[0].iov_len = log_buf_size - log_buf_start;
+        segs[1].iov_base = base;
+        segs[1].iov_len = log_buf_start;
     }
 
     void clear_log_buffer() noexcept
@@ -471,6 +767,7 @@ class base_process_service : public service_record
         log_buffer.clear();
         log_buffer.shrink_to_fit();
         log_buf_size = 0;
+        log_buf_start = 0;
     }
 
     void set_env_file(const std::string &env_file_p)
@@ -488,8 +785,21 @@ class base_process_service : public service_record
     {
         run_in_cgroup = std::move(run_in_cgroup_p);
     }
+
+    // Set resource settings for the service cgroup (0 for any value means not set; for memory_max,
+    // -1 means "max" i.e. no limit). They are applied each time the service process is started.
+    void set_cgroup_limits(uint64_t memory_max, unsigned cpu_weight, unsigned io_weight) noexcept
+    {
+        cgroup_memory_max = memory_max;
+        cgroup_cpu_weight = cpu_weight;
+        cgroup_io_weight = io_weight;
+    }
+
+    bool get_resource_usage(service_resource_usage &usage) noexcept override;
     #endif
 
+    void get_mem_usage(service_mem_usage &usage) noexcept override;
+
     #if SUPPORT_CAPABILITIES
     void set_cap(cap_iab_wrapper &&iab, unsigned int sbits) noexcept
     {
@@ -535,6 +845,24 @@ class base_process_service : public service_record
         restart_delay = delay;
     }
 
+    // Set the maximum restart delay (for exponential backoff; 0 to disable) and the maximum jitter
+    // (random extra delay) as a percentage of the delay.
+    void set_restart_backoff(timespec delay_max, unsigned jitter) noexcept
+    {
+        restart_delay_max = delay_max;
+        restart_delay_jitter = jitter;
+    }
+
+    bool get_restart_backoff(time_val &delay, unsigned &count) noexcept override
+    {
+        if (!(restart_delay < restart_delay_max)) {
+            return false;
+        }
+        delay = (restart_backoff_count != 0) ? restart_backoff : restart_delay;
+        count = restart_backoff_count;
+        return true;
+    }
+
     void set_stop_timeout(timespec timeout) noexcept
     {
         stop_timeout = timeout;
@@ -622,6 +950,7 @@ class process_service : public base_process_service
 
     bool reserved_stop_watch : 1;
     bool stop_issued : 1;
+    bool doing_smooth_recovery : 1; // if we are performing smooth recovery
 
     pid_t stop_pid = -1;
     proc_status_t stop_status = {};
@@ -630,8 +959,6 @@ class process_service : public base_process_service
     stop_child_watcher stop_watcher;
     stop_status_pipe_watcher stop_pipe_watcher;
 
-    bool doing_smooth_recovery = false; // if we are performing smooth recovery
-
     service_record *consumer_for = nullptr;
 
 #if USE_UTMPX
@@ -648,6 +975,11 @@ class process_service : public base_process_service
         }
     }
 
+    bool needs_after_fork() noexcept override
+    {
+        return *inittab_id || *inittab_line;
+    }
+
 #endif
 
     protected:
@@ -672,11 +1004,32 @@ class process_service : public base_process_service
         if (pid == -1 || !tracking_child) {
             // If service process has already finished, we were just waiting for the stop command
             // process:
-            stop_issued = false; // reset for next time
-            stopped();
+            stop_finished();
         }
     }
 
+    // The service process (and stop command, if any) has terminated while stopping. The service is
+    // stopped, unless we must wait for other processes in its cgroup to terminate.
+    void stop_finished() noexcept
+    {
+        #if SUPPORT_CGROUPS
+        if (kill_cgroup_remainder()) {
+            // cgroup_emptied() will be called once the cgroup is empty
+            return;
+        }
+        #endif
+        stop_issued = false; // reset for next time
+        stopped();
+    }
+
+    #if SUPPORT_CGROUPS
+    void cgroup_emptied() noexcept override
+    {
+        stop_issued = false;
+        stopped();
+    }
+    #endif
+
     virtual bool check_restart() noexcept override
     {
         if (max_restart_interval_count != 0) {
@@ -721,6 +1074,7 @@ class process_service : public base_process_service
             const std::list<prelim_dep> &depends_p)
          : base_process_service(sset, name, s_type, std::move(command), command_offsets,
              depends_p), reserved_stop_watch(false), stop_issued(false),
+             doing_smooth_recovery(false),
              readiness_watcher(this), stop_watcher(this), stop_pipe_watcher(this)
     {
     }
@@ -731,6 +1085,7 @@ class process_service : public base_process_service
             const std::list<prelim_dep> &depends_p)
          : base_process_service(sset, name, service_type_t::PROCESS, std::move(command), command_offsets,
              depends_p), reserved_stop_watch(false), stop_issued(false),
+             doing_smooth_recovery(false),
              readiness_watcher(this), stop_watcher(this), stop_pipe_watcher(this)
     {
     }
@@ -777,6 +1132,12 @@ class process_service : public base_process_service
         return consumer_for;
     }
 
+    void get_mem_usage(service_mem_usage &usage) noexcept override
+    {
+        base_process_service::get_mem_usage(usage);
+        usage.record_size = sizeof(*this);
+    }
+
     ~process_service() noexcept
     {
         if (reserved_stop_watch) {
@@ -828,6 +1189,13 @@ class bgproc_service : public process_service
     {
         return pid_file;
     }
+
+    void get_mem_usage(service_mem_usage &usage) noexcept override
+    {
+        process_service::get_mem_usage(usage);
+        usage.record_size = sizeof(*this);
+        usage.heap_size += heap_size_of(pid_file);
+    }
 };
 
 // Service which is started and stopped via separate commands
@@ -857,6 +1225,12 @@ class scripted_service : public base_process_service
     {
     }
 
+    void get_mem_usage(service_mem_usage &usage) noexcept override
+    {
+        base_process_service::get_mem_usage(usage);
+        usage.record_size = sizeof(*this);
+    }
+
     ~scripted_service() noexcept
     {
     }
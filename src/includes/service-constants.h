@@ -1,6 +1,8 @@
 #ifndef SERVICE_CONSTANTS_H
 #define SERVICE_CONSTANTS_H
 
+#include <cstdint>
+
 #include <mconfig.h>
 
 #include <control-datatypes.h>
@@ -14,7 +16,7 @@ enum class service_state_t : dinit_cptypes::srvstate_t {
 };
 
 /* Service types */
-enum class service_type_t {
+enum class service_type_t : uint8_t {
     PLACEHOLDER,  // Placeholder service, used for various reasons
     PROCESS,      // Service runs as a process, and can be stopped by
                   // sending the process a signal (usually SIGTERM)
@@ -47,7 +49,7 @@ enum class shutdown_type_t : char {
 };
 
 /* Reasons for why service stopped */
-enum class stopped_reason_t
+enum class stopped_reason_t : uint8_t
 {
     NORMAL,
     DEPRESTART, // A hard dependency was restarted
@@ -67,6 +69,18 @@ inline bool did_finish(stopped_reason_t reason)
     return reason == stopped_reason_t::TERMINATED;
 }
 
+/* Service start stages, for which times are recorded (for startup latency analysis) */
+enum class start_stage_t {
+    REQUESTED,       // start was requested
+    DEPS_STARTED,    // all dependencies were satisfied
+    EXEC_ISSUED,     // service process was launched
+    EXEC_CONFIRMED,  // service process exec() was confirmed
+    READY,           // service process notified readiness
+    STARTED          // service reached STARTED state
+};
+
+constexpr int NUM_START_STAGES = static_cast<int>(start_stage_t::STARTED) + 1;
+
 /* Execution stage */
 enum class exec_stage {
     ARRANGE_FDS, READ_ENV_FILE, SET_NOTIFYFD_VAR, SETUP_ACTIVATION_SOCKET, SETUP_CONTROL_SOCKET,
@@ -120,7 +134,7 @@ const char * const exec_stage_descriptions[/* static_cast<int>(exec_stage::DO_EX
 static_assert(sizeof(exec_stage_descriptions) == (sizeof(char *) * (static_cast<int>(exec_stage::DO_EXEC) + 1)),
         "exec_stage_descriptions missing a stage description");
 
-enum class dependency_type
+enum class dependency_type : uint8_t
 {
     REGULAR,
     SOFT,       // dependency starts in parallel, failure/stop does not affect dependent
@@ -131,15 +145,16 @@ enum class dependency_type
     PREPARED_BY // as for REGULAR, but dependency must restart if dependent does
 };
 
-enum class log_type_id
+enum class log_type_id : uint8_t
 {
     NONE,     // discard all output
     LOGFILE,  // log to a file
     BUFFER,   // log to a buffer in memory
-    PIPE      // pipe to another process (service)
+    PIPE,     // pipe to another process (service)
+    ROTFILE   // log to a file, written by dinit (with rotation)
 };
 
-enum class auto_restart_mode
+enum class auto_restart_mode : uint8_t
 {
     NEVER,      // Never automatically restart
     ALWAYS,     // Always restart
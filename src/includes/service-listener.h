@@ -1,7 +1,10 @@
 #ifndef SERVICE_LISTENER_H
 #define SERVICE_LISTENER_H
 
+#include <cstdint>
+
 #include <service-constants.h>
+#include <dinit-ll.h>
 
 class service_record;
 
@@ -9,10 +12,47 @@ class service_record;
 class service_listener
 {
     public:
-    
+    // Node in the list of listeners of the observed service (a listener can be added to only one
+    // service at a time)
+    lld_node<service_listener> listener_node;
+
     // An event occurred on the service being observed.
     // Listeners must not be added or removed during event notification.
     virtual void service_event(service_record * service, service_event_t event) noexcept = 0;
 };
 
+inline lld_node<service_listener> &extract_listener_node(service_listener *l) noexcept
+{
+    return l->listener_node;
+}
+
+// A change recorded in the event history of a service set: a service event, or the addition or
+// removal of a service.
+struct service_set_event_t
+{
+    enum class kind_t : uint8_t {
+        SERVICE_EVENT,  // a service event occurred (see 'event')
+        ADDED,          // a service was added (loaded)
+        REMOVED         // a service was removed (unloaded)
+    };
+
+    uint64_t seq;                  // sequence number (the first event has sequence number 1)
+    service_record *service;       // the service (nullptr if since removed)
+    uint32_t service_id;           // identifier of the service, unique within the set
+    kind_t kind;
+    service_event_t event;         // the event (if kind is SERVICE_EVENT)
+    service_state_t state;         // service state at the time of the event
+    service_state_t target_state;  // target state at the time of the event
+};
+
+// Interface for listening to all services in a service set
+class service_set_listener
+{
+    public:
+
+    // A change was recorded in the service set.
+    // Service set listeners must not be added or removed during event notification.
+    virtual void service_set_event(const service_set_event_t &event) noexcept = 0;
+};
+
 #endif
@@ -21,6 +21,7 @@
 #include <dinit-log.h>
 #include <service-dir.h>
 #include <dinit-env.h>
+#include <dinit-util.h>
 
 /*
  * This header defines service_record, a data record maintaining information about a service,
@@ -151,6 +152,28 @@ class service_set;
 class base_process_service;
 class process_service;
 
+// Resource usage of a service (as accounted by its cgroup)
+struct service_resource_usage
+{
+    enum : uint8_t {
+        HAVE_CPU = 1,     // cpu_usec is valid
+        HAVE_MEMORY = 2,  // memory_bytes is valid
+        HAVE_PIDS = 4,    // pids is valid
+    };
+
+    uint8_t flags = 0;
+    uint64_t cpu_usec = 0;      // total CPU time used, in microseconds
+    uint64_t memory_bytes = 0;  // current memory usage
+    uint64_t pids = 0;          // current number of tasks (processes and threads)
+};
+
+// Memory used by a service record (see service_record::get_mem_usage)
+struct service_mem_usage
+{
+    size_t record_size = 0;     // size of the record object itself
+    size_t heap_size = 0;       // heap memory owned by the record (approximate)
+};
+
 /* Service dependency record */
 class service_dep
 {
@@ -158,6 +181,9 @@ class service_dep
     service_record * to;
 
     public:
+    // Node for the list of dependents of the 'to' service
+    lld_node<service_dep> dpt_node;
+
     /* Whether the 'from' service is waiting for the 'to' service to start */
     bool waiting_on;
     /* Whether the 'from' service is holding an acquire on the 'to' service */
@@ -206,6 +232,11 @@ class service_dep
     }
 };
 
+inline lld_node<service_dep> &extract_dpt_node(service_dep *dep) noexcept
+{
+    return dep->dpt_node;
+}
+
 /* preliminary service dependency information */
 class prelim_dep
 {
@@ -277,6 +308,7 @@ class service_record
     const char *service_dsc_dir = nullptr; // directory containing service description file
 
     auto_restart_mode auto_restart; // whether to restart this (process) if it dies unexpectedly
+    stopped_reason_t stop_reason = stopped_reason_t::NORMAL;  // reason why stopped
     bool smooth_recovery : 1; // whether the service process can restart without bringing down service
 
     // Pins. Start pins are directly transitive (hence pinned_started and dept_pinned_started) whereas
@@ -288,6 +320,8 @@ class service_record
     bool waiting_for_deps : 1;  // if STARTING, whether we are waiting for dependencies/console
                                 // if STOPPING, whether we are waiting for dependents to stop
     bool waiting_for_console : 1;   // waiting for exclusive console access (while STARTING)
+    bool waiting_for_start_slot : 1; // waiting for a start slot (while STARTING)
+    bool have_start_slot : 1;   // whether we hold a start slot (STARTING)
     bool have_console : 1;      // whether we have exclusive console access (STARTING/STARTED)
     bool waiting_for_execstat : 1;  // if we are waiting for exec status after fork()
     bool start_explicit : 1;    // whether we are are explicitly required to be started
@@ -307,27 +341,37 @@ class service_record
 
     bool is_loading : 1;        // used to detect cyclic dependencies when loading a service
 
+    // Process services:
+    bool force_stop : 1;        // true if the service must actually stop. This is the case if for
+                                // example the process dies; the service, and all its dependencies,
+                                // MUST be stopped.
+
     int required_by = 0;        // number of dependents wanting this service to be started
 
+    int start_priority = 0;     // order in which to dispatch services waiting for a start slot
+
     // list of dependencies
     typedef std::list<service_dep> dep_list;
     
-    // list of dependents
-    typedef std::list<service_dep *> dpt_list;
+    // list of dependents (linked via the service_dep records, which are held in the dependency list
+    // of each dependent, so no separate allocation is needed)
+    typedef dlist<service_dep, extract_dpt_node> dpt_list;
     
     dep_list depends_on;  // services this one depends on
     dpt_list dependents;  // services depending on this one
     
     service_set *services; // the set this service belongs to
+    uint32_t service_id = 0; // identifier within the set (assigned by the set)
+
+    // Times (monotonic clock, in nanoseconds) at which each stage of the most recent start was
+    // reached; 0 if not (yet) reached.
+    uint64_t start_times[NUM_START_STAGES] = {};
     
-    std::unordered_set<service_listener *> listeners;
+    // Listeners (linked via a node in each listener, so no allocation is needed)
+    dlist<service_listener, extract_listener_node> listeners;
     
     process_service *log_consumer = nullptr;
 
-    // Process services:
-    bool force_stop; // true if the service must actually stop. This is the
-                     // case if for example the process dies; the service,
-                     // and all its dependencies, MUST be stopped.
     
     int term_signal = SIGTERM;  // signal to use for process termination
     
@@ -336,8 +380,6 @@ class service_record
     uid_t socket_uid = -1;  // socket user id or -1
     gid_t socket_gid = -1;  // socket group id or -1
 
-    stopped_reason_t stop_reason = stopped_reason_t::NORMAL;  // reason why stopped
-
     string start_on_completion;  // service to start when this one completes
 
     // Data for use by service_set
@@ -345,6 +387,9 @@ class service_record
     
     // Console queue.
     lld_node<service_record> console_queue_node;
+
+    // Queue of services waiting for a start slot.
+    lld_node<service_record> start_queue_node;
     
     // Propagation and start/stop queues
     lls_node<service_record> prop_queue_node;
@@ -408,12 +453,8 @@ class service_record
             || (service_state == service_state_t::STARTING && waiting_for_deps);
     }
     
-    void notify_listeners(service_event_t event) noexcept
-    {
-        for (auto l : listeners) {
-            l->service_event(this, event);
-        }
-    }
+    // Notify listeners (and the service set) of a service event.
+    inline void notify_listeners(service_event_t event) noexcept;
     
     // Queue to run on the console. 'acquired_console()' will be called when the console is available.
     // Has no effect if the service has already queued for console.
@@ -421,6 +462,9 @@ class service_record
     
     // Release console (console must be currently held by this service)
     void release_console() noexcept;
+
+    // Release the start slot, if held (or leave the start slot queue, if queued).
+    void release_start_slot() noexcept;
     
     // Initiate definite startup
     void initiate_start() noexcept;
@@ -452,6 +496,13 @@ class service_record
     // All dependents have stopped, and this service should proceed to stop.
     virtual void bring_down() noexcept;
 
+    // Whether bring_up() launches a process, and so should be subject to the limit on the number
+    // of concurrently starting services (see service_set::set_start_limit).
+    virtual bool needs_start_slot() noexcept
+    {
+        return false;
+    }
+
     // Whether a STARTING service can immediately transition to STOPPED (as opposed to
     // having to wait for it reach STARTED and then go through STOPPING). Note that the
     // waiting_for_deps flag being set may override this check.
@@ -468,6 +519,10 @@ class service_record
     // any appropriate cleanup.
     virtual void becoming_inactive() noexcept { }
 
+    // The service environment has been set (on load or reload). Any state derived from the environment
+    // or other settings should be discarded.
+    virtual void environment_changed() noexcept { }
+
     // Check whether the service should automatically restart (assuming auto_restart is ALWAYS or ON_FAILURE)
     virtual bool check_restart() noexcept
     {
@@ -485,7 +540,8 @@ class service_record
         : service_name(name), service_state(service_state_t::STOPPED),
             desired_state(service_state_t::STOPPED), auto_restart(auto_restart_mode::NEVER),
             smooth_recovery(false), pinned_stopped(false), pinned_started(false), dept_pinned_started(false),
-            waiting_for_deps(false), waiting_for_console(false), have_console(false),
+            waiting_for_deps(false), waiting_for_console(false), waiting_for_start_slot(false),
+            have_start_slot(false), have_console(false),
             waiting_for_execstat(false), start_explicit(false), prop_require(false), prop_release(false),
             prop_failure(false), prop_start(false), prop_stop(false), prop_pin_dpt(false),
             start_failed(false), start_skipped(false), in_auto_restart(false), in_user_restart(false),
@@ -512,19 +568,12 @@ class service_record
         try {
             for (auto & pdep : deplist_p) {
                 auto b = depends_on.emplace(depends_on.end(), this, pdep.to, pdep.dep_type);
-                try {
-                    pdep.to->dependents.push_back(&(*b));
-                }
-                catch (...) {
-                    // we'll roll back one now and re-throw:
-                    depends_on.pop_back();
-                    throw;
-                }
+                pdep.to->dependents.append(&(*b));
             }
         }
         catch (...) {
             for (auto & dep : depends_on) {
-                dep.get_to()->dependents.pop_back();
+                dep.get_to()->dependents.unlink(&dep);
             }
             throw;
         }
@@ -550,6 +599,9 @@ class service_record
 
     // Console is available.
     void acquired_console() noexcept;
+
+    // A start slot has been assigned (after queueing for one).
+    void acquired_start_slot() noexcept;
     
     // Get the target (aka desired) state.
     service_state_t get_target_state() noexcept
@@ -574,9 +626,12 @@ class service_record
         return service_dsc_dir;
     }
 
+    // Set the service environment. This is done when the service is loaded or reloaded, after the
+    // other settings have been set.
     void set_environment(environment &&env) noexcept
     {
         this->service_env = std::move(env);
+        environment_changed();
     }
 
     // Set whether this service should automatically restart when it dies
@@ -610,6 +665,18 @@ class service_record
         this->socket_gid = socket_gid;
     }
 
+    // Set the start priority. When the number of concurrently starting services is limited,
+    // services waiting to start are dispatched in order of (highest) priority.
+    void set_start_priority(int priority) noexcept
+    {
+        start_priority = priority;
+    }
+
+    int get_start_priority() noexcept
+    {
+        return start_priority;
+    }
+
     // Set the service that this one "chains" to. When this service completes, the named service is started.
     void set_chain_to(string &&chain_to) noexcept
     {
@@ -675,16 +742,36 @@ class service_record
         return start_skipped;
     }
 
-    // Add a listener. A listener must only be added once. May throw std::bad_alloc.
-    void add_listener(service_listener * listener)
+    uint32_t get_service_id() const noexcept
+    {
+        return service_id;
+    }
+
+    // Record the current time as the time at which the given start stage was reached.
+    void record_start_time(start_stage_t stage) noexcept;
+
+    uint64_t get_start_time(start_stage_t stage) noexcept
+    {
+        return start_times[static_cast<int>(stage)];
+    }
+
+    void set_service_id(uint32_t id) noexcept
+    {
+        service_id = id;
+    }
+
+    // Add a listener. A listener must only be added once (and only to one service).
+    void add_listener(service_listener * listener) noexcept
     {
-        listeners.insert(listener);
+        listeners.append(listener);
     }
     
     // Remove a listener.    
     void remove_listener(service_listener * listener) noexcept
     {
-        listeners.erase(listener);
+        if (listeners.is_queued(listener)) {
+            listeners.unlink(listener);
+        }
     }
     
     // Assuming there is one reference (from a control link), return true if this is the only reference,
@@ -703,15 +790,20 @@ class service_record
                 }
             }
         }
-        auto i = listeners.begin();
-        return (++i == listeners.end());
+        return !listeners.is_empty() && listeners.front() == listeners.tail();
+    }
+
+    // Check whether there are any listeners (eg control connection handles) for this service.
+    bool has_listeners() noexcept
+    {
+        return !listeners.is_empty();
     }
 
     // Check whether this service has no dependents/dependencies/references that would keep it from
     // unloading. Does not check listeners (i.e. mostly useful for placeholder services).
     bool is_unrefd() noexcept
     {
-        return depends_on.empty() && dependents.empty() && log_consumer == nullptr;
+        return depends_on.empty() && dependents.is_empty() && log_consumer == nullptr;
     }
 
     // Get fd corresponding to the read end of the pipe/socket connected to the write end used by the
@@ -736,6 +828,11 @@ class service_record
         return waiting_for_console;
     }
 
+    bool is_waiting_for_start_slot()
+    {
+        return waiting_for_start_slot;
+    }
+
     bool has_console()
     {
         return have_console;
@@ -751,6 +848,27 @@ class service_record
         return {};
     }
 
+    // Get the automatic restart backoff state: the delay to apply before the next restart, and the
+    // number of consecutive restarts over which it has been increased. Returns false if the service
+    // doesn't restart with backoff.
+    virtual bool get_restart_backoff(time_val &delay, unsigned &count) noexcept
+    {
+        return false;
+    }
+
+    // Get the current resource usage of the service (i.e. of its cgroup). Returns false if not
+    // available (the service does not run in a cgroup); otherwise, usage.flags indicates which
+    // values could be read.
+    virtual bool get_resource_usage(service_resource_usage &usage) noexcept
+    {
+        return false;
+    }
+
+    // Get the memory used by this service record: the size of the record object, and (an estimate
+    // of) the heap memory held for its dependencies, strings, buffers and so on. Subclasses which
+    // add to the record override this to report their own size and additional heap memory.
+    virtual void get_mem_usage(service_mem_usage &usage) noexcept;
+
     void set_file_mod_time(struct timespec load_time_p)
     {
         sdf_mod_time = load_time_p;
@@ -800,13 +918,7 @@ class service_record
     service_dep &add_dep(service_record *to, dependency_type dep_type, dep_list::iterator i)
     {
         auto pre_i = depends_on.emplace(i, this, to, dep_type);
-        try {
-            to->dependents.push_back(&(*pre_i));
-        }
-        catch (...) {
-            depends_on.erase(pre_i);
-            throw;
-        }
+        to->dependents.append(&(*pre_i));
 
         if (dep_type != dependency_type::BEFORE && dep_type != dependency_type::AFTER) {
             if (dep_type == dependency_type::REGULAR || dep_type == dependency_type::PREPARED_BY
@@ -852,12 +964,7 @@ class service_record
     dep_list::iterator rm_dep(dep_list::iterator i) noexcept
     {
         auto to = i->get_to();
-        for (auto j = to->dependents.begin(); ; ++j) {
-            if (*j == &(*i)) {
-                to->dependents.erase(j);
-                break;
-            }
-        }
+        to->dependents.unlink(&(*i));
         if (i->holding_acq) {
             to->release();
         }
@@ -937,6 +1044,12 @@ class placeholder_service : public service_record {
         log_output_fd = fds.second;
     }
 
+    void get_mem_usage(service_mem_usage &usage) noexcept override
+    {
+        service_record::get_mem_usage(usage);
+        usage.record_size = sizeof(*this);
+    }
+
     ~placeholder_service()
     {
         if (log_output_fd != -1) {
@@ -962,6 +1075,12 @@ class triggered_service : public service_record {
         return true;
     }
 
+    void get_mem_usage(service_mem_usage &usage) noexcept override
+    {
+        service_record::get_mem_usage(usage);
+        usage.record_size = sizeof(*this);
+    }
+
     void set_trigger(bool new_trigger) noexcept
     {
         is_triggered = new_trigger;
@@ -971,6 +1090,34 @@ class triggered_service : public service_record {
     }
 };
 
+// Hash and equality functors for indexing service records by name. These allow lookup of a record
+// via a string_view (as well as via another record).
+struct hash_svc_name
+{
+    size_t operator()(const service_record *svc) const noexcept
+    {
+        return hash(string_view(svc->get_name()));
+    }
+
+    size_t operator()(const string_view &name) const noexcept
+    {
+        return hash(name);
+    }
+};
+
+struct svc_name_equal
+{
+    bool operator()(const service_record *a, const service_record *b) const noexcept
+    {
+        return a->get_name() == b->get_name();
+    }
+
+    bool operator()(const service_record *svc, const string_view &name) const noexcept
+    {
+        return name == string_view(svc->get_name());
+    }
+};
+
 inline auto extract_prop_queue(service_record *sr) -> decltype(sr->prop_queue_node) &
 {
     return sr->prop_queue_node;
@@ -986,11 +1133,18 @@ inline auto extract_console_queue(service_record *sr) -> decltype(sr->console_qu
     return sr->console_queue_node;
 }
 
+inline auto extract_start_queue(service_record *sr) -> decltype(sr->start_queue_node) &
+{
+    return sr->start_queue_node;
+}
+
 /*
  * A service_set, as the name suggests, manages a set of services.
  *
  * Other than the ability to find services by name, the service set manages various queues.
- * One is the queue for processes wishing to acquire the console. There is also a set of
+ * One is the queue for processes wishing to acquire the console. Another is the queue of services
+ * waiting for a start slot, when the number of services concurrently starting a process is
+ * limited (by priority, rather than first-come first-served). There is also a set of
  * processes that want to start, and another set of those that want to stop. These latter
  * two "queues" (not really queues since their order is not important) are used to prevent too
  * much recursion and to prevent service states from "bouncing" too rapidly.
@@ -1008,7 +1162,18 @@ class service_set
 {
     protected:
     int active_services;
-    std::list<service_record *> records;
+
+    // All records in the set, in order of service identifier. (Records are added with increasing
+    // identifiers, and a replacement record takes over the position and identifier of the
+    // original; so a listing can be resumed after a given identifier even if records have been
+    // added or removed meanwhile).
+    std::vector<service_record *> records;
+
+    // Index of records by name. If more than one record with the same name is present in the
+    // set (which can occur transiently, eg when a service is unloaded and replaced by a placeholder),
+    // the most recently added record is the one indexed.
+    dinit_unordered_set<service_record *, hash_svc_name, svc_name_equal> records_by_name;
+
     bool restart_enabled; // whether automatic restart is enabled (allowed)
     
     shutdown_type_t shutdown_type = shutdown_type_t::NONE;  // Shutdown type, if stopping
@@ -1016,10 +1181,65 @@ class service_set
     // Services waiting for exclusive access to the console
     dlist<service_record, extract_console_queue> console_queue;
 
+    // Services waiting for a start slot (ordered by start priority), the maximum number of start
+    // slots (0 = unlimited) and the number currently held
+    dlist<service_record, extract_start_queue> start_queue;
+    unsigned start_limit = 0;
+    unsigned start_slots_used = 0;
+
+    // Assign start slots to queued services, while any are available
+    void pull_start_queue() noexcept;
+
     // Propagation and start/stop "queues" - list of services waiting for processing
     slist<service_record, extract_prop_queue> prop_queue;
     slist<service_record, extract_stop_queue> stop_queue;
-    
+
+    // Whether a batch of events is being dispatched, and whether queue processing has been
+    // deferred until the end of the batch (see process_queues_batched())
+    bool in_batch = false;
+    bool batch_processing_due = false;
+
+    // Identifier to be assigned to the next service added to the set
+    uint32_t next_service_id = 1;
+
+    // History of recent events (circular buffer, indexed by sequence number), and the sequence
+    // number of the most recent event. Allows a subscriber to catch up on missed events.
+    static constexpr unsigned event_history_size = 256;
+    service_set_event_t event_history[event_history_size] {};
+    uint64_t event_seq = 0;
+
+    // Listeners for events on all services in the set
+    std::unordered_set<service_set_listener *> set_listeners;
+
+    // Record an event in the history, and notify set listeners.
+    void record_event(service_record *svc, service_set_event_t::kind_t kind,
+            service_event_t event = service_event_t::STARTED) noexcept
+    {
+        service_set_event_t &ev = event_history[++event_seq % event_history_size];
+        ev.seq = event_seq;
+        ev.service = svc;
+        ev.service_id = svc->get_service_id();
+        ev.kind = kind;
+        ev.event = event;
+        ev.state = svc->get_state();
+        ev.target_state = svc->get_target_state();
+
+        for (auto l : set_listeners) {
+            l->service_set_event(ev);
+        }
+    }
+
+    // Find the position of a record (which must be present) in the records vector. This is a
+    // binary search by service identifier; a linear scan here would make loading n services (each
+    // of which replaces the dummy record added while its dependencies are loaded) O(n^2).
+    std::vector<service_record *>::iterator find_record(service_record *svc) noexcept
+    {
+        return std::lower_bound(records.begin(), records.end(), svc,
+                [](service_record *a, service_record *b) {
+                    return a->get_service_id() < b->get_service_id();
+                });
+    }
+
     public:
     service_set() noexcept
     {
@@ -1075,6 +1295,11 @@ class service_set
         return service;
     }
 
+    // Called when a service is about to be unloaded (via unload_service).
+    virtual void service_unloading(service_record *service) noexcept
+    {
+    }
+
     // Start the service with the given name. The named service will begin
     // transition to the 'started' state.
     //
@@ -1088,20 +1313,68 @@ class service_set
         service_set::start_service(record);
     }
     
+    // Add a service record to the set.
+    // Throws:
+    //   std::bad_alloc
     void add_service(service_record *svc)
     {
+        svc->set_service_id(next_service_id++);
         records.push_back(svc);
+        try {
+            auto ins = records_by_name.insert(svc);
+            if (!ins.second) {
+                // Another record with the same name exists; the new record supersedes it.
+                *ins.first = svc;
+            }
+        }
+        catch (...) {
+            records.pop_back();
+            throw;
+        }
+
+        if (svc->get_type() != service_type_t::PLACEHOLDER) {
+            record_event(svc, service_set_event_t::kind_t::ADDED);
+        }
     }
     
+    // Remove a service record from the set (does not delete the record).
     void remove_service(service_record *svc) noexcept
     {
-        records.erase(std::find(records.begin(), records.end(), svc));
+        records.erase(find_record(svc));
+        auto i = records_by_name.find(string_view(svc->get_name()));
+        if (i != records_by_name.end() && *i == svc) {
+            records_by_name.erase(i);
+        }
+
+        for (auto &ev : event_history) {
+            if (ev.service == svc) ev.service = nullptr;
+        }
+
+        if (svc->get_type() != service_type_t::PLACEHOLDER) {
+            record_event(svc, service_set_event_t::kind_t::REMOVED);
+            event_history[event_seq % event_history_size].service = nullptr;
+        }
     }
 
+    // Replace a service record with another record. The replacement must have the same name as the
+    // original, and takes over its identifier.
     void replace_service(service_record *orig, service_record *replacement) noexcept
     {
-        auto i = std::find(records.begin(), records.end(), orig);
-        *i = replacement;
+        *find_record(orig) = replacement;
+        auto j = records_by_name.find(string_view(orig->get_name()));
+        if (j != records_by_name.end() && *j == orig) {
+            *j = replacement;
+        }
+
+        replacement->set_service_id(orig->get_service_id());
+        for (auto &ev : event_history) {
+            if (ev.service == orig) ev.service = replacement;
+        }
+
+        if (orig->get_type() == service_type_t::PLACEHOLDER
+                && replacement->get_type() != service_type_t::PLACEHOLDER) {
+            record_event(replacement, service_set_event_t::kind_t::ADDED);
+        }
     }
 
     // Unload a service, possibly replacing it with a placeholder service. This can fail with bad_alloc.
@@ -1132,8 +1405,9 @@ class service_set
             if (dept->dep_type == dependency_type::AFTER) {
                 make_placeholder();
                 dept->set_to(placeholder);
-                auto &ph_depts = placeholder->get_dependents();
-                ph_depts.splice(ph_depts.end(), svc_depts, i++);
+                ++i;
+                svc_depts.unlink(dept);
+                placeholder->get_dependents().append(dept);
                 continue;
             }
             ++i;
@@ -1153,16 +1427,65 @@ class service_set
         }
 
         // Proceed with unload.
+        service_unloading(svc);
         svc->prepare_for_unload();
         remove_service(svc);
         delete svc;
     }
 
-    // Get the list of all loaded services.
-    const std::list<service_record *> &list_services() noexcept
+    // Get the list of all loaded services (in order of service identifier).
+    const std::vector<service_record *> &list_services() noexcept
     {
         return records;
     }
+
+    // Get the position in the service list of the first service with an identifier greater than
+    // that given.
+    std::vector<service_record *>::const_iterator list_services_after(uint32_t id) const noexcept
+    {
+        return std::upper_bound(records.begin(), records.end(), id,
+                [](uint32_t id, const service_record *svc) { return id < svc->get_service_id(); });
+    }
+
+    // Add a listener for events on all services. A listener must only be added once. May throw
+    // std::bad_alloc.
+    void add_set_listener(service_set_listener *listener)
+    {
+        set_listeners.insert(listener);
+    }
+
+    void remove_set_listener(service_set_listener *listener) noexcept
+    {
+        set_listeners.erase(listener);
+    }
+
+    // Get the sequence number of the most recent event (0 if there have been no events).
+    uint64_t get_event_seq() noexcept
+    {
+        return event_seq;
+    }
+
+    // Check whether all events following the event with the given sequence number are still
+    // available in the event history.
+    bool has_events_since(uint64_t seq) noexcept
+    {
+        return seq <= event_seq && (event_seq - seq) <= event_history_size;
+    }
+
+    // Call the given function for each event following the event with the given sequence
+    // number, in order (requires has_events_since(seq)).
+    template <typename F> void replay_events_since(uint64_t seq, F f)
+    {
+        while (seq < event_seq) {
+            f(event_history[++seq % event_history_size]);
+        }
+    }
+
+    // Record a service event (called when a service notifies its listeners).
+    void service_event_occurred(service_record *svc, service_event_t event) noexcept
+    {
+        record_event(svc, service_set_event_t::kind_t::SERVICE_EVENT, event);
+    }
     
     // Add a service record to the state propagation queue. The service record will have its
     // do_propagation() method called when the queue is processed.
@@ -1196,6 +1519,37 @@ class service_set
             }
         }
     }
+
+    // Begin dispatching a batch of events (eg. all events returned from a single poll of the event
+    // loop). Until end_batch() is called, processing of queues via process_queues_batched() is
+    // deferred, so that it is done once for the whole batch rather than once per event.
+    void begin_batch() noexcept
+    {
+        in_batch = true;
+    }
+
+    // Finish dispatching a batch of events, and process queues if processing was deferred.
+    void end_batch() noexcept
+    {
+        in_batch = false;
+        if (batch_processing_due) {
+            batch_processing_due = false;
+            process_queues();
+        }
+    }
+
+    // Process queues, or (if a batch of events is being dispatched) defer processing until the end
+    // of the batch. This should be used only from event handlers which need not observe the result
+    // of processing before returning (for example, it must not be used when processing a control
+    // command, since the reply may depend on the result).
+    void process_queues_batched() noexcept
+    {
+        if (in_batch) {
+            batch_processing_due = true;
+            return;
+        }
+        process_queues();
+    }
     
     // Set the console queue tail (returns previous tail)
     void append_console_queue(service_record *newTail) noexcept
@@ -1243,6 +1597,40 @@ class service_set
         return console_queue.is_queued(service);
     }
 
+    // Set the maximum number of services which may concurrently be starting a process (i.e. in
+    // STARTING state, with dependencies satisfied); 0 for no limit.
+    void set_start_limit(unsigned limit) noexcept
+    {
+        start_limit = limit;
+        pull_start_queue();
+    }
+
+    unsigned get_start_limit() noexcept
+    {
+        return start_limit;
+    }
+
+    // Acquire a start slot for a service. If none is available, the service is queued (according
+    // to priority) and false is returned; when a slot becomes available it will be assigned to
+    // the service, which will be added to the transition queue.
+    bool acquire_start_slot(service_record *service) noexcept;
+
+    // Release a start slot (previously acquired), and assign it to a waiting service if any.
+    void release_start_slot() noexcept;
+
+    void unqueue_start_slot(service_record *service) noexcept
+    {
+        if (start_queue.is_queued(service)) {
+            start_queue.unlink(service);
+        }
+    }
+
+    // Number of start slots currently held
+    unsigned count_start_slots_used() noexcept
+    {
+        return start_slots_used;
+    }
+
     // Notification from service that it is active (state != STOPPED)
     // Only to be called on the transition from inactive to active.
     void service_active(service_record *) noexcept;
@@ -1262,9 +1650,9 @@ class service_set
     {
         restart_enabled = false;
         shutdown_type = type;
-        for (std::list<service_record *>::iterator i = records.begin(); i != records.end(); ++i) {
-            (*i)->stop(false);
-            (*i)->unpin();
+        for (service_record *svc : records) {
+            svc->stop(false);
+            svc->unpin();
         }
         process_queues();
     }
@@ -1287,11 +1675,24 @@ class service_set
     }
 };
 
+inline void service_record::notify_listeners(service_event_t event) noexcept
+{
+    for (auto l : listeners) {
+        l->service_event(this, event);
+    }
+    services->service_event_occurred(this, event);
+}
+
+class auto_reloader;
+
 // A service set which loads services from one of several service directories.
 class dirload_service_set : public service_set
 {
     service_dir_pathlist service_dirs;
 
+    // Watcher for changes to service descriptions, if automatic reload is enabled
+    auto_reloader *reloader = nullptr;
+
     // Implementation of service load/reload.
     // Find a service record, or load it from file. If the service has dependencies, load those also.
     //
@@ -1329,6 +1730,8 @@ class dirload_service_set : public service_set
 
     dirload_service_set(const dirload_service_set &) = delete;
 
+    ~dirload_service_set() noexcept;
+
     int get_service_dir_count() noexcept
     {
         return service_dirs.size();
@@ -1339,6 +1742,22 @@ class dirload_service_set : public service_set
         return service_dirs[n].get_dir();
     }
 
+    // Advise the operating system that the service description files in all service directories
+    // will be needed soon. This allows the files to be read ahead of time, concurrently, rather than
+    // one-at-a-time as each service is loaded. Errors are ignored (this is an optimisation only).
+    void preload_service_descriptions() noexcept;
+
+    // Enable automatic reload of services when their descriptions (or included files) are changed
+    // (see auto-reload.h). Changes are detected only for services loaded after this is called.
+    // Returns false on failure (which is logged).
+    bool enable_auto_reload() noexcept;
+
+    // Get the automatic reload watcher; returns nullptr if automatic reload is not enabled.
+    auto_reloader *get_auto_reloader() noexcept
+    {
+        return reloader;
+    }
+
     service_record *load_service(const char *name) override
     {
         return load_service(name, nullptr);
@@ -1349,6 +1768,8 @@ class dirload_service_set : public service_set
 
     service_record *reload_service(service_record *service) override;
 
+    void service_unloading(service_record *service) noexcept override;
+
     int get_set_type_id() noexcept override
     {
         return SSET_TYPE_DIRLOAD;
@@ -11,11 +11,13 @@
 
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <fcntl.h>
 #include <pwd.h>
 #include <grp.h>
 #include <dirent.h>
 
 #include "proc-service.h"
+#include "auto-reload.h"
 #include "dinit-log.h"
 #include "dinit-util.h"
 #include "dinit-utmp.h"
@@ -72,6 +74,48 @@ static void process_dep_dir(dirload_service_set &sset,
     closedir(depdir);
 }
 
+void dirload_service_set::preload_service_descriptions() noexcept
+{
+#ifdef POSIX_FADV_WILLNEED
+    unsigned preload_count = 0;
+
+    for (auto &service_dir : service_dirs) {
+        DIR *dir = opendir(service_dir.get_dir());
+        if (dir == nullptr) {
+            continue;
+        }
+
+        int dir_fd = dirfd(dir);
+        dirent *dent;
+        while ((dent = readdir(dir)) != nullptr) {
+            if (!dinit_load::validate_service_name(dent->d_name)) continue;
+            if (dent->d_type != DT_REG) {
+                if (dent->d_type != DT_LNK && dent->d_type != DT_UNKNOWN) continue;
+                // Check the link target (or unknown type) is a regular file before opening it;
+                // opening some other type of file (eg a FIFO or device) might have side effects.
+                struct stat statbuf;
+                if (fstatat(dir_fd, dent->d_name, &statbuf, 0) == -1) continue;
+                if (!S_ISREG(statbuf.st_mode)) continue;
+            }
+
+            int fd = openat(dir_fd, dent->d_name, O_RDONLY | O_CLOEXEC | O_NONBLOCK);
+            if (fd == -1) continue;
+
+            // The advice may cause the file contents to be read asynchronously; the actual read when
+            // loading the service will then be satisfied from cache.
+            if (posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED) == 0) {
+                ++preload_count;
+            }
+            close(fd);
+        }
+
+        closedir(dir);
+    }
+
+    log(loglevel_t::DEBUG, "Requested read-ahead of ", preload_count, " service description file(s)");
+#endif
+}
+
 service_record * dirload_service_set::load_service(const char * name,
         const service_record *avoid_circular, int recursion_depth)
 {
@@ -83,6 +127,39 @@ service_record * dirload_service_set::reload_service(service_record * service)
     return load_reload_service(service->get_name().c_str(), service, service);
 }
 
+void dirload_service_set::service_unloading(service_record *service) noexcept
+{
+    if (reloader != nullptr) {
+        reloader->service_unloaded(service->get_name());
+    }
+}
+
+dirload_service_set::~dirload_service_set() noexcept
+{
+    delete reloader;
+}
+
+bool dirload_service_set::enable_auto_reload() noexcept
+{
+    if (reloader != nullptr) {
+        return true;
+    }
+
+    reloader = new (std::nothrow) auto_reloader(this);
+    if (reloader == nullptr) {
+        log(loglevel_t::ERROR, "Can't enable automatic reload: out of memory");
+        return false;
+    }
+
+    if (!reloader->start()) {
+        delete reloader;
+        reloader = nullptr;
+        return false;
+    }
+
+    return true;
+}
+
 using service_dep_list = decltype(std::declval<dinit_load::service_settings_wrapper<prelim_dep>>().depends);
 
 // Check for dependency cycles for the specified service (orig) with the given set of dependencies. Report
@@ -132,7 +209,7 @@ static void update_depenencies(service_record *service,
         // Insert all new dependents (from "before" relationships) before the first pre-existing dependent
         for (auto new_dept_i = before_deps.begin(); new_dept_i != before_deps.end(); ) {
             auto &new_dept = *new_dept_i;
-            depts.insert(depts.begin(), &new_dept);
+            depts.prepend(&new_dept);
             // splice the dependency into the dependent:
             auto next_dept_i = std::next(new_dept_i);
             auto &from_deps = new_dept.get_from()->get_dependencies();
@@ -487,7 +564,13 @@ service_record *dirload_service_set::load_reload_service(const char *fullname,
         }
     }
 
+    // Paths of the files read, if watching for changes:
+    std::vector<std::string> sdf_paths;
+
     file_input_stack input_stack;
+    if (reloader != nullptr) {
+        input_stack.record_file_paths(&sdf_paths);
+    }
     input_stack.push(std::move(service_filename), std::move(service_file), sdf_parent_fd.release());
 
     try {
@@ -724,8 +807,17 @@ service_record *dirload_service_set::load_reload_service(const char *fullname,
             // - this will be done later)
         }
 
+        #if SUPPORT_CGROUPS
+        if (settings.onstart_flags.create_cgroup && settings.run_in_cgroup.empty()) {
+            // Created cgroup is named after the service (relative to dinit's own cgroup) by default
+            settings.run_in_cgroup = fullname;
+        }
+        #endif
+
         if (service_type == service_type_t::PROCESS) {
             std::vector<const char *> stop_arg_parts = separate_args(settings.stop_command, settings.stop_command_offsets);
+            std::vector<const char *> logfile_compress_parts = separate_args(settings.logfile_compress,
+                    settings.logfile_compress_offsets);
             process_service *rvalps;
             if (create_new_record) {
                 if (reload_svc != nullptr) {
@@ -746,6 +838,8 @@ service_record *dirload_service_set::load_reload_service(const char *fullname,
             rvalps->set_env_file(std::move(settings.env_file));
             #if SUPPORT_CGROUPS
             rvalps->set_cgroup(std::move(settings.run_in_cgroup));
+            rvalps->set_cgroup_limits(settings.cgroup_memory_max, settings.cgroup_cpu_weight,
+                    settings.cgroup_io_weight);
             #endif
             #if SUPPORT_CAPABILITIES
             rvalps->set_cap(std::move(settings.capabilities), settings.secbits.get());
@@ -760,6 +854,7 @@ service_record *dirload_service_set::load_reload_service(const char *fullname,
             rvalps->set_rlimits(std::move(settings.rlimits));
             rvalps->set_restart_interval(settings.restart_interval, settings.max_restarts);
             rvalps->set_restart_delay(settings.restart_delay);
+            rvalps->set_restart_backoff(settings.restart_delay_max, settings.restart_delay_jitter);
             rvalps->set_stop_timeout(settings.stop_timeout);
             rvalps->set_start_timeout(settings.start_timeout);
             rvalps->set_extra_termination_signal(settings.term_signal);
@@ -769,6 +864,10 @@ service_record *dirload_service_set::load_reload_service(const char *fullname,
             rvalps->set_logfile_details(std::move(settings.logfile), settings.logfile_perms,
                     settings.logfile_uid, settings.logfile_gid);
             rvalps->set_log_buf_max(settings.max_log_buffer_sz);
+            rvalps->set_log_buf_discard_old(settings.log_buffer_discard_old);
+            rvalps->set_logfile_rotation(settings.logfile_rotate_size, settings.logfile_rotate_count,
+                    std::move(settings.logfile_compress), std::move(logfile_compress_parts),
+                    std::move(settings.logfile_compress_suffix));
             rvalps->set_log_mode(settings.log_type);
             #if USE_UTMPX
             rvalps->set_utmp_id(settings.inittab_id);
@@ -777,6 +876,8 @@ service_record *dirload_service_set::load_reload_service(const char *fullname,
         }
         else if (service_type == service_type_t::BGPROCESS) {
             std::vector<const char *> stop_arg_parts = separate_args(settings.stop_command, settings.stop_command_offsets);
+            std::vector<const char *> logfile_compress_parts = separate_args(settings.logfile_compress,
+                    settings.logfile_compress_offsets);
             bgproc_service *rvalps;
             if (create_new_record) {
                 if (reload_svc != nullptr) {
@@ -797,6 +898,8 @@ service_record *dirload_service_set::load_reload_service(const char *fullname,
             rvalps->set_env_file(std::move(settings.env_file));
             #if SUPPORT_CGROUPS
             rvalps->set_cgroup(std::move(settings.run_in_cgroup));
+            rvalps->set_cgroup_limits(settings.cgroup_memory_max, settings.cgroup_cpu_weight,
+                    settings.cgroup_io_weight);
             #endif
             #if SUPPORT_CAPABILITIES
             rvalps->set_cap(std::move(settings.capabilities), settings.secbits.get());
@@ -812,6 +915,7 @@ service_record *dirload_service_set::load_reload_service(const char *fullname,
             rvalps->set_pid_file(std::move(settings.pid_file));
             rvalps->set_restart_interval(settings.restart_interval, settings.max_restarts);
             rvalps->set_restart_delay(settings.restart_delay);
+            rvalps->set_restart_backoff(settings.restart_delay_max, settings.restart_delay_jitter);
             rvalps->set_stop_timeout(settings.stop_timeout);
             rvalps->set_start_timeout(settings.start_timeout);
             rvalps->set_extra_termination_signal(settings.term_signal);
@@ -819,11 +923,17 @@ service_record *dirload_service_set::load_reload_service(const char *fullname,
             rvalps->set_logfile_details(std::move(settings.logfile), settings.logfile_perms,
                     settings.logfile_uid, settings.logfile_gid);
             rvalps->set_log_buf_max(settings.max_log_buffer_sz);
+            rvalps->set_log_buf_discard_old(settings.log_buffer_discard_old);
+            rvalps->set_logfile_rotation(settings.logfile_rotate_size, settings.logfile_rotate_count,
+                    std::move(settings.logfile_compress), std::move(logfile_compress_parts),
+                    std::move(settings.logfile_compress_suffix));
             rvalps->set_log_mode(settings.log_type);
             settings.onstart_flags.runs_on_console = false;
         }
         else if (service_type == service_type_t::SCRIPTED) {
             std::vector<const char *> stop_arg_parts = separate_args(settings.stop_command, settings.stop_command_offsets);
+            std::vector<const char *> logfile_compress_parts = separate_args(settings.logfile_compress,
+                    settings.logfile_compress_offsets);
             scripted_service *rvalps;
             if (create_new_record) {
                 if (reload_svc != nullptr) {
@@ -844,6 +954,8 @@ service_record *dirload_service_set::load_reload_service(const char *fullname,
             rvalps->set_env_file(std::move(settings.env_file));
             #if SUPPORT_CGROUPS
             rvalps->set_cgroup(std::move(settings.run_in_cgroup));
+            rvalps->set_cgroup_limits(settings.cgroup_memory_max, settings.cgroup_cpu_weight,
+                    settings.cgroup_io_weight);
             #endif
             #if SUPPORT_CAPABILITIES
             rvalps->set_cap(std::move(settings.capabilities), settings.secbits.get());
@@ -863,6 +975,10 @@ service_record *dirload_service_set::load_reload_service(const char *fullname,
             rvalps->set_logfile_details(std::move(settings.logfile), settings.logfile_perms,
                     settings.logfile_uid, settings.logfile_gid);
             rvalps->set_log_buf_max(settings.max_log_buffer_sz);
+            rvalps->set_log_buf_discard_old(settings.log_buffer_discard_old);
+            rvalps->set_logfile_rotation(settings.logfile_rotate_size, settings.logfile_rotate_count,
+                    std::move(settings.logfile_compress), std::move(logfile_compress_parts),
+                    std::move(settings.logfile_compress_suffix));
             rvalps->set_log_mode(settings.log_type);
         }
         else {
@@ -891,6 +1007,7 @@ service_record *dirload_service_set::load_reload_service(const char *fullname,
         rval->set_socket_details(std::move(settings.socket_path), settings.socket_perms,
                 settings.socket_uid, settings.socket_gid);
         rval->set_chain_to(std::move(settings.chain_to_name));
+        rval->set_start_priority(settings.start_priority);
         rval->set_environment(std::move(srv_env));
         rval->set_file_mod_time(mod_time);
 
@@ -901,25 +1018,13 @@ service_record *dirload_service_set::load_reload_service(const char *fullname,
         if (create_new_record) {
             // switch dependencies on old record so that they refer to the new record
 
+            // --- Point of no return: mustn't fail from here ---
+
             // first link in all the (new) "before" dependents (one way at this stage):
             auto &dept_list = rval->get_dependents();
-            unsigned added_dependents = 0;
-            try {
-                for (auto &dept : before_deps) {
-                    dept_list.push_back(&dept);
-                    ++added_dependents;
-                }
+            for (auto &dept : before_deps) {
+                dept_list.append(&dept);
             }
-            catch (...) {
-                // Undo, since the invalid state will cause issues when the new service is disposed of
-                while (added_dependents > 0) {
-                    dept_list.pop_back();
-                    --added_dependents;
-                }
-                throw;
-            }
-
-            // --- Point of no return: mustn't fail from here ---
 
             // Splice in the new "before" dependencies
             auto i = before_deps.begin();
@@ -955,9 +1060,8 @@ service_record *dirload_service_set::load_reload_service(const char *fullname,
 
             // Transfer dependents from the original service record to the new record;
             // set links in all dependents on the original to point to the new service:
-            auto first_new_before = dept_list.begin();
-            dept_list.splice(first_new_before, reload_depts);
-            for (auto &dept : dept_list) {
+            dept_list.splice_before(reload_depts, dept_list.front());
+            for (auto dept : dept_list) {
                 dept->set_to(rval);
             }
 
@@ -997,8 +1101,7 @@ service_record *dirload_service_set::load_reload_service(const char *fullname,
             }
 
             // Finally, replace the old service with the new one:
-            auto iter = std::find(records.begin(), records.end(), orig_svc);
-            *iter = rval;
+            replace_service(orig_svc, rval);
             delete orig_svc;
         }
 
@@ -1013,6 +1116,10 @@ service_record *dirload_service_set::load_reload_service(const char *fullname,
 
         depth_updates.commit();
 
+        if (reloader != nullptr) {
+            reloader->service_loaded(rval->get_name().c_str(), sdf_paths);
+        }
+
         return rval;
     }
     catch (service_description_exc &setting_exc)
@@ -1040,3 +1147,304 @@ service_record *dirload_service_set::load_reload_service(const char *fullname,
         throw;
     }
 }
+
+// Automatic reload
+
+#ifdef __linux__
+static constexpr uint32_t auto_reload_watch_mask = IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM
+        | IN_CREATE | IN_DELETE | IN_ONLYDIR;
+#endif
+
+auto_reloader::~auto_reloader() noexcept
+{
+    if (inotify_fd != -1) {
+        watcher.deregister(event_loop);
+        timer.deregister(event_loop);
+        bp_sys::close(inotify_fd);
+    }
+}
+
+bool auto_reloader::start() noexcept
+{
+#ifdef __linux__
+    int fd = bp_sys::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd == -1) {
+        log(loglevel_t::ERROR, "Can't enable automatic reload: ", strerror(errno));
+        return false;
+    }
+
+    try {
+        int dir_count = services->get_service_dir_count();
+        for (int i = 0; i < dir_count; ++i) {
+            const char *dir = services->get_service_dir(i);
+            int wd = bp_sys::inotify_add_watch(fd, dir, auto_reload_watch_mask);
+            if (wd == -1) {
+                // Not an error: the directory need not exist
+                log(loglevel_t::DEBUG, "Can't watch service directory ", dir, ": ", strerror(errno));
+                continue;
+            }
+            service_dir_wds.insert(wd);
+        }
+
+        timer.add_timer(event_loop);
+        try {
+            watcher.add_watch(event_loop, fd, dasynq::IN_EVENTS);
+        }
+        catch (...) {
+            timer.deregister(event_loop);
+            throw;
+        }
+    }
+    catch (std::exception &exc) {
+        log(loglevel_t::ERROR, "Can't enable automatic reload: ", exc.what());
+        bp_sys::close(fd);
+        return false;
+    }
+
+    inotify_fd = fd;
+    return true;
+#else
+    log(loglevel_t::ERROR, "Can't enable automatic reload: not supported on this platform");
+    return false;
+#endif
+}
+
+void auto_reloader::forget_service(const std::string &name) noexcept
+{
+    for (auto i = include_users.begin(); i != include_users.end(); ) {
+        i->second.erase(name);
+        if (i->second.empty()) {
+            i = include_users.erase(i);
+        }
+        else {
+            ++i;
+        }
+    }
+}
+
+void auto_reloader::remove_unused_watches() noexcept
+{
+#ifdef __linux__
+    for (auto i = include_dir_wds.begin(); i != include_dir_wds.end(); ) {
+        int wd = i->second;
+        // (include_users is ordered by watch descriptor, so we can find any entry for this one):
+        auto users_it = include_users.lower_bound(std::make_pair(wd, std::string()));
+        if (wd != -1 && users_it != include_users.end() && users_it->first.first == wd) {
+            ++i;
+            continue;
+        }
+        // A directory may be both a service directory and hold included files, in which case it
+        // has a single watch, which must remain:
+        if (wd != -1 && service_dir_wds.count(wd) == 0) {
+            bp_sys::inotify_rm_watch(inotify_fd, wd);
+        }
+        i = include_dir_wds.erase(i);
+    }
+#endif
+}
+
+void auto_reloader::service_loaded(const char *name, const std::vector<std::string> &files) noexcept
+{
+#ifdef __linux__
+    // The service may have been loaded before (i.e. this is a reload), and may now include a
+    // different set of files:
+    try {
+        forget_service(name);
+    }
+    catch (std::bad_alloc &) {
+        // (only possible in constructing the name string)
+        log(loglevel_t::WARN, "Can't watch included files for service ", name, ": out of memory");
+        return;
+    }
+
+    // The service description itself (the first file) is in a service directory, which is already
+    // watched; record only the included files.
+    try {
+        for (size_t i = 1; i < files.size(); ++i) {
+            const std::string &path = files[i];
+            std::string dir = (std::string)parent_path(path);
+            if (dir.empty()) dir = ".";
+
+            int wd;
+            auto wd_it = include_dir_wds.find(dir);
+            if (wd_it != include_dir_wds.end()) {
+                wd = wd_it->second;
+            }
+            else {
+                wd = bp_sys::inotify_add_watch(inotify_fd, dir.c_str(), auto_reload_watch_mask);
+                if (wd == -1) {
+                    log(loglevel_t::WARN, "Can't watch directory ", dir, " (for service ", name, "): ",
+                            strerror(errno));
+                }
+                include_dir_wds.emplace(dir, wd);
+            }
+
+            if (wd != -1) {
+                include_users[std::make_pair(wd, std::string(base_name(path.c_str())))].insert(name);
+            }
+        }
+    }
+    catch (std::bad_alloc &) {
+        log(loglevel_t::WARN, "Can't watch included files for service ", name, ": out of memory");
+    }
+
+    remove_unused_watches();
+#endif
+}
+
+void auto_reloader::service_unloaded(const std::string &name) noexcept
+{
+    forget_service(name);
+    remove_unused_watches();
+}
+
+bool auto_reloader::file_changed(int wd, const char *name)
+{
+    bool affected = false;
+
+    if (service_dir_wds.count(wd) != 0) {
+        // A service description (not necessarily of a loaded service; that is checked when the
+        // batch is processed):
+        changed_files.insert(name);
+        affected = true;
+    }
+
+    auto users_it = include_users.find(std::make_pair(wd, std::string(name)));
+    if (users_it != include_users.end()) {
+        changed_services.insert(users_it->second.begin(), users_it->second.end());
+        affected = true;
+    }
+
+    return affected;
+}
+
+void auto_reloader::process_batch() noexcept
+{
+    batch_pending = false;
+    stats.batches++;
+
+    // Find the loaded services affected by the changes. We can't reload them while iterating the
+    // service list, since reloading may alter it.
+    std::vector<std::string> to_reload;
+    try {
+        for (service_record *svc : services->list_services()) {
+            if (svc->get_type() == service_type_t::PLACEHOLDER) continue;
+            const std::string &svc_name = svc->get_name();
+            bool affected = reload_all || changed_services.count(svc_name) != 0;
+            if (!affected) {
+                // A service instance ("name@arg") is loaded from the file for its base name:
+                auto at_pos = svc_name.find('@');
+                affected = changed_files.count(at_pos == std::string::npos ? svc_name
+                        : svc_name.substr(0, at_pos)) != 0;
+            }
+            if (affected) {
+                to_reload.push_back(svc_name);
+            }
+        }
+    }
+    catch (std::bad_alloc &) {
+        log(loglevel_t::ERROR, "Automatic reload: out of memory");
+        to_reload.clear();
+    }
+
+    changed_files.clear();
+    changed_services.clear();
+    reload_all = false;
+
+    for (const std::string &svc_name : to_reload) {
+        service_record *svc = services->find_service(svc_name);
+        if (svc == nullptr) continue;
+
+        if (svc->has_listeners()) {
+            log(loglevel_t::WARN, "Service ", svc_name, " description changed, but not reloaded: "
+                    "service is referenced by a control connection");
+            stats.skipped++;
+            continue;
+        }
+
+        try {
+            services->reload_service(svc);
+            log(loglevel_t::NOTICE, "Service ", svc_name, " reloaded (description changed)");
+            stats.reloads++;
+        }
+        catch (service_description_exc &sdexc) {
+            log_service_load_failure(sdexc);
+            stats.failures++;
+        }
+        catch (service_load_exc &slexc) {
+            log(loglevel_t::ERROR, "Could not reload service ", slexc.service_name, ": ",
+                    slexc.exc_description);
+            stats.failures++;
+        }
+        catch (std::bad_alloc &) {
+            log(loglevel_t::ERROR, "Could not reload service ", svc_name, ": out of memory");
+            stats.failures++;
+        }
+    }
+
+    services->process_queues();
+
+    time_val now;
+    event_loop.get_time(now, clock_type::MONOTONIC);
+    stats.last_latency = now - batch_start;
+    if (stats.max_latency < stats.last_latency) {
+        stats.max_latency = stats.last_latency;
+    }
+}
+
+dasynq::rearm auto_reloader::inotify_watcher::fd_event(eventloop_t &loop, int fd, int flags) noexcept
+{
+#ifdef __linux__
+    alignas(struct inotify_event) char buf[4096];
+    bool affected = false;
+
+    ssize_t r;
+    while ((r = bp_sys::read(fd, buf, sizeof(buf))) > 0) {
+        char *p = buf;
+        while (p < buf + r) {
+            struct inotify_event *event = (struct inotify_event *)p;
+            owner->stats.events++;
+            if (event->mask & IN_Q_OVERFLOW) {
+                // Events have been lost, so we don't know what has changed:
+                log(loglevel_t::WARN, "Automatic reload: change events lost; reloading all services");
+                owner->reload_all = true;
+                affected = true;
+            }
+            else if (event->len != 0) {
+                try {
+                    affected |= owner->file_changed(event->wd, event->name);
+                }
+                catch (std::bad_alloc &) {
+                    log(loglevel_t::ERROR, "Automatic reload: out of memory; reloading all services");
+                    owner->reload_all = true;
+                    affected = true;
+                }
+            }
+            p += sizeof(struct inotify_event) + event->len;
+        }
+    }
+
+    if (affected) {
+        // (Re-)arm the timer, so that the batch is processed once changes cease, unless the batch
+        // has already been delayed for the maximum time:
+        time_val now;
+        loop.get_time(now, clock_type::MONOTONIC);
+        if (!owner->batch_pending) {
+            owner->batch_pending = true;
+            owner->batch_start = now;
+            owner->timer.arm_timer_rel(loop, owner->debounce_delay);
+        }
+        else if (now - owner->batch_start < owner->max_batch_delay) {
+            owner->timer.arm_timer_rel(loop, owner->debounce_delay);
+        }
+    }
+#endif
+
+    return dasynq::rearm::REARM;
+}
+
+dasynq::rearm auto_reloader::debounce_timer::timer_expiry(eventloop_t &loop, int expiry_count) noexcept
+{
+    owner->process_batch();
+    return dasynq::rearm::NOOP;
+}
@@ -116,6 +116,9 @@ rearm exec_status_pipe_watcher::fd_event(eventloop_t &loop, int fd, int flags) n
         sr->exec_failed(exec_status);
     }
     else {
+        if (sr->get_state() == service_state_t::STARTING) {
+            sr->record_start_time(start_stage_t::EXEC_CONFIRMED);
+        }
         sr->exec_succeeded();
 
         if (sr->pid == -1) {
@@ -124,7 +127,7 @@ rearm exec_status_pipe_watcher::fd_event(eventloop_t &loop, int fd, int flags) n
         }
     }
 
-    sr->services->process_queues();
+    sr->services->process_queues_batched();
 
     return rearm::REMOVED;
 }
@@ -168,7 +171,7 @@ rearm stop_status_pipe_watcher::fd_event(eventloop_t &loop, int fd, int flags) n
         }
     }
 
-    sr->services->process_queues();
+    sr->services->process_queues_batched();
 
     return rearm::REMOVED;
 }
@@ -184,6 +187,7 @@ rearm ready_notify_watcher::fd_event(eventloop_t &, int fd, int flags) noexcept
                 service->process_timer.stop_timer(event_loop);
                 service->waiting_stopstart_timer = false;
             }
+            service->record_start_time(start_stage_t::READY);
             service->started();
         }
         else if (r == 0 || errno != EAGAIN) {
@@ -195,7 +199,7 @@ rearm ready_notify_watcher::fd_event(eventloop_t &, int fd, int flags) noexcept
             service->failed_to_start(false, false);
             service->bring_down();
         }
-        service->services->process_queues();
+        service->services->process_queues_batched();
     }
     else {
         // Just keep consuming data from the pipe:
@@ -211,6 +215,49 @@ rearm ready_notify_watcher::fd_event(eventloop_t &, int fd, int flags) noexcept
     return rearm::REARM;
 }
 
+#if SUPPORT_CGROUPS
+rearm cgroup_events_watcher::fd_event(eventloop_t &, int fd, int flags) noexcept
+{
+    // Consume the inotify events; we only care that cgroup.events has changed:
+    char buf[256];
+    while (bp_sys::read(fd, buf, sizeof(buf)) > 0) { }
+
+    if (service->is_cgroup_populated()) {
+        return rearm::REARM;
+    }
+
+    if (service->waiting_stopstart_timer) {
+        service->process_timer.stop_timer(event_loop);
+        service->waiting_stopstart_timer = false;
+    }
+    service->stop_cgroup_watch();
+    service->cgroup_emptied();
+    service->services->process_queues_batched();
+    return rearm::REMOVED;
+}
+#endif
+
+#if SUPPORT_PIDFD
+rearm pidfd_watcher::fd_event(eventloop_t &loop, int fd, int flags) noexcept
+{
+    base_process_service *sr = service;
+
+    // The process has terminated. It is not our child, so its exit status is not available; treat
+    // it as a clean exit.
+    sr->stop_pidfd_watch();
+    sr->pid = -1;
+    sr->exit_status = service_record::proc_status_t(CLD_EXITED, 0);
+
+    if (sr->waiting_stopstart_timer) {
+        sr->process_timer.stop_timer(loop);
+        sr->waiting_stopstart_timer = false;
+    }
+
+    sr->handle_exit_status();
+    return rearm::REMOVED;
+}
+#endif
+
 dasynq::rearm service_child_watcher::status_change(eventloop_t &loop, pid_t child,
         service_child_watcher::proc_status_t status) noexcept
 {
@@ -257,15 +304,55 @@ dasynq::rearm stop_child_watcher::status_change(eventloop_t &loop, pid_t child,
     }
 
     sr->handle_stop_exit();
-    sr->services->process_queues();
+    sr->services->process_queues_batched();
     return dasynq::rearm::NOOP;
 }
 
 rearm log_output_watcher::fd_event(eventloop_t &eloop, int fd, int flags) noexcept
 {
+    if (service->log_type == log_type_id::ROTFILE) {
+        // Read as much as is available (up to the size of the staging buffer) and write it to the
+        // logfile in one go. The staging buffer can be shared by all services, since output is
+        // written out before we return.
+        static char staging_buf[16 * 1024];
+        int r = bp_sys::read(fd, staging_buf, sizeof(staging_buf));
+        if (r == -1) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+                return rearm::REARM;
+            }
+            goto bad_read;
+        }
+        if (r == 0) goto eof_read;
+
+        service->write_rotfile(staging_buf, r);
+        return rearm::REARM;
+    }
+
     // In case buffer size has been decreased, check if we are already at the limit:
     if (service->log_buf_size >= service->log_buf_max) {
-        // If so, read and discard.
+        if (service->log_buf_discard_old && service->log_buf_size != 0) {
+            // Overwrite the oldest data. Note that if the buffer size has been decreased, we continue
+            // to use the current (larger) buffer.
+            unsigned buf_start = service->log_buf_start;
+            size_t max_read = std::max(service->log_buf_max / 8, 256u);
+            max_read = std::min((unsigned)max_read, service->log_buf_size - buf_start);
+
+            int r = bp_sys::read(fd, service->log_buffer.data() + buf_start, max_read);
+            if (r == -1) {
+                if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+                    return rearm::REARM;
+                }
+                goto bad_read;
+            }
+            if (r == 0) goto eof_read;
+
+            buf_start += r;
+            if (buf_start == service->log_buf_size) buf_start = 0;
+            service->log_buf_start = buf_start;
+            return rearm::REARM;
+        }
+
+        // Otherwise, read and discard.
         char buf[1024];
         int r = bp_sys::read(fd, buf, 1024);
         if (r == -1) {
@@ -279,6 +366,10 @@ rearm log_output_watcher::fd_event(eventloop_t &eloop, int fd, int flags) noexce
     }
 
     {
+        // If the buffer had wrapped, and the size has since been increased, we must unwrap it
+        // before adding to it:
+        service->unwrap_log_buffer();
+
         size_t max_read = std::max(service->log_buf_max / 8, 256u);
         max_read = std::min((unsigned)max_read, service->log_buf_max - service->log_buf_size);
 
@@ -371,8 +462,7 @@ void process_service::handle_exit_status() noexcept
         }
         if (!waiting_for_deps) {
             if (stop_pid == -1 && !waiting_for_execstat) {
-                stop_issued = false; // reset for next time
-                stopped();
+                stop_finished();
             }
         }
         else if (get_target_state() == service_state_t::STARTED && !pinned_stopped) {
@@ -388,7 +478,7 @@ void process_service::handle_exit_status() noexcept
     else {
         handle_unexpected_termination();
     }
-    services->process_queues();
+    services->process_queues_batched();
 }
 
 void process_service::exec_failed(run_proc_err errcode) noexcept
@@ -488,7 +578,7 @@ void bgproc_service::handle_exit_status() noexcept
                     }
                 }
             }
-            services->process_queues();
+            services->process_queues_batched();
             return;
         }
         else /* if (service_state == service_state_t::STARTED) */ {
@@ -518,7 +608,7 @@ void bgproc_service::handle_exit_status() noexcept
                 // Failed startup: no auto-restart.
                 stop_reason = stopped_reason_t::TERMINATED;
                 unrecoverable_stop();
-                services->process_queues();
+                services->process_queues_batched();
             }
 
             return;
@@ -552,8 +642,7 @@ void bgproc_service::handle_exit_status() noexcept
         // We won't log a non-zero exit status or termination due to signal here -
         // we assume that the process died because we signalled it.
         if (stop_pid == -1 && !waiting_for_execstat) {
-            stop_issued = false;
-            stopped();
+            stop_finished();
         }
     }
     else {
@@ -568,7 +657,7 @@ void bgproc_service::handle_exit_status() noexcept
         }
         handle_unexpected_termination();
     }
-    services->process_queues();
+    services->process_queues_batched();
 }
 
 void bgproc_service::exec_failed(run_proc_err errcode) noexcept
@@ -608,11 +697,11 @@ void scripted_service::handle_exit_status() noexcept
     if (current_state == service_state_t::STOPPING) {
         // We might be running the stop script, or we might be running the start script and have issued
         // a cancel order via SIGINT:
+        if (waiting_stopstart_timer) {
+            process_timer.stop_timer(event_loop);
+            waiting_stopstart_timer = false;
+        }
         if (interrupting_start) {
-            if (waiting_stopstart_timer) {
-                process_timer.stop_timer(event_loop);
-                waiting_stopstart_timer = false;
-            }
             // We issued a start interrupt, so we expected this failure:
             if (did_exit && exit_status.get_exit_status() != 0) {
                 log(loglevel_t::NOTICE, "Service ", get_name(), " start cancelled; exit code ",
@@ -649,7 +738,7 @@ void scripted_service::handle_exit_status() noexcept
             // can be stopped. There's not really any other useful course of action here.
             stopped();
         }
-        services->process_queues();
+        services->process_queues_batched();
     }
     else { // STARTING
         if (exit_status.did_exit_clean()) {
@@ -674,7 +763,7 @@ void scripted_service::handle_exit_status() noexcept
             stop_reason = stopped_reason_t::FAILED;
             failed_to_start();
         }
-        services->process_queues();
+        services->process_queues_batched();
     }
 }
 
@@ -738,6 +827,16 @@ bgproc_service::read_pid_file(proc_status_t *exit_status) noexcept
         child_info.si_pid = 0; // for portability
         int waitid_r = bp_sys::waitid(P_PID, pid, &child_info, WNOHANG | WEXITED);
         if (waitid_r == -1 && errno == ECHILD) {
+            // The process is not our child, so we can't wait for it; watch it via a pidfd instead,
+            // if possible.
+            #if SUPPORT_PIDFD
+            stop_pidfd_watch();
+            if (watch_pidfd()) {
+                tracking_child = true;
+                return pid_result_t::OK;
+            }
+            #endif
+
             // We can't track this child - check process exists:
             if (bp_sys::kill(pid, 0) == 0 || errno != ESRCH) {
                 log(loglevel_t::WARN, get_name(), ": unable to supervise process with pid ", pid);
@@ -899,6 +998,17 @@ bool process_service::start_stop_process(const std::vector<const char *> &cmd) n
         logfile = "/dev/null";
     }
 
+    run_proc_env *proc_env;
+    try {
+        proc_env = &get_proc_env(true);
+    }
+    catch (std::bad_alloc &) {
+        log(loglevel_t::ERROR, get_name(), ": can't launch stop command; out of memory");
+        bp_sys::close(pipefd[0]);
+        bp_sys::close(pipefd[1]);
+        return false;
+    }
+
     bool child_status_registered = false;
 
     // Set up complete, now fork and exec:
@@ -936,6 +1046,7 @@ bool process_service::start_stop_process(const std::vector<const char *> &cmd) n
         run_params.env_file = env_file.c_str();
         run_params.nice_is_set = nice_is_set;
         run_params.nice = nice;
+        run_params.proc_env = proc_env;
         #if SUPPORT_CGROUPS
         run_params.run_in_cgroup = run_in_cgroup.c_str();
         #endif
@@ -65,6 +65,9 @@ static int move_reserved_fd(int *fd, int min_fd)
 void base_process_service::run_child_proc(run_proc_params params) noexcept
 {
     // Child process. Must not risk throwing any uncaught exception from here until exit().
+    // If we were launched via bp_sys::vfork_call, we share memory with the parent: we must also
+    // avoid allocating or modifying shared state (other than the buffers in params.proc_env). See
+    // can_vfork_spawn() for the settings which are excluded on that basis.
     const char * const *args = params.args;
     const char *working_dir = params.working_dir;
     const char *logfile = params.logfile;
@@ -104,16 +107,8 @@ void base_process_service::run_child_proc(run_proc_params params) noexcept
     sigfillset(&sigall_set);
     sigprocmask(SIG_SETMASK, &sigall_set, nullptr);
 
-    constexpr int bufsz = 11 + type_max_num_digits<pid_t>() + 1;
-    // "LISTEN_PID=" - 11 characters; the expression above calculates the maximum number of bytes
-    // required for LISTEN_PID=nnn, including nul terminator, where nnn is a pid_t in decimal
-    char nbuf[bufsz];
-
-    // "DINIT_CS_FD=" - 12 bytes.
-    constexpr int csenvbufsz = 12 + type_max_num_digits<int>() + 1;
-    char csenvbuf[csenvbufsz];
-
-    environment::env_map proc_env_map;
+    // The environment has been prepared by the parent; we just need to fill in some values.
+    run_proc_env &proc_env = *params.proc_env;
 
     run_proc_err err;
     err.stage = exec_stage::ARRANGE_FDS;
@@ -172,50 +167,24 @@ void base_process_service::run_child_proc(run_proc_params params) noexcept
         if (notify_fd == -1) goto failure_out;
     }
 
-    try {
-        // Set up notify-fd variable:
-        if (notify_var != nullptr && *notify_var != 0) {
-            err.stage = exec_stage::SET_NOTIFYFD_VAR;
-            // We need to do an allocation: the variable name length, '=', and space for the value,
-            // and nul terminator:
-            int notify_var_len = strlen(notify_var);
-            int req_sz = notify_var_len + 1 /* '=' */ + type_max_num_digits<int>() + 1 /* '\0' */;
-            char *var_str = (char *)malloc(req_sz);
-            if (var_str == nullptr) goto failure_out;
-            buf_print(var_str, notify_var, '=', notify_fd);
-            service_env.set_var(var_str);
-        }
-
-        // Set up Systemd-style socket activation:
-        if (socket_fd != -1) {
-            err.stage = exec_stage::SETUP_ACTIVATION_SOCKET;
-
-            // If we passing a pre-opened socket, it has to be fd number 3. (Thanks, Systemd).
-            if (dup2(socket_fd, 3) == -1) goto failure_out;
-            if (socket_fd != 3) close(socket_fd);
+    // Set up notify-fd variable:
+    if (!proc_env.notify_var.empty()) {
+        buf_print(&proc_env.notify_var[strlen(notify_var) + 1], notify_fd);
+    }
 
-            service_env.set_var("LISTEN_FDS=1");
-            buf_print(nbuf, "LISTEN_PID=", getpid());
-            service_env.set_var(nbuf);
-        }
+    // Set up Systemd-style socket activation:
+    if (socket_fd != -1) {
+        err.stage = exec_stage::SETUP_ACTIVATION_SOCKET;
 
-        if (csfd != -1) {
-            err.stage = exec_stage::SETUP_CONTROL_SOCKET;
-            buf_print(csenvbuf, "DINIT_CS_FD=", csfd);
-            service_env.set_var(csenvbuf);
-        }
+        // If we passing a pre-opened socket, it has to be fd number 3. (Thanks, Systemd).
+        if (dup2(socket_fd, 3) == -1) goto failure_out;
+        if (socket_fd != 3) close(socket_fd);
 
-        // We'll re-use READ_ENV_FILE stage here; it's accurate enough.
-        err.stage = exec_stage::READ_ENV_FILE;
-        proc_env_map = service_env.build(main_env);
+        buf_print(proc_env.listen_pid + 11 /* "LISTEN_PID=" */, getpid());
     }
-    catch (std::system_error &sys_err) {
-        errno = sys_err.code().value();
-        goto failure_out;
-    }
-    catch (std::bad_alloc &) {
-        errno = ENOMEM;
-        goto failure_out;
+
+    if (csfd != -1) {
+        buf_print(proc_env.cs_fd + 12 /* "DINIT_CS_FD=" */, csfd);
     }
 
     if (working_dir != nullptr && *working_dir != 0) {
@@ -496,7 +465,7 @@ void base_process_service::run_child_proc(run_proc_params params) noexcept
 
     err.stage = exec_stage::DO_EXEC;
     // (on linux we could use execvpe, but it's not POSIX and not in eg FreeBSD).
-    bp_sys::environ = const_cast<char **>(proc_env_map.env_list.data());
+    bp_sys::environ = const_cast<char **>(proc_env.env_map.env_list.data());
     execvp(args[0], const_cast<char **>(args));
 
     // If we got here, the exec failed:
@@ -20,24 +20,14 @@
  * See service.h for details.
  */
 
-// Find the requested service by name.
-static service_record * find_service(const std::list<service_record *> & records,
-                                    const char *name) noexcept
-{
-    using std::list;
-    list<service_record *>::const_iterator i = records.begin();
-    for ( ; i != records.end(); ++i ) {
-        if (strcmp((*i)->get_name().c_str(), name) == 0) {
-            return *i;
-        }
-    }
-    return nullptr;
-}
-
 service_record * service_set::find_service(const std::string &name, bool find_placeholders) noexcept
 {
-    service_record *r = ::find_service(records, name.c_str());
-    if (r != nullptr && !find_placeholders && r->get_type() == service_type_t::PLACEHOLDER) {
+    auto i = records_by_name.find(string_view(name));
+    if (i == records_by_name.end()) {
+        return nullptr;
+    }
+    service_record *r = *i;
+    if (!find_placeholders && r->get_type() == service_type_t::PLACEHOLDER) {
         return nullptr;
     }
     return r;
@@ -48,8 +38,7 @@ void service_record::prepare_for_unload() noexcept
     // Remove all dependencies:
     for (auto &dep : depends_on) {
         service_record *dependency = dep.get_to();
-        auto &dep_dpts = dependency->dependents;
-        dep_dpts.erase(std::find(dep_dpts.begin(), dep_dpts.end(), &dep));
+        dependency->dependents.unlink(&dep);
         if (dep.dep_type == dependency_type::AFTER) {
             if (dependency->get_type() == service_type_t::PLACEHOLDER) {
                 if (dependency->is_unrefd()) {
@@ -81,6 +70,8 @@ void service_record::stopped() noexcept
         release_console();
     }
 
+    release_start_slot();
+
     force_stop = false;
 
     // If we are to re-start, restarting should have been set true and desired_state should be STARTED.
@@ -385,6 +376,8 @@ void service_record::do_start() noexcept
         notify_listeners(service_event_t::STOPCANCELLED);
     }
     else { // !was_active
+        std::fill_n(start_times, NUM_START_STAGES, 0);
+        record_start_time(start_stage_t::REQUESTED);
         services->service_active(this);
         prop_require = !prop_release;
         prop_release = false;
@@ -445,6 +438,26 @@ bool service_record::check_deps_started() noexcept
 
 void service_record::all_deps_started() noexcept
 {
+    if (waiting_for_start_slot) {
+        return;
+    }
+
+    // We may get here again after acquiring a start slot or the console; only record the time at
+    // which dependencies first started:
+    if (!have_start_slot && !have_console) {
+        record_start_time(start_stage_t::DEPS_STARTED);
+    }
+
+    // Wait for a start slot before queueing for the console, so that a service doesn't hold the
+    // console while it waits for other services to start:
+    if (!have_start_slot && needs_start_slot()) {
+        if (!services->acquire_start_slot(this)) {
+            waiting_for_start_slot = true;
+            return;
+        }
+        have_start_slot = true;
+    }
+
     if (onstart_flags.starts_on_console && !have_console) {
         queue_for_console();
         return;
@@ -458,6 +471,13 @@ void service_record::all_deps_started() noexcept
     }
 }
 
+void service_record::record_start_time(start_stage_t stage) noexcept
+{
+    time_val now;
+    event_loop.get_time(now, clock_type::MONOTONIC, true);
+    start_times[static_cast<int>(stage)] = uint64_t(now.seconds()) * 1000000000u + now.nseconds();
+}
+
 void service_record::acquired_console() noexcept
 {
     waiting_for_console = false;
@@ -478,6 +498,8 @@ void service_record::acquired_console() noexcept
 
 void service_record::started() noexcept
 {
+    release_start_slot();
+
     // If we start on console but don't keep it, release it now:
     if (have_console && !onstart_flags.runs_on_console) {
         bp_sys::tcsetpgrp(0, bp_sys::getpgrp());
@@ -485,6 +507,7 @@ void service_record::started() noexcept
     }
 
     log_service_started(get_name());
+    record_start_time(start_stage_t::STARTED);
     service_state = service_state_t::STARTED;
     notify_listeners(service_event_t::STARTED);
 
@@ -519,13 +542,15 @@ void service_record::failed_to_start(bool depfailed, bool immediate_stop) noexce
         waiting_for_console = false;
     }
 
+    release_start_slot();
+
     if (start_explicit) {
         start_explicit = false;
         release(false);
     }
 
     // Cancel start of dependents:
-    for (auto & dept : dependents) {
+    for (auto dept : dependents) {
         switch (dept->dep_type) {
         case dependency_type::REGULAR:
         case dependency_type::PREPARED_BY:
@@ -703,9 +728,9 @@ void service_record::do_stop(bool with_restart) noexcept
 
     if (service_state != service_state_t::STARTED) {
         if (service_state == service_state_t::STARTING) {
-            // If waiting for a dependency, or waiting for the console, we can interrupt start. Otherwise,
-            // we need to delegate to can_interrupt_start() (which can be overridden).
-            if (!waiting_for_deps && !waiting_for_console) {
+            // If waiting for a dependency, the console or a start slot, we can interrupt start.
+            // Otherwise, we need to delegate to can_interrupt_start() (which can be overridden).
+            if (!waiting_for_deps && !waiting_for_console && !waiting_for_start_slot) {
                 if (!can_interrupt_start()) {
                     // Well this is awkward: we're going to have to continue starting. We can stop once
                     // we've reached the started state.
@@ -723,6 +748,8 @@ void service_record::do_stop(bool with_restart) noexcept
                 waiting_for_console = false;
             }
 
+            release_start_slot();
+
             // We must have had desired_state == STARTED.
             notify_listeners(service_event_t::STARTCANCELLED);
 
@@ -902,11 +929,94 @@ void service_record::release_console() noexcept
     services->pull_console_queue();
 }
 
+void service_record::acquired_start_slot() noexcept
+{
+    waiting_for_start_slot = false;
+    have_start_slot = true;
+
+    // Continue starting via the transition queue (we may not be able to start immediately, eg. if
+    // the slot was released by a service in the middle of a state transition).
+    services->add_transition_queue(this);
+}
+
+void service_record::release_start_slot() noexcept
+{
+    if (waiting_for_start_slot) {
+        services->unqueue_start_slot(this);
+        waiting_for_start_slot = false;
+    }
+    else if (have_start_slot) {
+        have_start_slot = false;
+        services->release_start_slot();
+    }
+}
+
 bool service_record::interrupt_start() noexcept
 {
     return true;
 }
 
+void service_record::get_mem_usage(service_mem_usage &usage) noexcept
+{
+    // Each dependency is held in a std::list node (the dependency record plus two link pointers);
+    // dependents are linked through those same nodes and need no further storage.
+    constexpr size_t dep_node_size = sizeof(service_dep) + 2 * sizeof(void *);
+
+    usage.record_size = sizeof(*this);
+    usage.heap_size = heap_size_of(service_name) + heap_size_of(socket_path)
+            + heap_size_of(start_on_completion) + depends_on.size() * dep_node_size
+            + service_env.get_heap_usage();
+}
+
+// Count the dependents which are waiting for a service to start
+static unsigned count_waiting_dependents(service_record *sr) noexcept
+{
+    unsigned count = 0;
+    for (service_dep *dept : sr->get_dependents()) {
+        if (dept->waiting_on) ++count;
+    }
+    return count;
+}
+
+bool service_set::acquire_start_slot(service_record *service) noexcept
+{
+    if (start_limit == 0 || start_slots_used < start_limit) {
+        ++start_slots_used;
+        return true;
+    }
+
+    // Queue in order of priority. For equal priority, a service with more dependents waiting on it
+    // goes first (it is more likely to be on the critical path); otherwise, first-come first-served.
+    int priority = service->get_start_priority();
+    unsigned waiting_depts = count_waiting_dependents(service);
+    for (service_record *i = start_queue.front(); i != nullptr; i = start_queue.next_of(i)) {
+        int i_priority = i->get_start_priority();
+        if (priority > i_priority
+                || (priority == i_priority && waiting_depts > count_waiting_dependents(i))) {
+            start_queue.insert_before(service, i);
+            return false;
+        }
+    }
+
+    start_queue.append(service);
+    return false;
+}
+
+void service_set::release_start_slot() noexcept
+{
+    --start_slots_used;
+    pull_start_queue();
+}
+
+void service_set::pull_start_queue() noexcept
+{
+    while (!start_queue.is_empty() && (start_limit == 0 || start_slots_used < start_limit)) {
+        service_record *front = start_queue.pop_front();
+        ++start_slots_used;
+        front->acquired_start_slot();
+    }
+}
+
 void service_set::service_active(service_record *sr) noexcept
 {
     active_services++;
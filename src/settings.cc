@@ -34,6 +34,11 @@ setting_details all_settings[] = {
         {str_logfile_gid,           setting_id_t::LOGFILE_GID,              false,  true,   false},
         {str_log_type,              setting_id_t::LOG_TYPE,                 false,  true,   false},
         {str_log_buffer_size,       setting_id_t::LOG_BUFFER_SIZE,          false,  true,   false},
+        {str_log_buffer_overflow,   setting_id_t::LOG_BUFFER_OVERFLOW,      false,  true,   false},
+        {str_logfile_rotate_size,   setting_id_t::LOGFILE_ROTATE_SIZE,      false,  true,   false},
+        {str_logfile_rotate_count,  setting_id_t::LOGFILE_ROTATE_COUNT,     false,  true,   false},
+        {str_logfile_compress,      setting_id_t::LOGFILE_COMPRESS,         false,  true,   false},
+        {str_logfile_compress_suffix, setting_id_t::LOGFILE_COMPRESS_SUFFIX, false, true,   false},
 
         {str_consumer_of,           setting_id_t::CONSUMER_OF,              false,  true,   false},
         {str_restart,               setting_id_t::RESTART,                  false,  true,   false},
@@ -44,6 +49,8 @@ setting_details all_settings[] = {
         {str_termsignal,            setting_id_t::TERMSIGNAL,               false,  true,   false}, // (deprecated)
         {str_restart_limit_interval,setting_id_t::RESTART_LIMIT_INTERVAL,   false,  true,   false},
         {str_restart_delay,         setting_id_t::RESTART_DELAY,            false,  true,   false},
+        {str_restart_delay_max,     setting_id_t::RESTART_DELAY_MAX,        false,  true,   false},
+        {str_restart_delay_jitter,  setting_id_t::RESTART_DELAY_JITTER,     false,  true,   false},
         {str_restart_limit_count,   setting_id_t::RESTART_LIMIT_COUNT,      false,  true,   false},
         {str_stop_timeout,          setting_id_t::STOP_TIMEOUT,             false,  true,   false},
         {str_start_timeout,         setting_id_t::START_TIMEOUT,            false,  true,   false},
@@ -61,9 +68,13 @@ setting_details all_settings[] = {
         {str_rlimit_addrspace,      setting_id_t::SETTING_RLIMIT_ADDRSPACE, false,  true,   false},
 
         {str_nice,                  setting_id_t::NICE,                     false,  true,   false},
+        {str_start_priority,        setting_id_t::START_PRIORITY,           false,  true,   false},
 
 #if SUPPORT_CGROUPS
         {str_run_in_cgroup,         setting_id_t::RUN_IN_CGROUP,            false,  true,   false},
+        {str_cgroup_memory_max,     setting_id_t::CGROUP_MEMORY_MAX,        false,  true,   false},
+        {str_cgroup_cpu_weight,     setting_id_t::CGROUP_CPU_WEIGHT,        false,  true,   false},
+        {str_cgroup_io_weight,      setting_id_t::CGROUP_IO_WEIGHT,         false,  true,   false},
 #endif
 
 #if SUPPORT_CAPABILITIES
@@ -6,7 +6,10 @@
 
 #include <string>
 #include <iostream>
+#include <fstream>
 #include <exception>
+#include <vector>
+#include <unordered_map>
 
 #include <sys/reboot.h>
 #include <sys/types.h>
@@ -16,6 +19,12 @@
 #include <sys/stat.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <dirent.h>
+
+#ifdef __linux__
+#include <sys/mount.h>
+#include <sys/swap.h>
+#endif
 
 #include "cpbuffer.h"
 #include "control-cmds.h"
@@ -43,6 +52,7 @@ using clock_type = dasynq::clock_type;
 class subproc_buffer;
 
 void do_system_shutdown(shutdown_type_t shutdown_type);
+static bool other_processes_remain();
 static void unmount_disks(loop_t &loop, subproc_buffer &sub_buf);
 static void swap_off(loop_t &loop, subproc_buffer &sub_buf);
 static loop_t::child_proc_watcher::proc_status_t run_process(const char * prog_args[],
@@ -50,6 +60,14 @@ static loop_t::child_proc_watcher::proc_status_t run_process(const char * prog_a
 
 constexpr static int subproc_bufsize = 4096;
 
+// After sending TERM to all processes, we wait until they have all terminated, checking at this
+// interval (nanoseconds), up to this many times (before sending KILL):
+constexpr static long term_poll_interval = 20000000;
+constexpr static int term_max_polls = 50;
+
+// Maximum number of unmount/swapoff operations to run concurrently:
+constexpr static unsigned max_parallel_tasks = 16;
+
 constexpr static char output_lost_msg[] = "[Some output has not been shown due to buffer overflow]\n";
 
 // A buffer which maintains a series of overflow markers, used for capturing and echoing
@@ -558,21 +576,25 @@ void do_system_shutdown(shutdown_type_t shutdown_type)
     // Send TERM/KILL to all (remaining) processes
     kill(-1, SIGTERM);
 
-    // 1 second delay (while outputting from sub_buf):
-    bool timeout_reached = false;
-    dasynq::time_val timeout {1, 0};
-    dasynq::time_val interval {0,0};
+    // Wait until all processes have terminated, for up to 1 second (while outputting from sub_buf):
+    bool wait_done = false;
+    int polls = 0;
+    dasynq::time_val interval {0, term_poll_interval};
     loop_t::timer::add_timer(loop, clock_type::MONOTONIC, true /* relative */,
-            timeout.get_timespec(), interval.get_timespec(),
+            interval.get_timespec(), interval.get_timespec(),
             [&](loop_t &eloop, int expiry_count) -> rearm {
 
-        timeout_reached = true;
-        return rearm::REMOVE;
+        polls += expiry_count;
+        if (polls >= term_max_polls || !other_processes_remain()) {
+            wait_done = true;
+            return rearm::REMOVE;
+        }
+        return rearm::REARM;
     });
 
     do {
       loop.run();
-    } while (!timeout_reached);
+    } while (!wait_done);
 
     kill(-1, SIGKILL);
 
@@ -779,8 +801,387 @@ static loop_t::child_proc_watcher::proc_status_t run_process(const char * prog_a
     return sp_watcher.exit_status;
 }
 
+// Check whether any processes (other than this process and init) remain. Zombie processes and
+// kernel threads are disregarded. Returns true if processes remain or if it can't be determined.
+static bool other_processes_remain()
+{
+#ifdef __linux__
+    DIR *proc_dir = opendir("/proc");
+    if (proc_dir == nullptr) {
+        return true;
+    }
+
+    constexpr unsigned long pf_kthread = 0x00200000; // PF_KTHREAD, from the kernel's sched.h
+    pid_t self = getpid();
+    bool remain = false;
+
+    while (!remain) {
+        dirent *ent = readdir(proc_dir);
+        if (ent == nullptr) break;
+
+        char *endp;
+        long pid = strtol(ent->d_name, &endp, 10);
+        if (ent->d_name[0] < '0' || ent->d_name[0] > '9' || *endp != '\0' || pid <= 1
+                || pid == self) {
+            continue;
+        }
+
+        // Read the process state and flags from /proc/<pid>/stat. The second field (the command
+        // name, in parentheses) may contain spaces, so we look for the last ')':
+        char stat_path[32];
+        snprintf(stat_path, sizeof(stat_path), "/proc/%ld/stat", pid);
+        int stat_fd = open(stat_path, O_RDONLY);
+        if (stat_fd == -1) continue; // (process has gone)
+        char buf[512];
+        ssize_t r = read(stat_fd, buf, sizeof(buf) - 1);
+        close(stat_fd);
+        if (r <= 0) continue;
+        buf[r] = '\0';
+
+        char *p = strrchr(buf, ')');
+        char state;
+        unsigned long flags;
+        // state, ppid, pgrp, session, tty_nr, tpgid, flags:
+        if (p == nullptr || sscanf(p + 1, " %c %*d %*d %*d %*d %*d %lu", &state, &flags) != 2) {
+            remain = true;
+            break;
+        }
+
+        if (state != 'Z' && state != 'X' && (flags & pf_kthread) == 0) {
+            remain = true;
+        }
+    }
+
+    closedir(proc_dir);
+    return remain;
+#else
+    return true;
+#endif
+}
+
+#ifdef __linux__
+
+// A task (unmount or swapoff) in a parallel shutdown phase. A task is run only once the tasks which
+// must precede it have completed.
+struct shutdown_task
+{
+    std::string path;       // mount point or swap device/file
+    int successor = -1;     // index of the task which must wait for this one, -1 if none
+    unsigned pending = 0;   // number of preceding tasks not yet completed
+    bool skip = false;      // nothing to do (but still wait for preceding tasks)
+};
+
+// Run a set of tasks, each in a child process (via task_func), with up to max_parallel_tasks
+// running concurrently. Output from the child processes goes through the subprocess buffer.
+static void run_parallel_tasks(std::vector<shutdown_task> &tasks,
+        void (*task_func)(const shutdown_task &), loop_t &loop, subproc_buffer &sub_buf)
+{
+    class task_watcher : public loop_t::child_proc_watcher_impl<task_watcher>
+    {
+        public:
+        bool terminated = false;
+
+        rearm status_change(loop_t &, pid_t child, proc_status_t status)
+        {
+            terminated = true;
+            return rearm::REMOVE;
+        }
+    };
+
+    // Output pipe, shared by all tasks. Each task should write its output as a single line (via a
+    // single write) so that output from different tasks is not interleaved.
+    bool have_pipe = true;
+    int pipefds[2];
+    if (dasynq::pipe2(pipefds, O_NONBLOCK) == -1) {
+        sub_buf.append("Warning: could not create pipe for subprocess output\n");
+        have_pipe = false;
+    }
+
+    subproc_out_watch owatch {sub_buf};
+
+    if (have_pipe) {
+        try {
+            owatch.add_watch(loop, pipefds[0], dasynq::IN_EVENTS);
+        }
+        catch (...) {
+            sub_buf.append("Warning: could not create output watch for subprocess\n");
+            close(pipefds[0]);
+            close(pipefds[1]);
+            have_pipe = false;
+        }
+    }
+
+    std::vector<task_watcher> watchers(tasks.size());
+    std::vector<size_t> ready;
+    std::vector<size_t> running;
+
+    for (size_t i = 0; i < tasks.size(); ++i) {
+        if (tasks[i].pending == 0) {
+            ready.push_back(i);
+        }
+    }
+
+    auto complete = [&](size_t i) {
+        int succ = tasks[i].successor;
+        if (succ != -1 && --tasks[succ].pending == 0) {
+            ready.push_back(succ);
+        }
+    };
+
+    while (!ready.empty() || !running.empty()) {
+        while (!ready.empty() && running.size() < max_parallel_tasks) {
+            size_t i = ready.back();
+            ready.pop_back();
+            if (tasks[i].skip) {
+                complete(i);
+                continue;
+            }
+
+            // If we've buffered any messages/output, give them a chance to go out now:
+            loop.poll();
+
+            pid_t ch_pid;
+            try {
+                ch_pid = watchers[i].fork(loop);
+            }
+            catch (std::exception &e) {
+                sub_buf.append("Couldn't fork for ");
+                sub_buf.append(tasks[i].path.c_str());
+                sub_buf.append(": ");
+                sub_buf.append(e.what());
+                sub_buf.append("\n");
+                complete(i);
+                continue;
+            }
+
+            if (ch_pid == 0) {
+                // child
+                if (have_pipe) {
+                    dup2(pipefds[1], STDOUT_FILENO);
+                    dup2(pipefds[1], STDERR_FILENO);
+                    close(pipefds[0]);
+                    close(pipefds[1]);
+                }
+                task_func(tasks[i]);
+                _exit(0);
+            }
+
+            running.push_back(i);
+        }
+
+        if (running.empty()) continue;
+
+        loop.run();
+
+        for (auto it = running.begin(); it != running.end(); ) {
+            if (watchers[*it].terminated) {
+                complete(*it);
+                it = running.erase(it);
+            }
+            else {
+                ++it;
+            }
+        }
+    }
+
+    if (have_pipe) {
+        owatch.deregister(loop);
+        close(pipefds[0]);
+        close(pipefds[1]);
+    }
+}
+
+// Write a message (from a task child process) to standard output, as a single write.
+static void task_message(const std::string &msg)
+{
+    std::string line = msg + "\n";
+    ssize_t r = write(STDOUT_FILENO, line.data(), line.size());
+    (void)r;
+}
+
+// Decode octal escapes (\ooo) as used for paths in /proc/self/mountinfo and /proc/swaps.
+static std::string unescape_path(const std::string &path)
+{
+    std::string r;
+    for (size_t i = 0; i < path.size(); ++i) {
+        if (path[i] == '\\' && i + 3 < path.size() && path[i+1] >= '0' && path[i+1] <= '3'
+                && path[i+2] >= '0' && path[i+2] <= '7' && path[i+3] >= '0' && path[i+3] <= '7') {
+            r += (char)(((path[i+1] - '0') << 6) | ((path[i+2] - '0') << 3) | (path[i+3] - '0'));
+            i += 3;
+        }
+        else {
+            r += path[i];
+        }
+    }
+    return r;
+}
+
+// Extract the next space-separated field from a line, starting at (and updating) pos.
+static std::string next_field(const std::string &line, std::string::size_type &pos)
+{
+    auto start = line.find_first_not_of(' ', pos);
+    if (start == std::string::npos) {
+        pos = line.size();
+        return {};
+    }
+    auto end = line.find(' ', start);
+    if (end == std::string::npos) end = line.size();
+    pos = end;
+    return line.substr(start, end - start);
+}
+
+// Read the mount table (/proc/self/mountinfo) as a set of unmount tasks, in which each mount must
+// wait for the mounts beneath it. As per "umount -a", some pseudo-filesystems are not unmounted.
+// Returns false if the mount table can't be read.
+//   may throw: std::bad_alloc
+static bool read_mount_tasks(std::vector<shutdown_task> &tasks)
+{
+    static const char * const keep_fs_types[] = {
+            "proc", "devfs", "devpts", "sysfs", "rpc_pipefs", "nfsd"
+    };
+
+    std::ifstream mountinfo("/proc/self/mountinfo");
+    if (!mountinfo) {
+        return false;
+    }
+
+    std::unordered_map<int, size_t> id_map;
+    std::vector<int> parent_ids;
+
+    std::string line;
+    while (std::getline(mountinfo, line)) {
+        // Fields: mount ID, parent ID, major:minor, root, mount point, options, optional fields
+        // (terminated by "-"), file system type, source, super options.
+        std::string::size_type pos = 0;
+        std::string id_str = next_field(line, pos);
+        std::string parent_str = next_field(line, pos);
+        next_field(line, pos);
+        next_field(line, pos);
+        std::string mount_point = next_field(line, pos);
+        next_field(line, pos);
+        std::string field;
+        do {
+            field = next_field(line, pos);
+        } while (!field.empty() && field != "-");
+        std::string fs_type = next_field(line, pos);
+
+        if (mount_point.empty() || fs_type.empty()) {
+            return false;
+        }
+
+        shutdown_task task;
+        task.path = unescape_path(mount_point);
+        for (const char *keep_type : keep_fs_types) {
+            if (fs_type == keep_type) {
+                task.skip = true;
+            }
+        }
+
+        id_map[atoi(id_str.c_str())] = tasks.size();
+        parent_ids.push_back(atoi(parent_str.c_str()));
+        tasks.push_back(std::move(task));
+    }
+
+    for (size_t i = 0; i < tasks.size(); ++i) {
+        auto it = id_map.find(parent_ids[i]);
+        if (it != id_map.end() && it->second != i) {
+            tasks[i].successor = it->second;
+            tasks[it->second].pending++;
+        }
+    }
+
+    return true;
+}
+
+// Read the swap table (/proc/swaps) as a set of (independent) swapoff tasks. Returns false if the
+// swap table can't be read.
+//   may throw: std::bad_alloc
+static bool read_swap_tasks(std::vector<shutdown_task> &tasks)
+{
+    std::ifstream swaps("/proc/swaps");
+    if (!swaps) {
+        return false;
+    }
+
+    std::string line;
+    std::getline(swaps, line); // header
+    while (std::getline(swaps, line)) {
+        std::string::size_type pos = 0;
+        std::string path = next_field(line, pos);
+        if (path.empty()) continue;
+        shutdown_task task;
+        task.path = unescape_path(path);
+        tasks.push_back(std::move(task));
+    }
+
+    return true;
+}
+
+// Unmount a file system (run in a child process). If it can't be unmounted, remount it read-only
+// and detach it, so that the file system on which it is mounted may still be unmounted. The root
+// file system is only remounted read-only.
+static void unmount_task(const shutdown_task &task)
+{
+    const char *path = task.path.c_str();
+    bool is_root = (task.path == "/");
+
+    std::string msg;
+    if (!is_root) {
+        // EINVAL: not a mount point (already unmounted, eg via mount propagation)
+        if (umount2(path, 0) == 0 || errno == EINVAL || errno == ENOENT) {
+            return;
+        }
+        msg = "umount " + task.path + ": " + strerror(errno);
+    }
+
+    if (mount(nullptr, path, nullptr, MS_REMOUNT | MS_RDONLY, nullptr) == 0) {
+        if (!is_root) {
+            msg += "; remounted read-only";
+        }
+    }
+    else {
+        if (!is_root) msg += "; ";
+        msg += "couldn't remount " + task.path + " read-only: " + strerror(errno);
+    }
+
+    if (!is_root) {
+        umount2(path, MNT_DETACH);
+    }
+
+    if (!msg.empty()) {
+        task_message(msg);
+    }
+}
+
+// Turn off a swap device or file (run in a child process).
+static void swapoff_task(const shutdown_task &task)
+{
+    if (swapoff(task.path.c_str()) == -1) {
+        task_message("swapoff " + task.path + ": " + strerror(errno));
+    }
+}
+
+#endif
+
 static void unmount_disks(loop_t &loop, subproc_buffer &sub_buf)
 {
+#ifdef __linux__
+    // Unmount file systems ourselves, in parallel where they are independent. If the mount table
+    // can't be read, fall back to "umount -a".
+    try {
+        std::vector<shutdown_task> tasks;
+        if (read_mount_tasks(tasks)) {
+            run_parallel_tasks(tasks, unmount_task, loop, sub_buf);
+            return;
+        }
+    }
+    catch (std::exception &e) {
+        sub_buf.append("Couldn't read mount table: ");
+        sub_buf.append(e.what());
+        sub_buf.append("\n");
+    }
+#endif
+
     try {
 #if __NetBSD__
         const char * unmount_args[] = { "/sbin/umount", "-a", nullptr };
@@ -800,6 +1201,23 @@ static void unmount_disks(loop_t &loop, subproc_buffer &sub_buf)
 
 static void swap_off(loop_t &loop, subproc_buffer &sub_buf)
 {
+#ifdef __linux__
+    // Turn off all swap devices/files in parallel. If the swap table can't be read, fall back
+    // to "swapoff -a".
+    try {
+        std::vector<shutdown_task> tasks;
+        if (read_swap_tasks(tasks)) {
+            run_parallel_tasks(tasks, swapoff_task, loop, sub_buf);
+            return;
+        }
+    }
+    catch (std::exception &e) {
+        sub_buf.append("Couldn't read swap table: ");
+        sub_buf.append(e.what());
+        sub_buf.append("\n");
+    }
+#endif
+
     try {
 #if __NetBSD__
         const char * swapoff_args[] = { "/sbin/swapctl", "-U", nullptr };
@@ -0,0 +1,293 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cassert>
+
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "dinit-client-async.h"
+
+#ifdef NDEBUG
+#error "This file must be built with assertions ENABLED!"
+#endif
+
+// Tests for the asynchronous control protocol client, using a socket pair (one end for the client,
+// the other acting as the daemon).
+
+using dinit_cptypes::handle_t;
+using dinit_cptypes::envvar_len_t;
+
+class test_info_handler : public dinit_info_handler
+{
+    public:
+    std::vector<std::string> &log;
+
+    explicit test_info_handler(std::vector<std::string> &log_p) : log(log_p) { }
+
+    void service_event(handle_t handle, service_event_t event,
+            const dinit_service_status &status) override
+    {
+        assert(event == service_event_t::STARTED);
+        assert(status.state == service_state_t::STARTED);
+        assert(status.pid == 1234);
+        log.push_back("event " + std::to_string(handle));
+    }
+
+    void env_event(const char *var_and_val, bool overridden) override
+    {
+        log.push_back(std::string("env ") + var_and_val + (overridden ? " (overridden)" : ""));
+    }
+};
+
+static void make_socket_pair(int &client_fd, int &server_fd)
+{
+    int fds[2];
+    assert(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+    client_fd = fds[0];
+    server_fd = fds[1];
+    fcntl(client_fd, F_SETFL, fcntl(client_fd, F_GETFL) | O_NONBLOCK);
+}
+
+static void add_service_event(std::vector<char> &out, handle_t handle, bool v5)
+{
+    unsigned status_size = v5 ? STATUS_BUFFER5_SIZE : STATUS_BUFFER_SIZE;
+    size_t pos = out.size();
+    out.resize(pos + 3 + sizeof(handle) + status_size);
+    char *pkt = out.data() + pos;
+    pkt[0] = (char)(v5 ? cp_info::SERVICEEVENT5 : cp_info::SERVICEEVENT);
+    pkt[1] = (char)(3 + sizeof(handle) + status_size);
+    memcpy(pkt + 2, &handle, sizeof(handle));
+    pkt[2 + sizeof(handle)] = (char)service_event_t::STARTED;
+    char *status = pkt + 3 + sizeof(handle);
+    memset(status, 0, status_size);
+    status[0] = (char)service_state_t::STARTED;
+    status[1] = (char)service_state_t::STARTED;
+    status[2] = 16; // has pid
+    pid_t pid = 1234;
+    memcpy(status + 6, &pid, sizeof(pid));
+}
+
+static void add_env_event(std::vector<char> &out, const char *var_and_val, bool overridden)
+{
+    envvar_len_t ln = strlen(var_and_val) + 1;
+    out.push_back((char)cp_info::ENVEVENT);
+    out.push_back((char)(3 + sizeof(envvar_len_t)));
+    out.push_back(overridden ? 1 : 0);
+    out.insert(out.end(), (char *)&ln, (char *)&ln + sizeof(ln));
+    out.insert(out.end(), var_and_val, var_and_val + ln);
+}
+
+// Several requests are issued before any reply is received; replies (interleaved with information
+// packets) are delivered one byte at a time.
+void test_pipelined_requests()
+{
+    int client_fd, server_fd;
+    make_socket_pair(client_fd, server_fd);
+
+    std::vector<std::string> log;
+    test_info_handler info_handler(log);
+    dinit_async_conn conn(client_fd);
+    conn.set_info_handler(&info_handler);
+
+    conn.query_version([&](uint16_t min_version, uint16_t version) {
+        assert(min_version == 1 && version == 8);
+        log.push_back("version");
+    });
+    conn.load_service("test-service", false, [&](cp_rply reply, handle_t handle,
+            service_state_t state, service_state_t target_state) {
+        assert(reply == cp_rply::SERVICERECORD);
+        assert(handle == 7);
+        assert(state == service_state_t::STOPPED);
+        assert(target_state == service_state_t::STARTED);
+        log.push_back("loaded");
+    });
+    conn.start_stop(cp_cmd::STARTSERVICE, 7, 128, [&](cp_rply reply) {
+        assert(reply == cp_rply::ACK);
+        log.push_back("started");
+    });
+    conn.service_status(7, [&](cp_rply reply, const dinit_service_status &status) {
+        assert(reply == cp_rply::SERVICESTATUS);
+        assert(status.state == service_state_t::STARTED);
+        assert(status.marked_active);
+        assert(status.pid == -1);
+        assert(status.exit_si_code == 0);
+        log.push_back("status");
+    });
+    conn.close_handle(7, [&](cp_rply reply) {
+        assert(reply == cp_rply::NOSERVICE);
+        log.push_back("closed");
+    });
+
+    assert(conn.pending_requests() == 5);
+    assert(conn.wants_write());
+    conn.write_ready();
+    assert(!conn.wants_write());
+
+    // Check the requests, as received by the "daemon":
+    char req_buf[256];
+    ssize_t req_len = read(server_fd, req_buf, sizeof(req_buf));
+    const char *req = req_buf;
+    assert(req[0] == (char)cp_cmd::QUERYVERSION);
+    req += 1;
+    assert(req[0] == (char)cp_cmd::LOADSERVICE);
+    uint16_t name_len;
+    memcpy(&name_len, req + 1, sizeof(name_len));
+    assert(name_len == strlen("test-service"));
+    assert(strncmp(req + 3, "test-service", name_len) == 0);
+    req += 3 + name_len;
+    handle_t handle;
+    assert(req[0] == (char)cp_cmd::STARTSERVICE);
+    assert(req[1] == (char)128);
+    memcpy(&handle, req + 2, sizeof(handle));
+    assert(handle == 7);
+    req += 2 + sizeof(handle);
+    // (the protocol version wasn't known when the request was queued)
+    assert(req[0] == (char)cp_cmd::SERVICESTATUS);
+    req += 1 + sizeof(handle);
+    assert(req[0] == (char)cp_cmd::CLOSEHANDLE);
+    req += 1 + sizeof(handle);
+    assert(req == req_buf + req_len);
+
+    // Replies and information packets:
+    std::vector<char> out;
+    const char cpversion[] = { (char)cp_rply::CPVERSION, 1, 0, 8, 0 };
+    out.insert(out.end(), cpversion, cpversion + sizeof(cpversion));
+    add_service_event(out, 3, true);
+    add_service_event(out, 3, false);
+    out.push_back((char)cp_rply::SERVICERECORD);
+    out.push_back((char)service_state_t::STOPPED);
+    handle = 7;
+    out.insert(out.end(), (char *)&handle, (char *)&handle + sizeof(handle));
+    out.push_back((char)service_state_t::STARTED);
+    out.push_back((char)cp_rply::PREACK);
+    add_env_event(out, "VAR=value", true);
+    out.push_back((char)cp_rply::ACK);
+    add_service_event(out, 7, true);
+    add_service_event(out, 7, false);
+    size_t status_pos = out.size();
+    out.resize(status_pos + 2 + STATUS_BUFFER_SIZE);
+    out[status_pos] = (char)cp_rply::SERVICESTATUS;
+    out[status_pos + 2] = (char)service_state_t::STARTED;
+    out[status_pos + 3] = (char)service_state_t::STARTED;
+    out[status_pos + 4] = 8; // marked active
+    out.push_back((char)cp_rply::NOSERVICE);
+
+    for (char c : out) {
+        assert(conn.pending_requests() != 0);
+        assert(write(server_fd, &c, 1) == 1);
+        conn.read_ready();
+    }
+
+    assert(conn.pending_requests() == 0);
+    std::vector<std::string> expected = { "version", "event 3", "loaded",
+            "env VAR=value (overridden)", "started", "event 7", "status", "closed" };
+    assert(log == expected);
+    assert(conn.get_protocol_version() == 8);
+
+    // With the version known, a full status is requested:
+    conn.service_status(7, [&](cp_rply reply, const dinit_service_status &status) {
+        log.push_back("status5");
+    });
+    conn.write_ready();
+    assert(read(server_fd, req_buf, sizeof(req_buf)) == 1 + sizeof(handle));
+    assert(req_buf[0] == (char)cp_cmd::SERVICESTATUS5);
+
+    close(server_fd);
+    close(client_fd);
+}
+
+// A reply with no outstanding request is a protocol error; closure of the connection is reported.
+void test_unexpected_reply()
+{
+    int client_fd, server_fd;
+    make_socket_pair(client_fd, server_fd);
+
+    dinit_async_conn conn(client_fd);
+
+    // no data available:
+    conn.read_ready();
+
+    char ack = (char)cp_rply::ACK;
+    assert(write(server_fd, &ack, 1) == 1);
+    bool threw = false;
+    try {
+        conn.read_ready();
+    }
+    catch (dinit_protocol_error &) {
+        threw = true;
+    }
+    assert(threw);
+
+    dinit_async_conn conn2(server_fd);
+    close(client_fd);
+    threw = false;
+    try {
+        conn2.read_ready();
+    }
+    catch (cp_read_exception &exc) {
+        assert(exc.errcode == 0);
+        threw = true;
+    }
+    assert(threw);
+    close(server_fd);
+}
+
+// Replies received before the connection is closed are processed before the closure is reported,
+// including when the data ends exactly at a read boundary.
+void test_reply_before_close()
+{
+    int client_fd, server_fd;
+    make_socket_pair(client_fd, server_fd);
+
+    dinit_async_conn conn(client_fd);
+
+    // (1024 single-byte replies fill the read buffer exactly)
+    constexpr int num_requests = 1024;
+    int replies = 0;
+    for (int i = 0; i < num_requests; ++i) {
+        conn.close_handle(i, [&](cp_rply reply) {
+            assert(reply == cp_rply::NOSERVICE);
+            ++replies;
+        });
+    }
+    conn.write_ready();
+    assert(!conn.wants_write());
+
+    // (the requests must be consumed, or closing the socket resets the connection)
+    std::vector<char> req_buf(num_requests * (1 + sizeof(handle_t)));
+    assert(read(server_fd, req_buf.data(), req_buf.size()) == (ssize_t)req_buf.size());
+
+    std::vector<char> out(num_requests, (char)cp_rply::NOSERVICE);
+    assert(write(server_fd, out.data(), out.size()) == (ssize_t)out.size());
+    close(server_fd);
+
+    bool threw = false;
+    try {
+        conn.read_ready();
+    }
+    catch (cp_read_exception &exc) {
+        assert(exc.errcode == 0);
+        threw = true;
+    }
+    assert(threw);
+    assert(replies == num_requests);
+    assert(conn.pending_requests() == 0);
+
+    close(client_fd);
+}
+
+#define RUN_TEST(name, spacing) \
+    std::cout << #name "..." spacing << std::flush; \
+    name(); \
+    std::cout << "PASSED" << std::endl;
+
+int main(int argc, char **argv)
+{
+    RUN_TEST(test_pipelined_requests, "  ");
+    RUN_TEST(test_unexpected_reply, "    ");
+    RUN_TEST(test_reply_before_close, "  ");
+
+    return 0;
+}
@@ -3,6 +3,7 @@
 #include <vector>
 #include <string>
 #include <set>
+#include <map>
 
 #include <dinit.h>
 #include <service.h>
@@ -117,6 +118,153 @@ void cptest_listservices()
     delete cc;
 }
 
+// Issue LISTSERVICES8 and collect the listed service names; returns the cursor to continue
+// from (if a LISTMORE reply was received) or 0 (if LISTDONE was received).
+static uint32_t list_services8(int fd, char flags, service_state_t state, const char *pattern,
+        uint32_t cursor, uint16_t limit, std::vector<std::string> &names)
+{
+    std::vector<char> cmd = { (char)cp_cmd::LISTSERVICES8, flags, (char)state,
+            (char)service_state_t::STOPPED, (char)service_type_t::INTERNAL };
+    char *cursor_cptr = reinterpret_cast<char *>(&cursor);
+    cmd.insert(cmd.end(), cursor_cptr, cursor_cptr + sizeof(cursor));
+    char *limit_cptr = reinterpret_cast<char *>(&limit);
+    cmd.insert(cmd.end(), limit_cptr, limit_cptr + sizeof(limit));
+    uint16_t pattern_len = strlen(pattern);
+    char *plen_cptr = reinterpret_cast<char *>(&pattern_len);
+    cmd.insert(cmd.end(), plen_cptr, plen_cptr + sizeof(pattern_len));
+    cmd.insert(cmd.end(), pattern, pattern + pattern_len);
+
+    bp_sys::supply_read_data(fd, std::move(cmd));
+
+    event_loop.regd_bidi_watchers[fd]->read_ready(event_loop, fd);
+
+    std::vector<char> wdata;
+    bp_sys::extract_written_data(fd, wdata);
+
+    unsigned pos = 0;
+    while (wdata[pos] == (char)cp_rply::SVCINFO) {
+        unsigned char name_len = wdata[pos + 1];
+        pos += 2 + STATUS_BUFFER5_SIZE;
+        names.emplace_back(wdata.data() + pos, name_len);
+        pos += name_len;
+    }
+
+    if (wdata[pos] == (char)cp_rply::LISTMORE) {
+        assert(wdata.size() == pos + 1 + sizeof(uint32_t));
+        uint32_t next_cursor;
+        memcpy(&next_cursor, wdata.data() + pos + 1, sizeof(next_cursor));
+        assert(next_cursor != 0);
+        return next_cursor;
+    }
+
+    assert(wdata[pos] == (char)cp_rply::LISTDONE);
+    assert(wdata.size() == pos + 1);
+    return 0;
+}
+
+void cptest_listservices8()
+{
+    service_set sset;
+
+    service_record *s1 = new service_record(&sset, "test-service-1", service_type_t::INTERNAL, {});
+    sset.add_service(s1);
+    service_record *s2 = new service_record(&sset, "test-service-2", service_type_t::INTERNAL, {});
+    sset.add_service(s2);
+    service_record *s3 = new service_record(&sset, "other-service-3", service_type_t::INTERNAL, {});
+    sset.add_service(s3);
+    service_record *s4 = new service_record(&sset, "test-service-4", service_type_t::INTERNAL, {});
+    sset.add_service(s4);
+
+    sset.start_service(s2);
+    sset.start_service(s3);
+    sset.start_service(s4);
+    sset.process_queues();
+
+    int fd = bp_sys::allocfd();
+    auto *cc = new control_conn_t(event_loop, &sset, fd);
+
+    // No filter, no limit:
+    std::vector<std::string> names;
+    assert(list_services8(fd, 0, service_state_t::STOPPED, "", 0, 0, names) == 0);
+    assert(names.size() == 4);
+
+    // Started services with names matching pattern:
+    names.clear();
+    assert(list_services8(fd, 1, service_state_t::STARTED, "test-*", 0, 0, names) == 0);
+    assert((std::set<std::string>(names.begin(), names.end())
+            == std::set<std::string>{"test-service-2", "test-service-4"}));
+
+    // Services not started:
+    names.clear();
+    assert(list_services8(fd, 1 | 16, service_state_t::STARTED, "", 0, 0, names) == 0);
+    assert(names.size() == 1 && names[0] == "test-service-1");
+
+    // Started services, one at a time:
+    std::set<std::string> all_names;
+    uint32_t cursor = 0;
+    unsigned num_requests = 0;
+    do {
+        names.clear();
+        cursor = list_services8(fd, 1, service_state_t::STARTED, "", cursor, 1, names);
+        assert(names.size() == 1);
+        all_names.insert(names[0]);
+        ++num_requests;
+    } while (cursor != 0);
+    assert(num_requests == 3);
+    assert((all_names == std::set<std::string>{"test-service-2", "other-service-3",
+            "test-service-4"}));
+
+    delete cc;
+}
+
+// Services unloaded or added between pages of a listing must not cause other services to be
+// skipped or listed twice.
+void cptest_listservices8_unload()
+{
+    service_set sset;
+
+    service_record *s1 = new service_record(&sset, "test-service-1", service_type_t::INTERNAL, {});
+    sset.add_service(s1);
+    service_record *s2 = new service_record(&sset, "test-service-2", service_type_t::INTERNAL, {});
+    sset.add_service(s2);
+    service_record *s3 = new service_record(&sset, "test-service-3", service_type_t::INTERNAL, {});
+    sset.add_service(s3);
+    service_record *s4 = new service_record(&sset, "test-service-4", service_type_t::INTERNAL, {});
+    sset.add_service(s4);
+
+    int fd = bp_sys::allocfd();
+    auto *cc = new control_conn_t(event_loop, &sset, fd);
+
+    std::vector<std::string> names;
+    uint32_t cursor = list_services8(fd, 0, service_state_t::STOPPED, "", 0, 2, names);
+    assert(cursor == s2->get_service_id());
+    assert((names == std::vector<std::string>{"test-service-1", "test-service-2"}));
+
+    // Unload a service that has already been listed, and the service which was listed last:
+    sset.remove_service(s1);
+    delete s1;
+    sset.remove_service(s2);
+    delete s2;
+
+    names.clear();
+    cursor = list_services8(fd, 0, service_state_t::STOPPED, "", cursor, 1, names);
+    assert((names == std::vector<std::string>{"test-service-3"}));
+    assert(cursor == s3->get_service_id());
+
+    // Unload the service not yet listed, and load a new one:
+    sset.remove_service(s4);
+    delete s4;
+    service_record *s5 = new service_record(&sset, "test-service-5", service_type_t::INTERNAL, {});
+    sset.add_service(s5);
+
+    names.clear();
+    cursor = list_services8(fd, 0, service_state_t::STOPPED, "", cursor, 1, names);
+    assert((names == std::vector<std::string>{"test-service-5"}));
+    assert(cursor == 0);
+
+    delete cc;
+}
+
 static handle_t  find_service(int fd, const char *service_name,
         service_state_t expected_state, service_state_t expected_target_state)
 {
@@ -514,6 +662,225 @@ void cptest_gentlestop()
     delete cc;
 }
 
+static void append_name(std::vector<char> &cmd, const char *service_name)
+{
+    uint16_t name_len = strlen(service_name);
+    char *name_len_cptr = reinterpret_cast<char *>(&name_len);
+    cmd.insert(cmd.end(), name_len_cptr, name_len_cptr + sizeof(name_len));
+    cmd.insert(cmd.end(), service_name, service_name + name_len);
+}
+
+void cptest_loadservices()
+{
+    test_service_set sset;
+
+    int fd = bp_sys::allocfd();
+    auto *cc = new control_conn_t(event_loop, &sset, fd);
+
+    std::vector<char> cmd = { (char)cp_cmd::LOADSERVICES, 0 /* load */ };
+    uint16_t count = 3;
+    char *count_cptr = reinterpret_cast<char *>(&count);
+    cmd.insert(cmd.end(), count_cptr, count_cptr + sizeof(count));
+    append_name(cmd, "test-service-1");
+    append_name(cmd, "test-service-n");
+    append_name(cmd, "test-service-2");
+
+    bp_sys::supply_read_data(fd, std::move(cmd));
+    bp_sys::set_blocking(fd);
+
+    event_loop.regd_bidi_watchers[fd]->read_ready(event_loop, fd);
+
+    // We expect:
+    // (1 byte)   cp_rply::SERVICERECORDS
+    // (2 bytes)  count
+    // count * (result code, state, handle, target state)
+
+    constexpr unsigned entry_size = 3 + sizeof(handle_t);
+
+    std::vector<char> wdata;
+    bp_sys::extract_written_data(fd, wdata);
+
+    assert(wdata.size() == 3 + 3 * entry_size);
+    assert(wdata[0] == (char)cp_rply::SERVICERECORDS);
+    uint16_t rcount;
+    memcpy(&rcount, wdata.data() + 1, sizeof(rcount));
+    assert(rcount == 3);
+
+    const char *entry = wdata.data() + 3;
+    assert(entry[0] == (char)cp_rply::SERVICERECORD);
+    assert(entry[1] == (char)service_state_t::STOPPED);
+    handle_t h1;
+    memcpy(&h1, entry + 2, sizeof(h1));
+    assert(control_conn_t_test::service_from_handle(cc, h1) == sset.service1);
+
+    entry += entry_size;
+    assert(entry[0] == (char)cp_rply::NOSERVICE);
+
+    entry += entry_size;
+    assert(entry[0] == (char)cp_rply::SERVICERECORD);
+    handle_t h2;
+    memcpy(&h2, entry + 2, sizeof(h2));
+    assert(control_conn_t_test::service_from_handle(cc, h2) == sset.service2);
+
+    delete cc;
+}
+
+// Issue STARTSTOPSERVICES for the given handles; returns the result codes.
+static std::vector<char> start_stop_services(int fd, cp_cmd command, char flags,
+        const std::vector<handle_t> &handles)
+{
+    std::vector<char> cmd = { (char)cp_cmd::STARTSTOPSERVICES, (char)command, flags };
+    uint16_t count = handles.size();
+    char *count_cptr = reinterpret_cast<char *>(&count);
+    cmd.insert(cmd.end(), count_cptr, count_cptr + sizeof(count));
+    for (handle_t h : handles) {
+        char *h_cp = reinterpret_cast<char *>(&h);
+        cmd.insert(cmd.end(), h_cp, h_cp + sizeof(h));
+    }
+
+    bp_sys::supply_read_data(fd, std::move(cmd));
+
+    event_loop.regd_bidi_watchers[fd]->read_ready(event_loop, fd);
+
+    std::vector<char> wdata;
+    bp_sys::extract_written_data(fd, wdata);
+
+    // Skip over info packets; the reply comes last:
+    unsigned idx = 0;
+    while ((unsigned char)wdata[idx] >= 100) {
+        idx += (unsigned char)wdata[idx + 1];
+    }
+
+    // (1 byte)   cp_rply::SSRESULTS
+    // (2 bytes)  count
+    // count * (1 byte) result code
+    assert(wdata.size() == idx + 3 + handles.size());
+    assert(wdata[idx] == (char)cp_rply::SSRESULTS);
+    uint16_t rcount;
+    memcpy(&rcount, wdata.data() + idx + 1, sizeof(rcount));
+    assert(rcount == handles.size());
+
+    return std::vector<char>(wdata.begin() + idx + 3, wdata.end());
+}
+
+void cptest_startstop_multi()
+{
+    service_set sset;
+
+    service_record *s1 = new service_record(&sset, "test-service-1", service_type_t::INTERNAL, {});
+    sset.add_service(s1);
+    service_record *s2 = new service_record(&sset, "test-service-2", service_type_t::INTERNAL,
+            {{s1, dependency_type::REGULAR}});
+    sset.add_service(s2);
+    service_record *s3 = new service_record(&sset, "test-service-3", service_type_t::INTERNAL, {});
+    sset.add_service(s3);
+
+    s3->pin_stop();
+
+    int fd = bp_sys::allocfd();
+    auto *cc = new control_conn_t(event_loop, &sset, fd);
+
+    handle_t h1 = find_service(fd, "test-service-1", service_state_t::STOPPED, service_state_t::STOPPED);
+    handle_t h2 = find_service(fd, "test-service-2", service_state_t::STOPPED, service_state_t::STOPPED);
+    handle_t h3 = find_service(fd, "test-service-3", service_state_t::STOPPED, service_state_t::STOPPED);
+
+    // Start s1, s2 and (pinned stopped) s3:
+    std::vector<char> codes = start_stop_services(fd, cp_cmd::STARTSERVICE, 0, {h1, h2, h3});
+    assert(codes[0] == (char)cp_rply::ALREADYSS);
+    assert(codes[1] == (char)cp_rply::ALREADYSS);
+    assert(codes[2] == (char)cp_rply::PINNEDSTOPPED);
+    assert(s1->get_state() == service_state_t::STARTED);
+    assert(s2->get_state() == service_state_t::STARTED);
+    assert(s3->get_state() == service_state_t::STOPPED);
+
+    // Gently stopping s1 alone fails, since s2 depends on it:
+    codes = start_stop_services(fd, cp_cmd::STOPSERVICE, 2 /* gentle */, {h1});
+    assert(codes[0] == (char)cp_rply::DEPENDENTS);
+    assert(s1->get_state() == service_state_t::STARTED);
+
+    // Gently stopping both together succeeds:
+    codes = start_stop_services(fd, cp_cmd::STOPSERVICE, 2 /* gentle */, {h1, h2});
+    assert(codes[0] == (char)cp_rply::ALREADYSS);
+    assert(codes[1] == (char)cp_rply::ALREADYSS);
+    assert(s1->get_state() == service_state_t::STOPPED);
+    assert(s2->get_state() == service_state_t::STOPPED);
+
+    delete cc;
+}
+
+// A write handler which refuses writes (EAGAIN) while blocked.
+class blockable_write_handler : public bp_sys::default_write_handler
+{
+    public:
+    bool blocked = true;
+
+    ssize_t write(int fd, const void *buf, size_t count) override
+    {
+        if (blocked) {
+            errno = EAGAIN;
+            return -1;
+        }
+        return default_write_handler::write(fd, buf, count);
+    }
+};
+
+void cptest_outbuf_chunks()
+{
+    service_set sset;
+
+    constexpr int num_services = 400;
+    std::set<std::string> names;
+    for (int i = 0; i < num_services; i++) {
+        std::string name = "test-service-" + std::to_string(i);
+        service_record *s = new service_record(&sset, name, service_type_t::INTERNAL, {});
+        sset.add_service(s);
+        names.insert(name);
+    }
+
+    blockable_write_handler *whndlr = new blockable_write_handler();
+    int fd = bp_sys::allocfd(whndlr);
+    auto *cc = new control_conn_t(event_loop, &sset, fd);
+
+    for (int round = 0; round < 2; round++) {
+        whndlr->blocked = true;
+        const cpoutbuf::stats_t &stats = cpoutbuf::get_stats();
+        unsigned long prev_allocs = stats.chunk_allocs;
+
+        bp_sys::supply_read_data(fd, { (char)cp_cmd::LISTSERVICES5 });
+        event_loop.regd_bidi_watchers[fd]->read_ready(event_loop, fd);
+
+        // The output can't be written, so should be queued across several chunks:
+        assert(stats.chunks_in_use > 1);
+        if (round == 1) {
+            // chunks from the first round should have been re-used
+            assert(stats.chunk_allocs == prev_allocs);
+        }
+
+        whndlr->blocked = false;
+        event_loop.regd_bidi_watchers[fd]->write_ready(event_loop, fd);
+        assert(stats.chunks_in_use == 0);
+        assert(stats.chunks_pooled > 0);
+
+        std::vector<char> wdata;
+        bp_sys::extract_written_data(fd, wdata);
+
+        // Check all services were listed, in well-formed packets:
+        std::set<std::string> found_names;
+        unsigned pos = 0;
+        while (wdata[pos] == (char)cp_rply::SVCINFO) {
+            unsigned char name_len = wdata[pos + 1];
+            pos += 2 + STATUS_BUFFER5_SIZE;
+            found_names.insert(std::string(wdata.data() + pos, name_len));
+            pos += name_len;
+        }
+        assert(wdata[pos] == (char)cp_rply::LISTDONE);
+        assert(pos + 1 == wdata.size());
+        assert(found_names == names);
+    }
+
+    delete cc;
+}
+
 void cptest_queryname()
 {
     service_set sset;
@@ -1181,6 +1548,57 @@ void cptest_closehandle()
     delete cc;
 }
 
+void cptest_handlereuse()
+{
+    service_set sset;
+
+    const char * const service_name_1 = "test-service-1";
+
+    service_record *s1 = new service_record(&sset, service_name_1, service_type_t::INTERNAL, {});
+    sset.add_service(s1);
+
+    int fd = bp_sys::allocfd();
+    auto *cc = new control_conn_t(event_loop, &sset, fd);
+
+    // Two handles for the same service:
+    handle_t h1 = find_service(fd, service_name_1, service_state_t::STOPPED, service_state_t::STOPPED);
+    handle_t h2 = find_service(fd, service_name_1, service_state_t::STOPPED, service_state_t::STOPPED);
+    assert(h1 != h2);
+    assert(control_conn_t_test::service_from_handle(cc, h1) == s1);
+    assert(control_conn_t_test::service_from_handle(cc, h2) == s1);
+
+    std::vector<char> cmd = { (char)cp_cmd::CLOSEHANDLE };
+    cmd.insert(cmd.end(), (char *)&h1, (char *)&h1 + sizeof(h1));
+    bp_sys::supply_read_data(fd, std::move(cmd));
+    event_loop.regd_bidi_watchers[fd]->read_ready(event_loop, fd);
+
+    std::vector<char> wdata;
+    bp_sys::extract_written_data(fd, wdata);
+    assert(wdata.size() == 1);
+    assert(wdata[0] == (char)cp_rply::ACK);
+
+    // The closed handle is no longer valid, but the other one is, and the service still reports
+    // events to it:
+    assert(control_conn_t_test::service_from_handle(cc, h1) == nullptr);
+    assert(control_conn_t_test::service_from_handle(cc, h2) == s1);
+
+    sset.start_service(s1);
+    bp_sys::extract_written_data(fd, wdata);
+    assert(wdata.size() > 1 + sizeof(h2));
+    assert(wdata[0] == (char)cp_info::SERVICEEVENT5);
+    handle_t ev_handle;
+    memcpy(&ev_handle, wdata.data() + 2, sizeof(ev_handle));
+    assert(ev_handle == h2);
+
+    // A new handle may re-use the slot of the closed handle, but is distinct from it:
+    handle_t h3 = find_service(fd, service_name_1, service_state_t::STARTED, service_state_t::STARTED);
+    assert(h3 != h1 && h3 != h2);
+    assert(control_conn_t_test::service_from_handle(cc, h1) == nullptr);
+    assert(control_conn_t_test::service_from_handle(cc, h3) == s1);
+
+    delete cc;
+}
+
 void cptest_invalid()
 {
     service_set sset;
@@ -1314,6 +1732,344 @@ void cptest_envevent()
 }
 
 
+// Issue SUBSCRIBE; check the reply header (returning the sequence number and the entries of the
+// snapshot, if any) and return any data following the snapshot.
+static std::vector<char> subscribe(int fd, uint64_t resume_seq, bool expect_resumed, uint64_t &seq,
+        std::map<uint32_t, std::string> &entries)
+{
+    std::vector<char> cmd = { (char)cp_cmd::SUBSCRIBE };
+    char *seq_cptr = reinterpret_cast<char *>(&resume_seq);
+    cmd.insert(cmd.end(), seq_cptr, seq_cptr + sizeof(resume_seq));
+
+    bp_sys::supply_read_data(fd, std::move(cmd));
+    event_loop.regd_bidi_watchers[fd]->read_ready(event_loop, fd);
+
+    std::vector<char> wdata;
+    bp_sys::extract_written_data(fd, wdata);
+
+    // (1 byte) cp_rply::SUBSCRIBED, (1 byte) flags, (8 bytes) sequence, (4 bytes) count
+    uint32_t count;
+    assert(wdata.size() >= 2 + sizeof(seq) + sizeof(count));
+    assert(wdata[0] == (char)cp_rply::SUBSCRIBED);
+    assert(wdata[1] == (expect_resumed ? 1 : 0));
+    memcpy(&seq, wdata.data() + 2, sizeof(seq));
+    memcpy(&count, wdata.data() + 2 + sizeof(seq), sizeof(count));
+
+    // entries: (4 bytes) id, (1 byte) state, (1 byte) target, (2 bytes) name length, name
+    size_t pos = 2 + sizeof(seq) + sizeof(count);
+    for (uint32_t i = 0; i < count; ++i) {
+        uint32_t id;
+        uint16_t name_len;
+        assert(wdata.size() >= pos + 8);
+        memcpy(&id, wdata.data() + pos, sizeof(id));
+        memcpy(&name_len, wdata.data() + pos + 6, sizeof(name_len));
+        pos += 8;
+        assert(wdata.size() >= pos + name_len);
+        entries[id] = std::string(wdata.data() + pos, name_len);
+        pos += name_len;
+    }
+
+    return std::vector<char>(wdata.begin() + pos, wdata.end());
+}
+
+// Check a SERVICEDELTA packet at the given position in the buffer, return position of next packet
+static size_t check_delta(const std::vector<char> &wdata, size_t pos, char event_code,
+        uint64_t expected_seq, uint32_t expected_id, const char *name = nullptr)
+{
+    constexpr unsigned hdr_size = 3 + sizeof(uint64_t) + sizeof(uint32_t) + 2;
+    assert(wdata.size() >= pos + hdr_size);
+    assert(wdata[pos] == (char)cp_info::SERVICEDELTA);
+    unsigned pkt_len = (unsigned char)wdata[pos + 1];
+    assert(wdata[pos + 2] == event_code);
+
+    uint64_t seq;
+    uint32_t id;
+    memcpy(&seq, wdata.data() + pos + 3, sizeof(seq));
+    memcpy(&id, wdata.data() + pos + 3 + sizeof(seq), sizeof(id));
+    assert(seq == expected_seq);
+    assert(id == expected_id);
+
+    if (name != nullptr) {
+        assert(std::string(wdata.data() + pos + hdr_size, pkt_len - hdr_size) == name);
+    }
+    else {
+        assert(pkt_len == hdr_size);
+    }
+
+    return pos + pkt_len;
+}
+
+void cptest_subscribe()
+{
+    service_set sset;
+
+    service_record *s1 = new service_record(&sset, "test-service-1", service_type_t::INTERNAL, {});
+    sset.add_service(s1);
+    service_record *s2 = new service_record(&sset, "test-service-2", service_type_t::INTERNAL, {});
+    sset.add_service(s2);
+    service_record *s3 = new service_record(&sset, "test-service-3", service_type_t::INTERNAL, {});
+    sset.add_service(s3);
+
+    sset.start_service(s2);
+
+    int fd = bp_sys::allocfd();
+    auto *cc = new control_conn_t(event_loop, &sset, fd);
+
+    // Full snapshot:
+    uint64_t seq;
+    std::map<uint32_t, std::string> entries;
+    std::vector<char> wdata = subscribe(fd, 0, false, seq, entries);
+    assert(wdata.empty());
+    assert(seq == sset.get_event_seq());
+    assert((entries == std::map<uint32_t, std::string> {
+            { s1->get_service_id(), "test-service-1" }, { s2->get_service_id(), "test-service-2" },
+            { s3->get_service_id(), "test-service-3" } }));
+
+    // Deltas:
+    sset.start_service(s1);
+    sset.remove_service(s3);
+    uint32_t s3_id = s3->get_service_id();
+    delete s3;
+    service_record *s4 = new service_record(&sset, "test-service-4", service_type_t::INTERNAL, {});
+    sset.add_service(s4);
+
+    bp_sys::extract_written_data(fd, wdata);
+    size_t pos = check_delta(wdata, 0, (char)service_event_t::STARTED, seq + 1, s1->get_service_id());
+    pos = check_delta(wdata, pos, (char)cp_delta_event::REMOVED, seq + 2, s3_id);
+    pos = check_delta(wdata, pos, (char)cp_delta_event::ADDED, seq + 3, s4->get_service_id(),
+            "test-service-4");
+    assert(pos == wdata.size());
+
+    delete cc;
+
+    // Resume from a previous sequence number, on a new connection:
+    fd = bp_sys::allocfd();
+    cc = new control_conn_t(event_loop, &sset, fd);
+
+    uint64_t seq2;
+    entries.clear();
+    wdata = subscribe(fd, seq + 1, true, seq2, entries);
+    assert(seq2 == seq + 3);
+    assert(entries.empty());
+    pos = check_delta(wdata, 0, (char)cp_delta_event::REMOVED, seq + 2, s3_id);
+    pos = check_delta(wdata, pos, (char)cp_delta_event::ADDED, seq + 3, s4->get_service_id(),
+            "test-service-4");
+    assert(pos == wdata.size());
+
+    delete cc;
+
+    // Resuming from an unknown sequence number gives a snapshot:
+    fd = bp_sys::allocfd();
+    cc = new control_conn_t(event_loop, &sset, fd);
+
+    entries.clear();
+    wdata = subscribe(fd, seq2 + 1000, false, seq, entries);
+    assert(seq == seq2);
+    assert(entries.size() == 3);
+    assert(wdata.empty());
+
+    delete cc;
+}
+
+void cptest_querystarttimes()
+{
+    // (a recorded time of 0 means "not reached", so make sure the simulated time isn't 0)
+    event_loop.advance_time(time_val(1, 0));
+
+    service_set sset;
+
+    service_record *s1 = new service_record(&sset, "test-service-1", service_type_t::INTERNAL, {});
+    sset.add_service(s1);
+    service_record *s2 = new service_record(&sset, "test-service-2", service_type_t::INTERNAL,
+            {{s1, dependency_type::REGULAR}});
+    sset.add_service(s2);
+    service_record *s3 = new service_record(&sset, "test-service-3", service_type_t::INTERNAL, {});
+    sset.add_service(s3);
+
+    sset.start_service(s2);
+
+    int fd = bp_sys::allocfd();
+    auto *cc = new control_conn_t(event_loop, &sset, fd);
+
+    std::vector<char> cmd = { (char)cp_cmd::QUERYSTARTTIMES };
+    bp_sys::supply_read_data(fd, std::move(cmd));
+    event_loop.regd_bidi_watchers[fd]->read_ready(event_loop, fd);
+
+    std::vector<char> wdata;
+    bp_sys::extract_written_data(fd, wdata);
+
+    // (1 byte) cp_rply::STARTTIMES, (8 bytes) current time, (4 bytes) count
+    uint64_t now;
+    uint32_t count;
+    assert(wdata.size() >= 1 + sizeof(now) + sizeof(count));
+    assert(wdata[0] == (char)cp_rply::STARTTIMES);
+    memcpy(&now, wdata.data() + 1, sizeof(now));
+    memcpy(&count, wdata.data() + 1 + sizeof(now), sizeof(count));
+    assert(count == 3);
+
+    struct entry
+    {
+        uint64_t times[NUM_START_STAGES];
+        std::vector<std::pair<uint32_t, dependency_type>> deps;
+    };
+    std::map<std::string, entry> entries;
+    std::vector<std::string> names;
+
+    size_t pos = 1 + sizeof(now) + sizeof(count);
+    for (uint32_t i = 0; i < count; ++i) {
+        entry ent;
+        uint16_t num_deps;
+        memcpy(ent.times, wdata.data() + pos, sizeof(ent.times));
+        pos += sizeof(ent.times);
+        memcpy(&num_deps, wdata.data() + pos, sizeof(num_deps));
+        pos += sizeof(num_deps);
+        for (uint16_t j = 0; j < num_deps; ++j) {
+            uint32_t dep_index;
+            memcpy(&dep_index, wdata.data() + pos, sizeof(dep_index));
+            ent.deps.emplace_back(dep_index, static_cast<dependency_type>(wdata[pos + sizeof(dep_index)]));
+            pos += sizeof(dep_index) + 1;
+        }
+        uint16_t name_len;
+        memcpy(&name_len, wdata.data() + pos, sizeof(name_len));
+        pos += sizeof(name_len);
+        std::string name(wdata.data() + pos, name_len);
+        pos += name_len;
+        names.push_back(name);
+        entries[name] = std::move(ent);
+    }
+    assert(pos == wdata.size());
+
+    // Started services have requested/deps-started/started times in order; the internal services
+    // don't reach the exec stages:
+    for (const char *name : { "test-service-1", "test-service-2" }) {
+        const entry &ent = entries[name];
+        uint64_t requested = ent.times[(int)start_stage_t::REQUESTED];
+        uint64_t deps_started = ent.times[(int)start_stage_t::DEPS_STARTED];
+        uint64_t started = ent.times[(int)start_stage_t::STARTED];
+        assert(requested != 0 && requested <= deps_started && deps_started <= started);
+        assert(started <= now);
+        assert(ent.times[(int)start_stage_t::EXEC_ISSUED] == 0);
+        assert(ent.times[(int)start_stage_t::EXEC_CONFIRMED] == 0);
+        assert(ent.times[(int)start_stage_t::READY] == 0);
+    }
+
+    // The dependency started before the dependent's dependencies were satisfied:
+    const entry &ent2 = entries["test-service-2"];
+    assert(ent2.deps.size() == 1);
+    assert(names[ent2.deps[0].first] == "test-service-1");
+    assert(ent2.deps[0].second == dependency_type::REGULAR);
+    assert(entries["test-service-1"].times[(int)start_stage_t::STARTED]
+            <= ent2.times[(int)start_stage_t::DEPS_STARTED]);
+
+    // Unstarted service has no times:
+    for (uint64_t t : entries["test-service-3"].times) {
+        assert(t == 0);
+    }
+
+    delete cc;
+}
+
+void cptest_querymemusage()
+{
+    service_set sset;
+
+    service_record *s1 = new service_record(&sset, "test-service-1", service_type_t::INTERNAL, {});
+    sset.add_service(s1);
+    service_record *s2 = new service_record(&sset, "test-service-2", service_type_t::INTERNAL,
+            {{s1, dependency_type::REGULAR}});
+    sset.add_service(s2);
+    std::string long_name = "test-service-with-a-name-too-long-for-short-string-optimisation";
+    service_record *s3 = new service_record(&sset, long_name, service_type_t::INTERNAL, {});
+    sset.add_service(s3);
+
+    int fd = bp_sys::allocfd();
+    auto *cc = new control_conn_t(event_loop, &sset, fd);
+
+    std::vector<char> cmd = { (char)cp_cmd::QUERYMEMUSAGE };
+    bp_sys::supply_read_data(fd, std::move(cmd));
+    event_loop.regd_bidi_watchers[fd]->read_ready(event_loop, fd);
+
+    std::vector<char> wdata;
+    bp_sys::extract_written_data(fd, wdata);
+
+    // (1 byte) cp_rply::MEMUSAGE, (4 bytes) count
+    uint32_t count;
+    assert(wdata.size() >= 1 + sizeof(count));
+    assert(wdata[0] == (char)cp_rply::MEMUSAGE);
+    memcpy(&count, wdata.data() + 1, sizeof(count));
+    assert(count == 3);
+
+    std::map<std::string, std::pair<uint32_t, uint32_t>> entries;
+    size_t pos = 1 + sizeof(count);
+    for (uint32_t i = 0; i < count; ++i) {
+        uint32_t sizes[2];
+        uint16_t name_len;
+        memcpy(sizes, wdata.data() + pos, sizeof(sizes));
+        pos += sizeof(sizes);
+        memcpy(&name_len, wdata.data() + pos, sizeof(name_len));
+        pos += sizeof(name_len);
+        std::string name(wdata.data() + pos, name_len);
+        pos += name_len;
+        entries[name] = { sizes[0], sizes[1] };
+    }
+    assert(pos == wdata.size());
+
+    for (auto &ent : entries) {
+        assert(ent.second.first == sizeof(service_record));
+    }
+
+    // The dependency record is owned by the dependent, and a long name is held on the heap:
+    assert(entries["test-service-2"].second >= entries["test-service-1"].second + sizeof(service_dep));
+    assert(entries[long_name].second >= entries["test-service-1"].second + long_name.length());
+
+    delete cc;
+}
+
+void cptest_queryresources()
+{
+    service_set sset;
+
+    const char * const service_name = "test-service-1";
+    service_record *s1 = new service_record(&sset, service_name, service_type_t::INTERNAL, {});
+    sset.add_service(s1);
+
+    int fd = bp_sys::allocfd();
+    auto *cc = new control_conn_t(event_loop, &sset, fd);
+
+    handle_t h = find_service(fd, service_name, service_state_t::STOPPED, service_state_t::STOPPED);
+
+    std::vector<char> cmd = { (char)cp_cmd::QUERYRESOURCES };
+    char * h_cp = reinterpret_cast<char *>(&h);
+    cmd.insert(cmd.end(), h_cp, h_cp + sizeof(h));
+    bp_sys::supply_read_data(fd, std::move(cmd));
+    event_loop.regd_bidi_watchers[fd]->read_ready(event_loop, fd);
+
+    std::vector<char> wdata;
+    bp_sys::extract_written_data(fd, wdata);
+
+    // The service has no cgroup, so no usage figures are valid:
+    assert(wdata.size() == 2 + 3 * sizeof(uint64_t));
+    assert(wdata[0] == (char)cp_rply::RESOURCES);
+    assert(wdata[1] == 0);
+
+    // A bad handle is a bad request:
+    handle_t bad_h = h + 1;
+    cmd = { (char)cp_cmd::QUERYRESOURCES };
+    h_cp = reinterpret_cast<char *>(&bad_h);
+    cmd.insert(cmd.end(), h_cp, h_cp + sizeof(bad_h));
+    bp_sys::supply_read_data(fd, std::move(cmd));
+    event_loop.regd_bidi_watchers[fd]->read_ready(event_loop, fd);
+
+    bp_sys::extract_written_data(fd, wdata);
+    assert(wdata.size() == 1);
+    assert(wdata[0] == (char)cp_rply::BADREQ);
+
+    // Make sure dinit will not read further commands
+    int current_watch = event_loop.regd_bidi_watchers[fd]->get_watches(event_loop);
+    assert(current_watch == dasynq::OUT_EVENTS);
+
+    delete cc;
+}
 
 #define RUN_TEST(name, spacing) \
     std::cout << #name "..." spacing << std::flush; \
@@ -1324,6 +2080,8 @@ int main(int argc, char **argv)
 {
     RUN_TEST(cptest_queryver, "           ");
     RUN_TEST(cptest_listservices, "       ");
+    RUN_TEST(cptest_listservices8, "      ");
+    RUN_TEST(cptest_listservices8_unload, "");
     RUN_TEST(cptest_findservice1, "       ");
     RUN_TEST(cptest_findservice2, "       ");
     RUN_TEST(cptest_findservice3, "       ");
@@ -1331,6 +2089,9 @@ int main(int argc, char **argv)
     RUN_TEST(cptest_startstop, "          ");
     RUN_TEST(cptest_start_pinned, "       ");
     RUN_TEST(cptest_gentlestop, "         ");
+    RUN_TEST(cptest_loadservices, "       ");
+    RUN_TEST(cptest_startstop_multi, "    ");
+    RUN_TEST(cptest_outbuf_chunks, "      ");
     RUN_TEST(cptest_queryname, "          ");
     RUN_TEST(cptest_unload, "             ");
     RUN_TEST(cptest_addrmdeps, "          ");
@@ -1341,7 +2102,12 @@ int main(int argc, char **argv)
     RUN_TEST(cptest_sendsignal, "         ");
     RUN_TEST(cptest_two_commands, "       ");
     RUN_TEST(cptest_closehandle, "        ");
+    RUN_TEST(cptest_handlereuse, "        ");
     RUN_TEST(cptest_invalid, "            ");
     RUN_TEST(cptest_envevent, "           ");
+    RUN_TEST(cptest_subscribe, "          ");
+    RUN_TEST(cptest_querystarttimes, "    ");
+    RUN_TEST(cptest_querymemusage, "      ");
+    RUN_TEST(cptest_queryresources, "     ");
     return 0;
 }
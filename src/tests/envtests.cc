@@ -96,6 +96,37 @@ void test_env_2()
     bp_sys::clearenv();
 }
 
+// Test env_map::set_var (used to add variables to an already-built mapping)
+void test_env_map_set()
+{
+    using namespace bp_sys;
+
+    bp_sys::clearenv();
+
+    environment env;
+    bp_sys::setenv("VAR1","VAR1-env",1);
+    env.set_var("VAR2=VAR2-env");
+
+    environment::env_map mapping = env.build();
+    assert(mapping.env_list.size() == 3);
+
+    char var2_buf[] = "VAR2=xxxx";
+    mapping.set_var(var2_buf);
+    mapping.set_var("VAR3=VAR3-new");
+
+    assert(mapping.env_list.size() == 4);
+    assert(mapping.env_list.back() == nullptr);
+    assert(strcmp(mapping.lookup("VAR1"), "VAR1-env") == 0);
+    assert(strcmp(mapping.lookup("VAR2"), "xxxx") == 0);
+    assert(strcmp(mapping.lookup("VAR3"), "VAR3-new") == 0);
+
+    // the value can be filled in after the variable has been set
+    strcpy(var2_buf + 5, "1234");
+    assert(strcmp(mapping.lookup("VAR2"), "1234") == 0);
+
+    bp_sys::clearenv();
+}
+
 #define RUN_TEST(name, spacing) \
     std::cout << #name "..." spacing << std::flush; \
     name(); \
@@ -105,4 +136,5 @@ int main(int argc, char **argv)
 {
     RUN_TEST(test_env_1, "                ");
     RUN_TEST(test_env_2, "                ");
+    RUN_TEST(test_env_map_set, "          ");
 }
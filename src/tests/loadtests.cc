@@ -10,6 +10,7 @@
 #include "service.h"
 #include "proc-service.h"
 #include "load-service.h"
+#include "auto-reload.h"
 
 std::string test_service_dir;
 
@@ -316,6 +317,107 @@ void test_settings()
     assert(settings.depends.front().name == "abc");
 }
 
+void test_restart_backoff()
+{
+    using string = std::string;
+    using string_iterator = std::string::iterator;
+
+    using prelim_dep = test_prelim_dep;
+
+    auto resolve_var = [](const std::string &name) {
+        return (char *)nullptr;
+    };
+
+    std::vector<std::string> bad_settings;
+
+    auto load_settings = [&](dinit_load::service_settings_wrapper<prelim_dep> &settings,
+            const char *content) {
+        file_input_stack input_stack;
+        bp_sys::supply_file_content("./dummy", content);
+        dio::istream infile;
+        infile.open("./dummy");
+        input_stack.push("./dummy", std::move(infile), bp_sys::open(".", O_DIRECTORY));
+
+        process_service_file("test-service", input_stack,
+                [&](string &line, file_pos_ref input_pos, string &setting,
+                        dinit_load::setting_op_t op, string_iterator &i,
+                        string_iterator &end) -> void {
+
+                    auto process_dep_dir_n = [&](std::list<prelim_dep> &deplist,
+                            const std::string &waitsford, dependency_type dep_type) -> void {
+                    };
+
+                    auto load_service_n = [&](const string &dep_name) -> const string & {
+                        return dep_name;
+                    };
+
+                    try {
+                        process_service_line(settings, "test-service", nullptr, line, input_pos,
+                                setting, op, i, end, load_service_n, process_dep_dir_n);
+                    }
+                    catch (service_description_exc &exc) {
+                        bad_settings.push_back(setting);
+                    }
+                },
+                nullptr, resolve_var);
+    };
+
+    auto report_error = [](const char *msg) {};
+
+    std::vector<std::string> lint;
+    auto report_lint = [&](const char *msg) {
+        lint.push_back(msg);
+    };
+
+    auto resolve_var_none = [](const std::string &name, environment::env_map const &) ->
+            const char * {
+        return nullptr;
+    };
+
+    // Valid settings:
+    {
+        dinit_load::service_settings_wrapper<prelim_dep> settings;
+        load_settings(settings,
+                "type = process\n"
+                "command = /something/test\n"
+                "restart-delay = 0.5\n"
+                "restart-delay-max = 30.5\n"
+                "restart-delay-jitter = 25\n");
+        settings.finalise(report_error, tenvmap, nullptr, report_lint, resolve_var_none);
+
+        assert(bad_settings.empty());
+        assert(lint.empty());
+        assert(settings.restart_delay_max.tv_sec == 30);
+        assert(settings.restart_delay_max.tv_nsec == 500000000);
+        assert(settings.restart_delay_jitter == 25);
+    }
+
+    // A negative maximum and a jitter above 100% are rejected (leaving the previous values); a
+    // maximum less than the restart delay is accepted, but reported as lint:
+    {
+        dinit_load::service_settings_wrapper<prelim_dep> settings;
+        load_settings(settings,
+                "type = process\n"
+                "command = /something/test\n"
+                "restart-delay = 5\n"
+                "restart-delay-max = -10\n"
+                "restart-delay-jitter = 10\n"
+                "restart-delay-jitter = 101\n"
+                "restart-delay-max = 2\n");
+        settings.finalise(report_error, tenvmap, nullptr, report_lint, resolve_var_none);
+
+        assert(bad_settings.size() == 2);
+        assert(bad_settings[0] == "restart-delay-max");
+        assert(bad_settings[1] == "restart-delay-jitter");
+        assert(settings.restart_delay_jitter == 10);
+        assert(settings.restart_delay_max.tv_sec == 2);
+        assert(settings.restart_delay_max.tv_nsec == 0);
+
+        assert(lint.size() == 1);
+        assert(lint[0].find("'restart-delay-max'") != std::string::npos);
+    }
+}
+
 void test_subst_errs()
 {
     using string = std::string;
@@ -697,6 +799,181 @@ void test_dir_env_subst()
     assert(dep1.get_to()->get_name() == "dirtest3" || dep2.get_to()->get_name() == "dirtest3");
 }
 
+// Supply inotify events (for files in the given watched directory) to the auto-reloader
+static void supply_inotify_events(dirload_service_set &sset, const char *dir,
+        std::initializer_list<const char *> names)
+{
+    std::vector<char> data;
+    for (const char *name : names) {
+        size_t name_len = (strlen(name) + 1 + sizeof(inotify_event) - 1)
+                / sizeof(inotify_event) * sizeof(inotify_event);
+        inotify_event event = {};
+        event.wd = bp_sys::get_inotify_watch(dir);
+        event.mask = IN_CLOSE_WRITE;
+        event.len = name_len;
+        data.insert(data.end(), (char *)&event, (char *)&event + sizeof(event));
+        size_t name_pos = data.size();
+        data.resize(name_pos + name_len);
+        strcpy(data.data() + name_pos, name);
+    }
+
+    int fd = sset.get_auto_reloader()->get_inotify_fd();
+    bp_sys::supply_read_data(fd, std::move(data));
+    event_loop.regd_fd_watchers[fd]->fd_event(event_loop, fd, dasynq::IN_EVENTS);
+}
+
+void test_auto_reload()
+{
+    dirload_service_set sset(test_service_dir.c_str());
+    assert(sset.enable_auto_reload());
+
+    auto t4 = sset.load_service("t4");
+    assert(t4->get_type() == service_type_t::PROCESS);
+
+    // Change an included file; the including service should be reloaded (once the debounce
+    // delay has elapsed):
+    auto fragment_1 = read_file_contents("./test-services/fragment-1");
+    bp_sys::supply_file_content("./test-services/fragment-1", std::string("type = internal\n"));
+    supply_inotify_events(sset, "./test-services", {"fragment-1"});
+
+    assert(sset.find_service("t4")->get_type() == service_type_t::PROCESS);
+    event_loop.advance_time(time_val {0, 250000000});
+    assert(sset.find_service("t4")->get_type() == service_type_t::INTERNAL);
+
+    const auto_reload_stats &stats = sset.get_auto_reloader()->get_stats();
+    assert(stats.events == 1);
+    assert(stats.batches == 1);
+    assert(stats.reloads == 1);
+    assert(stats.failures == 0);
+
+    // Several changes affecting the same service, within the debounce delay, should result in a
+    // single reload:
+    bp_sys::supply_file_content("./test-services/fragment-1", fragment_1);
+    supply_inotify_events(sset, "./test-services", {"t4", "fragment-2"});
+    event_loop.advance_time(time_val {0, 200000000});
+    supply_inotify_events(sset, "./test-services", {"t4", "fragment-1"});
+    event_loop.advance_time(time_val {0, 200000000});
+    assert(stats.batches == 1);
+    event_loop.advance_time(time_val {0, 50000000});
+
+    assert(sset.find_service("t4")->get_type() == service_type_t::PROCESS);
+    assert(stats.events == 5);
+    assert(stats.batches == 2);
+    assert(stats.reloads == 2);
+
+    // A change to an unrelated file shouldn't cause any reload:
+    supply_inotify_events(sset, "./test-services", {"t1"});
+    event_loop.advance_time(time_val {0, 250000000});
+    assert(stats.batches == 3);
+    assert(stats.reloads == 2);
+}
+
+// Included files which a service no longer uses (after reload, or when it is unloaded) are no longer
+// watched.
+void test_auto_reload_unload()
+{
+    dirload_service_set sset(test_service_dir.c_str());
+    assert(sset.enable_auto_reload());
+
+    bp_sys::supply_file_content("./test-services/t5",
+            "type = internal\n"
+            "@include \"t5-inc/fragment\"\n");
+    bp_sys::supply_file_content("./test-services/t5-inc/fragment", "restart = false\n");
+
+    sset.load_service("t5");
+    assert(bp_sys::get_inotify_watch("./test-services/t5-inc") != -1);
+
+    // Reload without the include; the directory is no longer watched:
+    bp_sys::supply_file_content("./test-services/t5", "type = internal\n");
+    supply_inotify_events(sset, "./test-services", {"t5"});
+    event_loop.advance_time(time_val {0, 250000000});
+    const auto_reload_stats &stats = sset.get_auto_reloader()->get_stats();
+    assert(stats.reloads == 1);
+    assert(bp_sys::get_inotify_watch("./test-services/t5-inc") == -1);
+
+    // Reload with the include again, then unload:
+    bp_sys::supply_file_content("./test-services/t5",
+            "type = internal\n"
+            "@include \"t5-inc/fragment\"\n");
+    supply_inotify_events(sset, "./test-services", {"t5"});
+    event_loop.advance_time(time_val {0, 250000000});
+    assert(stats.reloads == 2);
+    assert(bp_sys::get_inotify_watch("./test-services/t5-inc") != -1);
+
+    service_record *t5 = sset.find_service("t5");
+    sset.unload_service(t5);
+    assert(sset.find_service("t5") == nullptr);
+    assert(bp_sys::get_inotify_watch("./test-services/t5-inc") == -1);
+
+    // The service directory remains watched:
+    assert(bp_sys::get_inotify_watch("./test-services") != -1);
+}
+
+#if SUPPORT_CGROUPS
+void test_cgroup_settings()
+{
+    using string = std::string;
+    using string_iterator = std::string::iterator;
+
+    using prelim_dep = test_prelim_dep;
+
+    dinit_load::service_settings_wrapper<prelim_dep> settings;
+
+    std::stringstream ss;
+
+    ss << "type = process\n"
+            "command = /something/test\n"
+            "options = create-cgroup\n"
+            "cgroup-memory-max = 512M\n"
+            "cgroup-cpu-weight = 200\n"
+            "cgroup-io-weight = 0\n";
+
+    file_input_stack input_stack;
+    bp_sys::supply_file_content("./dummy", ss.str());
+    dio::istream infile;
+    infile.open("./dummy");
+    input_stack.push("./dummy", std::move(infile), bp_sys::open(".", O_DIRECTORY));
+
+    auto resolve_var = [](const std::string &name) {
+        return (char *)nullptr;
+    };
+
+    std::vector<std::string> bad_settings;
+
+    process_service_file("test-service", input_stack,
+            [&](string &line, file_pos_ref input_pos, string &setting,
+                    dinit_load::setting_op_t op, string_iterator &i,
+                    string_iterator &end) -> void {
+
+                auto process_dep_dir_n = [&](std::list<prelim_dep> &deplist,
+                        const std::string &waitsford, dependency_type dep_type) -> void {
+                };
+
+                auto load_service_n = [&](const string &dep_name) -> const string & {
+                    return dep_name;
+                };
+
+                try {
+                    process_service_line(settings, "test-service", nullptr, line, input_pos,
+                            setting, op, i, end, load_service_n, process_dep_dir_n);
+                }
+                catch (service_description_exc &exc) {
+                    bad_settings.push_back(setting);
+                }
+            },
+            nullptr, resolve_var);
+
+    assert(settings.onstart_flags.create_cgroup);
+    assert(settings.cgroup_memory_max == 512u * 1024 * 1024);
+    assert(settings.cgroup_cpu_weight == 200);
+    assert(settings.cgroup_io_weight == 0);
+
+    // io weight of 0 is out of range:
+    assert(bad_settings.size() == 1);
+    assert(bad_settings.front() == "cgroup-io-weight");
+}
+#endif
+
 #define RUN_TEST(name, spacing) \
     std::cout << #name "..." spacing << std::flush; \
     name(); \
@@ -711,6 +988,7 @@ int main(int argc, char **argv)
     RUN_TEST(test_env_subst3, "           ");
     RUN_TEST(test_nonexistent, "          ");
     RUN_TEST(test_settings, "             ");
+    RUN_TEST(test_restart_backoff, "      ");
     RUN_TEST(test_subst_errs, "           ");
     RUN_TEST(test_path_env_subst, "       ");
     RUN_TEST(test_newline, "              ");
@@ -720,6 +998,11 @@ int main(int argc, char **argv)
     RUN_TEST(test_plusassign, "           ");
     RUN_TEST(test_includes, "             ");
     RUN_TEST(test_dir_env_subst, "        ");
+    RUN_TEST(test_auto_reload, "          ");
+    RUN_TEST(test_auto_reload_unload, "   ");
+    #if SUPPORT_CGROUPS
+    RUN_TEST(test_cgroup_settings, "      ");
+    #endif
     bp_sys::clearenv();
     return 0;
 }
@@ -2815,11 +2815,712 @@ void test_prepared_by_restart()
 
     assert(prep_svc.get_state() == service_state_t::STOPPED);
     assert(p.get_state() == service_state_t::STOPPED);
+    assert(event_loop.active_timers.size() == 0);
 
     sset.remove_service(&p);
     sset.remove_service(&prep_svc);
 }
 
+// Test log buffer which discards old output when full
+void test_proc_log_buffer_ring()
+{
+    using namespace std;
+
+    service_set sset;
+
+    ha_string command = "test-command";
+    list<pair<unsigned,unsigned>> command_offsets;
+    command_offsets.emplace_back(0, command.length());
+    std::list<prelim_dep> depends;
+
+    process_service p {&sset, "testproc", std::move(command), command_offsets, depends};
+    init_service_defaults(p);
+    p.set_log_mode(log_type_id::BUFFER);
+    p.set_log_buf_max(40);
+    p.set_log_buf_discard_old(true);
+    sset.add_service(&p);
+
+    p.start();
+    sset.process_queues();
+
+    base_process_service_test::exec_succeeded(&p);
+    sset.process_queues();
+    assert(p.get_state() == service_state_t::STARTED);
+
+    int lfd = base_process_service_test::get_log_input_fd(&p);
+    assert(lfd != -1);
+
+    auto get_contents = [&]() -> std::string {
+        struct iovec segs[2];
+        p.get_log_buffer(segs);
+        std::string r((char *)segs[0].iov_base, segs[0].iov_len);
+        r.append((char *)segs[1].iov_base, segs[1].iov_len);
+        return r;
+    };
+
+    std::string output = "0123456789012345678901234567890123456789abcdefghij";
+    bp_sys::supply_read_data(lfd, std::vector<char>(output.begin(), output.begin() + 30));
+    event_loop.regd_fd_watchers[lfd]->fd_event(event_loop, lfd, dasynq::IN_EVENTS);
+    assert(get_contents() == output.substr(0, 30));
+
+    // Fill the buffer, then wrap:
+    bp_sys::supply_read_data(lfd, std::vector<char>(output.begin() + 30, output.end()));
+    event_loop.regd_fd_watchers[lfd]->fd_event(event_loop, lfd, dasynq::IN_EVENTS);
+    assert(get_contents() == output.substr(0, 40));
+    event_loop.regd_fd_watchers[lfd]->fd_event(event_loop, lfd, dasynq::IN_EVENTS);
+    assert(get_contents() == output.substr(10));
+
+    p.stop();
+    sset.process_queues();
+    base_process_service_test::handle_exit(&p, 0);
+    sset.process_queues();
+    assert(p.get_state() == service_state_t::STOPPED);
+
+    // On restart, a note is appended (discarding old output to make room):
+    p.start();
+    sset.process_queues();
+    assert(get_contents() == output.substr(44) + "\n(dinit: note: service restarted)\n");
+
+    base_process_service_test::exec_succeeded(&p);
+    sset.process_queues();
+    p.stop();
+    sset.process_queues();
+    base_process_service_test::handle_exit(&p, 0);
+    sset.process_queues();
+
+    sset.remove_service(&p);
+}
+
+// Output is written to the logfile by dinit, and the logfile is rotated once it reaches the rotation
+// size.
+void test_proc_log_rotate()
+{
+    using namespace std;
+
+    service_set sset;
+
+    ha_string command = "test-command";
+    list<pair<unsigned,unsigned>> command_offsets;
+    command_offsets.emplace_back(0, command.length());
+    std::list<prelim_dep> depends;
+
+    process_service p {&sset, "testproc", std::move(command), command_offsets, depends};
+    init_service_defaults(p);
+    p.set_logfile_details("/var/log/testproc.log", 0600, -1, -1);
+    p.set_logfile_rotation(20, 2, ha_string(), {}, ".gz");
+    p.set_log_mode(log_type_id::ROTFILE);
+    sset.add_service(&p);
+
+    bp_sys::supply_file_content("/var/log/testproc.log", std::string("0123456789"));
+
+    p.start();
+    sset.process_queues();
+
+    base_process_service_test::exec_succeeded(&p);
+    sset.process_queues();
+    assert(p.get_state() == service_state_t::STARTED);
+
+    int lfd = base_process_service_test::get_log_input_fd(&p);
+    assert(lfd != -1);
+
+    auto get_contents = [&](const char *path) -> std::string {
+        std::vector<char> content;
+        if (!bp_sys::get_file_content(path, content)) return "(none)";
+        return std::string(content.begin(), content.end());
+    };
+
+    auto supply_output = [&](const std::string &output) {
+        bp_sys::supply_read_data(lfd, std::vector<char>(output.begin(), output.end()));
+        event_loop.regd_fd_watchers[lfd]->fd_event(event_loop, lfd, dasynq::IN_EVENTS);
+    };
+
+    // Output is appended to the existing content:
+    supply_output("abcde\n");
+    assert(get_contents("/var/log/testproc.log") == "0123456789abcde\n");
+
+    // Reaching the rotation size causes rotation:
+    supply_output("fghij\n");
+    assert(get_contents("/var/log/testproc.log") == "");
+    assert(get_contents("/var/log/testproc.log.1") == "0123456789abcde\nfghij\n");
+
+    supply_output("klmnopqrstuvwxyz01234\n");
+    assert(get_contents("/var/log/testproc.log.1") == "klmnopqrstuvwxyz01234\n");
+    assert(get_contents("/var/log/testproc.log.2") == "0123456789abcde\nfghij\n");
+
+    // Only two rotated files are kept:
+    supply_output("56789012345678901234\n");
+    assert(get_contents("/var/log/testproc.log.1") == "56789012345678901234\n");
+    assert(get_contents("/var/log/testproc.log.2") == "klmnopqrstuvwxyz01234\n");
+    assert(get_contents("/var/log/testproc.log.3") == "(none)");
+
+    supply_output("end\n");
+    assert(get_contents("/var/log/testproc.log") == "end\n");
+
+    p.stop();
+    sset.process_queues();
+    base_process_service_test::handle_exit(&p, 0);
+    sset.process_queues();
+    assert(p.get_state() == service_state_t::STOPPED);
+
+    sset.remove_service(&p);
+}
+
+// With a compress command, rotation is deferred while the previously rotated file is still being
+// compressed (so that it is not renamed while the compress command is working on it).
+void test_proc_log_rotate_compress()
+{
+    using namespace std;
+
+    service_set sset;
+
+    ha_string command = "test-command";
+    list<pair<unsigned,unsigned>> command_offsets;
+    command_offsets.emplace_back(0, command.length());
+    std::list<prelim_dep> depends;
+
+    ha_string compress = "gzip";
+    list<pair<unsigned,unsigned>> compress_offsets;
+    compress_offsets.emplace_back(0, compress.length());
+    std::vector<const char *> compress_parts = separate_args(compress, compress_offsets);
+
+    process_service p {&sset, "testproc", std::move(command), command_offsets, depends};
+    init_service_defaults(p);
+    p.set_logfile_details("/var/log/testproc-c.log", 0600, -1, -1);
+    p.set_logfile_rotation(20, 2, std::move(compress), std::move(compress_parts), ".gz");
+    p.set_log_mode(log_type_id::ROTFILE);
+    sset.add_service(&p);
+
+    p.start();
+    sset.process_queues();
+
+    base_process_service_test::exec_succeeded(&p);
+    sset.process_queues();
+    assert(p.get_state() == service_state_t::STARTED);
+
+    int lfd = base_process_service_test::get_log_input_fd(&p);
+    assert(lfd != -1);
+
+    auto get_contents = [&](const char *path) -> std::string {
+        std::vector<char> content;
+        if (!bp_sys::get_file_content(path, content)) return "(none)";
+        return std::string(content.begin(), content.end());
+    };
+
+    auto supply_output = [&](const std::string &output) {
+        bp_sys::supply_read_data(lfd, std::vector<char>(output.begin(), output.end()));
+        event_loop.regd_fd_watchers[lfd]->fd_event(event_loop, lfd, dasynq::IN_EVENTS);
+    };
+
+    // First rotation starts the compress command:
+    supply_output("01234567890123456789\n");
+    assert(get_contents("/var/log/testproc-c.log.1") == "01234567890123456789\n");
+    pid_t compress_pid = base_process_service_test::get_log_compress_pid(&p);
+    assert(compress_pid != -1);
+
+    // While it runs, the logfile grows beyond the rotation size rather than being rotated:
+    supply_output("abcdefghijklmnopqrst\n");
+    supply_output("uvwxyz\n");
+    assert(get_contents("/var/log/testproc-c.log") == "abcdefghijklmnopqrst\nuvwxyz\n");
+    assert(get_contents("/var/log/testproc-c.log.1") == "01234567890123456789\n");
+    assert(get_contents("/var/log/testproc-c.log.2") == "(none)");
+
+    // Once it has finished, the deferred rotation happens (and compression of the new file starts):
+    base_process_service_test::handle_log_compress_exit(&p);
+    assert(get_contents("/var/log/testproc-c.log") == "");
+    assert(get_contents("/var/log/testproc-c.log.1") == "abcdefghijklmnopqrst\nuvwxyz\n");
+    assert(get_contents("/var/log/testproc-c.log.2") == "01234567890123456789\n");
+    pid_t compress_pid2 = base_process_service_test::get_log_compress_pid(&p);
+    assert(compress_pid2 != -1 && compress_pid2 != compress_pid);
+
+    // If the logfile hasn't reached the rotation size, completion doesn't cause rotation:
+    supply_output("end\n");
+    base_process_service_test::handle_log_compress_exit(&p);
+    assert(base_process_service_test::get_log_compress_pid(&p) == -1);
+    assert(get_contents("/var/log/testproc-c.log") == "end\n");
+
+    p.stop();
+    sset.process_queues();
+    base_process_service_test::handle_exit(&p, 0);
+    sset.process_queues();
+    assert(p.get_state() == service_state_t::STOPPED);
+
+    sset.remove_service(&p);
+}
+
+// When events are dispatched as a batch, the processing that follows process termination is deferred
+// until the end of the batch.
+void test_proc_batch_dispatch()
+{
+    using namespace std;
+
+    service_set sset;
+
+    service_record b {&sset, "test-service-b", service_type_t::INTERNAL, {}};
+    sset.add_service(&b);
+
+    ha_string command = "test-command";
+    list<pair<unsigned,unsigned>> command_offsets;
+    command_offsets.emplace_back(0, command.length());
+    std::list<prelim_dep> depends = {{&b, REG}};
+
+    process_service p1 {&sset, "testproc-1", ha_string(command), command_offsets, depends};
+    process_service p2 {&sset, "testproc-2", ha_string(command), command_offsets, depends};
+    init_service_defaults(p1);
+    init_service_defaults(p2);
+    sset.add_service(&p1);
+    sset.add_service(&p2);
+
+    p1.start();
+    p2.start();
+    sset.process_queues();
+    base_process_service_test::exec_succeeded(&p1);
+    base_process_service_test::exec_succeeded(&p2);
+    sset.process_queues();
+    assert(p1.get_state() == service_state_t::STARTED);
+    assert(p2.get_state() == service_state_t::STARTED);
+    assert(b.get_state() == service_state_t::STARTED);
+
+    p1.stop();
+    p2.stop();
+    sset.process_queues();
+    assert(p1.get_state() == service_state_t::STOPPING);
+    assert(p2.get_state() == service_state_t::STOPPING);
+    assert(b.get_state() == service_state_t::STOPPING);
+
+    sset.begin_batch();
+    base_process_service_test::handle_exit(&p1, 0);
+    base_process_service_test::handle_exit(&p2, 0);
+
+    // The dependency is waiting for the queues to be processed:
+    assert(p1.get_state() == service_state_t::STOPPED);
+    assert(p2.get_state() == service_state_t::STOPPED);
+    assert(b.get_state() == service_state_t::STOPPING);
+
+    sset.end_batch();
+    assert(p1.get_state() == service_state_t::STOPPED);
+    assert(p2.get_state() == service_state_t::STOPPED);
+    assert(b.get_state() == service_state_t::STOPPED);
+    assert(sset.count_active_services() == 0);
+
+    sset.remove_service(&p1);
+    sset.remove_service(&p2);
+    sset.remove_service(&b);
+}
+
+// Restart with exponential backoff (and jitter)
+void test_proc_restart_backoff()
+{
+    using namespace std;
+
+    service_set sset;
+
+    ha_string command = "test-command";
+    list<pair<unsigned,unsigned>> command_offsets;
+    command_offsets.emplace_back(0, command.length());
+    std::list<prelim_dep> depends;
+
+    process_service p {&sset, "testproc", std::move(command), command_offsets, depends};
+    init_service_defaults(p);
+    p.set_smooth_recovery(true);
+    p.set_restart_interval(time_val(10,0), 0);
+    p.set_restart_delay(time_val {0, 1000});
+    p.set_restart_backoff(time_val {0, 8000}, 0);
+    sset.add_service(&p);
+
+    p.start();
+    sset.process_queues();
+    base_process_service_test::exec_succeeded(&p);
+    sset.process_queues();
+    assert(p.get_state() == service_state_t::STARTED);
+
+    time_val delay;
+    unsigned count;
+
+    // Each restart (where the process doesn't run for the restart interval) doubles the delay, up
+    // to the maximum:
+    const long expected_delays[] = { 1000, 2000, 4000, 8000, 8000 };
+    for (unsigned i = 0; i < 5; ++i) {
+        pid_t last_pid = bp_sys::last_forked_pid;
+        base_process_service_test::handle_exit(&p, 0);
+        sset.process_queues();
+
+        assert(p.get_restart_backoff(delay, count));
+        assert(delay == time_val(0, expected_delays[i]));
+        assert(count == i + 1);
+
+        event_loop.advance_time(time_val {0, expected_delays[i] - 1});
+        assert(bp_sys::last_forked_pid == last_pid);
+        event_loop.advance_time(time_val {0, 1});
+        assert(bp_sys::last_forked_pid == last_pid + 1);
+
+        base_process_service_test::exec_succeeded(&p);
+        sset.process_queues();
+        assert(p.get_state() == service_state_t::STARTED);
+    }
+
+    // Once the process has run for the restart interval, the delay is reset:
+    event_loop.advance_time(time_val {10, 0});
+    pid_t last_pid = bp_sys::last_forked_pid;
+    base_process_service_test::handle_exit(&p, 0);
+    sset.process_queues();
+    assert(bp_sys::last_forked_pid == last_pid + 1);
+    assert(p.get_restart_backoff(delay, count));
+    assert(delay == time_val(0, 1000));
+    assert(count == 1);
+
+    base_process_service_test::exec_succeeded(&p);
+    sset.process_queues();
+
+    // With jitter, the delay is extended by up to the given percentage:
+    p.set_restart_backoff(time_val {0, 8000}, 50);
+    last_pid = bp_sys::last_forked_pid;
+    base_process_service_test::handle_exit(&p, 0);
+    sset.process_queues();
+    assert(p.get_restart_backoff(delay, count));
+    assert(delay == time_val(0, 2000));
+
+    event_loop.advance_time(time_val {0, 1999});
+    assert(bp_sys::last_forked_pid == last_pid);
+    event_loop.advance_time(time_val {0, 1001});
+    assert(bp_sys::last_forked_pid == last_pid + 1);
+
+    base_process_service_test::exec_succeeded(&p);
+    sset.process_queues();
+    assert(event_loop.active_timers.size() == 0);
+
+    sset.remove_service(&p);
+}
+
+// The child environment is built once and re-used across restarts, until the environment changes.
+void test_proc_env_cached()
+{
+    using namespace std;
+
+    service_set sset;
+
+    ha_string command = "test-command";
+    list<pair<unsigned,unsigned>> command_offsets;
+    command_offsets.emplace_back(0, command.length());
+    std::list<prelim_dep> depends;
+
+    process_service p {&sset, "testproc", std::move(command), command_offsets, depends};
+    init_service_defaults(p);
+    sset.add_service(&p);
+
+    auto start_and_stop = [&]() {
+        p.start();
+        sset.process_queues();
+        base_process_service_test::exec_succeeded(&p);
+        sset.process_queues();
+        assert(p.get_state() == service_state_t::STARTED);
+
+        p.stop();
+        sset.process_queues();
+        base_process_service_test::handle_exit(&p, 0);
+        sset.process_queues();
+        assert(p.get_state() == service_state_t::STOPPED);
+    };
+
+    const run_proc_env &proc_env = base_process_service_test::get_start_proc_env(&p);
+    assert(!proc_env.valid);
+
+    start_and_stop();
+    assert(proc_env.valid);
+    const char * const *env_list = proc_env.env_map.env_list.data();
+    size_t env_size = proc_env.env_map.env_list.size();
+
+    // Restart: environment is re-used, not rebuilt
+    start_and_stop();
+    assert(proc_env.valid);
+    assert(proc_env.env_map.env_list.data() == env_list);
+
+    // Change to the main environment invalidates:
+    main_env.set_var("TEST_PROC_ENV_CACHED=1", true);
+    assert(!proc_env.valid);
+    start_and_stop();
+    assert(proc_env.valid);
+    assert(proc_env.env_map.env_list.size() == env_size + 1);
+    assert(proc_env.env_map.lookup("TEST_PROC_ENV_CACHED") != nullptr);
+
+    // As does setting the service environment (i.e. reload):
+    environment senv;
+    senv.set_var("TEST_SVC_VAR=2");
+    p.set_environment(std::move(senv));
+    assert(!proc_env.valid);
+    start_and_stop();
+    assert(proc_env.valid);
+    assert(proc_env.env_map.lookup("TEST_SVC_VAR") != nullptr);
+
+    main_env.undefine_var("TEST_PROC_ENV_CACHED", true);
+    sset.remove_service(&p);
+}
+
+#if SUPPORT_PIDFD
+// A bgprocess daemon which is not a child of dinit is supervised via a pidfd: termination is
+// detected when the pidfd becomes readable, and signals are sent via the pidfd.
+void test_bgproc_pidfd()
+{
+    using namespace std;
+
+    service_set sset;
+
+    ha_string command = "test-command";
+    list<pair<unsigned,unsigned>> command_offsets;
+    command_offsets.emplace_back(0, command.length());
+    std::list<prelim_dep> depends;
+
+    bgproc_service p {&sset, "testproc", std::move(command), command_offsets, depends};
+    init_service_defaults(p);
+    p.set_auto_restart(auto_restart_mode::NEVER);
+    p.set_pid_file("/run/daemon.pid");
+    sset.add_service(&p);
+
+    p.start();
+    sset.process_queues();
+    base_process_service_test::exec_succeeded(&p);
+    sset.process_queues();
+    assert(p.get_state() == service_state_t::STARTING);
+
+    pid_t daemon_instance;
+    supply_pid_contents("/run/daemon.pid", &daemon_instance);
+    bp_sys::non_child_pid = daemon_instance;
+
+    base_process_service_test::handle_exit(&p, 0); // exit the launch process
+    assert(p.get_state() == service_state_t::STARTED);
+    assert(p.get_pid() == daemon_instance);
+    int pidfd = base_process_service_test::get_pidfd(&p);
+    assert(pidfd != -1);
+    assert(event_loop.regd_fd_watchers.count(pidfd) == 1);
+
+    // Daemon terminates unexpectedly:
+    event_loop.regd_fd_watchers[pidfd]->fd_event(event_loop, pidfd, dasynq::IN_EVENTS);
+    assert(p.get_state() == service_state_t::STOPPED);
+    assert(base_process_service_test::get_pidfd(&p) == -1);
+    assert(event_loop.regd_fd_watchers.count(pidfd) == 0);
+
+    // Start again, and then stop; the daemon is signalled, and the service stops once it terminates:
+    p.start();
+    sset.process_queues();
+    base_process_service_test::exec_succeeded(&p);
+    sset.process_queues();
+
+    supply_pid_contents("/run/daemon.pid", &daemon_instance);
+    bp_sys::non_child_pid = daemon_instance;
+
+    base_process_service_test::handle_exit(&p, 0);
+    assert(p.get_state() == service_state_t::STARTED);
+    pidfd = base_process_service_test::get_pidfd(&p);
+    assert(pidfd != -1);
+
+    bp_sys::last_sig_sent = -1;
+    p.stop(true);
+    sset.process_queues();
+    assert(p.get_state() == service_state_t::STOPPING);
+    assert(bp_sys::last_sig_sent == SIGTERM);
+
+    event_loop.regd_fd_watchers[pidfd]->fd_event(event_loop, pidfd, dasynq::IN_EVENTS);
+    assert(p.get_state() == service_state_t::STOPPED);
+    assert(base_process_service_test::get_pidfd(&p) == -1);
+    assert(event_loop.active_timers.size() == 0);
+
+    bp_sys::non_child_pid = -1;
+    sset.remove_service(&p);
+}
+#endif
+
+#if SUPPORT_CGROUPS
+// Stopping a service with kill-cgroup: remaining processes in the cgroup are killed via cgroup.kill,
+// and the service is stopped once cgroup.events reports that the cgroup is empty.
+void test_proc_cgroup_kill()
+{
+    using namespace std;
+
+    service_set sset;
+
+    ha_string command = "test-command";
+    list<pair<unsigned,unsigned>> command_offsets;
+    command_offsets.emplace_back(0, command.length());
+    std::list<prelim_dep> depends;
+
+    process_service p {&sset, "testproc", std::move(command), command_offsets, depends};
+    init_service_defaults(p);
+    p.set_cgroup("/test-cgroup");
+    service_flags_t flags;
+    flags.kill_cgroup = true;
+    p.set_flags(flags);
+    sset.add_service(&p);
+
+    const char *events_path = "/sys/fs/cgroup/test-cgroup/cgroup.events";
+    const char *kill_path = "/sys/fs/cgroup/test-cgroup/cgroup.kill";
+    bp_sys::supply_file_content(events_path, "populated 1\nfrozen 0\n");
+    bp_sys::supply_file_content(kill_path, "");
+
+    p.start();
+    sset.process_queues();
+    base_process_service_test::exec_succeeded(&p);
+    sset.process_queues();
+    assert(p.get_state() == service_state_t::STARTED);
+
+    p.stop(true);
+    sset.process_queues();
+    assert(p.get_state() == service_state_t::STOPPING);
+    assert(bp_sys::last_sig_sent == SIGTERM);
+
+    // Stop timeout: the cgroup is killed (rather than signalling the process group):
+    event_loop.advance_time(time_val {10, 0});
+    sset.process_queues();
+    assert(p.get_state() == service_state_t::STOPPING);
+    assert(bp_sys::last_sig_sent == SIGTERM);
+    std::vector<char> kill_content;
+    assert(bp_sys::get_file_content(kill_path, kill_content));
+    assert(kill_content == std::vector<char>{'1'});
+    bp_sys::supply_file_content(kill_path, "");
+
+    // Process terminates, but cgroup is still populated:
+    base_process_service_test::handle_exit(&p, 0);
+    sset.process_queues();
+    assert(p.get_state() == service_state_t::STOPPING);
+    int events_fd = base_process_service_test::get_cgroup_events_fd(&p);
+    assert(events_fd != -1);
+    assert(event_loop.regd_fd_watchers.count(events_fd) == 1);
+    assert(bp_sys::get_file_content(kill_path, kill_content));
+    assert(kill_content == std::vector<char>{'1'});
+
+    // A change that doesn't empty the cgroup:
+    bp_sys::supply_read_data(events_fd, {'x'});
+    event_loop.regd_fd_watchers[events_fd]->fd_event(event_loop, events_fd, dasynq::IN_EVENTS);
+    assert(p.get_state() == service_state_t::STOPPING);
+
+    // The cgroup empties:
+    bp_sys::supply_file_content(events_path, "populated 0\nfrozen 0\n");
+    bp_sys::supply_read_data(events_fd, {'x'});
+    event_loop.regd_fd_watchers[events_fd]->fd_event(event_loop, events_fd, dasynq::IN_EVENTS);
+    assert(p.get_state() == service_state_t::STOPPED);
+    assert(base_process_service_test::get_cgroup_events_fd(&p) == -1);
+    assert(event_loop.regd_fd_watchers.count(events_fd) == 0);
+    assert(event_loop.active_timers.size() == 0);
+
+    // Start again; this time the cgroup never empties, and we give up after the stop timeout:
+    bp_sys::supply_file_content(events_path, "populated 1\nfrozen 0\n");
+    p.start();
+    sset.process_queues();
+    base_process_service_test::exec_succeeded(&p);
+    sset.process_queues();
+    assert(p.get_state() == service_state_t::STARTED);
+
+    p.stop(true);
+    sset.process_queues();
+    base_process_service_test::handle_exit(&p, 0);
+    sset.process_queues();
+    assert(p.get_state() == service_state_t::STOPPING);
+    assert(base_process_service_test::get_cgroup_events_fd(&p) != -1);
+
+    event_loop.advance_time(time_val {10, 0});
+    sset.process_queues();
+    assert(p.get_state() == service_state_t::STOPPED);
+    assert(base_process_service_test::get_cgroup_events_fd(&p) == -1);
+    assert(event_loop.active_timers.size() == 0);
+
+    sset.remove_service(&p);
+}
+
+// Test creation of a service cgroup, applying resource settings, and reading resource usage
+void test_proc_cgroup_create()
+{
+    using namespace std;
+
+    service_set sset;
+
+    ha_string command = "test-command";
+    list<pair<unsigned,unsigned>> command_offsets;
+    command_offsets.emplace_back(0, command.length());
+    std::list<prelim_dep> depends;
+
+    process_service p {&sset, "testcg", std::move(command), command_offsets, depends};
+    init_service_defaults(p);
+    p.set_cgroup("/testcg");
+    service_flags_t flags;
+    flags.create_cgroup = true;
+    p.set_flags(flags);
+    sset.add_service(&p);
+
+    const char *subtree_path = "/sys/fs/cgroup/cgroup.subtree_control";
+    bp_sys::supply_file_content(subtree_path, "");
+
+    // No resource settings; the cgroup doesn't exist yet, and is created:
+    p.start();
+    sset.process_queues();
+    assert(base_process_service_test::get_cgroup_created(&p));
+    base_process_service_test::exec_succeeded(&p);
+    sset.process_queues();
+    assert(p.get_state() == service_state_t::STARTED);
+
+    std::vector<char> content;
+    assert(bp_sys::get_file_content(subtree_path, content));
+    assert(content == (std::vector<char>{'+', 'p', 'i', 'd', 's'}));
+
+    // No accounting files (controllers not available): no usage reported
+    service_resource_usage usage;
+    assert(p.get_resource_usage(usage));
+    assert(usage.flags == 0);
+
+    bp_sys::supply_file_content("/sys/fs/cgroup/testcg/cpu.stat",
+            "usage_usec 2500000\nuser_usec 2000000\nsystem_usec 500000\n");
+    bp_sys::supply_file_content("/sys/fs/cgroup/testcg/memory.current", "1048576\n");
+    bp_sys::supply_file_content("/sys/fs/cgroup/testcg/pids.current", "3\n");
+    assert(p.get_resource_usage(usage));
+    assert(usage.flags == (service_resource_usage::HAVE_CPU | service_resource_usage::HAVE_MEMORY
+            | service_resource_usage::HAVE_PIDS));
+    assert(usage.cpu_usec == 2500000);
+    assert(usage.memory_bytes == 1048576);
+    assert(usage.pids == 3);
+
+    p.stop(true);
+    sset.process_queues();
+    base_process_service_test::handle_exit(&p, 0);
+    sset.process_queues();
+    assert(p.get_state() == service_state_t::STOPPED);
+    assert(!base_process_service_test::get_cgroup_created(&p));
+
+    // With resource settings; the cgroup exists already (so is not removed on stop):
+    p.set_cgroup_limits(64 * 1024 * 1024, 50, 200);
+    bp_sys::supply_file_content("/sys/fs/cgroup/testcg/memory.max", "max\n");
+    bp_sys::supply_file_content("/sys/fs/cgroup/testcg/cpu.weight", "100\n");
+    bp_sys::supply_file_content("/sys/fs/cgroup/testcg/io.weight", "default 100\n");
+
+    p.start();
+    sset.process_queues();
+    assert(!base_process_service_test::get_cgroup_created(&p));
+    base_process_service_test::exec_succeeded(&p);
+    sset.process_queues();
+    assert(p.get_state() == service_state_t::STARTED);
+
+    assert(bp_sys::get_file_content("/sys/fs/cgroup/testcg/memory.max", content));
+    assert(std::string(content.begin(), content.end()) == "67108864");
+    assert(bp_sys::get_file_content("/sys/fs/cgroup/testcg/cpu.weight", content));
+    assert(std::string(content.begin(), content.end()) == "50");
+    assert(bp_sys::get_file_content("/sys/fs/cgroup/testcg/io.weight", content));
+    assert(std::string(content.begin(), content.end()) == "default 200");
+
+    p.stop(true);
+    sset.process_queues();
+    base_process_service_test::handle_exit(&p, 0);
+    sset.process_queues();
+    assert(p.get_state() == service_state_t::STOPPED);
+
+    // A resource setting that can't be applied causes the service to fail to start:
+    p.set_cgroup("/testcg2");
+    p.set_cgroup_limits(std::numeric_limits<uint64_t>::max(), 0, 0);
+    p.start();
+    sset.process_queues();
+    assert(p.get_state() == service_state_t::STOPPED);
+    assert(!base_process_service_test::get_cgroup_created(&p));
+
+    assert(event_loop.active_timers.size() == 0);
+    sset.remove_service(&p);
+}
+#endif
+
 #define RUN_TEST(name, spacing) \
     std::cout << #name "..." spacing << std::flush; \
     name(); \
@@ -2877,4 +3578,17 @@ int main(int argc, char **argv)
     RUN_TEST(test_scripted_start_skip2, "  ");
     RUN_TEST(test_waitsfor_restart, "      ");
     RUN_TEST(test_prepared_by_restart, "   ");
+    RUN_TEST(test_proc_log_buffer_ring, "  ");
+    RUN_TEST(test_proc_log_rotate, "       ");
+    RUN_TEST(test_proc_log_rotate_compress, "");
+    RUN_TEST(test_proc_batch_dispatch, "   ");
+    RUN_TEST(test_proc_env_cached, "       ");
+    RUN_TEST(test_proc_restart_backoff, "  ");
+    #if SUPPORT_CGROUPS
+    RUN_TEST(test_proc_cgroup_kill, "      ");
+    RUN_TEST(test_proc_cgroup_create, "    ");
+    #endif
+    #if SUPPORT_PIDFD
+    RUN_TEST(test_bgproc_pidfd, "          ");
+    #endif
 }
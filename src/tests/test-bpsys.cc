@@ -45,6 +45,7 @@ class fs_node
     virtual fs_node *create_file(const char *name) = 0;
     virtual bool set_file_content(std::vector<char> &&content) = 0;
     virtual const std::vector<char> *get_file_content() = 0;
+    virtual bool remove(const char *name) = 0;
     virtual ~fs_node() {}
 };
 
@@ -81,6 +82,12 @@ class file_fs_node : public fs_node
     {
         return &contents;
     }
+
+    bool remove(const char *name) override
+    {
+        errno = ENOTDIR;
+        return false;
+    }
 };
 
 class dir_fs_node : public fs_node
@@ -132,6 +139,17 @@ class dir_fs_node : public fs_node
         errno = EISDIR;
         return nullptr;
     }
+
+    bool remove(const char *name) override
+    {
+        auto i = entries.find(std::string(name));
+        if (i == entries.end()) {
+            errno = ENOENT;
+            return false;
+        }
+        entries.erase(i);
+        return true;
+    }
 };
 
 // Handle operations on a file descriptor
@@ -146,6 +164,8 @@ class fd_handler
     virtual void supply_data(std::vector<char> &&data) = 0;
     // for resolving against (openat etc)
     virtual fs_node *get_fs_node() { return nullptr; }
+    // the file the fd is open on, if any
+    virtual fs_node *get_file_node() { return nullptr; }
 
     virtual ~fd_handler() {}
 };
@@ -154,10 +174,11 @@ class file_fd_handler : public fd_handler
 {
     public:
     read_cond rrs;
+    fs_node *file_node = nullptr;
 
     file_fd_handler() {}
 
-    file_fd_handler(fs_node *fsnode)
+    file_fd_handler(fs_node *fsnode) : file_node(fsnode)
     {
         const auto *file_content_ptr = fsnode->get_file_content();
         if (file_content_ptr == nullptr) {
@@ -213,9 +234,37 @@ class file_fd_handler : public fd_handler
         return true;
     }
 
+    fs_node *get_file_node() override
+    {
+        return file_node;
+    }
+
     virtual ~file_fd_handler() override {}
 };
 
+// Write handler for an open file: written data replaces the file content (or, if opened for
+// append, is added to the original content)
+class file_write_handler : public bp_sys::default_write_handler
+{
+    fs_node *node;
+
+    public:
+    file_write_handler(fs_node *node_p, bool append = false) : node(node_p)
+    {
+        if (append) {
+            data = *node->get_file_content();
+        }
+    }
+
+    ssize_t write(int fd, const void *buf, size_t count) override
+    {
+        default_write_handler::write(fd, buf, count);
+        std::vector<char> content = data;
+        node->set_file_content(std::move(content));
+        return count;
+    }
+};
+
 class dir_fd_handler : public fd_handler
 {
     fs_node *node;
@@ -259,6 +308,10 @@ std::map<int, std::shared_ptr<bp_sys::write_handler>> write_hndlr_map;
 // environment variables, in "NAME=VALUE" form
 std::vector<char *> env_vars;
 
+// inotify watch descriptors, by watched path
+std::map<std::string, int> inotify_watches;
+int last_inotify_wd = 0;
+
 } // anon namespace
 
 namespace bp_sys {
@@ -267,6 +320,7 @@ char **environ = nullptr;
 
 int last_sig_sent = -1; // last signal number sent, accessible for tests.
 pid_t last_forked_pid = 1;  // last forked process id (incremented each 'fork')
+pid_t non_child_pid = -1;
 
 // Test helper methods:
 
@@ -453,6 +507,16 @@ void supply_file_content(const std::string &path, const std::vector<char> &data)
     supply_file_content(path, std::move(data_copy));
 }
 
+bool get_file_content(const std::string &path, std::vector<char> &data)
+{
+    fs_node *node = resolve_path(path);
+    if (node == nullptr) return false;
+    const auto *content = node->get_file_content();
+    if (content == nullptr) return false;
+    data = *content;
+    return true;
+}
+
 void supply_file_content(const std::string &path, const std::string &data)
 {
     std::vector<char> vec_data;
@@ -469,20 +533,25 @@ void supply_file_content(const std::string &path, const std::string &data)
 int open(const char *pathname, int flags)
 {
     fs_node *node = resolve_path(pathname);
+    if (node == nullptr && (flags & O_CREAT) != 0) {
+        node = find_or_create_dir_file(pathname);
+    }
     if (node == nullptr) {
         errno = ENOENT;
         return -1;
     }
 
     fd_handler *hndlr;
+    int nfd;
     if (node->get_file_content() != nullptr) {
         hndlr = new file_fd_handler(node);
+        nfd = allocfd(new file_write_handler(node, (flags & O_APPEND) != 0));
     }
     else {
         hndlr = new dir_fd_handler(node);
+        nfd = allocfd();
     }
 
-    int nfd = allocfd();
     fd_handlers[nfd] = std::shared_ptr<fd_handler>(hndlr);
     return nfd;
 }
@@ -518,7 +587,13 @@ int openat(int dirfd, const char *pathname, int flags)
         return -1;
     }
 
-    fd_handler *hndlr = new file_fd_handler(resolved);
+    fd_handler *hndlr;
+    if (resolved->get_file_content() != nullptr) {
+        hndlr = new file_fd_handler(resolved);
+    }
+    else {
+        hndlr = new dir_fd_handler(resolved);
+    }
 
     int nfd = allocfd();
     fd_handlers[nfd] = std::shared_ptr<fd_handler>(hndlr);
@@ -611,6 +686,171 @@ ssize_t writev(int fd, const struct iovec *iov, int iovcnt)
     return r;
 }
 
+int fstat(int fd, struct stat *statbuf)
+{
+    auto i = fd_handlers.find(fd);
+    if (i == fd_handlers.end()) {
+        errno = EBADF;
+        return -1;
+    }
+    fs_node *node = i->second->get_file_node();
+    if (node == nullptr) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    *statbuf = {};
+    statbuf->st_mode = S_IFREG;
+    statbuf->st_size = node->get_file_content()->size();
+    return 0;
+}
+
+// Split a path into the parent directory node and the final component
+static fs_node *resolve_parent(const std::string &path, std::string &name)
+{
+    auto slash_pos = path.rfind('/');
+    if (slash_pos == std::string::npos) {
+        name = path;
+        if (current_dir_node == nullptr) {
+            current_dir_node = new dir_fs_node();
+        }
+        return current_dir_node;
+    }
+    name = path.substr(slash_pos + 1);
+    if (slash_pos == 0) {
+        if (root_dir_hndlr == nullptr) {
+            root_dir_hndlr = new dir_fs_node();
+        }
+        return root_dir_hndlr;
+    }
+    return resolve_path(path.substr(0, slash_pos));
+}
+
+int unlink(const char *pathname)
+{
+    std::string name;
+    fs_node *parent = resolve_parent(pathname, name);
+    if (parent == nullptr) {
+        errno = ENOENT;
+        return -1;
+    }
+    fs_node *node = parent->resolve(name.c_str());
+    if (node == nullptr) {
+        errno = ENOENT;
+        return -1;
+    }
+    if (node->get_file_content() == nullptr) {
+        errno = EISDIR;
+        return -1;
+    }
+    return parent->remove(name.c_str()) ? 0 : -1;
+}
+
+int rename(const char *oldpath, const char *newpath)
+{
+    fs_node *node = resolve_path(oldpath);
+    if (node == nullptr) {
+        errno = ENOENT;
+        return -1;
+    }
+    const std::vector<char> *content = node->get_file_content();
+    if (content == nullptr) {
+        errno = EISDIR;
+        return -1;
+    }
+
+    fs_node *new_node = find_or_create_dir_file(newpath);
+    if (new_node == nullptr || !new_node->set_file_content(std::vector<char>(*content))) {
+        return -1;
+    }
+    return unlink(oldpath);
+}
+
+int mkdir(const char *pathname, mode_t mode)
+{
+    if (resolve_path(pathname) != nullptr) {
+        errno = EEXIST;
+        return -1;
+    }
+    if (find_or_create_dir_file(pathname, false) == nullptr) {
+        errno = ENOENT;
+        return -1;
+    }
+    return 0;
+}
+
+int rmdir(const char *pathname)
+{
+    if (resolve_path(pathname) == nullptr) {
+        errno = ENOENT;
+        return -1;
+    }
+    return 0;
+}
+
+int inotify_init1(int flags)
+{
+    int nfd = allocfd();
+    auto *hndlr = new file_fd_handler();
+    hndlr->set_blocking(true);
+    fd_handlers[nfd] = std::shared_ptr<fd_handler>(hndlr);
+    return nfd;
+}
+
+int inotify_add_watch(int fd, const char *pathname, uint32_t mask)
+{
+    if (resolve_path(pathname) == nullptr) {
+        errno = ENOENT;
+        return -1;
+    }
+    auto i = inotify_watches.find(pathname);
+    if (i != inotify_watches.end()) {
+        return i->second;
+    }
+    int wd = ++last_inotify_wd;
+    inotify_watches[pathname] = wd;
+    return wd;
+}
+
+int inotify_rm_watch(int fd, int wd)
+{
+    for (auto i = inotify_watches.begin(); i != inotify_watches.end(); ++i) {
+        if (i->second == wd) {
+            inotify_watches.erase(i);
+            return 0;
+        }
+    }
+    errno = EINVAL;
+    return -1;
+}
+
+int get_inotify_watch(const char *pathname)
+{
+    auto i = inotify_watches.find(pathname);
+    return (i != inotify_watches.end()) ? i->second : -1;
+}
+
+int pidfd_open(pid_t pid, unsigned flags)
+{
+    int nfd = allocfd();
+    auto *hndlr = new file_fd_handler();
+    hndlr->set_blocking(true);
+    fd_handlers[nfd] = std::shared_ptr<fd_handler>(hndlr);
+    return nfd;
+}
+
+int pidfd_send_signal(int pidfd, int sig, siginfo_t *info, unsigned flags)
+{
+    if (fd_handlers.find(pidfd) == fd_handlers.end()) {
+        errno = EBADF;
+        return -1;
+    }
+    if (sig != 0) {
+        last_sig_sent = sig;
+    }
+    return 0;
+}
+
 char *getenv(const char *name)
 {
     size_t name_len = strlen(name);
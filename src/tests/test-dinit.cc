@@ -1,3 +1,6 @@
+#include <string>
+
+#include "mconfig.h"
 #include "dasynq.h"
 #include "dinit.h"
 
@@ -8,6 +11,11 @@ eventloop_t event_loop;
 int active_control_conns = 0;
 bool external_log_open = false;
 
+#if SUPPORT_CGROUPS
+std::string cgroups_path;
+bool have_cgroups_path = false;
+#endif
+
 /*
 These are provided in header instead:
 
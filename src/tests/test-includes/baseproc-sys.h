@@ -5,7 +5,9 @@
 #include <vector>
 
 #include <cassert>
+#include <cerrno>
 #include <csignal>
+#include <cstdint>
 
 #include <sys/stat.h>
 #include <sys/types.h>
@@ -14,6 +16,10 @@
 #include <unistd.h>
 #include <fcntl.h>
 
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
+
 // Mock system functions for testing.
 
 namespace bp_sys {
@@ -52,6 +58,8 @@ void extract_written_data(int fd, std::vector<char> &data);
 void supply_file_content(const std::string &path, const std::vector<char> &data);
 void supply_file_content(const std::string &path, std::vector<char> &&data);
 void supply_file_content(const std::string &path, const std::string &data);
+// retrieve file content (including data written via an fd opened on the file)
+bool get_file_content(const std::string &path, std::vector<char> &data);
 
 // Mock system calls:
 
@@ -75,6 +83,23 @@ inline int fstatat(int dirfd, const char *pathname, struct stat *statbuf, int fl
     throw std::string("unexpected call to fstatat");
 }
 
+// fstat reports (only) the size of a file; fchown and fchmod do nothing.
+int fstat(int fd, struct stat *statbuf);
+
+inline int fchown(int fd, uid_t owner, gid_t group)
+{
+    return 0;
+}
+
+inline int fchmod(int fd, mode_t mode)
+{
+    return 0;
+}
+
+// rename and unlink work only on files (not directories).
+int rename(const char *oldpath, const char *newpath);
+int unlink(const char *pathname);
+
 inline ssize_t readlinkat(int dirfd, const char *pathname, char *buf, size_t bufsize)
 {
     throw std::string("unexpected call to readlinkat");
@@ -147,10 +172,17 @@ class exit_status
     }
 };
 
+// A process id which waitid reports as not being a child process (ECHILD), for tests:
+extern pid_t non_child_pid;
+
 inline int waitid(idtype_t idtype, id_t id, siginfo_t *info_p, int options)
 {
     assert(idtype == P_PID);
     assert((options & WNOHANG) != 0);
+    if ((pid_t)id == non_child_pid) {
+        errno = ECHILD;
+        return -1;
+    }
     // TODO complete mock
     return 0; // return success with no pid, i.e. process hasn't terminated
 }
@@ -159,8 +191,36 @@ ssize_t read(int fd, void *buf, size_t count);
 ssize_t write(int fd, const void *buf, size_t count);
 ssize_t writev (int fd, const struct iovec *iovec, int count);
 
+// mkdir creates a directory in the mock filesystem (EEXIST if the path exists); rmdir always
+// succeeds for an existing path, but leaves the node in place.
+int mkdir(const char *pathname, mode_t mode);
+int rmdir(const char *pathname);
+
+// inotify: the returned fd has no data to read (EAGAIN) until some is supplied via supply_read_data;
+// a watch can be added for any existing path. Each path is given a distinct watch descriptor, which
+// can be retrieved via get_inotify_watch (-1 if the path isn't watched).
+int inotify_init1(int flags);
+int inotify_add_watch(int fd, const char *pathname, uint32_t mask);
+int inotify_rm_watch(int fd, int wd);
+int get_inotify_watch(const char *pathname);
+
+// pidfd: the returned fd has no data to read; a signal sent via pidfd_send_signal is recorded
+// as for kill (other than signal 0, which is ignored).
+int pidfd_open(pid_t pid, unsigned flags);
+int pidfd_send_signal(int pidfd, int sig, siginfo_t *info, unsigned flags);
+
 extern char **environ;
 char *getenv(const char *name);
+
+// Like fork (in the mock event loop), the child function is not actually run:
+extern pid_t last_forked_pid;
+constexpr bool have_vfork_call = true;
+
+inline pid_t vfork_call(int (*fn)(void *), void *arg) noexcept
+{
+    return ++last_forked_pid;
+}
+
 int setenv(const char *name, const char *value, int overwrite);
 int clearenv();
 
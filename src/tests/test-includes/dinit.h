@@ -24,7 +24,7 @@ class eventloop_t
     time_val current_time {0, 0};
 
     public:
-    void get_time(time_val &tv, dasynq::clock_type clock) noexcept
+    void get_time(time_val &tv, dasynq::clock_type clock, bool force_update = false) noexcept
     {
         tv = current_time;
     }
@@ -87,6 +87,11 @@ class eventloop_t
             return bp_sys::last_forked_pid;
         }
 
+        void reserve_watch(eventloop_t &eloop)
+        {
+
+        }
+
         void add_reserved(eventloop_t &eloop, pid_t child, int prio = dasynq::DEFAULT_PRIORITY) noexcept
         {
 
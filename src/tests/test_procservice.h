@@ -47,6 +47,46 @@ class base_process_service_test
     {
         return bsp->notification_fd;
     }
+
+    static int get_log_input_fd(base_process_service *bsp)
+    {
+        return bsp->log_input_fd;
+    }
+
+    static pid_t get_log_compress_pid(base_process_service *bsp)
+    {
+        return bsp->logfile_compress_pid;
+    }
+
+    static void handle_log_compress_exit(base_process_service *bsp)
+    {
+        bsp->compress_listener.status_change(event_loop, bsp->logfile_compress_pid,
+                eventloop_t::child_proc_watcher::proc_status_t(CLD_EXITED, 0));
+    }
+
+    static const run_proc_env &get_start_proc_env(base_process_service *bsp)
+    {
+        return bsp->start_proc_env;
+    }
+
+    #if SUPPORT_CGROUPS
+    static int get_cgroup_events_fd(base_process_service *bsp)
+    {
+        return bsp->cgroup_events_fd;
+    }
+
+    static bool get_cgroup_created(base_process_service *bsp)
+    {
+        return bsp->cgroup_created;
+    }
+    #endif
+
+    #if SUPPORT_PIDFD
+    static int get_pidfd(base_process_service *bsp)
+    {
+        return bsp->pidfd;
+    }
+    #endif
 };
 
 namespace bp_sys {
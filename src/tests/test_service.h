@@ -10,6 +10,7 @@ class test_service : public service_record
     public:
     bool bring_up_reqd = false;
     bool start_interruptible = false;
+    bool uses_start_slot = false;  // whether subject to the start limit (as for process services)
 
     test_service(service_set *set, std::string name, service_type_t type_p,
             const std::list<prelim_dep> &deplist_p)
@@ -28,6 +29,11 @@ class test_service : public service_record
         return true;
     }
 
+    bool needs_start_slot() noexcept override
+    {
+        return uses_start_slot;
+    }
+
     // All dependents have stopped.
     virtual void bring_down() noexcept override
     {
@@ -1,4 +1,7 @@
 #include <iostream>
+#include <algorithm>
+#include <string>
+#include <vector>
 
 #include <cerrno>
 #include <cassert>
@@ -6,6 +9,8 @@
 #include "service.h"
 #include "test_service.h"
 #include "baseproc-sys.h"
+#include "log-arena.h"
+#include "dinit-journal.h"
 
 #ifdef NDEBUG
 #error "This file must be built with assertions ENABLED!"
@@ -1882,6 +1887,309 @@ void test_release_from_failed()
     assert(s3->get_state() == service_state_t::STOPPED);
 }
 
+// Service lookup by name remains correct through add/replace/unload (including where a
+// placeholder takes the place of an unloaded service).
+void test_find_service1()
+{
+    service_set sset;
+
+    service_record *s1 = new service_record(&sset, "test-service-1", service_type_t::INTERNAL, {});
+    service_record *s2 = new service_record(&sset, "test-service-2", service_type_t::INTERNAL, {{s1, AFTER}});
+    service_record *s3 = new service_record(&sset, "test-service-3", service_type_t::INTERNAL, {});
+    sset.add_service(s1);
+    sset.add_service(s2);
+    sset.add_service(s3);
+
+    assert(sset.find_service("test-service-1") == s1);
+    assert(sset.find_service("test-service-2") == s2);
+    assert(sset.find_service("test-service-3") == s3);
+    assert(sset.find_service("test-service-4") == nullptr);
+
+    // Replace s3 with a new record of the same name
+    service_record *s3r = new service_record(&sset, "test-service-3", service_type_t::INTERNAL, {});
+    sset.replace_service(s3, s3r);
+    delete s3;
+    assert(sset.find_service("test-service-3") == s3r);
+
+    // Unloading s1 leaves a placeholder (due to the "after" dependency from s2), which is found only
+    // when placeholders are requested.
+    sset.unload_service(s1);
+    assert(sset.find_service("test-service-1") == nullptr);
+    service_record *ph = sset.find_service("test-service-1", true);
+    assert(ph != nullptr);
+    assert(ph->get_type() == service_type_t::PLACEHOLDER);
+    assert(s2->get_dependencies().front().get_to() == ph);
+
+    // Unloading s2 also removes the (now unreferenced) placeholder
+    sset.unload_service(s2);
+    assert(sset.find_service("test-service-2") == nullptr);
+    assert(sset.find_service("test-service-1", true) == nullptr);
+    assert(sset.list_services().size() == 1);
+
+    sset.remove_service(s3r);
+    delete s3r;
+    assert(sset.find_service("test-service-3") == nullptr);
+}
+
+// Start limit: services beyond the limit wait for a start slot, and are dispatched in order of
+// priority (and then of waiting dependents).
+void test_start_limit()
+{
+    service_set sset;
+    sset.set_start_limit(1);
+
+    test_service *s1 = new test_service(&sset, "test-service-1", service_type_t::INTERNAL, {});
+    test_service *s2 = new test_service(&sset, "test-service-2", service_type_t::INTERNAL, {});
+    test_service *s3 = new test_service(&sset, "test-service-3", service_type_t::INTERNAL, {});
+    test_service *s4 = new test_service(&sset, "test-service-4", service_type_t::INTERNAL, {});
+    test_service *s5 = new test_service(&sset, "test-service-5", service_type_t::INTERNAL, {{s4, REG}});
+    s5->uses_start_slot = false;
+    for (test_service *s : {s1, s2, s3, s4}) {
+        s->uses_start_slot = true;
+        sset.add_service(s);
+    }
+    sset.add_service(s5);
+    s2->set_start_priority(5);
+
+    sset.start_service(s1);
+    assert(s1->bring_up_reqd);
+    assert(sset.count_start_slots_used() == 1);
+
+    // s3, then s2 (with higher priority) and s4 (with a dependent waiting), must wait:
+    sset.start_service(s3);
+    sset.start_service(s2);
+    sset.start_service(s5);
+    assert(s3->get_state() == service_state_t::STARTING && s3->is_waiting_for_start_slot());
+    assert(s2->get_state() == service_state_t::STARTING && s2->is_waiting_for_start_slot());
+    assert(s4->get_state() == service_state_t::STARTING && s4->is_waiting_for_start_slot());
+    assert(!s2->bring_up_reqd && !s3->bring_up_reqd && !s4->bring_up_reqd);
+
+    // s2 is dispatched first when s1 starts:
+    s1->started();
+    sset.process_queues();
+    assert(s2->bring_up_reqd);
+    assert(!s3->bring_up_reqd && !s4->bring_up_reqd);
+    assert(sset.count_start_slots_used() == 1);
+
+    // Then s4 (ahead of s3, as s5 is waiting for it):
+    s2->failed_to_start();
+    sset.process_queues();
+    assert(s2->get_state() == service_state_t::STOPPED);
+    assert(s4->bring_up_reqd);
+    assert(!s3->bring_up_reqd);
+
+    // Stopping a service that is waiting for a slot removes it from the queue:
+    sset.stop_service(s3);
+    assert(s3->get_state() == service_state_t::STOPPED);
+    assert(!s3->is_waiting_for_start_slot());
+
+    s4->started();
+    sset.process_queues();
+    assert(s4->get_state() == service_state_t::STARTED);
+    assert(s5->bring_up_reqd);  // (not subject to the limit)
+    s5->started();
+    assert(!s3->bring_up_reqd);
+    assert(sset.count_start_slots_used() == 0);
+
+    // Raising the limit dispatches waiting services:
+    s3->bring_up_reqd = false;
+    sset.start_service(s3);
+    assert(s3->bring_up_reqd);
+    assert(sset.count_start_slots_used() == 1);
+    sset.start_service(s2);
+    assert(s2->is_waiting_for_start_slot());
+    sset.set_start_limit(0);
+    sset.process_queues();
+    assert(!s2->is_waiting_for_start_slot());
+    assert(sset.count_start_slots_used() == 2);
+
+    s2->started();
+    s3->started();
+    sset.process_queues();
+    assert(sset.count_start_slots_used() == 0);
+}
+
+// A service which starts on the console waits for a start slot before it queues for the console, and
+// the time at which its dependencies started is recorded once.
+void test_start_limit_console()
+{
+    service_set sset;
+    sset.set_start_limit(1);
+
+    // (a recorded time of 0 means "not reached", so make sure the simulated time isn't 0)
+    event_loop.advance_time(time_val(1, 0));
+
+    test_service *s1 = new test_service(&sset, "test-service-1", service_type_t::INTERNAL, {});
+    s1->uses_start_slot = true;
+    sset.add_service(s1);
+
+    test_service *s2 = new test_service(&sset, "test-service-2", service_type_t::INTERNAL, {});
+    s2->uses_start_slot = true;
+    service_flags_t s2_flags;
+    s2_flags.starts_on_console = true;
+    s2->set_flags(s2_flags);
+    sset.add_service(s2);
+
+    // s3 starts and runs on the console, and doesn't need a start slot:
+    test_service *s3 = new test_service(&sset, "test-service-3", service_type_t::INTERNAL, {});
+    service_flags_t s3_flags;
+    s3_flags.starts_on_console = true;
+    s3_flags.runs_on_console = true;
+    s3->set_flags(s3_flags);
+    sset.add_service(s3);
+
+    sset.start_service(s1);
+    assert(s1->bring_up_reqd);
+
+    // s2 must wait for a start slot, and is not yet queued for the console:
+    sset.start_service(s2);
+    sset.process_queues();
+    assert(s2->is_waiting_for_start_slot());
+    assert(!sset.is_queued_for_console(s2));
+    uint64_t deps_started_time = s2->get_start_time(start_stage_t::DEPS_STARTED);
+    assert(deps_started_time != 0);
+
+    // s3 queues for the console, and takes it:
+    sset.start_service(s3);
+    sset.process_queues();
+    assert(sset.is_queued_for_console(s3));
+    sset.pull_console_queue();
+    assert(s3->bring_up_reqd);
+
+    // s2 gets the slot when s1 starts, and then waits for the console:
+    event_loop.advance_time(time_val(1, 0));
+    s1->started();
+    sset.process_queues();
+    assert(!s2->is_waiting_for_start_slot());
+    assert(sset.count_start_slots_used() == 1);
+    assert(sset.is_queued_for_console(s2));
+    assert(!s2->bring_up_reqd);
+
+    // s2 gets the console when s3 stops:
+    event_loop.advance_time(time_val(1, 0));
+    s3->started();
+    sset.process_queues();
+    sset.stop_service(s3);
+    sset.process_queues();
+    assert(s3->get_state() == service_state_t::STOPPED);
+    assert(s2->bring_up_reqd);
+    assert(s2->get_start_time(start_stage_t::DEPS_STARTED) == deps_started_time);
+
+    s2->started();
+    sset.process_queues();
+    assert(sset.count_start_slots_used() == 0);
+    assert(sset.is_console_queue_empty());
+}
+
+// Check log arena growth, eviction of lower-priority messages, and discard counts
+void test_log_arena()
+{
+    log_arena arena;
+    arena.set_max_size(8192);
+
+    char msg[1000];
+    auto queue_msg = [&](unsigned priority, char fill) -> bool {
+        memset(msg, fill, sizeof(msg));
+        if (!arena.begin_msg(priority)) return false;
+        if (!arena.append(msg, sizeof(msg))) return false;
+        arena.commit();
+        return true;
+    };
+
+    // Fill with low-priority messages; the buffer should grow to the maximum size
+    for (int i = 0; i < 8; ++i) {
+        assert(queue_msg(1, 'a' + i));
+    }
+    assert(arena.get_capacity() == 8192);
+
+    // Full: a message of the same priority is discarded
+    assert(!queue_msg(1, 'x'));
+    assert(arena.get_discarded(1) == 1);
+    assert(arena.take_unreported_discards() == 1);
+
+    // A higher-priority message evicts the oldest lower-priority message
+    assert(queue_msg(3, 'E'));
+    assert(arena.get_discarded(1) == 2);
+    assert(arena.get_discarded(3) == 0);
+
+    size_t len;
+    const char *front = arena.front(len);
+    assert(len == 1000 && front[0] == 'b');
+
+    // A partially-consumed front message is not evicted
+    assert(!arena.consume(10));
+    assert(arena.is_partway());
+    assert(queue_msg(2, 'W'));
+    assert(arena.get_discarded(1) == 3);
+    front = arena.front(len);
+    assert(len == 990 && front[0] == 'b');
+    assert(arena.consume(990));
+
+    // Remaining messages are in order, excluding the evicted message 'c'
+    const char expected[] = "defghEW";
+    for (const char *e = expected; *e != 0; ++e) {
+        front = arena.front(len);
+        assert(len == 1000 && front[0] == *e && front[999] == *e);
+        assert(arena.consume(len));
+    }
+    assert(arena.empty());
+    assert(arena.take_unreported_discards() == 2);
+}
+
+// Check journal writing (with wrap-around), re-attaching, and detection of corrupt records
+void test_journal()
+{
+    alignas(8) static char data[4096];
+    memset(data, 0, sizeof(data));
+
+    journal_writer writer;
+    writer.attach(data, sizeof(data));
+    for (int i = 1; i <= 100; ++i) {
+        std::string text = "message " + std::to_string(i);
+        assert(writer.begin(journal_rec_type::MESSAGE, 1, "svc", 3));
+        writer.append(text.c_str(), text.length());
+        writer.commit(i * 1000u);
+    }
+
+    // Records should be the most recent, with no gaps, and have intact contents:
+    std::vector<uint64_t> seqs;
+    auto collect = [&](size_t offset, const journal_rec_hdr &hdr, const char *name,
+            const char *text, size_t text_len) {
+        assert(strncmp(name, "svc", 3) == 0);
+        std::string expected = "message " + std::to_string(hdr.seq);
+        assert(std::string(text, text_len) == expected);
+        assert(hdr.timestamp == hdr.seq * 1000u);
+        seqs.push_back(hdr.seq);
+    };
+    journal_scan(data, sizeof(data), collect);
+    std::sort(seqs.begin(), seqs.end());
+    assert(seqs.size() > 50 && seqs.back() == 100);
+    for (size_t i = 1; i < seqs.size(); ++i) {
+        assert(seqs[i] == seqs[i - 1] + 1);
+    }
+
+    // A new writer continues after the most recent record:
+    journal_writer writer2;
+    writer2.attach(data, sizeof(data));
+    assert(writer2.begin(journal_rec_type::DINIT_START, 1, nullptr, 0));
+    writer2.commit(0);
+    uint64_t max_seq = 0;
+    journal_scan(data, sizeof(data), [&](size_t offset, const journal_rec_hdr &hdr, const char *,
+            const char *, size_t) {
+        max_seq = std::max(max_seq, hdr.seq);
+    });
+    assert(max_seq == 101);
+
+    // A corrupted record is not seen as valid:
+    size_t num_valid = 0;
+    journal_scan(data, sizeof(data), [&](size_t, const journal_rec_hdr &, const char *, const char *,
+            size_t) { ++num_valid; });
+    data[sizeof(journal_rec_hdr) + 1] ^= 1;
+    size_t num_valid2 = 0;
+    journal_scan(data, sizeof(data), [&](size_t, const journal_rec_hdr &, const char *, const char *,
+            size_t) { ++num_valid2; });
+    assert(num_valid2 == num_valid - 1);
+}
 
 #define RUN_TEST(name, spacing) \
     std::cout << #name "..." spacing << std::flush; \
@@ -1936,4 +2244,9 @@ int main(int argc, char **argv)
     RUN_TEST(test_restart_stop3, "        ");
     RUN_TEST(test_restart_stop4, "        ");
     RUN_TEST(test_release_from_failed, "  ");
+    RUN_TEST(test_find_service1, "        ");
+    RUN_TEST(test_start_limit, "          ");
+    RUN_TEST(test_start_limit_console, "  ");
+    RUN_TEST(test_log_arena, "            ");
+    RUN_TEST(test_journal, "              ");
 }